@@ -0,0 +1,34 @@
+find_package(PkgConfig)
+PKG_CHECK_MODULES(PC_LIBURING "liburing")
+
+FIND_PATH(LIBURING_INCLUDE_DIRS
+    NAMES liburing.h
+    HINTS ${PC_LIBURING_INCLUDE_DIR}
+    ${CMAKE_INSTALL_PREFIX}/include
+    PATHS
+    /usr/local/include
+    /usr/include
+)
+
+FIND_LIBRARY(LIBURING_LIBRARIES
+    NAMES uring ${LIBURING_LIBRARY_NAME}
+    HINTS ${PC_LIBURING_LIBDIR}
+    ${CMAKE_INSTALL_PREFIX}/lib
+    ${CMAKE_INSTALL_PREFIX}/lib64
+    PATHS
+    ${LIBURING_INCLUDE_DIRS}/../lib
+    /usr/local/lib
+    /usr/lib
+)
+
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(LIBURING DEFAULT_MSG LIBURING_LIBRARIES LIBURING_INCLUDE_DIRS)
+MARK_AS_ADVANCED(LIBURING_LIBRARIES LIBURING_INCLUDE_DIRS)
+
+if (LIBURING_FOUND AND NOT TARGET liburing::liburing)
+  add_library(liburing::liburing INTERFACE IMPORTED)
+  set_target_properties(liburing::liburing PROPERTIES
+    INTERFACE_INCLUDE_DIRECTORIES "${LIBURING_INCLUDE_DIRS}"
+    INTERFACE_LINK_LIBRARIES "${LIBURING_LIBRARIES}"
+  )
+endif()
@@ -0,0 +1,385 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <iostream>
+#include <QHostAddress>
+#include <QMutexLocker>
+#include "iq_server.h"
+
+/* Longest request line */
+#define IQ_MAX_LINE 256
+
+static const struct
+{
+    const char   *name;
+    file_formats  format;
+} iq_formats[] = {
+    {"cf32", FILE_FORMAT_CF},
+    {"cs8",  FILE_FORMAT_CS8},
+    {"cs16", FILE_FORMAT_CS16L},
+    {"cs32", FILE_FORMAT_CS32L},
+    {"cu8",  FILE_FORMAT_CS8U},
+    {"cu16", FILE_FORMAT_CS16LU},
+    {"cu32", FILE_FORMAT_CS32LU},
+};
+
+IqServer::IqServer(QObject *parent) :
+    QObject(parent),
+    iq_server(this),
+    iq_udp(this),
+    iq_next_id(1),
+    iq_pump_timer(this),
+    iq_buf(IQ_MAX_BUFFER)
+{
+    connect(&iq_server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+    connect(&iq_pump_timer, SIGNAL(timeout()), this, SLOT(pump()));
+    iq_pump_timer.setInterval(IQ_PUMP_INTERVAL);
+}
+
+void IqServer::attach(quint64 client, iq_ring_sptr ring, double rate, int format)
+{
+    QMutexLocker locker(&iq_mutex);
+
+    iq_attached.append(Attached{client, ring, rate, format});
+    QMetaObject::invokeMethod(this, "processAttached", Qt::QueuedConnection);
+}
+
+/*! \brief Name of a sample format in the protocol, null if not supported. */
+const char *IqServer::formatName(int format)
+{
+    for (auto &f : iq_formats)
+        if (f.format == format)
+            return f.name;
+    return nullptr;
+}
+
+/*! \brief Start listening on all interfaces.
+ *  \param port The network port.
+ *  \returns True if the server is listening.
+ */
+bool IqServer::listen(int port)
+{
+    if (iq_server.isListening())
+        iq_server.close();
+
+    return iq_server.listen(QHostAddress::Any, port);
+}
+
+/*! \brief Stop listening and close all client connections. */
+void IqServer::close()
+{
+    while (!iq_clients.isEmpty())
+        dropClient(iq_clients.begin().key());
+
+    if (iq_server.isListening())
+        iq_server.close();
+}
+
+void IqServer::setHosts(QStringList hosts)
+{
+    iq_allowed_hosts = hosts;
+}
+
+void IqServer::acceptConnection()
+{
+    while (QTcpSocket *socket = iq_server.nextPendingConnection())
+    {
+        auto address = socket->peerAddress();
+        bool allowed = false;
+
+        for (auto allowed_host : iq_allowed_hosts)
+        {
+#if QT_VERSION < QT_VERSION_CHECK(5, 8, 0)
+            if (address == QHostAddress(allowed_host))
+#else
+            if (address.isEqual(QHostAddress(allowed_host)))
+#endif
+            {
+                allowed = true;
+                break;
+            }
+        }
+
+        if (!allowed)
+        {
+            std::cout << "*** I/Q stream connection attempt from " << address.toString().toStdString()
+                      << " (not in allowed list)" << std::endl;
+            socket->close();
+            socket->deleteLater();
+            continue;
+        }
+
+        quint64 id = iq_next_id++;
+        Client &client = iq_clients[id];
+
+        client.socket = socket;
+        client.buffer.clear();
+        client.requested = false;
+        client.udp_port = 0;
+        client.ring.reset();
+        client.pos = 0;
+        client.dropped = 0;
+        client.budget = IQ_MAX_BUFFER;
+        socket->setProperty("iq_client", id);
+        connect(socket, SIGNAL(readyRead()), this, SLOT(startRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(clientDisconnected()));
+    }
+}
+
+/*! \brief Read the request line of a client.
+ *
+ * Anything sent after the request is ignored.
+ */
+void IqServer::startRead()
+{
+    auto *socket = qobject_cast<QTcpSocket *>(sender());
+    quint64 id = socket ? socket->property("iq_client").toULongLong() : 0;
+    auto it = iq_clients.find(id);
+
+    if (it == iq_clients.end())
+        return;
+
+    QByteArray data = socket->readAll();
+
+    if (it->requested)
+        return;
+
+    it->buffer.append(data);
+
+    int eol = it->buffer.indexOf('\n');
+
+    if (eol < 0)
+    {
+        if (it->buffer.size() > IQ_MAX_LINE)
+            dropClient(id);
+        return;
+    }
+
+    QByteArray line = it->buffer.left(eol);
+    int vfo, stage, format;
+
+    it->buffer.clear();
+    if (!parseRequest(line, vfo, stage, format, it->udp_port))
+    {
+        socket->write("RPRT 1\n");
+        return;
+    }
+
+    it->requested = true;
+    emit streamRequested(id, vfo, stage, format);
+}
+
+void IqServer::clientDisconnected()
+{
+    auto *socket = qobject_cast<QTcpSocket *>(sender());
+
+    if (socket)
+        dropClient(socket->property("iq_client").toULongLong());
+}
+
+/*! \brief Start sending the streams passed to attach(). */
+void IqServer::processAttached()
+{
+    QList<Attached> attached;
+
+    {
+        QMutexLocker locker(&iq_mutex);
+        attached.swap(iq_attached);
+    }
+
+    for (auto &a : attached)
+    {
+        auto it = iq_clients.find(a.client);
+
+        if (it == iq_clients.end())
+        {
+            // Gone meanwhile, the stream has to be released
+            if (a.ring)
+                emit streamClosed(a.client);
+            continue;
+        }
+
+        if (!a.ring)
+        {
+            it->requested = false;
+            it->socket->write("RPRT 1\n");
+            continue;
+        }
+
+        // Keep up with the stream, the input stage can run at several
+        // 10 MB/s, but do not hold more than the ring itself
+        size_t item_size = a.ring->item_size();
+        size_t budget = size_t(a.rate * item_size * IQ_PUMP_INTERVAL * IQ_PUMP_HEADROOM / 1000.0);
+        budget = std::min(std::max(budget, size_t(IQ_MAX_BUFFER)), a.ring->capacity() / 2);
+        budget -= budget % item_size;
+        if (iq_buf.size() < budget)
+            iq_buf.resize(budget);
+
+        it->ring = a.ring;
+        it->pos = a.ring->head();
+        it->budget = budget;
+        it->socket->write(QString("IQ %1 %2 %3\n")
+                          .arg(qint64(a.rate))
+                          .arg(QLatin1String(formatName(a.format)))
+                          .arg(a.ring->item_size())
+                          .toLatin1());
+        if (!iq_pump_timer.isActive())
+            iq_pump_timer.start();
+    }
+}
+
+/*! \brief Send the new samples to the clients.
+ *
+ * TCP clients get at most their budget of unsent bytes, UDP clients as
+ * many datagrams as the budget, the rest waits in the ring. The budget
+ * holds IQ_PUMP_HEADROOM intervals of the stream, at least IQ_MAX_BUFFER.
+ */
+void IqServer::pump()
+{
+    bool streaming = false;
+    QList<quint64> closed;
+
+    for (auto it = iq_clients.begin(); it != iq_clients.end(); ++it)
+    {
+        auto &client = *it;
+
+        if (!client.ring)
+            continue;
+        // The sample rate has changed, the client reconnects
+        if (client.ring->closed())
+        {
+            closed.append(it.key());
+            continue;
+        }
+        streaming = true;
+
+        if (client.udp_port)
+        {
+            size_t n = client.ring->read(client.pos, iq_buf.data(), client.budget, client.dropped);
+            QHostAddress address = client.socket->peerAddress();
+
+            for (size_t sent = 0; sent < n; sent += IQ_UDP_PAYLOAD)
+                iq_udp.writeDatagram(iq_buf.data() + sent, std::min<size_t>(IQ_UDP_PAYLOAD, n - sent),
+                                     address, client.udp_port);
+        }
+        else
+        {
+            qint64 room = qint64(client.budget) - client.socket->bytesToWrite();
+
+            if (room <= 0)
+                continue;
+
+            size_t n = client.ring->read(client.pos, iq_buf.data(), size_t(room), client.dropped);
+
+            if (n > 0)
+                client.socket->write(iq_buf.data(), n);
+        }
+    }
+
+    for (quint64 id : closed)
+        dropClient(id);
+
+    if (!streaming)
+        iq_pump_timer.stop();
+}
+
+void IqServer::dropClient(quint64 id)
+{
+    auto it = iq_clients.find(id);
+
+    if (it == iq_clients.end())
+        return;
+
+    QTcpSocket *socket = it->socket;
+
+    // A requested stream may still be on its way to attach(), it is
+    // released in processAttached() then
+    if (it->ring)
+    {
+        if (it->dropped > 0)
+            std::cout << "I/Q stream client " << socket->peerAddress().toString().toStdString()
+                      << " lost " << it->dropped << " bytes" << std::endl;
+        emit streamClosed(id);
+    }
+    iq_clients.erase(it);
+    socket->disconnect(this);
+    socket->close();
+    socket->deleteLater();
+}
+
+/*
+ * Parse a request:
+ *   [vfo=<n>] [stage=input|baseband] [format=<format>] [udp=<port>]
+ * vfo -1 (the default) is the current VFO, the default stage is baseband,
+ * the default format cf32.
+ */
+bool IqServer::parseRequest(const QByteArray &line, int &vfo, int &stage, int &format,
+                            quint16 &udp_port)
+{
+    QString request = QString::fromLatin1(line).simplified();
+    QStringList args = request.isEmpty() ? QStringList() : request.split(' ');
+
+    vfo = -1;
+    stage = iq_stream_sink::STAGE_BASEBAND;
+    format = FILE_FORMAT_CF;
+    udp_port = 0;
+
+    for (auto &arg : args)
+    {
+        QString key = arg.section('=', 0, 0).toLower();
+        QString value = arg.section('=', 1).toLower();
+        bool ok = !value.isEmpty();
+
+        if (key == "vfo")
+        {
+            vfo = value.toInt(&ok);
+            ok &= (vfo >= -1);
+        }
+        else if (key == "udp")
+        {
+            udp_port = value.toUShort(&ok);
+            ok &= (udp_port > 0);
+        }
+        else if (key == "stage" && value == "input")
+            stage = iq_stream_sink::STAGE_INPUT;
+        else if (key == "stage" && value == "baseband")
+            stage = iq_stream_sink::STAGE_BASEBAND;
+        else if (key == "format")
+        {
+            ok = false;
+            for (auto &f : iq_formats)
+                if (value == f.name)
+                {
+                    format = f.format;
+                    ok = true;
+                }
+        }
+        else
+            ok = false;
+
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,131 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef IQ_SERVER_H
+#define IQ_SERVER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUdpSocket>
+#include <vector>
+#include "interfaces/iq_stream_sink.h"
+
+/* Least unsent bytes per TCP client, older samples are dropped in the ring. */
+#define IQ_MAX_BUFFER       (256 * 1024)
+/* Payload of the UDP datagrams, see udp_sink_f. */
+#define IQ_UDP_PAYLOAD      1024
+/* Time between two transfers from the rings to the clients in ms. */
+#define IQ_PUMP_INTERVAL    10
+/* Pump intervals of samples a client may have unsent, for late timer ticks. */
+#define IQ_PUMP_HEADROOM    4
+
+/*! \brief TCP server streaming the I/Q samples of the VFOs.
+ *
+ * Lives in the remote control thread. A client sends one request line
+ *
+ *   [vfo=<n>] [stage=input|baseband] [format=<format>] [udp=<port>]
+ *
+ * which is passed to the GUI thread with streamRequested(). The GUI thread
+ * starts the stream in the receiver and hands its ring to attach(). The
+ * client gets the line
+ *
+ *   IQ <rate> <format> <bytes per sample>
+ *
+ * followed by the samples, on the TCP connection or as UDP datagrams to
+ * <port> on the client host, or RPRT 1 if the request failed. Every client
+ * reads the shared ring from its own position. A client, that does not
+ * keep up, loses the oldest samples, the receiver never waits for it.
+ */
+class IqServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit IqServer(QObject *parent = 0);
+
+    /*! \brief Start sending a stream, may be called from any thread.
+     *  \param ring The ring of the stream, null if it could not be started.
+     */
+    void attach(quint64 client, iq_ring_sptr ring, double rate, int format);
+
+    static const char *formatName(int format);
+
+public slots:
+    bool listen(int port);
+    void close();
+    void setHosts(QStringList hosts);
+
+signals:
+    void streamRequested(quint64 client, int vfo, int stage, int format);
+    void streamClosed(quint64 client);
+
+private slots:
+    void acceptConnection();
+    void startRead();
+    void clientDisconnected();
+    void processAttached();
+    void pump();
+
+private:
+    struct Client
+    {
+        QTcpSocket *socket;
+        QByteArray  buffer;    /*!< Received data not parsed yet. */
+        bool        requested; /*!< The request line has been received. */
+        quint16     udp_port;  /*!< Send UDP datagrams to this port, 0 for TCP. */
+        iq_ring_sptr ring;     /*!< Null until the stream is attached. */
+        uint64_t    pos;       /*!< Read position in the ring. */
+        uint64_t    dropped;   /*!< Bytes lost, because the client was too slow. */
+        size_t      budget;    /*!< Most unsent bytes, scaled with the rate. */
+    };
+
+    struct Attached
+    {
+        quint64      client;
+        iq_ring_sptr ring;
+        double       rate;
+        int          format;
+    };
+
+    void dropClient(quint64 id);
+    static bool parseRequest(const QByteArray &line, int &vfo, int &stage, int &format,
+                             quint16 &udp_port);
+
+    QTcpServer                  iq_server;
+    QUdpSocket                  iq_udp;
+    QStringList                 iq_allowed_hosts;
+    QHash<quint64, Client>      iq_clients;
+    quint64                     iq_next_id;
+    QTimer                      iq_pump_timer;
+    std::vector<char>           iq_buf;       /*!< Transfer buffer of pump(). */
+
+    QMutex                      iq_mutex;     /*!< Protects iq_attached. */
+    QList<Attached>             iq_attached;  /*!< Streams passed to attach(). */
+};
+
+#endif // IQ_SERVER_H
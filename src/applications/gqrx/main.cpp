@@ -77,6 +77,17 @@ int main(int argc, char *argv[])
     else
         qDebug() << "Failed to disable controlport";
 
+    // Performance counters for the DSP load dock. Work time is measured as
+    // thread CPU time, so blocks waiting for the sound card do not look busy.
+    // They cost every work() call of every block two clock_gettime() calls
+    // and updating the running averages and variances of the items and the
+    // buffer fullness of each port, so the user can turn them off with
+    // GR_CONF_PERFCOUNTERS_ON=False.
+    if (!qEnvironmentVariableIsSet("GR_CONF_PERFCOUNTERS_ON"))
+        qputenv("GR_CONF_PERFCOUNTERS_ON", "True");
+    if (!qEnvironmentVariableIsSet("GR_CONF_PERFCOUNTERS_CLOCK"))
+        qputenv("GR_CONF_PERFCOUNTERS_CLOCK", "thread");
+
     QCommandLineParser parser;
     parser.setApplicationDescription("Gqrx software defined radio receiver " VERSION);
     parser.addHelpOption();
@@ -21,9 +21,10 @@
  * the Free Software Foundation, Inc., 51 Franklin Street,
  * Boston, MA 02110-1301, USA.
  */
+#include <cstring>
+#include <set>
 #include <string>
 #include <vector>
-#include <volk/volk.h>
 
 #include <QSettings>
 #include <QByteArray>
@@ -60,6 +61,7 @@ using namespace std::chrono_literals;
 /* DSP */
 #include "receiver.h"
 #include "remote_control_settings.h"
+#include "rx_settings.h"
 
 #include "qtgui/bookmarkstaglist.h"
 #include "qtgui/bandplan.h"
@@ -113,6 +115,10 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     meter_timer = new QTimer(this);
     connect(meter_timer, SIGNAL(timeout()), this, SLOT(meterTimeout()));
 
+    /* DSP load timer */
+    dsp_load_timer = new QTimer(this);
+    connect(dsp_load_timer, SIGNAL(timeout()), this, SLOT(dspLoadTimeout()));
+
     /* FFT timer & data */
     iq_fft_timer = new QTimer(this);
     connect(iq_fft_timer, SIGNAL(timeout()), this, SLOT(iqFftTimeout()));
@@ -142,6 +148,7 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     uiDockRxOpt = new DockRxOpt();
     uiDockRDS = new DockRDS();
     uiDockProbe = new DockProbe();
+    uiDockDspLoad = new DockDspLoad();
     uiDockAudio = new DockAudio();
     uiDockInputCtl = new DockInputCtl();
     uiDockFft = new DockFft();
@@ -192,10 +199,13 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     uiDockAudio->raise();
 
     addDockWidget(Qt::BottomDockWidgetArea, uiDockBookmarks);
+    addDockWidget(Qt::BottomDockWidgetArea, uiDockDspLoad);
+    tabifyDockWidget(uiDockBookmarks, uiDockDspLoad);
 
     /* hide docks that we don't want to show initially */
     uiDockBookmarks->hide();
     uiDockRDS->hide();
+    uiDockDspLoad->hide();
 
     /* Add dock widget actions to View menu. By doing it this way all signal/slot
        connections will be established automagially.
@@ -207,6 +217,7 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     ui->menu_View->addAction(uiDockFft->toggleViewAction());
     ui->menu_View->addAction(uiDockBookmarks->toggleViewAction());
     ui->menu_View->addAction(uiDockProbe->toggleViewAction());
+    ui->menu_View->addAction(uiDockDspLoad->toggleViewAction());
     ui->menu_View->addSeparator();
     ui->menu_View->addAction(ui->mainToolBar->toggleViewAction());
     ui->menu_View->addSeparator();
@@ -314,6 +325,8 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     connect(uiDockFft, SIGNAL(fftPeakHoldToggled(bool)), this, SLOT(setFftPeakHold(bool)));
     connect(uiDockFft, SIGNAL(peakDetectionToggled(bool)), this, SLOT(setPeakDetection(bool)));
     connect(uiDockRDS, SIGNAL(rdsDecoderToggled(bool)), this, SLOT(setRdsDecoder(bool)));
+    connect(uiDockDspLoad, SIGNAL(latencyProbesToggled(bool)), this, SLOT(setLatencyProbes(bool)));
+    connect(uiDockDspLoad, SIGNAL(latencyProfileChanged(int)), this, SLOT(setLatencyProfile(int)));
 
     // Bookmarks
     connect(uiDockBookmarks, SIGNAL(newBookmarkActivated(BookmarkInfo &)), this, SLOT(onBookmarkActivated(BookmarkInfo &)));
@@ -328,16 +341,20 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     connect(dxc_timer, SIGNAL(timeout()), this, SLOT(checkDXCSpotTimeout()));
 
     // I/Q playback
-    connect(iq_tool, SIGNAL(startRecording(QString, file_formats, int)), this, SLOT(startIqRecording(QString, file_formats, int)));
+    connect(iq_tool, SIGNAL(startRecording(QString, file_formats, int, bool)), this, SLOT(startIqRecording(QString, file_formats, int, bool)));
     connect(iq_tool, SIGNAL(stopRecording()), this, SLOT(stopIqRecording()));
     connect(iq_tool, SIGNAL(startPlayback(QString, float, qint64, file_formats, qint64, int, bool)),
                  this, SLOT(startIqPlayback(QString, float, qint64, file_formats, qint64, int, bool)));
     connect(iq_tool, SIGNAL(stopPlayback()), this, SLOT(stopIqPlayback()));
     connect(iq_tool, SIGNAL(seek(qint64)), this,SLOT(seekIqFile(qint64)));
-    connect(iq_tool, SIGNAL(saveFileRange(const QString &, file_formats, quint64,quint64)), this,SLOT(saveFileRange(const QString &, file_formats, quint64,quint64)));
+    connect(iq_tool, SIGNAL(playbackSpeedChanged(double)), this, SLOT(setIqPlaybackSpeed(double)));
+    connect(iq_tool, SIGNAL(saveFileRange(const QString &, file_formats, file_formats, quint64,quint64)), this,SLOT(saveFileRange(const QString &, file_formats, file_formats, quint64,quint64)));
 
     // remote control
     connect(remote, SIGNAL(newRDSmode(bool)), uiDockRDS, SLOT(setRDSmode(bool)));
+    connect(remote, SIGNAL(newLatencyProbes(bool)), uiDockDspLoad, SLOT(setLatencyProbes(bool)));
+    connect(remote, SIGNAL(newShmExport(bool)), this, SLOT(setShmExport(bool)));
+    connect(remote, SIGNAL(newLatencyProfile(int)), uiDockDspLoad, SLOT(setLatencyProfile(int)));
     connect(remote, SIGNAL(newFilterOffset(qint64)), this, SLOT(setFilterOffset(qint64)));
     connect(remote, SIGNAL(newFilterOffset(qint64)), uiDockRxOpt, SLOT(setFilterOffset(qint64)));
     connect(remote, SIGNAL(newFrequency(qint64)), this, SLOT(setNewFrequency(qint64)));
@@ -353,6 +370,9 @@ MainWindow::MainWindow(const QString& cfgfile, bool edit_conf, QWidget *parent)
     connect(remote, SIGNAL(stopAudioRecorderEvent()), this, SLOT(stopAudioRec()));
     connect(ui->plotter, SIGNAL(newFilterFreq(int, int)), remote, SLOT(setPassband(int, int)));
     connect(remote, SIGNAL(newPassband(int)), this, SLOT(setPassband(int)));
+    connect(remote, SIGNAL(newVfoChanges(RemoteVfoChanges)), this, SLOT(applyRemoteVfoChanges(RemoteVfoChanges)));
+    connect(remote, SIGNAL(newIqStream(quint64,int,int,int)), this, SLOT(startIqStream(quint64,int,int,int)));
+    connect(remote, SIGNAL(iqStreamClosed(quint64)), this, SLOT(stopIqStream(quint64)));
     connect(remote, SIGNAL(gainChanged(QString, double)), uiDockInputCtl, SLOT(setGain(QString,double)));
     connect(remote, SIGNAL(dspChanged(bool)), this, SLOT(on_actionDSP_triggered(bool)));
     connect(uiDockRDS, SIGNAL(rdsPI(QString)), remote, SLOT(rdsPI(QString)));
@@ -431,6 +451,9 @@ MainWindow::~MainWindow()
     meter_timer->stop();
     delete meter_timer;
 
+    dsp_load_timer->stop();
+    delete dsp_load_timer;
+
     iq_fft_timer->stop();
     delete iq_fft_timer;
 
@@ -473,6 +496,7 @@ MainWindow::~MainWindow()
     delete uiDockInputCtl;
     delete uiDockProbe;
     delete uiDockRDS;
+    delete uiDockDspLoad;
     delete rx;
     delete remote;
     delete [] d_fftData;
@@ -581,6 +605,10 @@ bool MainWindow::loadConfig(const QString& cfgfile, bool check_crash,
         uiDockAudio->setFftSampleRate(int_val);
     }
 
+    rx->set_udp_options(m_settings->value("output/udp_payload", UDP_AUDIO_DEFAULT_PAYLOAD).toInt(),
+                        m_settings->value("output/udp_rtp", false).toBool(),
+                        m_settings->value("output/udp_multicast_ttl", 1).toInt());
+
     QString indev = m_settings->value("input/device", "").toString();
     if (!indev.isEmpty())
     {
@@ -740,6 +768,7 @@ bool MainWindow::loadConfig(const QString& cfgfile, bool check_crash,
     uiDockFft->readSettings(m_settings);
     uiDockBookmarks->readSettings(m_settings);
     uiDockAudio->readSettings(m_settings);
+    uiDockDspLoad->readSettings(m_settings);
     dxc_options->readSettings(m_settings);
     rx->commit_audio_rate();
 
@@ -749,6 +778,8 @@ bool MainWindow::loadConfig(const QString& cfgfile, bool check_crash,
      * Initialization the remote control at the end.
      * We must be sure that all variables initialized before starting RC server.
      */
+    setShmExport(m_settings->value("output/shm_export", false).toBool());
+
     remote->readSettings(m_settings);
     bool_val = m_settings->value("remote_control/enabled", false).toBool();
     if (bool_val)
@@ -849,9 +880,30 @@ void MainWindow::storeSession()
         uiDockFft->saveSettings(m_settings);
         uiDockAudio->saveSettings(m_settings);
         uiDockBookmarks->saveSettings(m_settings);
+        uiDockDspLoad->saveSettings(m_settings);
 
         remote->saveSettings(m_settings);
         iq_tool->saveSettings(m_settings);
+        if (rx->get_shm_export())
+            m_settings->setValue("output/shm_export", true);
+        else
+            m_settings->remove("output/shm_export");
+
+        int udp_payload, udp_ttl;
+        bool udp_rtp;
+        rx->get_udp_options(udp_payload, udp_rtp, udp_ttl);
+        if (udp_payload != UDP_AUDIO_DEFAULT_PAYLOAD)
+            m_settings->setValue("output/udp_payload", udp_payload);
+        else
+            m_settings->remove("output/udp_payload");
+        if (udp_rtp)
+            m_settings->setValue("output/udp_rtp", true);
+        else
+            m_settings->remove("output/udp_rtp");
+        if (udp_ttl != 1)
+            m_settings->setValue("output/udp_multicast_ttl", udp_ttl);
+        else
+            m_settings->remove("output/udp_multicast_ttl");
         dxc_options->saveSettings(m_settings);
 
         int old_current = rx->get_current();
@@ -1063,7 +1115,6 @@ void MainWindow::readRXSettings(int ver, double actual_rate)
 {
     bool conv_ok;
     int int_val;
-    double  dbl_val;
     int i = 0;
     qint64 offs = 0;
     rxSpinBox->setMaximum(0);
@@ -1076,150 +1127,7 @@ void MainWindow::readRXSettings(int ver, double actual_rate)
     {
         m_settings->beginGroup(grp);
 
-        bool isLocked = m_settings->value("freq_locked", false).toBool();
-        rx->set_freq_lock(isLocked);
-
-        offs = m_settings->value("offset", 0).toInt(&conv_ok);
-        if (conv_ok)
-        {
-            if(!isLocked || ver < 4)
-                if(std::abs(offs) > actual_rate / 2)
-                    offs = (offs > 0) ? (actual_rate / 2) : (-actual_rate / 2);
-            rx->set_filter_offset(offs);
-        }
-
-        int_val = Modulations::MODE_AM;
-        if (m_settings->contains("demod")) {
-            if (ver >= 3) {
-                int_val = Modulations::GetEnumForModulationString(m_settings->value("demod").toString());
-            } else {
-                int_val = Modulations::ConvertFromOld(m_settings->value("demod").toInt(&conv_ok));
-            }
-        }
-        rx->set_demod(Modulations::idx(int_val));
-
-        rx->set_am_dcr(m_settings->value("am_dcr", true).toBool());
-
-        rx->set_amsync_dcr(m_settings->value("amsync_dcr", true).toBool());
-
-        int_val = m_settings->value("pll_bw", 1000).toInt(&conv_ok);
-        if (conv_ok)
-            rx->set_pll_bw(int_val / 1.0e6);
-
-        int_val = m_settings->value("cwoffset", 700).toInt(&conv_ok);
-        if (conv_ok)
-            rx->set_cw_offset(int_val);
-
-        int_val = m_settings->value("fm_maxdev", 2500).toInt(&conv_ok);
-        if (conv_ok)
-            rx->set_fm_maxdev(int_val);
-
-        dbl_val = m_settings->value("fm_deemph", 75).toDouble(&conv_ok);
-        if (conv_ok && dbl_val >= 0.0)
-            rx->set_fm_deemph(dbl_val);
-
-        dbl_val = m_settings->value("fmpll_damping_factor", 0.7).toDouble(&conv_ok);
-        if (conv_ok && dbl_val > 0.0)
-            rx->set_fmpll_damping_factor(dbl_val);
-
-        if (m_settings->value("subtone_filter", false).toBool())
-            rx->set_fm_subtone_filter(true);
-        else
-            rx->set_fm_subtone_filter(false);
-
-        dbl_val = m_settings->value("sql_level", 1.0).toDouble(&conv_ok);
-        if (conv_ok && dbl_val < 1.0)
-            rx->set_sql_level(dbl_val);
-
-        // AGC settings
-        int_val = m_settings->value("agc_target_level", 0).toInt(&conv_ok);
-        if (conv_ok)
-            rx->set_agc_target_level(int_val);
-
-        //TODO: store/restore the preset correctly
-        int_val = m_settings->value("agc_decay", 500).toInt(&conv_ok);
-        if (conv_ok)
-            rx->set_agc_decay(int_val);
-
-        int_val = m_settings->value("agc_attack", 20).toInt(&conv_ok);
-        if (conv_ok)
-            rx->set_agc_attack(int_val);
-
-        int_val = m_settings->value("agc_hang", 0).toInt(&conv_ok);
-        if (conv_ok)
-            rx->set_agc_hang(int_val);
-
-        int_val = m_settings->value("agc_panning", 0).toInt(&conv_ok);
-        if (conv_ok)
-            rx->set_agc_panning(int_val);
-
-        if (m_settings->value("agc_panning_auto", false).toBool())
-            rx->set_agc_panning_auto(true);
-        else
-            rx->set_agc_panning_auto(false);
-
-        int_val = m_settings->value("agc_maxgain", 100).toInt(&conv_ok);
-        if (conv_ok)
-            rx->set_agc_max_gain(int_val);
-
-        if (m_settings->value("agc_off", false).toBool())
-            rx->set_agc_on(false);
-        else
-            rx->set_agc_on(true);
-
-        for (int j = 1; j < RECEIVER_NB_COUNT + 1; j++)
-        {
-            rx->set_nb_on(j, m_settings->value(QString("nb%1on").arg(j), false).toBool());
-            float thr = m_settings->value(QString("nb%1thr").arg(j), 2.0).toFloat(&conv_ok);
-            if (conv_ok)
-                rx->set_nb_threshold(j, thr);
-        }
-
-        bool flo_ok = false;
-        bool fhi_ok = false;
-        int flo = m_settings->value("filter_low_cut", 0).toInt(&flo_ok);
-        int fhi = m_settings->value("filter_high_cut", 0).toInt(&fhi_ok);
-        int_val = m_settings->value("filter_shape", Modulations::FILTER_SHAPE_NORMAL).toInt(&conv_ok);
-
-        if (flo != fhi)
-            rx->set_filter(flo, fhi, receiver::filter_shape(int_val));
-
-        if (ver < 4)
-        {
-            m_settings->endGroup();
-            m_settings->beginGroup("audio");
-        }
-        int_val = m_settings->value("gain", QVariant(-60)).toInt(&conv_ok);
-        if (conv_ok)
-            if (!rx->get_agc_on())
-                rx->set_agc_manual_gain(float(int_val)*0.1f);
-
-        QString rec_dir = m_settings->value("rec_dir", QDir::homePath()).toString();
-        rx->set_audio_rec_dir(rec_dir.toStdString());
-
-        bool squelch_triggered = m_settings->value("squelch_triggered_recording", false).toBool();
-        rx->set_audio_rec_sql_triggered(squelch_triggered);
-
-        int_val = m_settings->value("rec_min_time", 0).toInt(&conv_ok);
-        if (!conv_ok)
-            int_val = 0;
-        rx->set_audio_rec_min_time(int_val);
-
-        int_val = m_settings->value("rec_max_gap", 0).toInt(&conv_ok);
-        if (!conv_ok)
-            int_val = 0;
-        rx->set_audio_rec_max_gap(int_val);
-
-        QString udp_host = m_settings->value("udp_host", "127.0.0.1").toString();
-        rx->set_udp_host(udp_host.toStdString());
-
-        int_val = m_settings->value("udp_port", 7355).toInt(&conv_ok);
-        if (!conv_ok)
-            int_val = 7355;
-        rx->set_udp_port(int_val);
-
-        bool udp_stereo = m_settings->value("udp_stereo", false).toBool();
-        rx->set_udp_stereo(udp_stereo);
+        read_vfo_settings(m_settings, rx, ver, actual_rate);
 
         m_settings->endGroup();
         ui->plotter->addVfo(rx->get_current_vfo());
@@ -1315,26 +1223,7 @@ void MainWindow::updateFrequencyRange()
  */
 void MainWindow::updateGainStages(bool read_from_device)
 {
-    gain_list_t gain_list;
-    std::vector<std::string> gain_names = rx->get_gain_names();
-    gain_t gain;
-
-    std::vector<std::string>::iterator it;
-    for (it = gain_names.begin(); it != gain_names.end(); ++it)
-    {
-        gain.name = *it;
-        rx->get_gain_range(gain.name, &gain.start, &gain.stop, &gain.step);
-        if (read_from_device)
-        {
-            gain.value = rx->get_gain(gain.name);
-        }
-        else
-        {
-            gain.value = (gain.start + gain.stop) / 2;
-            rx->set_gain(gain.name, gain.value);
-        }
-        gain_list.push_back(gain);
-    }
+    gain_list_t gain_list = read_gain_stages(rx, read_from_device);
 
     uiDockInputCtl->setGainStages(gain_list);
     remote->setGainStages(gain_list);
@@ -1405,21 +1294,15 @@ void MainWindow::setNewFrequency(qint64 rx_freq)
         std::set<int> del_list;
         if (rx->get_rx_count() > 1)
         {
+            // The plotter keeps its VFOs sorted by offset
             std::vector<vfo::sptr> locked_vfos;
-            int offset_lim = (int)(ui->plotter->getSampleRate() / 2);
             ui->plotter->getLockedVfos(locked_vfos);
             for (auto& cvfo : locked_vfos)
-            {
                 ui->plotter->removeVfo(cvfo);
-                int new_offset = cvfo->get_offset() + delta_freq;
-                if ((new_offset > offset_lim) || (new_offset < -offset_lim))
-                    del_list.insert(cvfo->get_index());
-                else
-                {
-                    rx->set_filter_offset(cvfo->get_index(), new_offset);
+            del_list = rx->move_locked_vfos(delta_freq);
+            for (auto& cvfo : locked_vfos)
+                if (del_list.count(cvfo->get_index()) == 0)
                     ui->plotter->addVfo(cvfo);
-                }
-            }
         }
 
         if (d_auto_bookmarks)
@@ -1481,32 +1364,14 @@ void MainWindow::setNewFrequency(qint64 rx_freq)
             }
             if (del_list.size() > 0)
             {
-                int lastCurrent = rx->get_current();
-                for (auto i = del_list.rbegin(); i != del_list.rend(); ++i)
-                {
-                    int last = rx->get_rx_count() - 1;
-                    rx->select_rx(*i);
-                    if (lastCurrent == last)
-                    {
-                        lastCurrent = *i;
-                        last = -1;
-                    }
-                    else
-                        if (*i != last)
-                        {
-                            ui->plotter->removeVfo(rx->get_vfo(last));
-                            last = *i;
-                        }
-                        else
-                            last = -1;
-                    rx->delete_rx();
-                    if (last != -1)
-                        ui->plotter->addVfo(rx->get_vfo(last));
-                }
-                rx->select_rx(lastCurrent);
-                ui->plotter->setCurrentVfo(lastCurrent);
+                int n = rx->delete_rx(del_list);
+                ui->plotter->clearVfos();
+                for (int i = 0; i < rx->get_rx_count(); i++)
+                    if (i != n)
+                        ui->plotter->addVfo(rx->get_vfo(i));
+                ui->plotter->setCurrentVfo(n);
                 rxSpinBox->setMaximum(rx->get_rx_count() - 1);
-                rxSpinBox->setValue(lastCurrent);
+                rxSpinBox->setValue(n);
             }
             if (ui->actionDSP->isChecked())
                 rx->start();
@@ -1685,7 +1550,7 @@ void MainWindow::selectDemod(const QString& strModulation)
 {
     Modulations::idx iDemodIndex;
 
-    iDemodIndex = Modulations::GetEnumForModulationString(strModulation);
+    iDemodIndex = Modulations::GetEnumForModulationString(strModulation.toStdString());
     qDebug() << "selectDemod(str):" << strModulation << "-> IDX:" << iDemodIndex;
 
     return selectDemod(iDemodIndex);
@@ -2116,10 +1981,12 @@ void MainWindow::meterTimeout()
 {
     float level;
     struct receiver::iq_tool_stats iq_stats;
+    struct receiver::audio_rec_stats rec_stats;
 
     level = rx->get_signal_pwr();
     ui->sMeter->setLevel(level);
     remote->setSignalLevel(level);
+    updateRemoteVfos();
     // As it looks like this timer is always active (when the DSP is running),
     // check iq recorder state here too
     rx->get_iq_tool_stats(iq_stats);
@@ -2132,27 +1999,31 @@ void MainWindow::meterTimeout()
             iq_tool->cancelRecording();
         }
         else
+        {
             //update status
             iq_tool->updateStats(iq_stats.failed, iq_stats.buffer_usage, iq_stats.file_pos);
+            iq_tool->updateWriterStats(iq_stats.buffer_hwm, iq_stats.write_latency, iq_stats.write_latency_max);
+        }
     }
     if (iq_stats.playing)
     {
         iq_tool->updateStats(iq_stats.failed, iq_stats.buffer_usage, iq_stats.file_pos);
         d_seek_pos = iq_stats.file_pos;
     }
+    rx->get_audio_rec_stats(rec_stats);
+    if (rec_stats.recording)
+        uiDockAudio->setAudioRecStats(rec_stats.queue_hwm, rec_stats.queue_size,
+                                      rec_stats.dropped, rec_stats.overruns);
     if (uiDockRxOpt->getAgcOn())
     {
         uiDockAudio->setAudioGain(rx->get_agc_gain() * 10.f);
     }
 }
 
-#define LOG2_10 3.321928094887362
-
 /** Baseband FFT plot timeout. */
 void MainWindow::iqFftTimeout()
 {
     unsigned int    fftsize;
-    unsigned int    i;
     qint64 fft_approx_timestamp;
     qint64 fft_start=QDateTime::currentMSecsSinceEpoch();
 
@@ -2166,33 +2037,20 @@ void MainWindow::iqFftTimeout()
         return;
     }
 
-    iqFftToMag(fftsize, d_fftData, d_realFftData);
-
-    for (i = 0; i < fftsize; i++)
-    {
-        /* FFT averaging */
-        d_iirFftData[i] += d_fftAvg * (d_realFftData[i] - d_iirFftData[i]);
-    }
+    fft_to_db(fftsize, d_fftData, d_realFftData);
+    fft_average(fftsize, d_realFftData, d_iirFftData, d_fftAvg);
 
     ui->plotter->setNewFftData(d_iirFftData, d_realFftData, fftsize, fft_approx_timestamp);
+    if (remote->spectrumWanted())
+        remote->setSpectrum(d_iirFftData, fftsize, d_hw_freq + d_lnb_lo,
+                            (qint64)rx->get_quad_rate(), fft_approx_timestamp);
+    if (rx->get_shm_export())
+        shm_spectrum.write(d_iirFftData, fftsize, d_hw_freq + d_lnb_lo,
+                           (qint64)rx->get_quad_rate(), fft_approx_timestamp);
     d_fft_duration+=(double(QDateTime::currentMSecsSinceEpoch()-fft_start)-d_fft_duration)*0.1;
     uiDockFft->setFftLag(d_fft_duration>iq_fft_timer->interval());
 }
 
-void MainWindow::iqFftToMag(unsigned int fftsize, std::complex<float>* fftData, float* realFftData) const
-{
-    // NB: without cast to float the multiplication will overflow at 64k
-    // and pwr_scale will be inf
-    float pwr_scale = 1.0f/ ((float)fftsize * (float)fftsize);
-
-    /* Normalize, calculate power and shift the FFT */
-    volk_32fc_magnitude_squared_32f(realFftData, fftData + (fftsize/2), fftsize/2);
-    volk_32fc_magnitude_squared_32f(realFftData + (fftsize/2), fftData, fftsize/2);
-    volk_32f_s32f_multiply_32f(realFftData, realFftData, pwr_scale, fftsize);
-    volk_32f_log2_32f(realFftData, realFftData, fftsize);
-    volk_32f_s32f_multiply_32f(realFftData, realFftData, 10 / LOG2_10, fftsize);
-}
-
 /** Audio FFT plot timeout. */
 void MainWindow::audioFftTimeout()
 {
@@ -2203,7 +2061,7 @@ void MainWindow::audioFftTimeout()
         rx->get_probe_fft_data(d_fftData, fftsize);
         if (fftsize > 0)
         {
-            iqFftToMag(fftsize, d_fftData, d_realFftData);
+            fft_to_db(fftsize, d_fftData, d_realFftData);
             uiDockProbe->setNewFftData(d_realFftData, fftsize);
         }
     }
@@ -2220,7 +2078,7 @@ void MainWindow::audioFftTimeout()
         return;
     }
 
-    iqFftToMag(fftsize, d_fftData, d_realFftData);
+    fft_to_db(fftsize, d_fftData, d_realFftData);
     uiDockAudio->setNewFftData(d_realFftData, fftsize);
 }
 
@@ -2237,6 +2095,70 @@ void MainWindow::rdsTimeout()
     }
 }
 
+/**
+ * DSP load timeout.
+ *
+ * Sampled once per second, also when the dock is hidden, so that the load
+ * can be queried through the remote control.
+ */
+void MainWindow::dspLoadTimeout()
+{
+    std::vector<dsp_load_block> blocks;
+    std::vector<dsp_load_vfo> vfos;
+    std::vector<latency_stage> stages;
+
+    rx->get_dsp_load(blocks, vfos);
+    remote->setDspLoad(vfos, blocks);
+    if (uiDockDspLoad->isVisible())
+        uiDockDspLoad->setDspLoad(vfos, blocks, rx->has_dsp_work_time());
+
+    if (rx->get_latency(stages))
+    {
+        remote->setLatency(stages);
+        if (uiDockDspLoad->isVisible())
+            uiDockDspLoad->setLatency(stages);
+    }
+
+    // Runs, while the DSP is running, so do the demodulator housekeeping here
+    rx->release_idle_demods();
+}
+
+/**
+ * @brief Enable or disable the end-to-end latency probes.
+ *
+ * The latency is read together with the DSP load in dspLoadTimeout().
+ */
+void MainWindow::setLatencyProbes(bool enabled)
+{
+    rx->set_latency_probes(enabled);
+    remote->setLatencyProbes(enabled);
+}
+
+/**
+ * @brief Enable or disable the shared memory export.
+ *
+ * The receiver exports the I/Q samples and the audio, the spectrum is
+ * exported by iqFftTimeout().
+ */
+void MainWindow::setShmExport(bool enabled)
+{
+    if (rx->set_shm_export(enabled) != receiver::STATUS_OK)
+        enabled = false;
+    if (!enabled)
+        shm_spectrum.reset();
+    remote->setShmExport(rx->get_shm_export());
+}
+
+/**
+ * @brief Select the latency profile.
+ * @param profile Index in the profile combo box, see latency_profile.
+ */
+void MainWindow::setLatencyProfile(int profile)
+{
+    rx->set_latency_profile((latency_profile)profile);
+    remote->setLatencyProfile(profile);
+}
+
 /**
  * @brief Set audio recording directory.
  * @param dir The directory, where audio files should be created.
@@ -2423,9 +2345,10 @@ QString MainWindow::makeIQFilename(const QString& recdir, file_formats fmt, cons
             .arg(recdir).arg(freq).arg(sr/dec);
     QString filename = filenameTemplate.arg(suffix);
 
+    metaFile.clear();
     if(sigmf)
     {
-        metaFile = new QFile(filenameTemplate.arg("fc.sigmf-meta"), this);
+        QFile file(filenameTemplate.arg("fc.sigmf-meta"));
         auto meta = QJsonDocument { QJsonObject {
             {"global", QJsonObject {
 #if Q_BYTE_ORDER == Q_BIG_ENDIAN
@@ -2446,15 +2369,22 @@ QString MainWindow::makeIQFilename(const QString& recdir, file_formats fmt, cons
             }}, {"annotations", QJsonArray {}},
         }}.toJson();
 
-        if (!metaFile->open(QIODevice::WriteOnly) || metaFile->write(meta) != meta.size()) {
+        if (!file.open(QIODevice::WriteOnly))
+            return "";
+        // Closed right away, the file is complete on disk before the samples
+        bool ok = (file.write(meta) == meta.size()) && file.flush();
+        file.close();
+        if (!ok || file.error() != QFileDevice::NoError) {
+            file.remove();
             return "";
         }
+        metaFile = file.fileName();
     }
     return filename;
 }
 
 /** Start I/Q recording. */
-void MainWindow::startIqRecording(const QString& recdir, file_formats fmt, int buffers_max)
+void MainWindow::startIqRecording(const QString& recdir, file_formats fmt, int buffers_max, bool direct_io)
 {
 
     bool sigmf = (fmt == FILE_FORMAT_SIGMF);
@@ -2462,11 +2392,11 @@ void MainWindow::startIqRecording(const QString& recdir, file_formats fmt, int b
     ui->actionIoConfig->setDisabled(true);
     ui->actionLoadSettings->setDisabled(true);
     // start recorder; fails if recording already in progress
-    if (lastRec.isEmpty() || rx->start_iq_recording(lastRec.toStdString(), fmt, buffers_max))
+    if (lastRec.isEmpty() || rx->start_iq_recording(lastRec.toStdString(), fmt, buffers_max, direct_io))
     {
         // remove metadata file if we managed to open it
-        if (sigmf && metaFile->isOpen())
-            metaFile->remove();
+        if (sigmf && !metaFile.isEmpty())
+            QFile::remove(metaFile);
 
         // reset action status
         ui->statusBar->showMessage(tr("Error starting I/Q recoder"));
@@ -2651,11 +2581,29 @@ void MainWindow::seekIqFile(qint64 seek_pos)
     }
 }
 
-void MainWindow::saveFileRange(const QString& recdir, file_formats fmt, quint64 from_ms, quint64 len_ms)
+/** I/Q playback speed, 0 runs as fast as the DSP allows. */
+void MainWindow::setIqPlaybackSpeed(double speed)
+{
+    if (rx->set_iq_playback_speed(speed) != receiver::STATUS_OK)
+        qDebug() << __func__ << ": failed to set speed" << speed;
+}
+
+void MainWindow::saveFileRange(const QString& recdir, file_formats fmt, file_formats out_fmt, quint64 from_ms, quint64 len_ms)
 {
     auto rectime=QDateTime::fromMSecsSinceEpoch(from_ms).toUTC();
-    std::string name=makeIQFilename(recdir,fmt,rectime).toStdString();
-    rx->save_file_range_ts(from_ms,len_ms,name);
+    // SigMF metadata of the fragment is written by makeIQFilename
+    std::string name=makeIQFilename(recdir,out_fmt,rectime).toStdString();
+    if (name.empty())
+    {
+        iq_tool->updateSaveProgress(-1);
+        return;
+    }
+    if (rx->save_file_range_ts(from_ms,len_ms,name,out_fmt) != receiver::STATUS_OK)
+    {
+        if (!metaFile.isEmpty())
+            QFile::remove(metaFile);
+        iq_tool->updateSaveProgress(-1);
+    }
 }
 
 void MainWindow::updateSaveProgress(const qint64 saved_ms)
@@ -2732,6 +2680,7 @@ void MainWindow::waterfall_background_func()
                                 ), waterfall_background_threads);
                 quint64 ms_available = rd->ms_available();
                 maxlines = std::min(lines, int(ms_available / ms_per_line));
+                rd->prefetch(maxlines + 1, ms_per_line);
                 k = 0;
                 if(std::abs(nlines) > lines)
                     line = 0;
@@ -2793,10 +2742,10 @@ void MainWindow::plotterWfCb(int line, gr_complex* data, float *tmpbuf, unsigned
     {
         if(line==0)
         {
-            iqFftToMag(n,data,d_realFftData);
+            fft_to_db(n, data, d_realFftData);
             ui->plotter->drawOneWaterfallLine(line, d_realFftData, n, ts);
         }else{
-            iqFftToMag(n,data,tmpbuf);
+            fft_to_db(n, data, tmpbuf);
             ui->plotter->drawOneWaterfallLine(line, tmpbuf, n, ts);
         }
         if((line & 15) == 0)
@@ -3020,6 +2969,7 @@ void MainWindow::on_actionDSP_triggered(bool checked)
 
         /* start GUI timers */
         meter_timer->start(100);
+        dsp_load_timer->start(1000);
 
         if (uiDockFft->fftRate())
         {
@@ -3050,12 +3000,16 @@ void MainWindow::on_actionDSP_triggered(bool checked)
         }
         /* stop GUI timers */
         meter_timer->stop();
+        dsp_load_timer->stop();
         iq_fft_timer->stop();
         audio_fft_timer->stop();
         rds_timer->stop();
 
         /* stop receiver */
         rx->stop();
+        uiDockDspLoad->clearDspLoad();
+        remote->setDspLoad(std::vector<dsp_load_vfo>(), std::vector<dsp_load_block>());
+        remote->setLatency(std::vector<latency_stage>());
 
         /* update menu text and button tooltip */
         ui->actionDSP->setToolTip(tr("Start DSP processing"));
@@ -3082,6 +3036,7 @@ void MainWindow::on_plotter_setPlaying(bool state)
 
             /* start GUI timers */
             meter_timer->start(100);
+            dsp_load_timer->start(1000);
 
             if (uiDockFft->fftRate())
             {
@@ -3107,12 +3062,16 @@ void MainWindow::on_plotter_setPlaying(bool state)
             }
             /* stop GUI timers */
             meter_timer->stop();
+            dsp_load_timer->stop();
             iq_fft_timer->stop();
             audio_fft_timer->stop();
             rds_timer->stop();
 
             /* stop receiver */
             rx->stop();
+            uiDockDspLoad->clearDspLoad();
+            remote->setDspLoad(std::vector<dsp_load_vfo>(), std::vector<dsp_load_block>());
+            remote->setLatency(std::vector<latency_stage>());
 
             ui->plotter->setRunningState(false);
         }
@@ -3490,32 +3449,70 @@ void MainWindow::onBookmarkActivatedAddDemod(BookmarkInfo & bm)
 
 void MainWindow::setPassband(int bandwidth)
 {
-    /* Check if filter is symmetric or not by checking the presets */
-    auto mode = uiDockRxOpt->currentDemod();
-    auto preset = uiDockRxOpt->currentFilter();
-
     int lo, hi;
-    Modulations::GetFilterPreset(mode, preset, lo, hi);
 
-    if (lo + hi == 0)
-    {
-        lo = -bandwidth / 2;
-        hi =  bandwidth / 2;
-    }
-    else if (lo >= 0 && hi >= 0)
-    {
-        hi = lo + bandwidth;
-    }
-    else if (lo <= 0 && hi <= 0)
-    {
-        lo = hi - bandwidth;
-    }
+    passband_to_filter(uiDockRxOpt->currentDemod(), uiDockRxOpt->currentFilter(),
+                       bandwidth, lo, hi);
 
     remote->setPassband(lo, hi);
 
     on_plotter_newFilterFreq(lo, hi);
 }
 
+/**
+ * Apply VFO changes from the remote control.
+ *
+ * All changes go to the receiver at once, the current VFO stays selected
+ * and the GUI is reloaded only if the current VFO has changed.
+ */
+void MainWindow::applyRemoteVfoChanges(const RemoteVfoChanges &changes)
+{
+    std::vector<receiver::vfo_change> rx_changes = remote_to_vfo_changes(rx, d_lnb_lo, changes);
+    std::set<int> replaced;
+    int current = rx->get_current();
+    bool current_changed = false;
+
+    for (auto &c : changes)
+    {
+        // The receiver may replace the blocks of the VFO
+        if (c.what == RemoteVfoChange::MODE && c.vfo != current)
+            replaced.insert(c.vfo);
+        current_changed |= (c.vfo == current);
+    }
+
+    for (int n : replaced)
+        ui->plotter->removeVfo(rx->get_vfo(n));
+    rx->apply_vfo_changes(rx_changes);
+    for (int n : replaced)
+        ui->plotter->addVfo(rx->get_vfo(n));
+
+    if (current_changed)
+        loadRxToGUI();
+    else
+        updateRemoteVfos();
+}
+
+/**
+ * Start an I/Q stream requested by a remote client.
+ *
+ * @param vfo The VFO, -1 for the current one.
+ */
+void MainWindow::startIqStream(quint64 client, int vfo, int stage, int format)
+{
+    iq_stream_sink_sptr tap = rx->start_iq_stream(vfo < 0 ? rx->get_current() : vfo,
+                                                  iq_stream_sink::stage(stage),
+                                                  file_formats(format));
+
+    if (tap)
+        iq_streams.insert(client, tap);
+    remote->attachIqStream(client, tap);
+}
+
+void MainWindow::stopIqStream(quint64 client)
+{
+    rx->stop_iq_stream(iq_streams.take(client));
+}
+
 void MainWindow::setFreqLock(bool lock, bool all)
 {
     rx->set_freq_lock(lock, all);
@@ -3751,6 +3748,7 @@ void MainWindow::on_actionAddDemodulator_triggered()
     ui->plotter->setCurrentVfo(rx->get_rx_count() - 1);
     rxSpinBox->setMaximum(rx->get_rx_count() - 1);
     rxSpinBox->setValue(n);
+    updateRemoteVfos();
 }
 
 void MainWindow::on_actionRemoveDemodulator_triggered()
@@ -3854,6 +3852,7 @@ void MainWindow::loadRxToGUI()
         uiDockAudio->audioRecStopped();
     uiDockAudio->setAudioStreamState(rx->get_udp_host(), rx->get_udp_port(), rx->get_udp_stereo(), rx->get_udp_streaming());
     uiDockAudio->setDedicatedAudioSink(rx->get_dedicated_audio_sink(), rx->get_dedicated_audio_dev());
+    updateRemoteVfos();
     d_have_audio = (mode_idx != Modulations::MODE_OFF);
     switch (mode_idx)
     {
@@ -3869,6 +3868,29 @@ void MainWindow::loadRxToGUI()
     }
 }
 
+/** Send the state of all VFOs to the remote control. */
+void MainWindow::updateRemoteVfos()
+{
+    std::vector<RemoteVfo> vfos;
+    double rf_freq = rx->get_rf_freq() + d_lnb_lo;
+
+    for (int i = 0; i < rx->get_rx_count(); i++)
+    {
+        vfo::sptr v = rx->get_vfo(i);
+        RemoteVfo rv;
+
+        rv.freq = qint64(rf_freq + v->get_offset());
+        rv.mode = v->get_demod();
+        rv.passband_lo = v->get_filter_low();
+        rv.passband_hi = v->get_filter_high();
+        rv.signal_level = rx->get_signal_pwr(i);
+        rv.squelch_open = rx->get_sql_open(i);
+        rv.squelch_level = v->get_sql_level();
+        vfos.push_back(rv);
+    }
+    remote->setVfos(vfos, rx->get_current());
+}
+
 void MainWindow::addClusterSpot()
 {
     ui->plotter->updateOverlay();
@@ -24,6 +24,7 @@
 #define MAINWINDOW_H
 
 #include <QColor>
+#include <QHash>
 #include <QMainWindow>
 #include <QPointer>
 #include <QSettings>
@@ -39,6 +40,7 @@
 #include "qtgui/dockinputctl.h"
 #include "qtgui/dockfft.h"
 #include "qtgui/dockbookmarks.h"
+#include "qtgui/dockdspload.h"
 #include "qtgui/dockprobe.h"
 #include "qtgui/dockrds.h"
 #include "qtgui/afsk1200win.h"
@@ -108,6 +110,7 @@ private:
     DockBookmarks  *uiDockBookmarks;
     DockProbe      *uiDockProbe;
     DockRDS        *uiDockRDS;
+    DockDspLoad    *uiDockDspLoad;
 
     CIqTool        *iq_tool;
     DXCOptions     *dxc_options;
@@ -123,10 +126,13 @@ private:
     QTimer   *audio_fft_timer;
     QTimer   *rds_timer;
     QTimer   *dxc_timer;
+    QTimer   *dsp_load_timer;
 
     receiver *rx;
 
     RemoteControl *remote;
+    QHash<quint64, iq_stream_sink_sptr> iq_streams;  /*!< I/Q streams of the remote clients. */
+    shm_spectrum_export shm_spectrum;   /*!< Shared memory export of the spectrum. */
 
     std::map<QString, QVariant> devList;
 
@@ -149,7 +155,7 @@ private:
     bool   d_fft_redraw_susended{0};
     double d_fft_duration{0.0};
 
-    QFile * metaFile;
+    QString metaFile;   /*!< SigMF metadata of the last I/Q file, removed on errors. */
 
 private:
     void updateHWFrequencyRange(bool ignore_limits);
@@ -163,7 +169,7 @@ private:
     void audioRecEventEmitter(std::string filename, bool is_running);
     static void audio_rec_event(MainWindow *self, std::string filename, bool is_running);
     void loadRxToGUI();
-    void iqFftToMag(unsigned int fftsize, std::complex<float>* fftData, float* realFftData) const;
+    void updateRemoteVfos();
     void waterfall_background_func();
     static void plotterWfCbWr(MainWindow *self, int line, gr_complex* data, float *tmpbuf, unsigned n, quint64 ts);
     void plotterWfCb(int line, gr_complex* data, float *tmpbuf, unsigned n, quint64 ts);
@@ -214,6 +220,9 @@ private slots:
     void setAudioGain(float gain);
     void setAudioMute(bool mute, bool global);
     void setPassband(int bandwidth);
+    void applyRemoteVfoChanges(const RemoteVfoChanges &changes);
+    void startIqStream(quint64 client, int vfo, int stage, int format);
+    void stopIqStream(quint64 client);
     void setFreqLock(bool lock, bool all);
     void setChanelizer(int n);
 
@@ -240,7 +249,7 @@ private slots:
 
     /* I/Q playback and recording*/
     QString makeIQFilename(const QString& recdir, file_formats fmt, const QDateTime ts);
-    void startIqRecording(const QString& recdir, file_formats fmt, int buffers_max);
+    void startIqRecording(const QString& recdir, file_formats fmt, int buffers_max, bool direct_io);
     void stopIqRecording();
     void startIqPlayback(const QString& filename, float samprate,
                          qint64 center_freq, file_formats fmt,
@@ -248,7 +257,8 @@ private slots:
                          int buffers_max, bool repeat);
     void stopIqPlayback();
     void seekIqFile(qint64 seek_pos);
-    void saveFileRange(const QString& recdir, file_formats fmt, quint64 from_ms, quint64 len_ms);
+    void setIqPlaybackSpeed(double speed);
+    void saveFileRange(const QString& recdir, file_formats fmt, file_formats out_fmt, quint64 from_ms, quint64 len_ms);
     void updateSaveProgress(const qint64 saved_ms);
     void plotterUpdate();
     void triggerIQFftRedraw(bool resume=false);
@@ -290,6 +300,9 @@ private slots:
 
     /* RDS */
     void setRdsDecoder(bool checked);
+    void setLatencyProbes(bool enabled);
+    void setLatencyProfile(int profile);
+    void setShmExport(bool enabled);
 
     /* Bookmarks */
     void onBookmarkActivated(BookmarkInfo & bm);
@@ -331,6 +344,7 @@ private slots:
     void iqFftTimeout();
     void audioFftTimeout();
     void rdsTimeout();
+    void dspLoadTimeout();
     void checkDXCSpotTimeout();
 };
 
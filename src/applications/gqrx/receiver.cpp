@@ -25,7 +25,6 @@
 #include <iostream>
 #include <sstream>
 #include <typeinfo>
-#include <QDebug>
 
 #include <gnuradio/prefs.h>
 #include <gnuradio/top_block.h>
@@ -64,6 +63,12 @@ receiver::receiver(const std::string input_device,
       d_running(false),
       d_input_rate(96000.0),
       d_use_chan(false),
+      d_latency_probes(false),
+      d_latency_profile(LATENCY_PROFILE_THROUGHPUT),
+      d_budget_input(0.0),
+      d_budget_chan(0.0),
+      d_budget_mixer(0.0),
+      d_budget_audio(-1.0),
       d_enable_chan(true),
       d_audio_rate(48000),
       d_decim(decimation),
@@ -75,7 +80,8 @@ receiver::receiver(const std::string input_device,
       d_iq_balance(false),
       d_mute(false),
       d_iq_fmt(FILE_FORMAT_NONE),
-      d_last_format(FILE_FORMAT_NONE)
+      d_last_format(FILE_FORMAT_NONE),
+      d_iq_speed(1.0)
 {
 
     tb = gr::make_top_block("gqrx");
@@ -146,8 +152,13 @@ receiver::receiver(const std::string input_device,
     chan = fft_channelizer_cc::make(8*4, 4, gr::fft::window::WIN_KAISER, 1);
     chan->set_filter_param(7.5);
 
+    lat_tagger = make_latency_tagger_cc();
+    lat_chan = make_latency_probe_sink(sizeof(gr_complex));
+    lat_mix = make_latency_probe_sink(sizeof(float));
+
     /* wav sink and source is created when rec/play is started */
     audio_null_sink0 = gr::blocks::null_sink::make(sizeof(float));
+    audio_fast_null = gr::blocks::null_sink::make(sizeof(float));
     audio_null_sink1 = gr::blocks::null_sink::make(sizeof(float));
     sniffer = make_sniffer_f();
     /* sniffer_rr is created at each activation. */
@@ -156,8 +167,8 @@ receiver::receiver(const std::string input_device,
     reconnect_all();
 
     gr::prefs pref;
-    qDebug() << "Using audio backend:"
-             << pref.get_string("audio", "audio_module", "N/A").c_str();
+    std::cout << "Using audio backend: "
+              << pref.get_string("audio", "audio_module", "N/A") << std::endl;
 
 }
 
@@ -172,6 +183,7 @@ void receiver::start()
 {
     if (!d_running)
     {
+        d_dsp_load.reset();
         tb->start();
         d_running = true;
     }
@@ -188,15 +200,28 @@ void receiver::stop()
     }
 }
 
+/**
+ * @brief Wait for the receiver to finish on its own.
+ *
+ * The flowgraph only finishes by itself, when a non-repeating I/Q file has
+ * been played to the end.
+ */
+void receiver::wait()
+{
+    if (d_running)
+    {
+        tb->wait();
+        d_running = false;
+    }
+}
+
 /**
  * @brief Select new input device.
  * @param device
  */
 void receiver::set_input_device(const std::string device)
 {
-    qDebug() << "Set input device:";
-    qDebug() << "  old:" << input_devstr.c_str();
-    qDebug() << "  new:" << device.c_str();
+    std::cout << "Set input device: " << device << std::endl;
 
     std::string error = "";
 
@@ -281,7 +306,9 @@ void receiver::set_input_file(const std::string name, const int sample_rate,
     for (auto& rxc : rx)
         rxc->connected(false);
 
-    input_throttle = gr::blocks::throttle::make(sizeof(gr_complex), sample_rate);
+    input_throttle = gr::blocks::throttle::make(sizeof(gr_complex),
+                                                sample_rate * (d_iq_speed > 0.0 ? d_iq_speed : 1.0));
+    input_file->set_realtime(d_iq_speed == 1.0);
 
     //set_demod(d_demod, fmt, true);
     input_file->set_save_progress_cb(d_save_progress);
@@ -331,13 +358,15 @@ gr::basic_block_sptr receiver::setup_source(file_formats fmt)
     }
     if (fmt > FILE_FORMAT_NONE)
     {
+        b = input_file;
         if (convert_from[fmt]) // Connect through a converter
         {
             tb->connect(input_file, 0, convert_from[fmt], 0);
-            tb->connect(convert_from[fmt], 0, input_throttle, 0);
-            b = input_throttle;
-        }else{ // No conversion
-            tb->connect(input_file, 0 ,input_throttle, 0);
+            b = convert_from[fmt];
+        }
+        if (d_iq_speed > 0.0) // Unlimited speed playback runs without a throttle
+        {
+            tb->connect(b, 0, input_throttle, 0);
             b = input_throttle;
         }
         return b;
@@ -352,15 +381,15 @@ gr::basic_block_sptr receiver::setup_source(file_formats fmt)
  */
 void receiver::set_output_device(const std::string device)
 {
-    qDebug() << "Set output device:";
-    qDebug() << "   old:" << output_devstr.c_str();
-    qDebug() << "   new:" << device.c_str();
+    std::cout << "Set output device: " << device << std::endl;
 
     output_devstr = device;
 
     tb->lock();
 
-    if (d_active > 0)
+    // The demodulators are routed to a null sink during fast playback
+    bool connected = (d_active > 0) && (d_audio_out == audio_snk);
+    if (connected)
     {
         try {
             tb->disconnect(audio_snk);
@@ -371,11 +400,14 @@ void receiver::set_output_device(const std::string device)
 
     try {
         audio_snk = create_audio_sink(device, d_audio_rate, "DMIX output");
+        if (d_latency_profile == LATENCY_PROFILE_LOW)
+            set_audio_sink_latency(audio_snk, LATENCY_LOW_AUDIO_TIME);
 
-        if (d_active > 0)
+        if (connected)
         {
             tb->connect(mc0, 0, audio_snk, 0);
             tb->connect(mc1, 0, audio_snk, 1);
+            d_audio_out = audio_snk;
         }
 
         tb->unlock();
@@ -451,6 +483,8 @@ double receiver::set_input_rate(double rate)
     configure_channelizer(false);
     iq_fft->set_quad_rate(d_decim_rate);
     probe_fft->set_quad_rate(d_decim_rate / chan->decim());
+    if (shm_iq)
+        shm_iq->set_rate(d_decim_rate);
     tb->unlock();
 
     return d_input_rate;
@@ -495,6 +529,8 @@ unsigned int receiver::set_input_decim(unsigned int decim)
     dc_corr->set_sample_rate(d_decim_rate);
     iq_fft->set_quad_rate(d_decim_rate);
     probe_fft->set_quad_rate(d_decim_rate / chan->decim());
+    if (shm_iq)
+        shm_iq->set_rate(d_decim_rate);
     configure_channelizer(true);
 
 #ifdef CUSTOM_AIRSPY_KERNELS
@@ -790,6 +826,56 @@ int receiver::delete_rx()
     return d_current;
 }
 
+/**
+ * @brief Delete several demodulators, the current one stays selected.
+ * @param vfos Indexes of the demodulators, not the current one.
+ * @return The index of the current demodulator afterwards.
+ */
+int receiver::delete_rx(const std::set<int> &vfos)
+{
+    int current = d_current;
+
+    for (auto i = vfos.rbegin(); i != vfos.rend(); ++i)
+    {
+        if (*i == current || *i >= int(rx.size()))
+            continue;
+        // delete_rx() moves the last demodulator into the freed slot
+        if (current == int(rx.size()) - 1)
+            current = *i;
+        select_rx(*i);
+        delete_rx();
+    }
+    select_rx(current);
+    return current;
+}
+
+/**
+ * @brief Keep the locked demodulators on their frequency after a retune.
+ * @param delta_freq Old minus new hardware frequency in Hz.
+ * @return The locked demodulators, that left the band, they are not moved
+ *         and should be deleted with delete_rx().
+ *
+ * Shared by the GUI and gqrx-headless, the current demodulator is never
+ * moved.
+ */
+std::set<int> receiver::move_locked_vfos(int64_t delta_freq)
+{
+    std::set<int> outside;
+    int offset_lim = (int)(get_quad_rate() / 2);
+
+    for (int i = 0; i < int(rx.size()); i++)
+    {
+        if (i == d_current || !rx[i]->get_freq_lock())
+            continue;
+        int offset = rx[i]->get_offset() + delta_freq;
+        if (offset > offset_lim || offset < -offset_lim)
+            outside.insert(i);
+        else
+            set_filter_offset(i, offset);
+    }
+    return outside;
+}
+
 /**
  * @brief Selects a demodulator.
  * @return STATUS_OK or STATUS_ERROR (if requested demodulator does not exist).
@@ -849,6 +935,90 @@ vfo::sptr receiver::get_vfo(int n)
     return rx[n];
 }
 
+/**
+ * @brief Apply changes to any VFOs at once.
+ * @param changes The changes, applied in order.
+ * @return STATUS_ERROR, without changing anything, if a VFO does not exist
+ *         or a change is invalid.
+ *
+ * The current VFO stays selected. The flowgraph is stopped at most once, if
+ * a demodulator changes, so a scanner can retune many VFOs in one go
+ * instead of selecting each of them.
+ */
+receiver::status receiver::apply_vfo_changes(const std::vector<vfo_change> &changes)
+{
+    bool restructure = false;
+
+    for (auto &c : changes)
+    {
+        if (c.vfo < 0 || c.vfo >= int(rx.size()))
+            return STATUS_ERROR;
+        if (c.what == vfo_change::DEMOD)
+        {
+            if (get_rxc(c.demod) == rx_chain(STATUS_ERROR))
+                return STATUS_ERROR;
+            restructure |= (c.demod != rx[c.vfo]->get_demod());
+        }
+        if (c.what == vfo_change::FILTER &&
+            ((c.low >= c.high) || (std::abs(c.high - c.low) < RX_FILTER_MIN_WIDTH)))
+            return STATUS_ERROR;
+    }
+
+    if (restructure && d_running)
+    {
+        tb->stop();
+        tb->wait();
+    }
+
+    int current = d_current;
+    for (auto &c : changes)
+    {
+        int low, high, tw;
+
+        switch (c.what)
+        {
+        case vfo_change::OFFSET:
+            set_filter_offset(c.vfo, c.value);
+            break;
+
+        case vfo_change::DEMOD:
+            if (c.demod == rx[c.vfo]->get_demod())
+                break;
+            // set_demod_locked() works on the current VFO
+            if (c.vfo != d_current)
+            {
+                background_rx();
+                d_current = c.vfo;
+                foreground_rx();
+            }
+            set_demod_locked(c.demod, -1);
+            break;
+
+        case vfo_change::FILTER:
+            rx[c.vfo]->get_filter(low, high, tw);
+            rx[c.vfo]->set_filter(c.low, c.high,
+                Modulations::TwFromFilterShape(c.low, c.high,
+                    Modulations::FilterShapeFromTw(low, high, tw)));
+            break;
+
+        case vfo_change::SQL_LEVEL:
+            rx[c.vfo]->set_sql_level(c.value);
+            break;
+        }
+    }
+    if (d_current != current)
+    {
+        background_rx();
+        d_current = current;
+        foreground_rx();
+    }
+
+    if (restructure && d_running)
+        tb->start();
+
+    return STATUS_OK;
+}
+
 std::vector<vfo::sptr> receiver::get_vfos()
 {
     std::vector<vfo::sptr> vfos;
@@ -969,6 +1139,17 @@ float receiver::get_signal_pwr() const
     return rx[d_current]->get_signal_level();
 }
 
+float receiver::get_signal_pwr(int rx_index) const
+{
+    return rx[rx_index]->get_signal_level();
+}
+
+/** Get the squelch decision of a receiver, true if the squelch is open. */
+bool receiver::get_sql_open(int rx_index) const
+{
+    return rx[rx_index]->get_sql_open();
+}
+
 /** Set new FFT size. */
 void receiver::set_iq_fft_size(int newsize)
 {
@@ -1067,6 +1248,7 @@ void receiver::set_channelizer(int n)
     }
     std::cerr<<"set_channelizer: stopped\n";
     set_channelizer_int(use_chan);
+    close_stale_iq_streams();
     if (d_running)
         tb->start();
     std::cerr<<"set_channelizer: started\n";
@@ -1127,6 +1309,7 @@ void receiver::configure_channelizer(bool reconnect)
     }
     else
         set_channelizer_int(use_chan);
+    close_stale_iq_streams();
 }
 
 receiver::status receiver::set_nb_on(int nbid, bool on)
@@ -1452,6 +1635,14 @@ receiver::status receiver::set_demod_locked(Modulations::idx demod, int old_idx)
         {
             rx[d_current]->restore_settings(*old_rx.get());
             rx[d_current]->set_offset(old_rx->get_offset());
+            // I/Q streams follow the VFO
+            std::vector<iq_stream_sink_sptr> taps = old_rx->get_iq_taps();
+            for (auto &tap : taps)
+            {
+                old_rx->remove_iq_tap(tap);
+                rx[d_current]->add_iq_tap(tap);
+            }
+            close_stale_iq_streams();
             // Recorders
             if (old_idx == -1)
                 if (old_rx->get_audio_recording())
@@ -1666,6 +1857,8 @@ receiver::status receiver::set_audio_rate(int rate)
     {
         d_audio_rate = rate;
         audio_fft->set_quad_rate(rate);
+        if (shm_audio)
+            shm_audio->set_rate(rate);
     }
     return STATUS_OK;
 }
@@ -1769,8 +1962,8 @@ receiver::status receiver::start_audio_playback(const std::string filename)
     /* route demodulator output to null sink */
     if (d_active > 0)
     {
-        tb->disconnect(mc0, 0, audio_snk, 0);
-        tb->disconnect(mc1, 0, audio_snk, 1);
+        tb->disconnect(mc0, 0, d_audio_out, 0);
+        tb->disconnect(mc1, 0, d_audio_out, 1);
     }
     tb->disconnect(rx[d_current], 0, audio_fft, 0);
     tb->connect(rx[d_current], 0, audio_null_sink0, 0); /** FIXME: other channel? */
@@ -1797,8 +1990,8 @@ receiver::status receiver::stop_audio_playback()
     tb->disconnect(rx[d_current], 1, audio_null_sink1, 0);
     if (d_active > 0)
     {
-        tb->connect(mc0, 0, audio_snk, 0);
-        tb->connect(mc1, 0, audio_snk, 1);
+        tb->connect(mc0, 0, d_audio_out, 0);
+        tb->connect(mc1, 0, d_audio_out, 1);
     }
     tb->connect(rx[d_current], 0, audio_fft, 0);  /** FIXME: other channel? */
     start();
@@ -1850,6 +2043,28 @@ bool receiver::get_udp_streaming()
     return rx[d_current]->get_udp_streaming();
 }
 
+/**
+ * @brief Set the options of the UDP audio streams of all VFOs.
+ * @param payload Audio bytes per datagram.
+ * @param rtp Prepend an RTP header with sequence number and timestamp.
+ * @param multicast_ttl Hop limit of multicast streams.
+ *
+ * Streams, that are already running, keep their options.
+ */
+void receiver::set_udp_options(int payload, bool rtp, int multicast_ttl)
+{
+    udp_audio_sender::set_options({payload, rtp, multicast_ttl});
+}
+
+void receiver::get_udp_options(int &payload, bool &rtp, int &multicast_ttl)
+{
+    udp_audio_sender::options opts = udp_audio_sender::get_options();
+
+    payload = opts.payload;
+    rtp = opts.rtp;
+    multicast_ttl = opts.multicast_ttl;
+}
+
 void receiver::set_dedicated_audio_sink(bool value)
 {
     if(d_running)
@@ -1893,8 +2108,9 @@ receiver::status receiver::connect_iq_recorder()
  * @brief Start I/Q data recorder.
  * @param filename The filename where to record.
 + * @param bytes_per_sample A hint to choose correct sample format.
+ * @param direct_io Write with O_DIRECT/io_uring instead of stdio.
  */
-receiver::status receiver::start_iq_recording(const std::string filename, const file_formats fmt, int buffers_max)
+receiver::status receiver::start_iq_recording(const std::string filename, const file_formats fmt, int buffers_max, bool direct_io)
 {
     int sink_bytes_per_chunk = any_to_any_base::fmt[fmt].size;
 
@@ -1905,7 +2121,8 @@ receiver::status receiver::start_iq_recording(const std::string filename, const
 
     try
     {
-        iq_sink = file_sink::make(sink_bytes_per_chunk, filename.c_str(), d_input_rate / any_to_any_base::fmt[fmt].nsamples, true, buffers_max);
+        iq_sink = file_sink::make(sink_bytes_per_chunk, filename.c_str(), d_input_rate / any_to_any_base::fmt[fmt].nsamples, true, buffers_max, direct_io,
+                                  fmt == FILE_FORMAT_CS16Z);
     }
     catch (std::runtime_error &e)
     {
@@ -1938,6 +2155,131 @@ receiver::status receiver::stop_iq_recording()
     return STATUS_OK;
 }
 
+/**
+ * @brief Start streaming the I/Q samples of a VFO.
+ * @param rx_index The VFO.
+ * @param where The stage of the VFO, see iq_stream_sink::stage.
+ * @param fmt Sample format, see iq_stream_sink::supported_format().
+ * @returns The sink, its ring is read by the clients, or null on error.
+ *
+ * Clients of the same VFO, stage and format share one sink. Every call
+ * must be paired with stop_iq_stream().
+ */
+iq_stream_sink_sptr receiver::start_iq_stream(int rx_index, iq_stream_sink::stage where,
+                                              file_formats fmt)
+{
+    if (rx_index < 0 || rx_index >= int(rx.size()) || !iq_stream_sink::supported_format(fmt))
+        return nullptr;
+
+    for (auto &tap : rx[rx_index]->get_iq_taps())
+        if (tap->get_stage() == where && tap->get_format() == fmt)
+        {
+            tap->ref();
+            return tap;
+        }
+
+    iq_stream_sink_sptr tap = make_iq_stream_sink(where, fmt, rx[rx_index]->get_iq_tap_rate(where));
+
+    tap->ref();
+    rx[rx_index]->add_iq_tap(tap);
+    return tap;
+}
+
+/**
+ * @brief Release an I/Q stream started with start_iq_stream().
+ *
+ * The sink is disconnected, when its last client is gone. Nothing to do,
+ * if its VFO has been deleted meanwhile.
+ */
+void receiver::stop_iq_stream(iq_stream_sink_sptr tap)
+{
+    if (!tap || tap->unref() > 0)
+        return;
+
+    for (auto &rxc : rx)
+        rxc->remove_iq_tap(tap);
+}
+
+/**
+ * @brief Close the I/Q streams, whose sample rate has changed.
+ *
+ * The rate and the ring size of a stream are fixed, when it starts. The
+ * sink is disconnected and its clients are dropped by the I/Q server, so
+ * they reconnect with the new rate. stop_iq_stream() still has to be
+ * called for every client.
+ */
+void receiver::close_stale_iq_streams()
+{
+    for (auto &rxc : rx)
+    {
+        std::vector<iq_stream_sink_sptr> taps = rxc->get_iq_taps();
+
+        for (auto &tap : taps)
+            if (std::abs(tap->get_rate() - rxc->get_iq_tap_rate(tap->get_stage())) > 0.5)
+            {
+                tap->get_ring()->close();
+                rxc->remove_iq_tap(tap);
+            }
+    }
+}
+
+/**
+ * @brief Set I/Q file playback speed.
+ * @param speed Multiple of the sample rate, 1.0 is real time and 0.0 runs
+ *              the flowgraph as fast as the DSP allows.
+ *
+ * The file source does not insert zeros when the reader falls behind at
+ * speeds other than real time, so the time stamps stay sample accurate.
+ * Audio is routed to a null sink, the sound card can't keep up anyway.
+ */
+receiver::status receiver::set_iq_playback_speed(double speed)
+{
+    if (speed < 0.0)
+        speed = 0.0;
+
+    bool rewire = ((speed > 0.0) != (d_iq_speed > 0.0)) ||
+                  ((speed == 1.0) != (d_iq_speed == 1.0));
+
+    d_iq_speed = speed;
+    if (!input_file)
+        return STATUS_OK;
+
+    input_file->set_realtime(speed == 1.0);
+    if (input_throttle && speed > 0.0)
+        input_throttle->set_sample_rate(d_input_rate * speed);
+
+    if (rewire && is_playing_iq())
+        return reconnect_all(FILE_FORMAT_LAST, true);
+
+    return STATUS_OK;
+}
+
+/**
+ * @brief Set the sink for the audio output during fast I/Q playback.
+ * @param sink Block with two float inputs or nullptr for a null sink.
+ */
+void receiver::set_fast_audio_sink(gr::basic_block_sptr sink)
+{
+    bool connected = (d_active > 0) && (d_audio_out == audio_fast_null);
+
+    if (!sink)
+        sink = gr::blocks::null_sink::make(sizeof(float));
+    if (connected)
+    {
+        tb->lock();
+        tb->disconnect(mc0, 0, audio_fast_null, 0);
+        tb->disconnect(mc1, 0, audio_fast_null, 1);
+    }
+    audio_fast_null = sink;
+    if (connected)
+    {
+        tb->connect(mc0, 0, audio_fast_null, 0);
+        tb->connect(mc1, 0, audio_fast_null, 1);
+        d_audio_out = audio_fast_null;
+        tb->unlock();
+    }
+}
+
 /**
  * @brief Seek to position in IQ file source.
  * @param pos Byte offset from the beginning of the file.
@@ -1989,21 +2331,46 @@ receiver::status receiver::seek_iq_file_ts(uint64_t ts, uint64_t &res_point)
     return status;
 }
 
-receiver::status receiver::save_file_range_ts(const uint64_t from_ms, const uint64_t len_ms, const std::string name)
+/**
+ * @brief Save a fragment of the IQ file being played.
+ * @param fmt Output format, FILE_FORMAT_LAST to keep the file format.
+ */
+receiver::status receiver::save_file_range_ts(const uint64_t from_ms, const uint64_t len_ms, const std::string name,
+                                              file_formats fmt)
 {
-    if (input_file->save_ts(from_ms, len_ms, name))
+    if (fmt == FILE_FORMAT_LAST)
+        fmt = d_last_format;
+    if (input_file->save_ts(from_ms, len_ms, name, d_last_format, fmt,
+                            convert_from[d_last_format], convert_to[fmt]))
         return STATUS_OK;
     return STATUS_ERROR;
 }
 
+void receiver::get_audio_rec_stats(struct audio_rec_stats &stats)
+{
+    wavfile_sink_gqrx::sptr sink = rx[d_current]->get_wav_sink();
+
+    stats.recording = sink->is_active();
+    stats.queue_hwm = sink->get_queue_hwm();
+    stats.queue_size = sink->get_queue_size();
+    stats.dropped = sink->get_dropped();
+    stats.overruns = sink->get_overruns();
+}
+
 void receiver::get_iq_tool_stats(struct iq_tool_stats &stats)
 {
     stats.recording = d_recording_iq;
     stats.playing = (d_last_format != FILE_FORMAT_NONE);
+    stats.buffer_hwm = -1;
+    stats.write_latency = -1.f;
+    stats.write_latency_max = -1.f;
     if (d_recording_iq && iq_sink)
     {
         stats.failed = iq_sink->get_failed();
         stats.buffer_usage = iq_sink->get_buffer_usage();
+        stats.buffer_hwm = iq_sink->get_buffer_hwm();
+        stats.write_latency = iq_sink->get_write_latency();
+        stats.write_latency_max = iq_sink->get_write_latency_max();
         stats.file_pos = iq_sink->get_written();
         stats.sample_pos = stats.file_pos * any_to_any_base::fmt[d_last_format].nsamples;
     }
@@ -2016,6 +2383,184 @@ void receiver::get_iq_tool_stats(struct iq_tool_stats &stats)
     }
 }
 
+/**
+ * @brief Sample the per-block DSP load.
+ * @param blocks Load of every primitive block, shared blocks first.
+ * @param vfos Load of the shared blocks (vfo = -1) and of every VFO.
+ *
+ * The load is measured since the previous call, so this should be called
+ * periodically from one place only.
+ */
+void receiver::get_dsp_load(std::vector<dsp_load_block> &blocks, std::vector<dsp_load_vfo> &vfos)
+{
+    std::map<int, int> port_vfo;
+    gr::block_sptr fork;
+
+    if (!d_running)
+    {
+        blocks.clear();
+        vfos.clear();
+        d_dsp_load.reset();
+        return;
+    }
+    // The VFOs read from the channelizer or from the block feeding the I/Q FFT
+    if (d_use_chan)
+        fork = chan;
+    else
+        fork = dsp_load_sampler::writer(iq_fft, 0);
+    for (auto &rxc : rx)
+        if (rxc && rxc->connected() && rxc->get_demod() != Modulations::MODE_OFF)
+            port_vfo[rxc->get_port()] = rxc->get_index();
+    d_dsp_load.sample(fork, {add0, add1}, port_vfo, blocks, vfos);
+}
+
+/**
+ * @brief Release the demodulators, that the VFOs have not used for a while.
+ *
+ * The VFOs build their demodulators on first use and keep them cached, when
+ * the mode is changed. Call this periodically to free the memory of the
+ * cached demodulators, see DEMOD_IDLE_TIMEOUT.
+ */
+void receiver::release_idle_demods()
+{
+    for (auto &rxc : rx)
+        if (rxc)
+            rxc->release_idle_demods();
+}
+
+/**
+ * @brief Enable or disable the shared memory export of the I/Q samples and
+ *        the audio.
+ *
+ * The I/Q samples are exported after the input blocks at the decimated
+ * input rate, the audio after the mixer as interleaved stereo, see
+ * gqrx_shm.h. The flowgraph is reconnected.
+ */
+receiver::status receiver::set_shm_export(bool enabled)
+{
+    if (enabled == get_shm_export())
+        return STATUS_OK;
+
+    if (enabled)
+    {
+        size_t iq_bytes = d_decim_rate * SHM_RING_SECONDS * sizeof(gr_complex);
+        size_t audio_bytes = d_audio_rate * SHM_RING_SECONDS * 2 * sizeof(float);
+        shm_ring_sptr iq_ring = shm_ring::make("iq", GQRX_SHM_IQ, sizeof(gr_complex), 0,
+                                               d_decim_rate, iq_bytes);
+        shm_ring_sptr audio_ring = shm_ring::make("audio", GQRX_SHM_AUDIO, 2 * sizeof(float), 2,
+                                                  d_audio_rate, audio_bytes);
+
+        if (!iq_ring || !audio_ring)
+            return STATUS_ERROR;
+
+        shm_iq = make_shm_sink(sizeof(gr_complex), 1, iq_ring);
+        shm_audio = make_shm_sink(sizeof(float), 2, audio_ring);
+    }
+    else
+    {
+        shm_iq.reset();
+        shm_audio.reset();
+    }
+    reconnect_all(FILE_FORMAT_LAST, true);
+
+    return STATUS_OK;
+}
+
+/**
+ * @brief Enable or disable the end-to-end latency probes.
+ *
+ * The probes are tagged right after the I/Q source (and the optional I/Q
+ * swap and DC removal) and measured after the channelizer, at the output
+ * of every VFO, after the audio mixer and when played by the audio sink.
+ * The flowgraph is reconnected, so this should not be called too often.
+ */
+receiver::status receiver::set_latency_probes(bool enabled)
+{
+    if (enabled == d_latency_probes)
+        return STATUS_OK;
+
+    d_latency_probes = enabled;
+    // Connected VFOs get their probe in connect_rx()
+    if (!enabled)
+        for (auto &rxc : rx)
+            rxc->set_latency_probe(false);
+    reconnect_all(FILE_FORMAT_LAST, true);
+    lat_chan->get();
+    lat_mix->get();
+
+    return STATUS_OK;
+}
+
+/**
+ * @brief Get the latency and the latency budget of every stage.
+ * @param stages The input blocks, the channelizer (if used), every active
+ *               VFO, the audio mixer and the audio sink.
+ * @return false if the DSP is not running.
+ *
+ * The measured latency (since the previous call) is only available with
+ * the latency probes enabled, otherwise it is -1. The latency of a stage
+ * is the difference to the stage before it. The mixer waits for the
+ * slowest VFO, so its stage latency is relative to the maximum of the VFOs.
+ * The budget is the longest time the batches and buffers of a stage can
+ * hold a sample with the current latency profile.
+ */
+bool receiver::get_latency(std::vector<latency_stage> &stages)
+{
+    const latency_stats none = {-1.0, -1.0, -1.0, 0};
+    latency_stats   stats;
+    double          prev = 0.0;
+    double          slowest = 0.0;
+
+    stages.clear();
+    if (!d_running)
+        return false;
+
+    auto add_stage = [&stages](const std::string &name, int vfo,
+                               const latency_stats &st, double before,
+                               double budget) {
+        latency_stage stage;
+
+        stage.name = name;
+        stage.vfo = vfo;
+        stage.total = st.avg;
+        stage.max = st.max;
+        stage.stage = (st.avg >= 0.0) ? std::max(st.avg - before, 0.0) : -1.0;
+        stage.budget = budget;
+        stages.push_back(stage);
+    };
+
+    // The probes are stamped after the input blocks
+    add_stage("input", -1, none, 0.0, d_budget_input);
+    if (d_use_chan)
+    {
+        stats = d_latency_probes ? lat_chan->get() : none;
+        add_stage("channelizer", -1, stats, 0.0, d_budget_chan);
+        prev = std::max(stats.avg, 0.0);
+    }
+    for (auto &rxc : rx)
+    {
+        if (!rxc || !rxc->connected() || rxc->get_demod() == Modulations::MODE_OFF)
+            continue;
+        stats = d_latency_probes ? rxc->get_latency() : none;
+        add_stage("vfo", rxc->get_index(), stats, prev, rxc->get_latency_budget());
+        slowest = std::max(slowest, stats.avg);
+    }
+    if (d_active > 0)
+    {
+        stats = d_latency_probes ? lat_mix->get() : none;
+        add_stage("mixer", -1, stats, slowest, d_budget_mixer);
+        prev = std::max(stats.avg, 0.0);
+        if (d_audio_out == audio_snk)
+        {
+            if (!d_latency_probes || !get_audio_sink_latency(audio_snk, stats))
+                stats = none;
+            add_stage("audio", -1, stats, prev, d_budget_audio);
+        }
+    }
+
+    return true;
+}
+
 /**
  * @brief Start data sniffer.
  * @param buffsize The buffer that should be used in the sniffer.
@@ -2093,12 +2638,23 @@ void receiver::connect_all(file_formats fmt)
         b = dc_corr;
     }
 
+    // Latency probes are stamped as close to the source as possible
+    if (d_latency_probes)
+    {
+        tb->connect(b, 0, lat_tagger, 0);
+        b = lat_tagger;
+    }
+
     // Visualization
     tb->connect(b, 0, iq_fft, 0);
+    if (shm_iq)
+        tb->connect(b, 0, shm_iq, 0);
     if(d_use_chan)
     {
         tb->connect(b, 0, chan, 0);
         tb->connect(chan, 0, probe_fft, 0);
+        if (d_latency_probes)
+            tb->connect(chan, 0, lat_chan, 0);
     }
     iq_src = b;
 
@@ -2108,6 +2664,74 @@ void receiver::connect_all(file_formats fmt)
     for (auto& rxc : rx)
         connect_rx(rxc->get_index());
     foreground_rx();
+    apply_latency_profile();
+}
+
+/**
+ * @brief Size the batches and output buffers of the shared blocks.
+ *
+ * The VFOs size their own blocks in receiver_base_cf::set_latency_profile().
+ * Takes effect, when the flowgraph is started.
+ */
+void receiver::apply_latency_profile()
+{
+    int max_buffer = latency_buffer_items(d_latency_profile, d_decim_rate);
+
+    // Input processing before the channelizer and the VFOs. The DC
+    // corrector is a hier block and keeps the default buffers, which hold
+    // only a few ms at typical input rates.
+    d_budget_input = 0.0;
+    iq_swap->set_max_output_buffer(max_buffer);
+    lat_tagger->set_max_output_buffer(max_buffer);
+    if (d_iq_rev)
+        d_budget_input += latency_block_time(1, max_buffer, sizeof(gr_complex), d_decim_rate);
+    if (d_dc_cancel)
+        d_budget_input += latency_block_time(1, 0, sizeof(gr_complex), d_decim_rate);
+    if (d_latency_probes)
+        d_budget_input += latency_block_time(1, max_buffer, sizeof(gr_complex), d_decim_rate);
+
+    // Every channelizer thread gets the same number of outputs
+    double chan_rate = d_decim_rate * chan->relative_rate();
+    int nthreads = chan->nthreads();
+    int multiple = latency_batch_items(d_latency_profile, chan_rate, CHANNELIZER_OUTPUT_MULTIPLE);
+
+    multiple = (multiple + nthreads - 1) / nthreads * nthreads;
+    max_buffer = latency_buffer_items(d_latency_profile, chan_rate);
+    chan->set_output_multiple(multiple);
+    chan->set_max_output_buffer(max_buffer);
+    d_budget_chan = d_use_chan ? latency_block_time(multiple, max_buffer, sizeof(gr_complex), chan_rate) : 0.0;
+
+    // Audio mixer: add and multiply_const in series
+    max_buffer = latency_buffer_items(d_latency_profile, d_audio_rate);
+    for (gr::block_sptr b : {gr::block_sptr(add0), gr::block_sptr(add1),
+                             gr::block_sptr(mc0), gr::block_sptr(mc1)})
+        b->set_max_output_buffer(max_buffer);
+    d_budget_mixer = 2.0 * latency_block_time(1, max_buffer, sizeof(float), d_audio_rate);
+
+    // Sound card buffer
+    if (set_audio_sink_latency(audio_snk, (d_latency_profile == LATENCY_PROFILE_LOW)
+                                          ? LATENCY_LOW_AUDIO_TIME : 0.0))
+        d_budget_audio = (d_latency_profile == LATENCY_PROFILE_LOW) ? LATENCY_LOW_AUDIO_TIME : -1.0;
+    else
+        d_budget_audio = -1.0;
+}
+
+/**
+ * @brief Select the latency profile.
+ * @param profile LATENCY_PROFILE_LOW for small batches and bounded buffers,
+ *                LATENCY_PROFILE_THROUGHPUT for the least CPU load.
+ *
+ * The flowgraph is reconnected, so that the new buffers are allocated.
+ */
+receiver::status receiver::set_latency_profile(latency_profile profile)
+{
+    if (profile == d_latency_profile)
+        return STATUS_OK;
+
+    d_latency_profile = profile;
+    reconnect_all(FILE_FORMAT_LAST, true);
+
+    return STATUS_OK;
 }
 
 void receiver::connect_rx()
@@ -2123,6 +2747,7 @@ void receiver::connect_rx(int n)
         return;
     std::cerr<<"connect_rx "<<n<<" active "<<d_active<<" demod "<<rx[n]->get_demod()<<std::endl;
     rx[n]->set_timestamp_source(&d_iq_ts);
+    rx[n]->set_latency_profile(d_latency_profile);
     if (rx[n]->get_demod() != Modulations::MODE_OFF)
     {
         if (d_active == 0)
@@ -2132,10 +2757,23 @@ void receiver::connect_rx(int n)
             tb->connect(add0, 0, mc0, 0);
             tb->connect(add1, 0, mc1, 0);
             std::cerr<<"connect audio_snk "<<d_active<<std::endl;
-            tb->connect(mc0, 0, audio_snk, 0);
-            tb->connect(mc1, 0, audio_snk, 1);
+            // Don't feed the sound card faster than real time
+            if (is_playing_iq() && d_iq_speed != 1.0)
+                d_audio_out = audio_fast_null;
+            else
+                d_audio_out = audio_snk;
+            tb->connect(mc0, 0, d_audio_out, 0);
+            tb->connect(mc1, 0, d_audio_out, 1);
+            if (d_latency_probes)
+                tb->connect(mc0, 0, lat_mix, 0);
+            if (shm_audio)
+            {
+                tb->connect(mc0, 0, shm_audio, 0);
+                tb->connect(mc1, 0, shm_audio, 1);
+            }
         }
         std::cerr<<"connect_rx d_active > 0 rx="<<n<<" port="<<d_active<<std::endl;
+        rx[n]->set_latency_probe(d_latency_probes);
         if(d_use_chan)
             tb->connect(chan, d_active, rx[n], 0);
         else
@@ -2176,8 +2814,15 @@ void receiver::disconnect_rx(int n)
             tb->disconnect(add0, 0, mc0, 0);
             tb->disconnect(add1, 0, mc1, 0);
             std::cerr<<"disconnect audio_snk "<<d_active<<std::endl;
-            tb->disconnect(mc0, 0, audio_snk, 0);
-            tb->disconnect(mc1, 0, audio_snk, 1);
+            tb->disconnect(mc0, 0, d_audio_out, 0);
+            tb->disconnect(mc1, 0, d_audio_out, 1);
+            if (d_latency_probes)
+                tb->disconnect(mc0, 0, lat_mix, 0);
+            if (shm_audio)
+            {
+                tb->disconnect(mc0, 0, shm_audio, 0);
+                tb->disconnect(mc1, 0, shm_audio, 1);
+            }
         }
         int rx_port = rx[n]->get_port();
         std::cerr<<"disconnect_rx d_active > 0 get_port="<<rx_port<<std::endl;
@@ -2367,6 +3012,12 @@ void receiver::audio_rec_event(receiver * self, int idx, std::string filename, b
 #define GR_STAT stat
 #endif
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#define FFT_READER_MMAP
+#endif
+
 receiver::fft_reader::fft_reader(std::string filename, int chunk_size, int samples_per_chunk, int sample_rate, uint64_t base_ts, uint64_t offset, any_to_any_base::sptr conv, rx_fft_c_sptr fft, receiver::fft_reader::fft_data_ready handler, int nthreads)
 {
     d_filename = filename;
@@ -2385,21 +3036,70 @@ receiver::fft_reader::fft_reader(std::string filename, int chunk_size, int sampl
         lock.unlock();
     }
     data_ready = handler;
-    d_fd = fopen(filename.c_str(), "rb");
-    if(d_fd)
-    {
-        GR_FSEEK(d_fd, 0, SEEK_END);
-        d_file_size = GR_FTELL(d_fd);
-    }
+    open_file();
     d_lasttime = std::chrono::steady_clock::now();
 }
 
 receiver::fft_reader::~fft_reader()
 {
     stop_threads();
+    close_file();
+}
+
+void receiver::fft_reader::open_file()
+{
+    d_file_size = 0;
+    d_fd = fopen(d_filename.c_str(), "rb");
+    if(!d_fd)
+        return;
+    GR_FSEEK(d_fd, 0, SEEK_END);
+    d_file_size = GR_FTELL(d_fd);
+    // Compressed file: worker threads decode the chunks, covering the
+    // requested frames. d_file_size is the size of the decoded data.
+    if((d_chunk_size == int(chunked_iq::ITEM_SIZE)) && chunked_iq::probe(d_filename))
+    {
+        try
+        {
+            d_zr = std::make_shared<chunked_iq::reader>(d_filename);
+            d_file_size = d_zr->get_items() * d_chunk_size;
+            return;
+        }
+        catch(std::runtime_error &e)
+        {
+            std::cerr << e.what() << std::endl;
+            d_file_size = 0;
+            return;
+        }
+    }
+#ifdef FFT_READER_MMAP
+    // Map the whole file, so that worker threads can convert the data
+    // directly from the page cache. Fall back to fread if mmap fails
+    // (32-bit address space, special files etc).
+    if(d_file_size > 0)
+    {
+        void * p = mmap(nullptr, d_file_size, PROT_READ, MAP_SHARED, GR_FILENO(d_fd), 0);
+        if(p != MAP_FAILED)
+        {
+            d_map = (const uint8_t *)p;
+            // Waterfall lines are sparse, prefetch() tells the kernel what we need
+            madvise(p, d_file_size, MADV_RANDOM);
+        }
+    }
+#endif
+}
+
+void receiver::fft_reader::close_file()
+{
+#ifdef FFT_READER_MMAP
+    if(d_map)
+        munmap((void *)d_map, d_file_size);
+#endif
+    d_map = nullptr;
+    d_zr.reset();
     if(d_fd)
         fclose(d_fd);
     d_fd = nullptr;
+    d_file_size = 0;
 }
 
 void receiver::fft_reader::start_threads(int nthreads, rx_fft_c_sptr fft)
@@ -2421,6 +3121,8 @@ void receiver::fft_reader::start_threads(int nthreads, rx_fft_c_sptr fft)
         t.ready = false;
         t.exit_request = false;
         t.line = 0;
+        t.src_pos = 0;
+        t.read_ofs = 0;
         t.thread = new std::thread(&receiver::fft_reader::task::thread_func,&t);
     }
 }
@@ -2483,15 +3185,9 @@ void receiver::fft_reader::reconfigure(std::string filename, int chunk_size, int
     if(d_filename != filename)
     {
         d_filename = filename;
-        if(d_fd)
-            fclose(d_fd);
+        close_file();
         lock.unlock();
-        d_fd = fopen(filename.c_str(), "rb");
-        if(d_fd)
-        {
-            GR_FSEEK(d_fd, 0, SEEK_END);
-            d_file_size = GR_FTELL(d_fd);
-        }
+        open_file();
     }
     d_lasttime = std::chrono::steady_clock::now();
 }
@@ -2513,25 +3209,79 @@ void receiver::fft_reader::wait()
 #endif
 }
 
-bool receiver::fft_reader::get_iq_fft_data(uint64_t ms, int n)
+/**
+ * @brief Calculate file position of the FFT frame, ending ms milliseconds
+ *        before current offset.
+ * @param ms Time offset (backwards) from current position.
+ * @param read_ofs Returns number of samples, missing at the beginning of the file.
+ * @return File position in bytes.
+ */
+uint64_t receiver::fft_reader::line_pos(uint64_t ms, int &read_ofs)
 {
     uint64_t samp = ms * d_sample_rate / 1000llu;
+    read_ofs = 0;
+    if(samp > d_offset)
+        samp = 0;
+    else
+        samp = d_offset - samp;
+    if(samp >= threads[0].samples)
+        return ((samp - threads[0].samples) / d_samples_per_chunk) * d_chunk_size;
+    read_ofs = threads[0].samples - samp;
+    return 0;
+}
+
+/**
+ * @brief Give the kernel a read-ahead hint for the lines to be requested.
+ * @param nlines Number of waterfall lines, that will be read.
+ * @param ms_per_line Waterfall line interval.
+ *
+ * Only the pages, covered by FFT frames are requested, so that rebuilding
+ * a waterfall with long line interval does not pull the whole file into
+ * the page cache.
+ */
+void receiver::fft_reader::prefetch(int nlines, double ms_per_line)
+{
+#ifdef FFT_READER_MMAP
+    if(!d_map || threads.empty())
+        return;
+    const uint64_t page = sysconf(_SC_PAGESIZE);
+    const uint64_t frame = d_chunk_size * (threads[0].samples / d_samples_per_chunk);
+    uint64_t start = 0;
+    uint64_t end = 0;
+    int read_ofs;
+    for(int k = 0; k < nlines; k++)
+    {
+        uint64_t from = line_pos(uint64_t(k * ms_per_line), read_ofs) / page * page;
+        uint64_t to = std::min(from + frame + page, d_file_size);
+        if(from >= d_file_size)
+            continue;
+        // lines go backwards in the file, merge overlapping ranges
+        if(end > start && to >= start)
+        {
+            start = std::min(start, from);
+            continue;
+        }
+        if(end > start)
+            madvise((void *)(d_map + start), end - start, MADV_WILLNEED);
+        start = from;
+        end = to;
+    }
+    if(end > start)
+        madvise((void *)(d_map + start), end - start, MADV_WILLNEED);
+#endif
+}
+
+bool receiver::fft_reader::get_iq_fft_data(uint64_t ms, int n)
+{
     int read_ofs = 0;
     unsigned k;
     if(!d_fd)
     {
         return false;
     }
-    if(samp > d_offset)
-        samp = 0;
-    else
-        samp = d_offset - samp;
-    if(samp>=threads[0].samples)
-        GR_FSEEK(d_fd, ((samp - threads[0].samples) / d_samples_per_chunk) * d_chunk_size, SEEK_SET);
-    else{
-        GR_FSEEK(d_fd, 0, SEEK_SET);
-        read_ofs = threads[0].samples - samp;
-    }
+    uint64_t pos = line_pos(ms, read_ofs);
+    if(!d_map && !d_zr)
+        GR_FSEEK(d_fd, pos, SEEK_SET);
     std::unique_lock<std::mutex> lock(mutex);
     if(busy == threads.size())
         finished.wait(lock);
@@ -2542,12 +3292,17 @@ bool receiver::fft_reader::get_iq_fft_data(uint64_t ms, int n)
         return false;
     busy++;
     lock.unlock();
-    if(read_ofs > 0)
-        std::memset(threads[k].d_buf.data(), 0, (read_ofs / d_samples_per_chunk) * d_chunk_size);
-    size_t nread = fread(&threads[k].d_buf[(read_ofs / d_samples_per_chunk) * d_chunk_size], d_chunk_size, (threads[k].samples - read_ofs) / d_samples_per_chunk, d_fd);
-    if(nread != (threads[k].samples - read_ofs) / d_samples_per_chunk)
-    {
-        //FIXME: Handle error?
+    threads[k].src_pos = pos;
+    threads[k].read_ofs = read_ofs;
+    if(!d_map && !d_zr)
+    {
+        if(read_ofs > 0)
+            std::memset(threads[k].d_buf.data(), 0, (read_ofs / d_samples_per_chunk) * d_chunk_size);
+        size_t nread = fread(&threads[k].d_buf[(read_ofs / d_samples_per_chunk) * d_chunk_size], d_chunk_size, (threads[k].samples - read_ofs) / d_samples_per_chunk, d_fd);
+        if(nread != (threads[k].samples - read_ofs) / d_samples_per_chunk)
+        {
+            //FIXME: Handle error?
+        }
     }
     threads[k].line = n;
     threads[k].ts = d_base_ts + d_offset_ms - ms;
@@ -2575,7 +3330,37 @@ void receiver::fft_reader::task::thread_func()
         ready = false;
         lock.unlock();
 
-        if(owner->d_conv)
+        if(owner->d_map || owner->d_zr)
+        {
+            // Convert straight from the mapped file (or the decoded chunks),
+            // zero-fill the parts before the beginning and after the end of
+            // the file.
+            const int spc = owner->d_samples_per_chunk;
+            const unsigned skip = (read_ofs / spc) * spc;
+            uint64_t nchunks = (samples - skip) / spc;
+            if(src_pos >= owner->d_file_size)
+                nchunks = 0;
+            else
+                nchunks = std::min(nchunks, (owner->d_file_size - src_pos) / owner->d_chunk_size);
+            const uint8_t * src;
+            if(owner->d_zr)
+            {
+                nchunks = owner->d_zr->read(src_pos / owner->d_chunk_size, d_buf.data(), nchunks, false);
+                src = d_buf.data();
+            }
+            else
+                src = owner->d_map + src_pos;
+            const unsigned nsamples = nchunks * spc;
+            gr_complex * dst = d_fftbuf.data();
+            std::fill(dst, dst + skip, gr_complex(0.f, 0.f));
+            if(owner->d_conv)
+                owner->d_conv->convert(src, dst + skip, nsamples);
+            else
+                std::memcpy(dst + skip, src, nchunks * owner->d_chunk_size);
+            std::fill(dst + skip + nsamples, dst + samples, gr_complex(0.f, 0.f));
+            d_fft.get_fft_data(buf, fftsize, d_fftbuf.data());
+        }
+        else if(owner->d_conv)
         {
             owner->d_conv->convert(d_buf.data(), d_fftbuf.data(), d_fft.get_fft_size());
             d_fft.get_fft_data(buf, fftsize, d_fftbuf.data());
@@ -44,12 +44,15 @@
 #include <string>
 #include <memory>
 #include <atomic>
+#include <set>
 
 #include "dsp/correct_iq_cc.h"
+#include "dsp/dsp_load.h"
+#include "dsp/latency_probe.h"
+#include "dsp/latency_profile.h"
 #include "dsp/filter/fir_decim.h"
 #include "dsp/rx_noise_blanker_cc.h"
 #include "dsp/rx_filter.h"
-#include "dsp/rx_meter.h"
 #include "dsp/rx_agc_xx.h"
 #include "dsp/rx_demod_fm.h"
 #include "dsp/rx_demod_am.h"
@@ -60,6 +63,9 @@
 #include "interfaces/udp_sink_f.h"
 #include "interfaces/file_sink.h"
 #include "interfaces/file_source.h"
+#include "interfaces/chunked_iq.h"
+#include "interfaces/iq_stream_sink.h"
+#include "interfaces/shm_sink.h"
 #include "receivers/receiver_base.h"
 #include "interfaces/audio_sink.h"
 
@@ -102,10 +108,40 @@ public:
         bool playing;
         bool failed;
         int buffer_usage;
+        int buffer_hwm;
+        float write_latency;
+        float write_latency_max;
         size_t file_pos;
         size_t sample_pos;
      };
 
+    /** Writer queue of the audio recorder of the current VFO. */
+    struct audio_rec_stats
+    {
+        bool recording;
+        unsigned queue_hwm;     /*!< Most blocks queued since the start. */
+        unsigned queue_size;
+        long long dropped;      /*!< Samples replaced with silence. */
+        unsigned overruns;
+    };
+
+    /** One change of a VFO, see apply_vfo_changes(). */
+    struct vfo_change
+    {
+        enum kind {
+            OFFSET,             /*!< Filter offset in Hz (value). */
+            DEMOD,              /*!< Demodulator (demod). */
+            FILTER,             /*!< Filter edges in Hz (low, high). */
+            SQL_LEVEL           /*!< Squelch level in dBFS (value). */
+        };
+        kind             what;
+        int              vfo;
+        double           value;
+        Modulations::idx demod;
+        int              low;
+        int              high;
+    };
+
     typedef std::function<void(std::string, bool)> audio_rec_event_handler_t;
     typedef std::function<void(int64_t)> iq_save_progress_t;
 
@@ -119,8 +155,12 @@ public:
         void reconfigure(std::string filename, int chunk_size, int samples_per_chunk, int sample_rate, uint64_t base_ts, uint64_t offset, any_to_any_base::sptr conv, rx_fft_c_sptr fft, receiver::fft_reader::fft_data_ready handler, int nthreads);
         uint64_t ms_available();
         bool get_iq_fft_data(uint64_t ms, int n);
+        void prefetch(int nlines, double ms_per_line);
         void wait();
         private:
+        void open_file();
+        void close_file();
+        uint64_t line_pos(uint64_t ms, int &read_ofs);
         struct task
         {
             task(){thread = nullptr;};
@@ -135,6 +175,8 @@ public:
             int line;
             unsigned samples;
             uint64_t ts;
+            uint64_t src_pos;
+            int read_ofs;
             fft_c_basic d_fft;
             std::vector<uint8_t> d_buf;
             std::vector<gr_complex> d_fftbuf;
@@ -142,7 +184,9 @@ public:
             std::condition_variable start{};
         };
         std::string d_filename;
-        FILE * d_fd;
+        FILE * d_fd{nullptr};
+        const uint8_t * d_map{nullptr};
+        std::shared_ptr<chunked_iq::reader> d_zr;
         int d_chunk_size;
         int d_samples_per_chunk;
         int d_sample_rate;
@@ -184,6 +228,7 @@ public:
 
     void        start();
     void        stop();
+    void        wait();
     bool        is_running() const {return d_running;}
     void        set_input_device(const std::string device);
     void        set_output_device(const std::string device);
@@ -230,6 +275,8 @@ public:
     int         add_rx();
     int         get_rx_count();
     int         delete_rx();
+    int         delete_rx(const std::set<int> &vfos);
+    std::set<int> move_locked_vfos(int64_t delta_freq);
     status      select_rx(int no);
     status      fake_select_rx(int no);
     int         get_current();
@@ -237,6 +284,7 @@ public:
     vfo::sptr   get_vfo(int n);
     vfo::sptr   find_vfo(int64_t freq);
     std::vector<vfo::sptr> get_vfos();
+    status      apply_vfo_changes(const std::vector<vfo_change> &changes);
 
     status      set_filter_offset(double offset_hz);
     status      set_filter_offset(int rx_index, double offset_hz);
@@ -250,6 +298,8 @@ public:
     status      get_filter(int &low, int &high, filter_shape &shape);
     status      set_freq_corr(double ppm);
     float       get_signal_pwr() const;
+    float       get_signal_pwr(int rx_index) const;
+    bool        get_sql_open(int rx_index) const;
     void        set_iq_fft_size(int newsize);
     void        set_iq_fft_window(int window_type, int correction);
     void        get_iq_fft_data(std::complex<float>* fftPoints,
@@ -367,6 +417,8 @@ public:
     bool        get_udp_stereo();
     status      set_udp_streaming(bool streaming);
     bool        get_udp_streaming();
+    void        set_udp_options(int payload, bool rtp, int multicast_ttl);
+    void        get_udp_options(int &payload, bool &rtp, int &multicast_ttl);
 
     /* Dedicated audio sink */
     void set_dedicated_audio_sink(bool value);
@@ -375,15 +427,44 @@ public:
     void set_dedicated_audio_dev(std::string value) { rx[d_current]->set_audio_dev(value); }
 
     /* I/Q recording and playback */
-    status      start_iq_recording(const std::string filename, const file_formats fmt, int buffers_max);
+    status      start_iq_recording(const std::string filename, const file_formats fmt, int buffers_max, bool direct_io = false);
     status      stop_iq_recording();
     status      seek_iq_file(long pos);
     status      seek_iq_file_ts(uint64_t ts, uint64_t &res_point);
+    status      set_iq_playback_speed(double speed);
+    double      get_iq_playback_speed() const { return d_iq_speed; }
+    void        set_fast_audio_sink(gr::basic_block_sptr sink);
     void        get_iq_tool_stats(struct iq_tool_stats &stats);
+    void        get_audio_rec_stats(struct audio_rec_stats &stats);
+
+    /* I/Q streaming */
+    iq_stream_sink_sptr start_iq_stream(int rx_index, iq_stream_sink::stage where,
+                                        file_formats fmt);
+    void        stop_iq_stream(iq_stream_sink_sptr tap);
+
+    /* Shared memory export */
+    status      set_shm_export(bool enabled);
+    bool        get_shm_export() const { return shm_iq || shm_audio; }
+
+    /* DSP load */
+    void        get_dsp_load(std::vector<dsp_load_block> &blocks, std::vector<dsp_load_vfo> &vfos);
+    bool        has_dsp_work_time() const { return d_dsp_load.has_work_time(); }
+
+    /* End-to-end latency */
+    status      set_latency_probes(bool enabled);
+    bool        get_latency_probes() const { return d_latency_probes; }
+    bool        get_latency(std::vector<latency_stage> &stages);
+    status      set_latency_profile(latency_profile profile);
+    latency_profile get_latency_profile() const { return d_latency_profile; }
+
+    /* Demodulator cache */
+    void        release_idle_demods();
+
     uint64_t    get_iq_file_size() { return input_file->get_size(); }
     bool        is_playing_iq() { return d_last_format != FILE_FORMAT_NONE; }
     bool        is_recording_iq() { return d_iq_fmt != FILE_FORMAT_NONE; }
-    status      save_file_range_ts(const uint64_t from_ms, const uint64_t len_ms, const std::string name);
+    status      save_file_range_ts(const uint64_t from_ms, const uint64_t len_ms, const std::string name,
+                                   file_formats fmt = FILE_FORMAT_LAST);
     template <typename T> void set_iq_save_progress_cb(T handler)
     {
         d_save_progress = handler;
@@ -416,6 +497,7 @@ public:
 
 private:
     void        connect_all(file_formats fmt);
+    void        apply_latency_profile();
     void        connect_rx();
     void        connect_rx(int n);
     void        disconnect_rx();
@@ -426,6 +508,7 @@ private:
     status      connect_iq_recorder();
     void        set_channelizer_int(bool use_chan);
     void        configure_channelizer(bool reconnect);
+    void        close_stale_iq_streams();
 
 private:
     int         d_current;          /*!< Current selected demodulator. */
@@ -434,6 +517,12 @@ private:
     double      d_input_rate;       /*!< Input sample rate. */
     double      d_decim_rate;       /*!< Rate after decimation (input_rate / decim) */
     bool        d_use_chan;         /*!< Use channelizer instead of direct connection */
+    bool        d_latency_probes;   /*!< Latency probes connected. */
+    latency_profile d_latency_profile; /*!< Batch and buffer sizes. */
+    double      d_budget_input;     /*!< Latency budget of the input blocks. */
+    double      d_budget_chan;      /*!< Latency budget of the channelizer. */
+    double      d_budget_mixer;     /*!< Latency budget of the audio mixer. */
+    double      d_budget_audio;     /*!< Sound card latency, -1 if unknown. */
     bool        d_enable_chan;      /*!< Enable channelizer usage when input rate is high enough */
     double      d_audio_rate;       /*!< Audio output rate. */
     unsigned int    d_decim;        /*!< input decimation. */
@@ -448,6 +537,7 @@ private:
     bool        d_mute;             /*!< Enable audio mute. */
     file_formats d_iq_fmt;
     file_formats d_last_format;
+    double      d_iq_speed;         /*!< I/Q playback speed, 0 = unlimited. */
     iqfile_timestamp_source d_iq_ts;
 
     std::string input_devstr;       /*!< Current input device string. */
@@ -474,6 +564,13 @@ private:
     rx_fft_c_sptr             iq_fft;     /*!< Baseband FFT block. */
     rx_fft_f_sptr             audio_fft;  /*!< Audio FFT block. */
 
+    latency_tagger_cc_sptr    lat_tagger; /*!< Adds the latency probe tags. */
+    latency_probe_sink_sptr   lat_chan;   /*!< Latency after the channelizer. */
+    latency_probe_sink_sptr   lat_mix;    /*!< Latency after the audio mixer. */
+
+    shm_sink_sptr             shm_iq;     /*!< Shared memory export of the input. */
+    shm_sink_sptr             shm_audio;  /*!< Shared memory export of the audio. */
+
     file_sink::sptr         iq_sink;     /*!< I/Q file sink. */
 
     //Format converters to/from different sample formats
@@ -496,7 +593,8 @@ private:
         any_to_any<gr_complex,std::array<int16_t,20>>::make(),
         any_to_any<gr_complex,std::array<int16_t,12>>::make(),
         any_to_any<gr_complex,std::array<int16_t,28>>::make(),
-        nullptr
+        nullptr,
+        any_to_any<gr_complex,std::complex<int16_t>>::make()
     };
     std::vector<any_to_any_base::sptr> convert_from
     {
@@ -517,7 +615,8 @@ private:
         any_to_any<std::array<int16_t,20>,gr_complex>::make(),
         any_to_any<std::array<int16_t,12>,gr_complex>::make(),
         any_to_any<std::array<int16_t,28>,gr_complex>::make(),
-        nullptr
+        nullptr,
+        any_to_any<std::complex<int16_t>,gr_complex>::make()
     };
 
     gr::blocks::throttle::sptr                     input_throttle;
@@ -526,14 +625,17 @@ private:
     gr::blocks::wavfile_source::sptr    wav_src;    /*!< WAV file source for playback. */
     gr::blocks::null_sink::sptr         audio_null_sink0; /*!< Audio null sink used during playback. */
     gr::blocks::null_sink::sptr         audio_null_sink1; /*!< Audio null sink used during playback. */
+    gr::basic_block_sptr                audio_fast_null;  /*!< Audio sink used during fast I/Q playback. */
 
     sniffer_f_sptr    sniffer;    /*!< Sample sniffer for data decoders. */
     resampler_ff_sptr sniffer_rr; /*!< Sniffer resampler. */
 
     gr::basic_block_sptr  audio_snk;  /*!< Pulse audio sink. */
+    gr::basic_block_sptr  d_audio_out; /*!< Sink mc0/mc1 are connected to. */
     audio_rec_event_handler_t d_audio_rec_event_handler;
     //! Get a path to a file containing random bytes
     receiver::fft_reader_sptr d_fft_reader;
+    dsp_load_sampler          d_dsp_load;  /*!< Per-block DSP load. */
     static std::string get_zero_file(void);
     static void audio_rec_event(receiver * self, int idx, std::string filename,
                                 bool running);
@@ -23,68 +23,103 @@
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <QDebug>
 #include <QString>
 #include <QStringList>
 #include "remote_control.h"
-#include "qtgui/dockrxopt.h"
+#include "remote_server.h"
+#include "iq_server.h"
 
 #define DEFAULT_RC_PORT            7356
 #define DEFAULT_RC_ALLOWED_HOSTS   "127.0.0.1"
+#define DEFAULT_IQ_PORT            7357
 
 RemoteControl::RemoteControl(QObject *parent) :
     QObject(parent)
 {
 
-    rc_freq = 0;
-    rc_filter_offset = 0;
-    bw_half = 740e3;
-    rc_lnb_lo_mhz = 0.0;
-    rc_mode = Modulations::MODE_OFF;
-    rc_passband_lo = 0;
-    rc_passband_hi = 0;
-    rc_program_id = "0000";
-    rds_status = false;
-    signal_level = -200.0;
-    squelch_level = -150.0;
-    audio_gain = -6.0;
-    audio_recorder_status = false;
-    receiver_running = false;
-    hamlib_compatible = false;
-    rds_station = QString("");
-    rds_radiotext = QString("");
+    state.freq = 0;
+    state.filter_offset = 0;
+    state.bw_half = 740e3;
+    state.lnb_lo_mhz = 0.0;
+    state.mode = Modulations::MODE_OFF;
+    state.passband_lo = 0;
+    state.passband_hi = 0;
+    state.program_id = "0000";
+    state.rds_status = false;
+    state.latency_probes = false;
+    state.low_latency = false;
+    state.shm_export = false;
+    state.signal_level = -200.0;
+    state.squelch_level = -150.0;
+    state.audio_gain = -6.0;
+    state.audio_recorder_status = false;
+    state.receiver_running = false;
+    state.hamlib_compatible = false;
+    state.rds_station = QString("");
+    state.rds_radiotext = QString("");
+    state.current_vfo = 0;
 
     rc_port = DEFAULT_RC_PORT;
     rc_allowed_hosts.append(DEFAULT_RC_ALLOWED_HOSTS);
-
-    rc_socket = 0;
-
-    connect(&rc_server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+    rc_listening = false;
+    iq_port = DEFAULT_IQ_PORT;
+    iq_listening = false;
+
+    // The server lives in its own thread, so that slow clients and queries
+    // never block the GUI
+    rc_server = new RemoteServer();
+    rc_server->moveToThread(&rc_thread);
+    connect(&rc_thread, SIGNAL(finished()), rc_server, SLOT(deleteLater()));
+    connect(rc_server, SIGNAL(command(quint64,QStringList)),
+            this, SLOT(runCommand(quint64,QStringList)));
+    connect(this, SIGNAL(commandDone(quint64,QByteArray)),
+            rc_server, SLOT(reply(quint64,QByteArray)));
+    publishState();
+    QMetaObject::invokeMethod(rc_server, "setHosts", Qt::QueuedConnection,
+                              Q_ARG(QStringList, rc_allowed_hosts));
+
+    iq_server = new IqServer();
+    iq_server->moveToThread(&rc_thread);
+    connect(&rc_thread, SIGNAL(finished()), iq_server, SLOT(deleteLater()));
+    connect(iq_server, SIGNAL(streamRequested(quint64,int,int,int)),
+            this, SIGNAL(newIqStream(quint64,int,int,int)));
+    connect(iq_server, SIGNAL(streamClosed(quint64)), this, SIGNAL(iqStreamClosed(quint64)));
+    QMetaObject::invokeMethod(iq_server, "setHosts", Qt::QueuedConnection,
+                              Q_ARG(QStringList, rc_allowed_hosts));
+    rc_thread.start();
 }
 
 RemoteControl::~RemoteControl()
 {
     stop_server();
+    rc_thread.quit();
+    rc_thread.wait();
 }
 
-/*! \brief Start the server. */
+/*! \brief Start the server, and the I/Q server unless its port is 0. */
 void RemoteControl::start_server()
 {
-    if (!rc_server.isListening())
-        rc_server.listen(QHostAddress::Any, rc_port);
+    if (!rc_listening)
+        QMetaObject::invokeMethod(rc_server, "listen", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(bool, rc_listening),
+                                  Q_ARG(int, rc_port));
+    if (!iq_listening && iq_port > 0)
+        QMetaObject::invokeMethod(iq_server, "listen", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(bool, iq_listening),
+                                  Q_ARG(int, iq_port));
 }
 
-/*! \brief Stop the server. */
+/*! \brief Stop the servers and close all client connections. */
 void RemoteControl::stop_server()
 {
-    if (rc_socket != 0) {
-        rc_socket->close();
-        rc_socket->deleteLater();
-        rc_socket = 0;
-    }
-
-    if (rc_server.isListening())
-        rc_server.close();
-
+    if (rc_listening)
+        QMetaObject::invokeMethod(rc_server, "close", Qt::BlockingQueuedConnection);
+    rc_listening = false;
+    if (iq_listening)
+        QMetaObject::invokeMethod(iq_server, "close", Qt::BlockingQueuedConnection);
+    iq_listening = false;
 }
 
 /*! \brief Read settings. */
@@ -99,6 +134,9 @@ void RemoteControl::readSettings(QSettings *settings)
     if (settings->contains("port"))
         setPort(settings->value("port").toInt());
 
+    if (settings->contains("iq_port"))
+        setIqPort(settings->value("iq_port").toInt());
+
     // Get list of allowed hosts
     if (settings->contains("allowed_hosts"))
         setHosts(settings->value("allowed_hosts").toStringList());
@@ -113,7 +151,7 @@ void RemoteControl::saveSettings(QSettings *settings) const
 
     settings->beginGroup("remote_control");
 
-    if (rc_server.isListening())
+    if (rc_listening)
         settings->setValue("enabled", true);
     else
         settings->remove("enabled");
@@ -123,6 +161,11 @@ void RemoteControl::saveSettings(QSettings *settings) const
     else
         settings->remove("port");
 
+    if (iq_port != DEFAULT_IQ_PORT)
+        settings->setValue("iq_port", iq_port);
+    else
+        settings->remove("iq_port");
+
     if (rc_allowed_hosts.count() > 0)
         settings->setValue("allowed_hosts", rc_allowed_hosts);
     else
@@ -143,138 +186,360 @@ void RemoteControl::setPort(int port)
         return;
 
     rc_port = port;
-    if (rc_server.isListening())
+    if (rc_listening)
     {
-        rc_server.close();
-        rc_server.listen(QHostAddress::Any, rc_port);
+        stop_server();
+        start_server();
+    }
+}
+
+/*! \brief Set the port of the I/Q server, 0 disables it.
+ *
+ * If the server is running it will be restarted.
+ */
+void RemoteControl::setIqPort(int port)
+{
+    if (port == iq_port)
+        return;
+
+    iq_port = port;
+    if (rc_listening)
+    {
+        stop_server();
+        start_server();
     }
 }
 
 void RemoteControl::setHosts(QStringList hosts)
 {
     rc_allowed_hosts = hosts;
+    QMetaObject::invokeMethod(rc_server, "setHosts", Qt::QueuedConnection,
+                              Q_ARG(QStringList, rc_allowed_hosts));
+    QMetaObject::invokeMethod(iq_server, "setHosts", Qt::QueuedConnection,
+                              Q_ARG(QStringList, rc_allowed_hosts));
 }
 
 
-/*! \brief Accept a new client connection.
+/*! \brief Answer a command, that does not change the state.
+ *  \param state The state snapshot to answer from.
+ *  \param cmdlist The command and its arguments.
+ *  \param answer The answer, if the command is a query.
+ *  \returns False if the command changes the state and must be run by
+ *            runCommand() in the GUI thread.
  *
- * This slot is called when a client opens a new connection.
+ * This is called by the server thread for every command, so it may only
+ * read the snapshot.
+ */
+bool RemoteControl::answerQuery(const RemoteState &state, const QStringList &cmdlist,
+                                QString &answer)
+{
+    const QString &cmd = cmdlist[0];
+
+    if (cmd.startsWith('@'))
+    {
+        if (cmdlist.size() > 1 &&
+            (cmdlist[1] == "F" || cmdlist[1] == "M" || cmdlist[1] == "L"))
+            return false;
+        answer = cmd_vfo_query(state, cmdlist);
+    }
+    else if (cmd == "f")
+        answer = cmd_get_freq(state);
+    else if (cmd == "m")
+        answer = cmd_get_mode(state);
+    else if (cmd == "l")
+        answer = cmd_get_level(state, cmdlist);
+    else if (cmd == "u")
+        answer = cmd_get_func(state, cmdlist);
+    else if (cmd == "v")
+        answer = cmd_get_vfo();
+    else if (cmd == "V")
+        answer = cmd_set_vfo(cmdlist);
+    else if (cmd == "s")
+        answer = cmd_get_split_vfo();
+    else if (cmd == "S")
+        answer = cmd_set_split_vfo();
+    else if (cmd == "p")
+        answer = cmd_get_param(state, cmdlist);
+    else if (cmd == "_")
+        answer = cmd_get_info();
+    else if (cmd == "LNB_LO" && cmdlist.size() != 2)
+        answer = QString("%1\n").arg((qint64)(state.lnb_lo_mhz * 1e6));
+    else if (cmd == "DSP_LOAD")
+        answer = cmd_dsp_load(state, cmdlist);
+    else if (cmd == "LATENCY")
+        answer = cmd_latency(state);
+    else if (cmd == "VFOS")
+        answer = cmd_vfos(state);
+    else if (cmd == "\\chk_vfo")
+        answer = QString("0\n");
+    else if (cmd == "\\dump_state")
+        answer = cmd_dump_state();
+    else if (cmd == "\\get_powerstat")
+        answer = QString("1\n");
+    else if (cmd == "F" || cmd == "M" || cmd == "L" || cmd == "U" ||
+             cmd == "AOS" || cmd == "LOS" || cmd == "LNB_LO")
+        return false;
+    else
+    {
+        // print unknown command and respond with an error
+        qWarning() << "Unknown remote command:" << cmdlist;
+        answer = QString("RPRT 1\n");
+    }
+
+    return true;
+}
+
+/*! \brief Topics clients can subscribe to with SUBSCRIBE. */
+const QStringList &RemoteControl::topics()
+{
+    static const QStringList list = {
+        "freq", "mode", "level", "sql", "sql_open", "af", "record", "dsp",
+        "rds_pi", "rds_station", "rds_radiotext"
+    };
+    return list;
+}
+
+/*! \brief Topics, that can be subscribed for any VFO. */
+const QStringList &RemoteControl::vfoTopics()
+{
+    static const QStringList list = {
+        "freq", "mode", "level", "sql", "sql_open"
+    };
+    return list;
+}
+
+/*! \brief Get the value of a subscription topic.
+ *  \param state The state snapshot.
+ *  \param topic One of topics(), or of vfoTopics() with vfo.
+ *  \param vfo VFO index or -1 for the current VFO.
+ *  \returns The value as sent in the EVENT line, without line end. Empty
+ *  if the VFO does not exist (any more).
  */
-void RemoteControl::acceptConnection()
+QString RemoteControl::topicValue(const RemoteState &state, const QString &topic, int vfo)
 {
-    if (rc_socket)
+    if (vfo >= 0 || topic == "sql_open")
     {
-        rc_socket->close();
-        rc_socket->deleteLater();
+        if (vfo < 0)
+            vfo = state.current_vfo;
+        if (vfo < 0 || vfo >= int(state.vfos.size()))
+            return QString();
+
+        const RemoteVfo &v = state.vfos[vfo];
+        if (topic == "freq")
+            return QString::number(v.freq);
+        else if (topic == "mode")
+            return QString("%1 %2").arg(intToModeStr(state, v.mode))
+                                   .arg(v.passband_hi - v.passband_lo);
+        else if (topic == "level")
+            return QString::number((double)v.signal_level, 'f', 1);
+        else if (topic == "sql")
+            return QString::number(v.squelch_level, 'f', 1);
+        else if (topic == "sql_open")
+            return QString::number(v.squelch_open);
+        return QString();
     }
-    rc_socket = rc_server.nextPendingConnection();
 
-    // check if host is allowed
-    auto address = rc_socket->peerAddress();
+    if (topic == "freq")
+        return QString::number(state.freq);
+    else if (topic == "mode")
+        return QString("%1 %2").arg(intToModeStr(state, state.mode))
+                               .arg(state.passband_hi - state.passband_lo);
+    else if (topic == "level")
+        return QString::number((double)state.signal_level, 'f', 1);
+    else if (topic == "sql")
+        return QString::number(state.squelch_level, 'f', 1);
+    else if (topic == "af")
+        return QString::number((double)state.audio_gain, 'f', 1);
+    else if (topic == "record")
+        return QString::number(state.audio_recorder_status);
+    else if (topic == "dsp")
+        return QString::number(state.receiver_running);
+    else if (topic == "rds_pi")
+        return state.program_id;
+    else if (topic == "rds_station")
+        return state.rds_station;
+    else if (topic == "rds_radiotext")
+        return state.rds_radiotext;
+
+    return QString();
+}
 
-    for (auto allowed_host : rc_allowed_hosts)
+/*! \brief Run a command, that changes the state.
+ *  \param client The connection the command came from.
+ *  \param cmdlist The command and its arguments.
+ *
+ * The server thread holds back further commands of this client until the
+ * answer is sent back with commandDone().
+ */
+void RemoteControl::runCommand(quint64 client, QStringList cmdlist)
+{
+    QString cmd = cmdlist[0];
+    QString answer;
+    RemoteVfoChanges changes;
+
+    if (cmd == "BATCH")
+    {
+        answer = runBatch(cmdlist.mid(1));
+    }
+    else if (cmd.startsWith('@'))
     {
-#if QT_VERSION < QT_VERSION_CHECK(5, 8, 0)
-        if (address == QHostAddress(allowed_host))
-#else
-        if (address.isEqual(QHostAddress(allowed_host)))
-#endif
+        if (stageVfoCommand(cmdlist, changes))
+        {
+            emit newVfoChanges(changes);
+            answer = QString("RPRT 0\n");
+        }
+        else
         {
-            connect(rc_socket, SIGNAL(readyRead()), this, SLOT(startRead()));
-            return;
+            answer = QString("RPRT 1\n");
         }
     }
+    else if (cmd == "F")
+        answer = cmd_set_freq(cmdlist);
+    else if (cmd == "M")
+        answer = cmd_set_mode(cmdlist);
+    else if (cmd == "L")
+        answer = cmd_set_level(cmdlist);
+    else if (cmd == "U")
+        answer = cmd_set_func(cmdlist);
+    else if (cmd == "AOS")
+        answer = cmd_AOS();
+    else if (cmd == "LOS")
+        answer = cmd_LOS();
+    else if (cmd == "LNB_LO")
+        answer = cmd_lnb_lo(cmdlist);
+    else
+        answer = QString("RPRT 1\n");
 
-    std::cout << "*** Remote connection attempt from " << address.toString().toStdString()
-              << " (not in allowed list)" << std::endl;
-    rc_socket->close();
-    rc_socket->deleteLater();
-    rc_socket = 0;
+    publishState();
+    emit commandDone(client, answer.toLatin1());
 }
 
-/*! \brief Start reading from the socket.
+/*! \brief Run the commands of a batch.
+ *  \param lines The commands between BATCH and END, tokens separated by
+ *                single spaces.
+ *  \returns The answers of all commands, followed by RPRT 0 if the batch
+ *           was applied, RPRT 1 if not.
  *
- * This slot is called when the client TCP socket emits a readyRead() signal,
- * i.e. when there is data to read.
+ * Queries are answered from the state before the batch. The set commands
+ * (F, M and L SQL, with or without VFO address) are checked first and
+ * applied together with one newVfoChanges(), so that the receiver is
+ * reconfigured only once. If one of them is invalid, none is applied.
  */
-void RemoteControl::startRead()
-{
-    while (rc_socket->canReadLine()) {
-        char    buffer[1024] = {0};
-        int     bytes_read;
-        QString answer = "";
-
-        bytes_read = rc_socket->readLine(buffer, 1024);
-        if (bytes_read < 2)  // command + '\n'
-            continue;
-
-#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
-        QStringList cmdlist = QString(buffer).trimmed().split(" ", QString::SkipEmptyParts);
-#else
-        QStringList cmdlist = QString(buffer).trimmed().split(" ", Qt::SkipEmptyParts);
-#endif
-
-        if (cmdlist.size() == 0)
-            continue;
-
-        QString cmd = cmdlist[0];
-        if (cmd == "f")
-            answer = cmd_get_freq();
-        else if (cmd == "F")
-            answer = cmd_set_freq(cmdlist);
-        else if (cmd == "m")
-            answer = cmd_get_mode();
-        else if (cmd == "M")
-            answer = cmd_set_mode(cmdlist);
-        else if (cmd == "l")
-            answer = cmd_get_level(cmdlist);
-        else if (cmd == "L")
-            answer = cmd_set_level(cmdlist);
-        else if (cmd == "u")
-            answer = cmd_get_func(cmdlist);
-        else if (cmd == "U")
-            answer = cmd_set_func(cmdlist);
-        else if (cmd == "v")
-            answer = cmd_get_vfo();
-        else if (cmd == "V")
-            answer = cmd_set_vfo(cmdlist);
-        else if (cmd == "s")
-            answer = cmd_get_split_vfo();
-        else if (cmd == "S")
-            answer = cmd_set_split_vfo();
-        else if (cmd == "p")
-            answer = cmd_get_param(cmdlist);
-        else if (cmd == "_")
-            answer = cmd_get_info();
-        else if (cmd == "AOS")
-            answer = cmd_AOS();
-        else if (cmd == "LOS")
-            answer = cmd_LOS();
-        else if (cmd == "LNB_LO")
-            answer = cmd_lnb_lo(cmdlist);
-        else if (cmd == "\\chk_vfo")
-            answer = QString("0\n");
-        else if (cmd == "\\dump_state")
-            answer = cmd_dump_state();
-        else if (cmd == "\\get_powerstat")
-            answer = QString("1\n");
-        else if (cmd == "q" || cmd == "Q")
+QString RemoteControl::runBatch(const QStringList &lines)
+{
+    RemoteVfoChanges changes;
+    QString answer;
+    bool ok = true;
+
+    for (auto &line : lines)
+    {
+        QStringList cmdlist = line.split(' ');
+        QString cmd_answer;
+
+        if (answerQuery(state, cmdlist, cmd_answer))
+        {
+            answer += cmd_answer;
+        }
+        else if (stageVfoCommand(cmdlist, changes))
         {
-            // FIXME: for now we assume 'close' command
-            rc_socket->close();
-            rc_socket->deleteLater();
-            rc_socket = 0;
-            return;
+            answer += QString("RPRT 0\n");
         }
         else
         {
-            // print unknown command and respond with an error
-            qWarning() << "Unknown remote command:" << cmdlist;
-            answer = QString("RPRT 1\n");
+            answer += QString("RPRT 1\n");
+            ok = false;
         }
+    }
+
+    if (!ok)
+        return answer + QString("RPRT 1\n");
+
+    if (!changes.empty())
+        emit newVfoChanges(changes);
+
+    return answer + QString("RPRT 0\n");
+}
+
+/*! \brief Check a VFO set command and add it to a list of changes.
+ *  \param cmdlist F, M or L SQL, with or without @<vfo> prefix.
+ *  \param changes The list to add the change to.
+ *  \returns False if the command is invalid.
+ *
+ * Commands without prefix go to the current VFO. The frequency must be
+ * within the bandwidth, the hardware is never retuned.
+ */
+bool RemoteControl::stageVfoCommand(const QStringList &cmdlist, RemoteVfoChanges &changes)
+{
+    QStringList args = cmdlist;
+    RemoteVfoChange change;
+    bool ok;
 
-        rc_socket->write(answer.toLatin1());
+    change.vfo = state.current_vfo;
+    if (args[0].startsWith('@') && !parseVfo(state, args, change.vfo))
+        return false;
+    if (change.vfo < 0 || change.vfo >= int(state.vfos.size()))
+        return false;
+
+    if (args[0] == "F" && args.size() == 2)
+    {
+        double freq = args[1].toDouble(&ok);
+        qint64 center = state.freq - state.filter_offset;
+
+        if (!ok || std::abs(freq - center) > state.bw_half)
+            return false;
+        change.what = RemoteVfoChange::FREQ;
+        change.freq = (qint64)freq;
+    }
+    else if (args[0] == "M" && (args.size() == 2 || args.size() == 3))
+    {
+        int mode = modeStrToInt(args[1]);
+
+        change.passband = args.value(2, "0").toInt(&ok);
+        if (mode == -1 || !ok || change.passband < 0)
+            return false;
+        change.what = RemoteVfoChange::MODE;
+        change.mode = Modulations::idx(mode);
+    }
+    else if (args[0] == "L" && args.size() == 3 &&
+             args[1].compare("SQL", Qt::CaseInsensitive) == 0)
+    {
+        double squelch = args[2].toDouble(&ok);
+
+        if (!ok)
+            return false;
+        change.what = RemoteVfoChange::SQL;
+        change.squelch_level = std::max<double>(-150, std::min<double>(0, squelch));
+    }
+    else
+    {
+        return false;
     }
+
+    changes.push_back(change);
+    return true;
+}
+
+/*! \brief Remove the @<vfo> prefix of a command.
+ *  \returns False if the VFO does not exist or the command is missing.
+ */
+bool RemoteControl::parseVfo(const RemoteState &state, QStringList &cmdlist, int &vfo)
+{
+    bool ok;
+
+    vfo = cmdlist[0].mid(1).toInt(&ok);
+    cmdlist.removeFirst();
+
+    return ok && vfo >= 0 && vfo < int(state.vfos.size()) && !cmdlist.isEmpty();
+}
+
+/*! \brief Publish a copy of the state to the server thread.
+ *
+ * Called after every change, the server thread answers the queries from
+ * the latest copy without locking.
+ */
+void RemoteControl::publishState()
+{
+    rc_server->setState(std::make_shared<const RemoteState>(state));
 }
 
 /*! \brief Slot called when the receiver is tuned to a new frequency.
@@ -285,13 +550,15 @@ void RemoteControl::startRead()
  */
 void RemoteControl::setNewFrequency(qint64 freq)
 {
-    rc_freq = freq;
+    state.freq = freq;
+    publishState();
 }
 
 /*! \brief Slot called when the filter offset is changed. */
 void RemoteControl::setFilterOffset(qint64 freq)
 {
-    rc_filter_offset = freq;
+    state.filter_offset = freq;
+    publishState();
 }
 
 /*! \brief Slot called when the LNB LO frequency has changed
@@ -299,111 +566,210 @@ void RemoteControl::setFilterOffset(qint64 freq)
  */
 void RemoteControl::setLnbLo(double freq_mhz)
 {
-    rc_lnb_lo_mhz = freq_mhz;
+    state.lnb_lo_mhz = freq_mhz;
+    publishState();
 }
 
 void RemoteControl::setBandwidth(qint64 bw)
 {
     // we want to leave some margin
-    bw_half = (qint64)(0.9f * (bw / 2.f));
+    state.bw_half = (qint64)(0.9f * (bw / 2.f));
+    publishState();
 }
 
 /*! \brief Set signal level in dBFS. */
 void RemoteControl::setSignalLevel(float level)
 {
-    signal_level = level;
+    state.signal_level = level;
+    publishState();
 }
 
 /*! \brief Set demodulator (from mainwindow). */
 void RemoteControl::setMode(Modulations::idx mode)
 {
-    rc_mode = mode;
+    state.mode = mode;
 
-    if (rc_mode == Modulations::MODE_OFF)
-        audio_recorder_status = false;
+    if (state.mode == Modulations::MODE_OFF)
+        state.audio_recorder_status = false;
+    publishState();
 }
 
 /*! \brief Set passband (from mainwindow). */
 void RemoteControl::setPassband(int passband_lo, int passband_hi)
 {
-    rc_passband_lo = passband_lo;
-    rc_passband_hi = passband_hi;
+    state.passband_lo = passband_lo;
+    state.passband_hi = passband_hi;
+    publishState();
 }
 
 /*! \brief New remote frequency received. */
 void RemoteControl::setNewRemoteFreq(qint64 freq)
 {
-    qint64 delta = freq - rc_freq;
-    qint64 bwh_eff = 0.8f * (float)bw_half;
+    qint64 delta = freq - state.freq;
+    qint64 bwh_eff = 0.8f * (float)state.bw_half;
 
-    rc_filter_offset += delta;
-    if ((rc_filter_offset > 0 && rc_filter_offset + rc_passband_hi < bwh_eff) ||
-        (rc_filter_offset < 0 && rc_filter_offset + rc_passband_lo > -bwh_eff))
+    state.filter_offset += delta;
+    if ((state.filter_offset > 0 && state.filter_offset + state.passband_hi < bwh_eff) ||
+        (state.filter_offset < 0 && state.filter_offset + state.passband_lo > -bwh_eff))
     {
         // move filter offset
-        emit newFilterOffset(rc_filter_offset);
+        emit newFilterOffset(state.filter_offset);
     }
     else
     {
         // moving filter offset would push it too close to or beyond the edge
         // move it close to the center and adjust hardware freq
-        if (rc_filter_offset < 0)
-            rc_filter_offset = -0.2f * bwh_eff;
+        if (state.filter_offset < 0)
+            state.filter_offset = -0.2f * bwh_eff;
         else
-            rc_filter_offset = 0.2f * bwh_eff;
-        emit newFilterOffset(rc_filter_offset);
+            state.filter_offset = 0.2f * bwh_eff;
+        emit newFilterOffset(state.filter_offset);
         emit newFrequency(freq);
     }
 
-    rc_freq = freq;
+    state.freq = freq;
 }
 
 /*! \brief Set squelch level (from mainwindow). */
 void RemoteControl::setSquelchLevel(double level)
 {
-    squelch_level = level;
+    state.squelch_level = level;
+    publishState();
 }
 
 /*! \brief Set audio gain (from mainwindow). */
 void RemoteControl::setAudioGain(float gain)
 {
-    audio_gain = gain;
+    state.audio_gain = gain;
+    publishState();
 }
 
 /*! \brief Start audio recorder (from mainwindow). */
 void RemoteControl::startAudioRecorder()
 {
-    if (rc_mode > Modulations::MODE_OFF)
-        audio_recorder_status = true;
+    if (state.mode > Modulations::MODE_OFF)
+        state.audio_recorder_status = true;
+    publishState();
 }
 
 /*! \brief Stop audio recorder (from mainwindow). */
 void RemoteControl::stopAudioRecorder()
 {
-    audio_recorder_status = false;
+    state.audio_recorder_status = false;
+    publishState();
 }
 
 /*! \brief Set receiver status (from mainwindow). */
 void RemoteControl::setReceiverStatus(bool enabled)
 {
-    receiver_running = enabled;
+    state.receiver_running = enabled;
+    publishState();
 }
 
 /*! \brief Set available gain settings (from mainwindow). */
 void RemoteControl::setGainStages(gain_list_t &gain_list)
 {
-    gains = gain_list;
+    state.gains = gain_list;
+    publishState();
+}
+
+/*! \brief Set the last DSP load sample (from mainwindow, empty when the DSP is stopped). */
+void RemoteControl::setDspLoad(const std::vector<dsp_load_vfo> &vfos,
+                               const std::vector<dsp_load_block> &blocks)
+{
+    state.dsp_load_vfos = vfos;
+    state.dsp_load_blocks = blocks;
+    publishState();
+}
+
+/*! \brief Set latency probe status (from mainwindow). */
+void RemoteControl::setLatencyProbes(bool enabled)
+{
+    state.latency_probes = enabled;
+    publishState();
+}
+
+/*! \brief Set latency profile (from mainwindow). */
+void RemoteControl::setLatencyProfile(int profile)
+{
+    state.low_latency = (profile == LATENCY_PROFILE_LOW);
+    publishState();
+}
+
+/*! \brief Set shared memory export status (from mainwindow). */
+void RemoteControl::setShmExport(bool enabled)
+{
+    state.shm_export = enabled;
+    publishState();
+}
+
+/*! \brief Set the latest latency sample (from mainwindow). */
+void RemoteControl::setLatency(const std::vector<latency_stage> &stages)
+{
+    state.latency_stages = stages;
+    publishState();
+}
+
+/*! \brief Set the state of all VFOs (from mainwindow). */
+void RemoteControl::setVfos(const std::vector<RemoteVfo> &vfos, int current)
+{
+    state.vfos = vfos;
+    state.current_vfo = current;
+    publishState();
+}
+
+/*! \brief Whether any client streams the spectrum, see setSpectrum(). */
+bool RemoteControl::spectrumWanted() const
+{
+    return rc_server->spectrumWanted();
+}
+
+/*! \brief Send a spectrum frame to the streaming clients (from mainwindow).
+ *  \param db Power in dBFS, lowest frequency first.
+ *  \param size Number of bins.
+ *  \param center Center frequency in Hz.
+ *  \param span Span in Hz.
+ *  \param timestamp Time of the frame in ms since the epoch.
+ *
+ * Only copies the frame, the clients are served by the server thread.
+ */
+void RemoteControl::setSpectrum(const float *db, unsigned int size, qint64 center,
+                                qint64 span, qint64 timestamp)
+{
+    auto frame = std::make_shared<SpectrumFrame>();
+
+    frame->db.assign(db, db + size);
+    frame->center = center;
+    frame->span = span;
+    frame->timestamp = timestamp;
+    rc_server->setSpectrum(frame);
+}
+
+/*! \brief Start sending an I/Q stream requested with newIqStream().
+ *  \param client The client of the request.
+ *  \param tap The stream, null if it could not be started.
+ *
+ * The stream must be released, when iqStreamClosed() is emitted for the
+ * client, also if it is passed here after the client has disconnected.
+ */
+void RemoteControl::attachIqStream(quint64 client, iq_stream_sink_sptr tap)
+{
+    if (tap)
+        iq_server->attach(client, tap->get_ring(), tap->get_rate(), tap->get_format());
+    else
+        iq_server->attach(client, nullptr, 0.0, FILE_FORMAT_NONE);
 }
 
 /*! \brief Set value for a specific gain setting (from DockInputCtl). */
 bool RemoteControl::setGain(QString name, double gain)
 {
-    for(auto &g : gains)
+    for(auto &g : state.gains)
     {
         if(name == QString::fromStdString(g.name))
         {
             if(gain != g.value) {
                 g.value = gain;
+                publishState();
                 emit gainChanged(name, gain);
             }
             return true;
@@ -415,28 +781,32 @@ bool RemoteControl::setGain(QString name, double gain)
 /*! \brief Set RDS program identification (from RDS parser). */
 void RemoteControl::rdsPI(QString program_id)
 {
-    rc_program_id = program_id;
+    state.program_id = program_id;
+    publishState();
 }
 
 /*! \brief Set RDS status (from RDS dock). */
 void RemoteControl::setRDSstatus(bool enabled)
 {
-    rds_status = enabled;
-    rc_program_id = "0000";
-    rds_station = "";
-    rds_radiotext = "";
+    state.rds_status = enabled;
+    state.program_id = "0000";
+    state.rds_station = "";
+    state.rds_radiotext = "";
+    publishState();
 }
 
 /*! \brief Set RDS Station name. */
 void RemoteControl::setRdsStation(QString name)
 {
-    rds_station = name.trimmed();
+    state.rds_station = name.trimmed();
+    publishState();
 }
 
 /*! \brief Set RDS Radiotext. */
 void RemoteControl::setRdsRadiotext(QString text)
 {
-    rds_radiotext = text.trimmed();
+    state.rds_radiotext = text.trimmed();
+    publishState();
 }
 
 
@@ -478,22 +848,22 @@ int RemoteControl::modeStrToInt(QString mode_str)
     else if (mode_str.compare("CWL", Qt::CaseInsensitive) == 0)
     {
         mode_int = Modulations::MODE_CWL;
-        hamlib_compatible = false;
+        state.hamlib_compatible = false;
     }
     else if (mode_str.compare("CWR", Qt::CaseInsensitive) == 0)  // "CWR" : "CWL"
     {
         mode_int = Modulations::MODE_CWL;
-        hamlib_compatible = true;
+        state.hamlib_compatible = true;
     }
     else if (mode_str.compare("CWU", Qt::CaseInsensitive) == 0)
     {
         mode_int = Modulations::MODE_CWU;
-        hamlib_compatible = false;
+        state.hamlib_compatible = false;
     }
     else if (mode_str.compare("CW", Qt::CaseInsensitive) == 0)  // "CW" : "CWU"
     {
         mode_int = Modulations::MODE_CWU;
-        hamlib_compatible = true;
+        state.hamlib_compatible = true;
     }
     else if (mode_str.compare("FM", Qt::CaseInsensitive) == 0)
     {
@@ -522,7 +892,7 @@ int RemoteControl::modeStrToInt(QString mode_str)
  *  \param mode The mode ID c.f. Modulations::rxopt_mode_idx
  *  \returns The mode string.
  */
-QString RemoteControl::intToModeStr(int mode)
+QString RemoteControl::intToModeStr(const RemoteState &state, int mode)
 {
     QString mode_str;
 
@@ -553,11 +923,11 @@ QString RemoteControl::intToModeStr(int mode)
         break;
 
     case Modulations::MODE_CWL:
-        mode_str = (hamlib_compatible) ? "CWR" : "CWL";
+        mode_str = (state.hamlib_compatible) ? "CWR" : "CWL";
         break;
 
     case Modulations::MODE_CWU:
-        mode_str = (hamlib_compatible) ? "CW" : "CWU";
+        mode_str = (state.hamlib_compatible) ? "CW" : "CWU";
         break;
 
     case Modulations::MODE_NFM:
@@ -585,9 +955,9 @@ QString RemoteControl::intToModeStr(int mode)
 }
 
 /* Get frequency */
-QString RemoteControl::cmd_get_freq() const
+QString RemoteControl::cmd_get_freq(const RemoteState &state)
 {
-    return QString("%1\n").arg(rc_freq);
+    return QString("%1\n").arg(state.freq);
 }
 
 /* Set new frequency */
@@ -606,11 +976,11 @@ QString RemoteControl::cmd_set_freq(QStringList cmdlist)
 }
 
 /* Get mode and passband */
-QString RemoteControl::cmd_get_mode()
+QString RemoteControl::cmd_get_mode(const RemoteState &state)
 {
     return QString("%1\n%2\n")
-                   .arg(intToModeStr(rc_mode))
-                   .arg(rc_passband_hi - rc_passband_lo);
+                   .arg(intToModeStr(state, state.mode))
+                   .arg(state.passband_hi - state.passband_lo);
 }
 
 /* Set mode and passband */
@@ -631,15 +1001,15 @@ QString RemoteControl::cmd_set_mode(QStringList cmdlist)
         }
         else
         {
-            rc_mode = Modulations::idx(mode);
-            emit newMode(rc_mode);
+            state.mode = Modulations::idx(mode);
+            emit newMode(state.mode);
 
             int passband = cmdlist.value(2, "0").toInt();
             if ( passband != 0 )
                 emit newPassband(passband);
 
-            if (rc_mode == 0)
-                audio_recorder_status = false;
+            if (state.mode == 0)
+                state.audio_recorder_status = false;
 
             answer = QString("RPRT 0\n");
         }
@@ -648,7 +1018,7 @@ QString RemoteControl::cmd_set_mode(QStringList cmdlist)
 }
 
 /* Get level */
-QString RemoteControl::cmd_get_level(QStringList cmdlist)
+QString RemoteControl::cmd_get_level(const RemoteState &state, const QStringList &cmdlist)
 {
     QString answer;
     QString lvl = cmdlist.value(1, "");
@@ -656,27 +1026,27 @@ QString RemoteControl::cmd_get_level(QStringList cmdlist)
     if (lvl == "?")
     {
         QStringList names;
-        for(auto &g : gains)
+        for(auto &g : state.gains)
             names.push_back(QString("%1_GAIN").arg(QString::fromStdString(g.name)));
         answer = QString("SQL STRENGTH AF %1\n").arg(names.join(" "));
     }
     else if (lvl.compare("STRENGTH", Qt::CaseInsensitive) == 0 || lvl.isEmpty())
     {
-        answer = QString("%1\n").arg((double)signal_level, 0, 'f', 1);
+        answer = QString("%1\n").arg((double)state.signal_level, 0, 'f', 1);
     }
     else if (lvl.compare("SQL", Qt::CaseInsensitive) == 0)
     {
-        answer = QString("%1\n").arg((double)squelch_level, 0, 'f', 1);
+        answer = QString("%1\n").arg((double)state.squelch_level, 0, 'f', 1);
     }
     else if (lvl.compare("AF", Qt::CaseInsensitive) == 0)
     {
-        answer = QString("%1\n").arg((double)audio_gain, 0, 'f', 1);
+        answer = QString("%1\n").arg((double)state.audio_gain, 0, 'f', 1);
     }
     else if (lvl.endsWith("_GAIN"))
     {
         lvl.chop(5);
         answer = QString("RPRT 1\n");
-        for(auto &g : gains)
+        for(auto &g : state.gains)
         {
             if(lvl == QString::fromStdString(g.name))
             {
@@ -702,7 +1072,7 @@ QString RemoteControl::cmd_set_level(QStringList cmdlist)
     if (lvl == "?")
     {
         QStringList names;
-        for(auto &g : gains)
+        for(auto &g : state.gains)
             names.push_back(QString("%1_GAIN").arg(QString::fromStdString(g.name)));
         answer = QString("SQL AF %1\n").arg(names.join(" "));
     }
@@ -713,8 +1083,8 @@ QString RemoteControl::cmd_set_level(QStringList cmdlist)
         if (ok)
         {
             answer = QString("RPRT 0\n");
-            squelch_level = std::max<double>(-150, std::min<double>(0, squelch));
-            emit newSquelchLevel(squelch_level);
+            state.squelch_level = std::max<double>(-150, std::min<double>(0, squelch));
+            emit newSquelchLevel(state.squelch_level);
         }
         else
         {
@@ -756,19 +1126,25 @@ QString RemoteControl::cmd_set_level(QStringList cmdlist)
 }
 
 /* Get function */
-QString RemoteControl::cmd_get_func(QStringList cmdlist)
+QString RemoteControl::cmd_get_func(const RemoteState &state, const QStringList &cmdlist)
 {
     QString answer;
     QString func = cmdlist.value(1, "");
 
     if (func == "?")
-        answer = QString("RECORD DSP RDS\n");
+        answer = QString("RECORD DSP RDS LATENCY LOW_LATENCY SHM\n");
     else if (func.compare("RECORD", Qt::CaseInsensitive) == 0)
-        answer = QString("%1\n").arg(audio_recorder_status);
+        answer = QString("%1\n").arg(state.audio_recorder_status);
     else if (func.compare("DSP", Qt::CaseInsensitive) == 0)
-        answer = QString("%1\n").arg(receiver_running);
+        answer = QString("%1\n").arg(state.receiver_running);
     else if (func.compare("RDS", Qt::CaseInsensitive) == 0)
-        answer = QString("%1\n").arg(rds_status);
+        answer = QString("%1\n").arg(state.rds_status);
+    else if (func.compare("LATENCY", Qt::CaseInsensitive) == 0)
+        answer = QString("%1\n").arg(state.latency_probes);
+    else if (func.compare("LOW_LATENCY", Qt::CaseInsensitive) == 0)
+        answer = QString("%1\n").arg(state.low_latency);
+    else if (func.compare("SHM", Qt::CaseInsensitive) == 0)
+        answer = QString("%1\n").arg(state.shm_export);
     else
         answer = QString("RPRT 1\n");
 
@@ -785,18 +1161,18 @@ QString RemoteControl::cmd_set_func(QStringList cmdlist)
 
     if (func == "?")
     {
-        answer = QString("RECORD DSP RDS\n");
+        answer = QString("RECORD DSP RDS LATENCY LOW_LATENCY SHM\n");
     }
     else if ((func.compare("RECORD", Qt::CaseInsensitive) == 0) && ok)
     {
-        if (rc_mode == Modulations::MODE_OFF || !receiver_running)
+        if (state.mode == Modulations::MODE_OFF || !state.receiver_running)
         {
             answer = QString("RPRT 1\n");
         }
         else
         {
             answer = QString("RPRT 0\n");
-            audio_recorder_status = status;
+            state.audio_recorder_status = status;
             if (status)
                 emit startAudioRecorderEvent();
             else
@@ -821,6 +1197,24 @@ QString RemoteControl::cmd_set_func(QStringList cmdlist)
 
         answer = QString("RPRT 0\n");
     }
+    else if ((func.compare("LATENCY", Qt::CaseInsensitive) == 0) && ok)
+    {
+        emit newLatencyProbes(status != 0);
+
+        answer = QString("RPRT 0\n");
+    }
+    else if ((func.compare("LOW_LATENCY", Qt::CaseInsensitive) == 0) && ok)
+    {
+        emit newLatencyProfile(status ? LATENCY_PROFILE_LOW : LATENCY_PROFILE_THROUGHPUT);
+
+        answer = QString("RPRT 0\n");
+    }
+    else if ((func.compare("SHM", Qt::CaseInsensitive) == 0) && ok)
+    {
+        emit newShmExport(status != 0);
+
+        answer = QString("RPRT 0\n");
+    }
     else
     {
         answer = QString("RPRT 1\n");
@@ -830,7 +1224,7 @@ QString RemoteControl::cmd_set_func(QStringList cmdlist)
 }
 
 /* Get parameter */
-QString RemoteControl::cmd_get_param(QStringList cmdlist)
+QString RemoteControl::cmd_get_param(const RemoteState &state, const QStringList &cmdlist)
 {
     QString answer;
     QString func = cmdlist.value(1, "");
@@ -838,11 +1232,11 @@ QString RemoteControl::cmd_get_param(QStringList cmdlist)
     if (func == "?")
         answer = QString("RDS_PI RDS_STATION RDS_RADIOTEXT\n");
     else if (func.compare("RDS_PI", Qt::CaseInsensitive) == 0)
-        answer = QString("%1\n").arg(rc_program_id);
+        answer = QString("%1\n").arg(state.program_id);
 	else if (func.compare("RDS_STATION", Qt::CaseInsensitive) == 0)
-		answer = QString("%1\n").arg(rds_station);
+		answer = QString("%1\n").arg(state.rds_station);
 	else if (func.compare("RDS_RADIOTEXT", Qt::CaseInsensitive) == 0)
-		answer = QString("%1\n").arg(rds_radiotext);
+		answer = QString("%1\n").arg(state.rds_radiotext);
     else
         answer = QString("RPRT 1\n");
 
@@ -850,13 +1244,13 @@ QString RemoteControl::cmd_get_param(QStringList cmdlist)
 }
 
 /* Get current 'VFO' (fake, only for hamlib) */
-QString RemoteControl::cmd_get_vfo() const
+QString RemoteControl::cmd_get_vfo()
 {
     return QString("VFOA\n");
 };
 
 /* Set 'VFO' (fake, only for hamlib) */
-QString RemoteControl::cmd_set_vfo(QStringList cmdlist)
+QString RemoteControl::cmd_set_vfo(const QStringList &cmdlist)
 {
     QString cmd_arg = cmdlist.value(1, "");
     QString answer;
@@ -872,7 +1266,7 @@ QString RemoteControl::cmd_set_vfo(QStringList cmdlist)
 };
 
 /* Get 'Split' mode (fake, only for hamlib) */
-QString RemoteControl::cmd_get_split_vfo() const
+QString RemoteControl::cmd_get_split_vfo()
 {
     return QString("0\nVFOA\n");
 };
@@ -884,7 +1278,7 @@ QString RemoteControl::cmd_set_split_vfo()
 }
 
 /* Get info */
-QString RemoteControl::cmd_get_info() const
+QString RemoteControl::cmd_get_info()
 {
     return QString("Gqrx %1 rdsapi\n").arg(VERSION);
 };
@@ -892,10 +1286,10 @@ QString RemoteControl::cmd_get_info() const
 /* Gpredict / Gqrx specific command: AOS - satellite AOS event */
 QString RemoteControl::cmd_AOS()
 {
-    if (rc_mode > Modulations::MODE_OFF && receiver_running)
+    if (state.mode > Modulations::MODE_OFF && state.receiver_running)
     {
         emit startAudioRecorderEvent();
-        audio_recorder_status = true;
+        state.audio_recorder_status = true;
     }
     return QString("RPRT 0\n");
 }
@@ -904,7 +1298,7 @@ QString RemoteControl::cmd_AOS()
 QString RemoteControl::cmd_LOS()
 {
     emit stopAudioRecorderEvent();
-    audio_recorder_status = false;
+    state.audio_recorder_status = false;
     return QString("RPRT 0\n");
 }
 
@@ -918,8 +1312,8 @@ QString RemoteControl::cmd_lnb_lo(QStringList cmdlist)
 
         if (ok)
         {
-            rc_lnb_lo_mhz = freq / 1e6;
-            emit newLnbLo(rc_lnb_lo_mhz);
+            state.lnb_lo_mhz = freq / 1e6;
+            emit newLnbLo(state.lnb_lo_mhz);
             return QString("RPRT 0\n");
         }
 
@@ -927,16 +1321,133 @@ QString RemoteControl::cmd_lnb_lo(QStringList cmdlist)
     }
     else
     {
-        return QString("%1\n").arg((qint64)(rc_lnb_lo_mhz * 1e6));
+        return QString("%1\n").arg((qint64)(state.lnb_lo_mhz * 1e6));
     }
 }
+
+/*
+ * Get the DSP load, one line per VFO (or per block with DSP_LOAD BLOCKS):
+ *   <vfo> <load %> <items/s> <buffer %> <blocks> <memory KiB>
+ *   <vfo> <block> <load %> <items/s> <buffer %> <memory KiB>
+ * vfo is "shared" for the blocks not belonging to a VFO.
+ */
+QString RemoteControl::cmd_dsp_load(const RemoteState &state, const QStringList &cmdlist)
+{
+    bool per_block = (cmdlist.size() == 2 && cmdlist[1].toUpper() == "BLOCKS");
+    QString answer;
+
+    if (cmdlist.size() > 2 || (cmdlist.size() == 2 && !per_block))
+        return QString("RPRT 1\n");
+    if (state.dsp_load_vfos.empty())
+        return QString("RPRT 1\n");
+
+    if (per_block)
+    {
+        for (auto &b : state.dsp_load_blocks)
+            answer += QString("%1 %2 %3 %4 %5 %6\n")
+                      .arg(b.vfo < 0 ? QString("shared") : QString::number(b.vfo))
+                      .arg(QString::fromStdString(b.name))
+                      .arg(b.load * 100.0, 0, 'f', 1)
+                      .arg(b.items_per_sec, 0, 'f', 0)
+                      .arg(b.buffer_full * 100.f, 0, 'f', 0)
+                      .arg(qulonglong(b.memory / 1024));
+    }
+    else
+    {
+        for (auto &v : state.dsp_load_vfos)
+            answer += QString("%1 %2 %3 %4 %5 %6\n")
+                      .arg(v.vfo < 0 ? QString("shared") : QString::number(v.vfo))
+                      .arg(v.load * 100.0, 0, 'f', 1)
+                      .arg(v.items_per_sec, 0, 'f', 0)
+                      .arg(v.buffer_full * 100.f, 0, 'f', 0)
+                      .arg(v.blocks)
+                      .arg(qulonglong(v.memory / 1024));
+    }
+    return answer + QString("RPRT 0\n");
+}
+
+/*
+ * Get the latency of every stage, one line per stage:
+ *   <stage> <vfo> <latency ms> <stage ms> <max ms> <budget ms>
+ * stage is input, channelizer, vfo, mixer or audio, vfo is "-" if not a
+ * VFO. The measured times are -1 without U LATENCY 1 and until the first
+ * probe arrived, the budget is -1 if unknown.
+ */
+QString RemoteControl::cmd_latency(const RemoteState &state)
+{
+    QString answer;
+
+    if (state.latency_stages.empty())
+        return QString("RPRT 1\n");
+
+    for (auto &st : state.latency_stages)
+        answer += QString("%1 %2 %3 %4 %5 %6\n")
+                  .arg(QString::fromStdString(st.name))
+                  .arg(st.vfo < 0 ? QString("-") : QString::number(st.vfo))
+                  .arg(st.total < 0.0 ? -1.0 : st.total * 1e3, 0, 'f', 1)
+                  .arg(st.stage < 0.0 ? -1.0 : st.stage * 1e3, 0, 'f', 1)
+                  .arg(st.total < 0.0 ? -1.0 : st.max * 1e3, 0, 'f', 1)
+                  .arg(st.budget < 0.0 ? -1.0 : st.budget * 1e3, 0, 'f', 1);
+    return answer + QString("RPRT 0\n");
+}
+
+/* Query of a VFO: @<vfo> f, @<vfo> m or @<vfo> l [STRENGTH|SQL] */
+QString RemoteControl::cmd_vfo_query(const RemoteState &state, QStringList cmdlist)
+{
+    int vfo;
+
+    if (!parseVfo(state, cmdlist, vfo))
+        return QString("RPRT 1\n");
+
+    const RemoteVfo &v = state.vfos[vfo];
+    QString cmd = cmdlist[0];
+    QString lvl = cmdlist.value(1, "");
+
+    if (cmd == "f")
+        return QString("%1\n").arg(v.freq);
+    else if (cmd == "m")
+        return QString("%1\n%2\n").arg(intToModeStr(state, v.mode))
+                                   .arg(v.passband_hi - v.passband_lo);
+    else if (cmd == "l" && (lvl.isEmpty() || lvl.compare("STRENGTH", Qt::CaseInsensitive) == 0))
+        return QString("%1\n").arg((double)v.signal_level, 0, 'f', 1);
+    else if (cmd == "l" && lvl.compare("SQL", Qt::CaseInsensitive) == 0)
+        return QString("%1\n").arg(v.squelch_level, 0, 'f', 1);
+
+    return QString("RPRT 1\n");
+}
+
+/*
+ * List the VFOs, one line per VFO:
+ *   <vfo> <frequency> <mode> <passband> <strength> <squelch>
+ * The current VFO is marked with a * after its index.
+ */
+QString RemoteControl::cmd_vfos(const RemoteState &state)
+{
+    QString answer;
+
+    for (size_t i = 0; i < state.vfos.size(); i++)
+    {
+        const RemoteVfo &v = state.vfos[i];
+
+        answer += QString("%1%2 %3 %4 %5 %6 %7\n")
+                  .arg(i)
+                  .arg(int(i) == state.current_vfo ? QString("*") : QString())
+                  .arg(v.freq)
+                  .arg(intToModeStr(state, v.mode))
+                  .arg(v.passband_hi - v.passband_lo)
+                  .arg((double)v.signal_level, 0, 'f', 1)
+                  .arg(v.squelch_level, 0, 'f', 1);
+    }
+    return answer + QString("RPRT 0\n");
+}
+
 /*
  * '\dump_state' used by hamlib clients, e.g. xdx, fldigi, rigctl and etc
  * More info:
  *  https://github.com/N0NB/hamlib/blob/master/include/hamlib/rig.h (bit fields)
  *  https://github.com/N0NB/hamlib/blob/master/dummy/netrigctl.c
  */
-QString RemoteControl::cmd_dump_state() const
+QString RemoteControl::cmd_dump_state()
 {
     return QString(
         /* rigctl protocol version */
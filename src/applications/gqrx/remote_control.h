@@ -27,14 +27,83 @@
 #include <QSettings>
 #include <QString>
 #include <QStringList>
-#include <QTcpServer>
-#include <QTcpSocket>
-#include <QtNetwork>
+#include <QThread>
+#include <vector>
+#include "dsp/dsp_load.h"
+#include "dsp/latency_probe.h"
+#include "dsp/latency_profile.h"
 #include "receivers/defines.h"
 #include "receivers/modulations.h"
+#include "interfaces/iq_stream_sink.h"
 
-/* For gain_t and gain_list_t */
-#include "qtgui/dockinputctl.h"
+/*! \brief State of one VFO as seen by the remote control clients. */
+struct RemoteVfo
+{
+    qint64      freq;              /*!< Frequency in Hz, including the LNB LO. */
+    Modulations::idx mode;
+    int         passband_lo;
+    int         passband_hi;
+    float       signal_level;      /*!< Signal level in dBFS */
+    double      squelch_level;     /*!< Squelch level in dBFS */
+    bool        squelch_open;      /*!< Squelch decision, true if open */
+};
+
+/*! \brief Change of one VFO requested with an addressed command or a batch. */
+struct RemoteVfoChange
+{
+    enum kind {
+        FREQ,                      /*!< freq */
+        MODE,                      /*!< mode and passband, 0 for the default */
+        SQL                        /*!< squelch_level */
+    };
+    kind        what;
+    int         vfo;
+    qint64      freq;
+    Modulations::idx mode;
+    int         passband;
+    double      squelch_level;
+};
+
+typedef std::vector<RemoteVfoChange> RemoteVfoChanges;
+
+/*! \brief Receiver state as seen by the remote control clients.
+ *
+ * The GUI thread publishes a copy after every change, the server thread
+ * answers the queries from the latest copy.
+ */
+struct RemoteState
+{
+    qint64      freq;
+    qint64      filter_offset;
+    qint64      bw_half;
+    double      lnb_lo_mhz;        /*!< Current LNB LO freq in MHz */
+
+    Modulations::idx mode;         /*!< Current mode. */
+    int         passband_lo;       /*!< Current low cutoff. */
+    int         passband_hi;       /*!< Current high cutoff. */
+    bool        rds_status;        /*!< RDS decoder enabled */
+    float       signal_level;      /*!< Signal level in dBFS */
+    double      squelch_level;     /*!< Squelch level in dBFS */
+    float       audio_gain;        /*!< Audio gain in dB */
+    QString     program_id;        /*!< RDS Program identification */
+    bool        audio_recorder_status; /*!< Recording enabled */
+    bool        receiver_running;  /*!< Whether the receiver is running or not */
+    bool        hamlib_compatible;
+    gain_list_t gains;             /*!< Possible and current gain settings */
+    QString     rds_station;       /*!< RDS Station Name */
+    QString     rds_radiotext;     /*!< RDS Radiotext */
+    std::vector<dsp_load_vfo>   dsp_load_vfos;   /*!< Last DSP load sample per VFO */
+    std::vector<dsp_load_block> dsp_load_blocks; /*!< Last DSP load sample per block */
+    bool        latency_probes;    /*!< Latency probes enabled */
+    bool        low_latency;       /*!< Low latency profile selected */
+    bool        shm_export;        /*!< Shared memory export enabled */
+    std::vector<latency_stage>  latency_stages;  /*!< Last latency sample per stage */
+    std::vector<RemoteVfo>      vfos;            /*!< All VFOs */
+    int         current_vfo;       /*!< Index of the VFO shown in the GUI */
+};
+
+class RemoteServer;
+class IqServer;
 
 /*! \brief Simple TCP server for remote control.
  *
@@ -55,8 +124,16 @@
  *
  *  close: Close connection (useful for interactive telnet sessions).
  *
+ * Commands can be addressed to any VFO with an @<vfo> prefix, and a list
+ * of commands between BATCH and END is applied at once, see runBatch().
+ *
+ * Any number of clients can be connected. The connections are served by
+ * RemoteServer in its own thread, which answers the queries from a
+ * RemoteState snapshot and passes only the commands changing the state
+ * to runCommand() in the GUI thread.
  *
- * FIXME: The server code is very minimalistic and probably not very robust.
+ * The same thread runs IqServer, streaming the I/Q samples of the VFOs on
+ * its own port, see newIqStream() and attachIqStream().
  */
 class RemoteControl : public QObject
 {
@@ -77,6 +154,12 @@ public:
         return rc_port;
     }
 
+    void setIqPort(int port);
+    int  getIqPort(void) const
+    {
+        return iq_port;
+    }
+
     void setHosts(QStringList hosts);
     QStringList getHosts(void) const
     {
@@ -84,6 +167,17 @@ public:
     }
     void setReceiverStatus(bool enabled);
     void setGainStages(gain_list_t &gain_list);
+    void setDspLoad(const std::vector<dsp_load_vfo> &vfos,
+                    const std::vector<dsp_load_block> &blocks);
+    void setLatencyProbes(bool enabled);
+    void setLatencyProfile(int profile);
+    void setShmExport(bool enabled);
+    void setLatency(const std::vector<latency_stage> &stages);
+    void setVfos(const std::vector<RemoteVfo> &vfos, int current);
+    bool spectrumWanted() const;
+    void setSpectrum(const float *db, unsigned int size, qint64 center, qint64 span,
+                     qint64 timestamp);
+    void attachIqStream(quint64 client, iq_stream_sink_sptr tap);
 
 public slots:
     void setNewFrequency(qint64 freq);
@@ -103,6 +197,12 @@ public slots:
     void setRdsStation(QString name);
     void setRdsRadiotext(QString text);
 
+    static bool answerQuery(const RemoteState &state, const QStringList &cmdlist,
+                            QString &answer);
+    static const QStringList &topics();
+    static const QStringList &vfoTopics();
+    static QString topicValue(const RemoteState &state, const QString &topic, int vfo = -1);
+
 signals:
     void newFrequency(qint64 freq);
     void newFilterOffset(qint64 offset);
@@ -116,63 +216,63 @@ signals:
     void gainChanged(QString name, double value);
     void dspChanged(bool value);
     void newRDSmode(bool value);
+    void newLatencyProbes(bool value);
+    void newLatencyProfile(int profile);
+    void newShmExport(bool enabled);
+    void newVfoChanges(const RemoteVfoChanges &changes);
+    void commandDone(quint64 client, QByteArray answer);
+    void newIqStream(quint64 client, int vfo, int stage, int format);
+    void iqStreamClosed(quint64 client);
 
 private slots:
-    void acceptConnection();
-    void startRead();
+    void runCommand(quint64 client, QStringList cmdlist);
 
 private:
-    QTcpServer  rc_server;         /*!< The active server object. */
-    QTcpSocket* rc_socket;         /*!< The active socket object. */
+    QThread       rc_thread;       /*!< The thread serving the clients. */
+    RemoteServer *rc_server;       /*!< The server, lives in rc_thread. */
+    bool          rc_listening;    /*!< Whether the server is listening. */
+    IqServer     *iq_server;       /*!< The I/Q stream server, lives in rc_thread. */
+    int           iq_port;         /*!< I/Q stream port, 0 to disable. */
+    bool          iq_listening;    /*!< Whether the I/Q server is listening. */
 
     QStringList rc_allowed_hosts;  /*!< Hosts where we accept connection from. */
     int         rc_port;           /*!< The port we are listening on. */
 
-    qint64      rc_freq;
-    qint64      rc_filter_offset;
-    qint64      bw_half;
-    double      rc_lnb_lo_mhz;     /*!< Current LNB LO freq in MHz */
-
-    Modulations::idx rc_mode;           /*!< Current mode. */
-    int         rc_passband_lo;    /*!< Current low cutoff. */
-    int         rc_passband_hi;    /*!< Current high cutoff. */
-    bool        rds_status;        /*!< RDS decoder enabled */
-    float       signal_level;      /*!< Signal level in dBFS */
-    double      squelch_level;     /*!< Squelch level in dBFS */
-    float       audio_gain;        /*!< Audio gain in dB */
-    QString     rc_program_id;     /*!< RDS Program identification */
-    bool        audio_recorder_status; /*!< Recording enabled */
-    bool        receiver_running;  /*!< Whether the receiver is running or not */
-    bool        hamlib_compatible;
-    gain_list_t gains;             /*!< Possible and current gain settings */
-    QString     rds_station;       /*!< RDS Station Name */
-    QString     rds_radiotext;     /*!< RDS Radiotext */
+    RemoteState state;             /*!< Current state, only used in the GUI thread. */
 
+    void        publishState();
     void        setNewRemoteFreq(qint64 freq);
+    bool        stageVfoCommand(const QStringList &cmdlist, RemoteVfoChanges &changes);
+    QString     runBatch(const QStringList &lines);
+    static bool parseVfo(const RemoteState &state, QStringList &cmdlist, int &vfo);
     int         modeStrToInt(QString mode_str);
-    QString     intToModeStr(int mode);
+    static QString intToModeStr(const RemoteState &state, int mode);
 
-    /* RC commands */
-    QString     cmd_get_freq() const;
+    /* RC commands changing the state, run in the GUI thread */
     QString     cmd_set_freq(QStringList cmdlist);
-    QString     cmd_get_mode();
     QString     cmd_set_mode(QStringList cmdlist);
-    QString     cmd_get_level(QStringList cmdlist);
     QString     cmd_set_level(QStringList cmdlist);
-    QString     cmd_get_func(QStringList cmdlist);
     QString     cmd_set_func(QStringList cmdlist);
-    QString     cmd_get_vfo() const;
-    QString     cmd_set_vfo(QStringList cmdlist);
-    QString     cmd_get_split_vfo() const;
-    QString     cmd_set_split_vfo();
-    QString     cmd_get_info() const;
-    QString     cmd_get_param(QStringList cmdlist);
     QString     cmd_AOS();
     QString     cmd_LOS();
     QString     cmd_lnb_lo(QStringList cmdlist);
-    QString     cmd_rds_station();
-    QString     cmd_rds_radiotext();
-    QString     cmd_dump_state() const;
+
+    /* RC queries, run in the server thread */
+    static QString cmd_get_freq(const RemoteState &state);
+    static QString cmd_get_mode(const RemoteState &state);
+    static QString cmd_get_level(const RemoteState &state, const QStringList &cmdlist);
+    static QString cmd_get_func(const RemoteState &state, const QStringList &cmdlist);
+    static QString cmd_get_param(const RemoteState &state, const QStringList &cmdlist);
+    static QString cmd_get_vfo();
+    static QString cmd_set_vfo(const QStringList &cmdlist);
+    static QString cmd_get_split_vfo();
+    static QString cmd_set_split_vfo();
+    static QString cmd_get_info();
+    static QString cmd_dsp_load(const RemoteState &state, const QStringList &cmdlist);
+    static QString cmd_latency(const RemoteState &state);
+    static QString cmd_dump_state();
+    static QString cmd_vfo_query(const RemoteState &state, QStringList cmdlist);
+    static QString cmd_vfos(const RemoteState &state);
 };
 
 #endif // REMOTE_CONTROL_H
@@ -0,0 +1,554 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <iostream>
+#include <QHostAddress>
+#include "remote_server.h"
+
+RemoteServer::RemoteServer(QObject *parent) :
+    QObject(parent),
+    rc_server(this),
+    rc_next_id(1),
+    rc_push_timer(this),
+    rc_subscribed(false),
+    rc_push_queued(false),
+    rc_spectrum_wanted(false),
+    rc_spectrum_queued(false)
+{
+    connect(&rc_server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+
+    rc_push_timer.setSingleShot(true);
+    connect(&rc_push_timer, SIGNAL(timeout()), this, SLOT(pushEvents()));
+    rc_clock.start();
+}
+
+void RemoteServer::setState(std::shared_ptr<const RemoteState> state)
+{
+    std::atomic_store(&rc_state, state);
+
+    // Wake up the server thread only if somebody listens, and only once
+    // for a burst of changes
+    if (rc_subscribed && !rc_push_queued.exchange(true))
+        QMetaObject::invokeMethod(this, "pushEvents", Qt::QueuedConnection);
+}
+
+void RemoteServer::setSpectrum(std::shared_ptr<const SpectrumFrame> frame)
+{
+    std::atomic_store(&rc_spectrum, frame);
+
+    if (rc_spectrum_wanted && !rc_spectrum_queued.exchange(true))
+        QMetaObject::invokeMethod(this, "pushSpectrum", Qt::QueuedConnection);
+}
+
+/*! \brief Start listening on all interfaces.
+ *  \param port The network port.
+ *  \returns True if the server is listening.
+ */
+bool RemoteServer::listen(int port)
+{
+    if (rc_server.isListening())
+        rc_server.close();
+
+    return rc_server.listen(QHostAddress::Any, port);
+}
+
+/*! \brief Stop listening and close all client connections. */
+void RemoteServer::close()
+{
+    while (!rc_clients.isEmpty())
+        dropClient(rc_clients.begin().key());
+
+    if (rc_server.isListening())
+        rc_server.close();
+}
+
+void RemoteServer::setHosts(QStringList hosts)
+{
+    rc_allowed_hosts = hosts;
+}
+
+/*! \brief Accept new client connections.
+ *
+ * This slot is called when clients open new connections.
+ */
+void RemoteServer::acceptConnection()
+{
+    while (QTcpSocket *socket = rc_server.nextPendingConnection())
+    {
+        // check if host is allowed
+        auto address = socket->peerAddress();
+        bool allowed = false;
+
+        for (auto allowed_host : rc_allowed_hosts)
+        {
+#if QT_VERSION < QT_VERSION_CHECK(5, 8, 0)
+            if (address == QHostAddress(allowed_host))
+#else
+            if (address.isEqual(QHostAddress(allowed_host)))
+#endif
+            {
+                allowed = true;
+                break;
+            }
+        }
+
+        if (!allowed)
+        {
+            std::cout << "*** Remote connection attempt from " << address.toString().toStdString()
+                      << " (not in allowed list)" << std::endl;
+            socket->close();
+            socket->deleteLater();
+            continue;
+        }
+
+        quint64 id = rc_next_id++;
+        Client &client = rc_clients[id];
+
+        client.socket = socket;
+        client.pending = false;
+        client.batching = false;
+        client.batch.clear();
+        client.subscriptions.clear();
+        client.spectrum.reset();
+        socket->setProperty("rc_client", id);
+        connect(socket, SIGNAL(readyRead()), this, SLOT(startRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(clientDisconnected()));
+    }
+}
+
+/*! \brief Read from a client socket.
+ *
+ * This slot is called when a client TCP socket emits a readyRead() signal,
+ * i.e. when there is data to read.
+ */
+void RemoteServer::startRead()
+{
+    auto *socket = qobject_cast<QTcpSocket *>(sender());
+    quint64 id = socket ? socket->property("rc_client").toULongLong() : 0;
+    auto it = rc_clients.find(id);
+
+    if (it == rc_clients.end())
+        return;
+
+    it->buffer.append(socket->readAll());
+    processLines(id);
+}
+
+void RemoteServer::clientDisconnected()
+{
+    auto *socket = qobject_cast<QTcpSocket *>(sender());
+
+    if (socket)
+        dropClient(socket->property("rc_client").toULongLong());
+}
+
+/*! \brief Send the answer of a command run in the GUI thread.
+ *  \param client The connection the command came from.
+ *  \param answer The answer.
+ *
+ * The client may have disconnected meanwhile, then the answer is dropped.
+ */
+void RemoteServer::reply(quint64 client, QByteArray answer)
+{
+    auto it = rc_clients.find(client);
+
+    if (it == rc_clients.end())
+        return;
+
+    it->socket->write(answer);
+    it->pending = false;
+    processLines(client);
+}
+
+/*! \brief Parse the complete lines received from a client.
+ *
+ * Stops at the first command, that has to be run in the GUI thread, and
+ * continues when its answer arrives.
+ */
+void RemoteServer::processLines(quint64 id)
+{
+    auto it = rc_clients.find(id);
+    QByteArray answers;
+
+    if (it == rc_clients.end())
+        return;
+
+    std::shared_ptr<const RemoteState> state = std::atomic_load(&rc_state);
+    int start = 0;
+
+    while (!it->pending)
+    {
+        int end = it->buffer.indexOf('\n', start);
+        if (end < 0)
+            break;
+
+        QStringList cmdlist = tokenize(QByteArray::fromRawData(it->buffer.constData() + start,
+                                                               end - start));
+        start = end + 1;
+        if (cmdlist.isEmpty())
+            continue;
+
+        QString answer;
+        if (it->batching)
+        {
+            if (cmdlist[0] == "END")
+            {
+                QStringList batch = it->batch;
+
+                batch.prepend("BATCH");
+                it->batch.clear();
+                it->batching = false;
+                it->pending = true;
+                emit command(id, batch);
+            }
+            else if (it->batch.size() < RC_MAX_BATCH)
+            {
+                it->batch.append(cmdlist.join(' '));
+            }
+            else
+            {
+                std::cout << "*** Remote batch too long, closing connection from "
+                          << it->socket->peerAddress().toString().toStdString() << std::endl;
+                dropClient(id);
+                return;
+            }
+        }
+        else if (cmdlist[0] == "BATCH")
+        {
+            it->batching = true;
+        }
+        else if (cmdlist[0] == "q" || cmdlist[0] == "Q")
+        {
+            // FIXME: for now we assume 'close' command
+            it->socket->write(answers);
+            dropClient(id);
+            return;
+        }
+        else if (cmdlist[0] == "SUBSCRIBE")
+        {
+            answers.append(cmdSubscribe(*it, cmdlist).toLatin1());
+        }
+        else if (cmdlist[0] == "UNSUBSCRIBE")
+        {
+            answers.append(cmdUnsubscribe(*it, cmdlist).toLatin1());
+        }
+        else if (cmdlist[0] == "SPECTRUM")
+        {
+            answers.append(cmdSpectrum(*it, cmdlist).toLatin1());
+        }
+        else if (RemoteControl::answerQuery(*state, cmdlist, answer))
+        {
+            answers.append(answer.toLatin1());
+        }
+        else
+        {
+            it->pending = true;
+            emit command(id, cmdlist);
+        }
+    }
+    it->buffer.remove(0, start);
+
+    if (!answers.isEmpty())
+        it->socket->write(answers);
+
+    // A client waiting for an answer may queue some commands, but not
+    // an unlimited amount
+    if (it->buffer.size() > (it->pending ? RC_MAX_BUFFER : RC_MAX_LINE))
+    {
+        std::cout << "*** Remote command too long, closing connection from "
+                  << it->socket->peerAddress().toString().toStdString() << std::endl;
+        dropClient(id);
+    }
+}
+
+void RemoteServer::dropClient(quint64 id)
+{
+    auto it = rc_clients.find(id);
+
+    if (it == rc_clients.end())
+        return;
+
+    QTcpSocket *socket = it->socket;
+    rc_clients.erase(it);
+    socket->disconnect(this);
+    socket->close();
+    socket->deleteLater();
+    updateSubscribed();
+}
+
+/*
+ * Subscribe to a topic:
+ *   SUBSCRIBE <topic> [interval] [vfo=<n>]
+ * The interval is in ms, or in s with an "s" suffix. The current value is
+ * sent right away, then every change, at most once per interval. With
+ * vfo=<n> the topic follows VFO n instead of the current VFO, and the
+ * events are sent as EVENT @<n> <topic> <value>.
+ */
+QString RemoteServer::cmdSubscribe(Client &client, const QStringList &cmdlist)
+{
+    QString topic = cmdlist.value(1, "");
+    qint64 interval = RC_DEFAULT_INTERVAL;
+    int vfo = -1;
+
+    if (topic == "?")
+        return RemoteControl::topics().join(" ") + "\n";
+    if (!RemoteControl::topics().contains(topic) || !parseSubscription(cmdlist, interval, vfo))
+        return QString("RPRT 1\n");
+    if (vfo >= 0)
+    {
+        std::shared_ptr<const RemoteState> state = std::atomic_load(&rc_state);
+        if (!RemoteControl::vfoTopics().contains(topic) || !state ||
+            vfo >= int(state->vfos.size()))
+            return QString("RPRT 1\n");
+    }
+
+    Subscription &sub = client.subscriptions[subscriptionKey(topic, vfo)];
+    sub.topic = topic;
+    sub.vfo = vfo;
+    sub.interval = std::max<qint64>(interval, RC_MIN_INTERVAL);
+    sub.sent_at = 0;
+    sub.value.clear();
+    sub.fresh = true;
+    updateSubscribed();
+
+    // Send the current value after the answer
+    if (!rc_push_queued.exchange(true))
+        QMetaObject::invokeMethod(this, "pushEvents", Qt::QueuedConnection);
+
+    return QString("RPRT 0\n");
+}
+
+/*
+ * Unsubscribe from a topic or, without argument, from all topics:
+ *   UNSUBSCRIBE [topic [vfo=<n>]]
+ */
+QString RemoteServer::cmdUnsubscribe(Client &client, const QStringList &cmdlist)
+{
+    qint64 interval = -1;
+    int vfo = -1;
+
+    if (cmdlist.size() == 1)
+        client.subscriptions.clear();
+    else if (!parseSubscription(cmdlist, interval, vfo) || interval >= 0 ||
+             client.subscriptions.remove(subscriptionKey(cmdlist[1], vfo)) == 0)
+        return QString("RPRT 1\n");
+
+    updateSubscribed();
+    return QString("RPRT 0\n");
+}
+
+/*
+ * Start, change or stop (with OFF) the spectrum stream:
+ *   SPECTRUM [key=value ...]
+ *   SPECTRUM OFF
+ * See SpectrumStream::parse() for the options.
+ */
+QString RemoteServer::cmdSpectrum(Client &client, const QStringList &cmdlist)
+{
+    if (cmdlist.size() == 2 && cmdlist[1].compare("OFF", Qt::CaseInsensitive) == 0)
+    {
+        client.spectrum.reset();
+    }
+    else
+    {
+        auto stream = client.spectrum ? client.spectrum : std::make_shared<SpectrumStream>();
+
+        if (!stream->parse(cmdlist.mid(1)))
+            return QString("RPRT 1\n");
+        client.spectrum = stream;
+    }
+
+    updateSubscribed();
+    return QString("RPRT 0\n");
+}
+
+void RemoteServer::updateSubscribed()
+{
+    bool subscribed = false;
+    bool spectrum = false;
+
+    for (auto &client : rc_clients)
+    {
+        subscribed |= !client.subscriptions.isEmpty();
+        spectrum |= bool(client.spectrum);
+    }
+    rc_subscribed = subscribed;
+    rc_spectrum_wanted = spectrum;
+}
+
+/*! \brief Send the latest spectrum frame to the streaming clients.
+ *
+ * Clients with more than RC_MAX_BUFFER unsent bytes skip the frame.
+ */
+void RemoteServer::pushSpectrum()
+{
+    rc_spectrum_queued = false;
+
+    std::shared_ptr<const SpectrumFrame> frame = std::atomic_load(&rc_spectrum);
+    qint64 now = rc_clock.elapsed();
+
+    if (!frame)
+        return;
+
+    for (auto &client : rc_clients)
+    {
+        if (!client.spectrum || !client.spectrum->due(now))
+            continue;
+        if (client.socket->bytesToWrite() > RC_MAX_BUFFER)
+            continue;
+
+        client.socket->write(client.spectrum->encode(*frame, now));
+    }
+}
+
+/*! \brief Send the changed topics to the subscribed clients.
+ *
+ * Called when a new snapshot is published, and by rc_push_timer for the
+ * changes held back by the interval of a subscription.
+ */
+void RemoteServer::pushEvents()
+{
+    rc_push_queued = false;
+
+    std::shared_ptr<const RemoteState> state = std::atomic_load(&rc_state);
+    qint64 now = rc_clock.elapsed();
+    qint64 next = -1;
+
+    for (auto &client : rc_clients)
+    {
+        QByteArray events;
+
+        // Coalesce the events of slow clients, until they catch up
+        bool congested = client.socket->bytesToWrite() > RC_MAX_BUFFER;
+
+        for (auto it = client.subscriptions.begin(); it != client.subscriptions.end(); ++it)
+        {
+            Subscription &sub = it.value();
+            QString value = RemoteControl::topicValue(*state, sub.topic, sub.vfo);
+
+            if (!sub.fresh && value == sub.value)
+                continue;
+
+            qint64 due = sub.fresh ? now : sub.sent_at + sub.interval;
+            if (congested)
+                due = std::max(due, now + sub.interval);
+            if (due > now)
+            {
+                next = (next < 0) ? due : std::min(next, due);
+                continue;
+            }
+
+            events.append(QString("EVENT %1 %2\n").arg(it.key(), value).toLatin1());
+            sub.value = value;
+            sub.sent_at = now;
+            sub.fresh = false;
+        }
+
+        if (!events.isEmpty())
+            client.socket->write(events);
+    }
+
+    if (next >= 0 && (!rc_push_timer.isActive() || rc_push_timer.remainingTime() > next - now))
+        rc_push_timer.start(int(next - now));
+}
+
+/*! \brief Parse the optional [interval] [vfo=<n>] after the topic.
+ *  \returns False if an argument is invalid or repeated.
+ */
+bool RemoteServer::parseSubscription(const QStringList &cmdlist, qint64 &interval, int &vfo)
+{
+    bool have_interval = false;
+    bool have_vfo = false;
+
+    for (int i = 2; i < cmdlist.size(); i++)
+    {
+        const QString &arg = cmdlist[i];
+        if (arg.startsWith("vfo=", Qt::CaseInsensitive))
+        {
+            bool ok;
+            vfo = arg.mid(4).toInt(&ok);
+            if (!ok || vfo < 0 || have_vfo)
+                return false;
+            have_vfo = true;
+        }
+        else
+        {
+            interval = parseInterval(arg);
+            if (interval < 0 || have_interval)
+                return false;
+            have_interval = true;
+        }
+    }
+    return true;
+}
+
+/*! \brief Key of a subscription, also the topic in its EVENT lines. */
+QString RemoteServer::subscriptionKey(const QString &topic, int vfo)
+{
+    return vfo < 0 ? topic : QString("@%1 %2").arg(vfo).arg(topic);
+}
+
+/*! \brief Parse an interval like 50, 50ms or 2s.
+ *  \returns The interval in ms or -1 if invalid.
+ */
+qint64 RemoteServer::parseInterval(const QString &str)
+{
+    QString num = str;
+    qint64 scale = 1;
+    bool ok;
+
+    if (num.endsWith("ms", Qt::CaseInsensitive))
+        num.chop(2);
+    else if (num.endsWith("s", Qt::CaseInsensitive))
+    {
+        num.chop(1);
+        scale = 1000;
+    }
+
+    double value = num.toDouble(&ok);
+    if (!ok || value < 0.0 || value > 3600.0 * 1000.0)
+        return -1;
+
+    return qint64(value * scale);
+}
+
+/*! \brief Split a command line at spaces and tabs, without the line end. */
+QStringList RemoteServer::tokenize(const QByteArray &line)
+{
+    QStringList tokens;
+    int i = 0;
+    int n = line.size();
+
+    while (i < n)
+    {
+        while (i < n && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r'))
+            i++;
+        int start = i;
+        while (i < n && line[i] != ' ' && line[i] != '\t' && line[i] != '\r')
+            i++;
+        if (i > start)
+            tokens.append(QString::fromLatin1(line.constData() + start, i - start));
+    }
+
+    return tokens;
+}
@@ -0,0 +1,153 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef REMOTE_SERVER_H
+#define REMOTE_SERVER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include "remote_control.h"
+#include "remote_spectrum.h"
+
+/* Longest command line we accept, longer lines close the connection. */
+#define RC_MAX_LINE   1024
+/* Most data we buffer while a client waits for the answer of a command. */
+#define RC_MAX_BUFFER 65536
+/* Most commands in one BATCH. */
+#define RC_MAX_BATCH  4096
+/* Default and shortest interval between two events of a subscription in ms. */
+#define RC_DEFAULT_INTERVAL 100
+#define RC_MIN_INTERVAL     20
+
+/*! \brief TCP server of the remote control, serving many clients.
+ *
+ * The server is moved to its own thread by RemoteControl. Every connection
+ * has its own line buffer. Queries are answered right away from the latest
+ * RemoteState snapshot, commands changing the state are emitted with
+ * command() and the answer comes back through reply(). The following
+ * commands of that client wait for the answer, so the answers are always
+ * sent in the order of the commands.
+ *
+ * Clients can subscribe to topics with SUBSCRIBE. When a new snapshot is
+ * published, the changed topics are sent as EVENT lines, at most once per
+ * interval of the subscription. Changes within the interval are coalesced,
+ * only the latest value is sent.
+ *
+ * Clients streaming the spectrum with SPECTRUM get the frames published
+ * with setSpectrum(), at most at the frame rate they asked for. Frames are
+ * dropped for clients, that can not keep up, so the caller never waits.
+ *
+ * The commands between BATCH and END are collected and sent to the GUI
+ * thread as one command, the answers come back together.
+ */
+class RemoteServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RemoteServer(QObject *parent = 0);
+
+    /*! \brief Publish a new state snapshot, may be called from any thread. */
+    void setState(std::shared_ptr<const RemoteState> state);
+
+    /*! \brief Publish a new spectrum frame, may be called from any thread. */
+    void setSpectrum(std::shared_ptr<const SpectrumFrame> frame);
+
+    /*! \brief Whether any client streams the spectrum. */
+    bool spectrumWanted() const
+    {
+        return rc_spectrum_wanted;
+    }
+
+public slots:
+    bool listen(int port);
+    void close();
+    void setHosts(QStringList hosts);
+    void reply(quint64 client, QByteArray answer);
+    void pushEvents();
+    void pushSpectrum();
+
+signals:
+    void command(quint64 client, QStringList cmdlist);
+
+private slots:
+    void acceptConnection();
+    void startRead();
+    void clientDisconnected();
+
+private:
+    struct Subscription
+    {
+        QString     topic;
+        int         vfo;       /*!< VFO index or -1 for the current VFO. */
+        qint64      interval;  /*!< Shortest time between two events in ms. */
+        qint64      sent_at;   /*!< Time of the last event in ms. */
+        QString     value;     /*!< Last value sent. */
+        bool        fresh;     /*!< Nothing sent yet. */
+    };
+
+    struct Client
+    {
+        QTcpSocket *socket;
+        QByteArray  buffer;    /*!< Received data not parsed yet. */
+        bool        pending;   /*!< Waiting for the answer of a command. */
+        bool        batching;  /*!< Collecting commands between BATCH and END. */
+        QStringList batch;     /*!< Commands of the batch, tokens joined by spaces. */
+        QHash<QString, Subscription> subscriptions;
+        std::shared_ptr<SpectrumStream> spectrum;  /*!< Null if not streaming. */
+    };
+
+    void processLines(quint64 id);
+    void dropClient(quint64 id);
+    QString cmdSubscribe(Client &client, const QStringList &cmdlist);
+    QString cmdUnsubscribe(Client &client, const QStringList &cmdlist);
+    QString cmdSpectrum(Client &client, const QStringList &cmdlist);
+    void updateSubscribed();
+    static bool parseSubscription(const QStringList &cmdlist, qint64 &interval, int &vfo);
+    static QString subscriptionKey(const QString &topic, int vfo);
+    static qint64 parseInterval(const QString &str);
+    static QStringList tokenize(const QByteArray &line);
+
+    QTcpServer                  rc_server;
+    QStringList                 rc_allowed_hosts;
+    QHash<quint64, Client>      rc_clients;
+    quint64                     rc_next_id;
+    std::shared_ptr<const RemoteState> rc_state;  /*!< Accessed with std::atomic_load/store. */
+
+    QTimer                      rc_push_timer;    /*!< Sends the events held back by the interval. */
+    QElapsedTimer               rc_clock;
+    std::atomic<bool>           rc_subscribed;    /*!< Any client has subscriptions. */
+    std::atomic<bool>           rc_push_queued;   /*!< pushEvents() is queued. */
+
+    std::shared_ptr<const SpectrumFrame> rc_spectrum; /*!< Accessed with std::atomic_load/store. */
+    std::atomic<bool>           rc_spectrum_wanted; /*!< Any client streams the spectrum. */
+    std::atomic<bool>           rc_spectrum_queued; /*!< pushSpectrum() is queued. */
+};
+
+#endif // REMOTE_SERVER_H
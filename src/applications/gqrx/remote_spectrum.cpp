@@ -0,0 +1,221 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cmath>
+#include <QString>
+#include "remote_spectrum.h"
+
+SpectrumStream::SpectrumStream() :
+    d_fps(10),
+    d_bins(1024),
+    d_bits(8),
+    d_encoding(ENC_RAW),
+    d_start(0),
+    d_stop(0),
+    d_min_db(-140.f),
+    d_max_db(0.f),
+    d_sent_at(-1),
+    d_seq(0)
+{
+}
+
+/*! \brief Set the stream options.
+ *  \param args Options of the SPECTRUM command, key=value:
+ *              fps, bins, bits (8 or 16), encoding (raw, delta or rle),
+ *              start and stop (Hz), min and max (dBFS).
+ *  \returns False if an option is invalid, the stream is unchanged then.
+ */
+bool SpectrumStream::parse(const QStringList &args)
+{
+    SpectrumStream s = *this;
+
+    for (auto &arg : args)
+    {
+        QString key = arg.section('=', 0, 0).toLower();
+        QString value = arg.section('=', 1);
+        bool ok = !value.isEmpty();
+
+        if (key == "fps")
+            s.d_fps = value.toInt(&ok);
+        else if (key == "bins")
+            s.d_bins = value.toInt(&ok);
+        else if (key == "bits")
+            s.d_bits = value.toInt(&ok);
+        else if (key == "start")
+            s.d_start = value.toLongLong(&ok);
+        else if (key == "stop")
+            s.d_stop = value.toLongLong(&ok);
+        else if (key == "min")
+            s.d_min_db = value.toFloat(&ok);
+        else if (key == "max")
+            s.d_max_db = value.toFloat(&ok);
+        else if (key == "encoding" && value.compare("raw", Qt::CaseInsensitive) == 0)
+            s.d_encoding = ENC_RAW;
+        else if (key == "encoding" && value.compare("delta", Qt::CaseInsensitive) == 0)
+            s.d_encoding = ENC_DELTA;
+        else if (key == "encoding" && value.compare("rle", Qt::CaseInsensitive) == 0)
+            s.d_encoding = ENC_RLE;
+        else
+            ok = false;
+
+        if (!ok)
+            return false;
+    }
+
+    if (s.d_fps < 1 || s.d_fps > SPECTRUM_MAX_FPS)
+        return false;
+    if (s.d_bins < 1 || s.d_bins > 65536)
+        return false;
+    if (s.d_bits != 8 && s.d_bits != 16)
+        return false;
+    if (s.d_min_db >= s.d_max_db)
+        return false;
+    if (s.d_start > s.d_stop || (s.d_start == s.d_stop && s.d_start != 0))
+        return false;
+
+    *this = s;
+    return true;
+}
+
+/*! \brief Whether the next frame is due, according to the frame rate. */
+bool SpectrumStream::due(qint64 now_ms) const
+{
+    qint64 period = 1000 / d_fps;
+
+    // Accept frames a bit early, so that the jitter of the FFT timer does
+    // not halve the rate when the plotter runs at the same rate
+    return d_sent_at < 0 || now_ms - d_sent_at >= period - period / 4;
+}
+
+/*! \brief Encode a frame.
+ *  \returns The header line followed by the binary bins.
+ */
+QByteArray SpectrumStream::encode(const SpectrumFrame &frame, qint64 now_ms)
+{
+    int n = frame.db.size();
+    double bin_hz = n ? double(frame.span) / n : 0.0;
+    double low_freq = frame.center - frame.span / 2.0;
+    int first = 0;
+    int last = n;
+
+    if (d_stop > d_start && bin_hz > 0.0)
+    {
+        first = std::max(0, std::min(n, int(std::floor((d_start - low_freq) / bin_hz))));
+        last = std::max(first, std::min(n, int(std::ceil((d_stop - low_freq) / bin_hz))));
+    }
+
+    // Decimate, keeping the peak, and quantize
+    int len = last - first;
+    int bins = std::min(d_bins, len);
+    unsigned qmax = (1u << d_bits) - 1;
+    float scale = qmax / (d_max_db - d_min_db);
+
+    d_values.resize(bins);
+    for (int b = 0; b < bins; b++)
+    {
+        int from = first + int(qint64(b) * len / bins);
+        int to = first + int(qint64(b + 1) * len / bins);
+        float peak = *std::max_element(frame.db.begin() + from, frame.db.begin() + to);
+
+        if (!(peak > d_min_db))
+            d_values[b] = 0;
+        else if (peak >= d_max_db)
+            d_values[b] = qmax;
+        else
+            d_values[b] = unsigned(std::lround((peak - d_min_db) * scale));
+    }
+
+    QByteArray body;
+    const char *enc_name = "raw";
+
+    switch (d_encoding)
+    {
+    case ENC_RAW:
+        body.reserve(bins * d_bits / 8);
+        for (unsigned v : d_values)
+            appendValue(body, v);
+        break;
+
+    case ENC_DELTA:
+    {
+        int prev = 0;
+
+        enc_name = "delta";
+        body.reserve(bins);
+        for (unsigned v : d_values)
+        {
+            int delta = int(v) - prev;
+            unsigned zz = (unsigned(delta) << 1) ^ unsigned(delta >> 31);
+
+            while (zz >= 0x80)
+            {
+                body.append(char(zz | 0x80));
+                zz >>= 7;
+            }
+            body.append(char(zz));
+            prev = int(v);
+        }
+        break;
+    }
+
+    case ENC_RLE:
+        enc_name = "rle";
+        for (int i = 0; i < bins; )
+        {
+            int run = 1;
+
+            while (i + run < bins && run < 255 && d_values[i + run] == d_values[i])
+                run++;
+            body.append(char(run));
+            appendValue(body, d_values[i]);
+            i += run;
+        }
+        break;
+    }
+
+    d_sent_at = now_ms;
+
+    QByteArray frame_data = QString("SPECTRUM %1 %2 %3 %4 %5 %6 %7 %8 %9 %10 %11 %12\n")
+            .arg(d_seq++)
+            .arg(frame.timestamp)
+            .arg(frame.center)
+            .arg(frame.span)
+            .arg(qint64(std::llround(low_freq + first * bin_hz)))
+            .arg(qint64(std::llround(low_freq + last * bin_hz)))
+            .arg(bins)
+            .arg(d_bits)
+            .arg(QLatin1String(enc_name))
+            .arg(d_min_db, 0, 'f', 1)
+            .arg(d_max_db, 0, 'f', 1)
+            .arg(body.size())
+            .toLatin1();
+
+    return frame_data + body;
+}
+
+void SpectrumStream::appendValue(QByteArray &out, unsigned value) const
+{
+    out.append(char(value & 0xff));
+    if (d_bits == 16)
+        out.append(char(value >> 8));
+}
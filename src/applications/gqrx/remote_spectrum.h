@@ -0,0 +1,78 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef REMOTE_SPECTRUM_H
+#define REMOTE_SPECTRUM_H
+
+#include <QByteArray>
+#include <QStringList>
+#include <vector>
+
+#define SPECTRUM_MAX_FPS    30
+
+/*! \brief One spectrum frame, as shown by the plotter. */
+struct SpectrumFrame
+{
+    std::vector<float> db;        /*!< Averaged power in dBFS, lowest frequency first. */
+    qint64      center;           /*!< Center frequency in Hz, including the LNB LO. */
+    qint64      span;             /*!< Span in Hz. */
+    qint64      timestamp;        /*!< Time of the frame in ms since the epoch. */
+};
+
+/*! \brief Spectrum stream of one remote control client.
+ *
+ * The stream decimates the frames to the selected window and number of
+ * bins, keeping the peak of the FFT bins merged into one, quantizes them
+ * to 8 or 16 bit and compresses them.
+ */
+class SpectrumStream
+{
+public:
+    enum encoding {
+        ENC_RAW,      /*!< One value per bin, 16 bit values little endian. */
+        ENC_DELTA,    /*!< Differences to the previous bin, zigzag varints. */
+        ENC_RLE       /*!< Pairs of repeat count (1 - 255) and value. */
+    };
+
+    SpectrumStream();
+
+    bool    parse(const QStringList &args);
+    bool    due(qint64 now_ms) const;
+    QByteArray encode(const SpectrumFrame &frame, qint64 now_ms);
+
+private:
+    void    appendValue(QByteArray &out, unsigned value) const;
+
+    int         d_fps;
+    int         d_bins;
+    int         d_bits;
+    encoding    d_encoding;
+    qint64      d_start;          /*!< Window start in Hz, 0 for the whole span. */
+    qint64      d_stop;           /*!< Window stop in Hz, 0 for the whole span. */
+    float       d_min_db;
+    float       d_max_db;
+    qint64      d_sent_at;        /*!< Time of the last frame in ms, -1 if none. */
+    quint64     d_seq;
+    std::vector<unsigned> d_values;
+};
+
+#endif // REMOTE_SPECTRUM_H
@@ -0,0 +1,286 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <cmath>
+#include <QDir>
+#include <QString>
+#include "rx_settings.h"
+
+/**
+ * @brief Apply the settings of a VFO group to the current VFO.
+ * @param settings The configuration, positioned at the group of the VFO.
+ * @param rx The receiver.
+ * @param ver Version of the configuration.
+ * @param actual_rate Input sample rate after decimation.
+ *
+ * Configurations older than version 4 keep the audio settings in the
+ * "audio" group, which is entered instead of the VFO group then, the
+ * caller has to end the group in both cases.
+ */
+void read_vfo_settings(QSettings *settings, receiver *rx, int ver, double actual_rate)
+{
+    bool    conv_ok;
+    int     int_val;
+    double  dbl_val;
+    qint64  offs;
+
+    bool isLocked = settings->value("freq_locked", false).toBool();
+    rx->set_freq_lock(isLocked);
+
+    offs = settings->value("offset", 0).toInt(&conv_ok);
+    if (conv_ok)
+    {
+        if(!isLocked || ver < 4)
+            if(std::abs(offs) > actual_rate / 2)
+                offs = (offs > 0) ? (actual_rate / 2) : (-actual_rate / 2);
+        rx->set_filter_offset(offs);
+    }
+
+    int_val = Modulations::MODE_AM;
+    if (settings->contains("demod")) {
+        if (ver >= 3) {
+            int_val = Modulations::GetEnumForModulationString(settings->value("demod").toString().toStdString());
+        } else {
+            int_val = Modulations::ConvertFromOld(settings->value("demod").toInt(&conv_ok));
+        }
+    }
+    rx->set_demod(Modulations::idx(int_val));
+
+    rx->set_am_dcr(settings->value("am_dcr", true).toBool());
+
+    rx->set_amsync_dcr(settings->value("amsync_dcr", true).toBool());
+
+    int_val = settings->value("pll_bw", 1000).toInt(&conv_ok);
+    if (conv_ok)
+        rx->set_pll_bw(int_val / 1.0e6);
+
+    int_val = settings->value("cwoffset", 700).toInt(&conv_ok);
+    if (conv_ok)
+        rx->set_cw_offset(int_val);
+
+    int_val = settings->value("fm_maxdev", 2500).toInt(&conv_ok);
+    if (conv_ok)
+        rx->set_fm_maxdev(int_val);
+
+    dbl_val = settings->value("fm_deemph", 75).toDouble(&conv_ok);
+    if (conv_ok && dbl_val >= 0.0)
+        rx->set_fm_deemph(dbl_val);
+
+    dbl_val = settings->value("fmpll_damping_factor", 0.7).toDouble(&conv_ok);
+    if (conv_ok && dbl_val > 0.0)
+        rx->set_fmpll_damping_factor(dbl_val);
+
+    if (settings->value("subtone_filter", false).toBool())
+        rx->set_fm_subtone_filter(true);
+    else
+        rx->set_fm_subtone_filter(false);
+
+    dbl_val = settings->value("sql_level", 1.0).toDouble(&conv_ok);
+    if (conv_ok && dbl_val < 1.0)
+        rx->set_sql_level(dbl_val);
+
+    // AGC settings
+    int_val = settings->value("agc_target_level", 0).toInt(&conv_ok);
+    if (conv_ok)
+        rx->set_agc_target_level(int_val);
+
+    //TODO: store/restore the preset correctly
+    int_val = settings->value("agc_decay", 500).toInt(&conv_ok);
+    if (conv_ok)
+        rx->set_agc_decay(int_val);
+
+    int_val = settings->value("agc_attack", 20).toInt(&conv_ok);
+    if (conv_ok)
+        rx->set_agc_attack(int_val);
+
+    int_val = settings->value("agc_hang", 0).toInt(&conv_ok);
+    if (conv_ok)
+        rx->set_agc_hang(int_val);
+
+    int_val = settings->value("agc_panning", 0).toInt(&conv_ok);
+    if (conv_ok)
+        rx->set_agc_panning(int_val);
+
+    if (settings->value("agc_panning_auto", false).toBool())
+        rx->set_agc_panning_auto(true);
+    else
+        rx->set_agc_panning_auto(false);
+
+    int_val = settings->value("agc_maxgain", 100).toInt(&conv_ok);
+    if (conv_ok)
+        rx->set_agc_max_gain(int_val);
+
+    if (settings->value("agc_off", false).toBool())
+        rx->set_agc_on(false);
+    else
+        rx->set_agc_on(true);
+
+    for (int j = 1; j < RECEIVER_NB_COUNT + 1; j++)
+    {
+        rx->set_nb_on(j, settings->value(QString("nb%1on").arg(j), false).toBool());
+        float thr = settings->value(QString("nb%1thr").arg(j), 2.0).toFloat(&conv_ok);
+        if (conv_ok)
+            rx->set_nb_threshold(j, thr);
+    }
+
+    bool flo_ok = false;
+    bool fhi_ok = false;
+    int flo = settings->value("filter_low_cut", 0).toInt(&flo_ok);
+    int fhi = settings->value("filter_high_cut", 0).toInt(&fhi_ok);
+    int_val = settings->value("filter_shape", Modulations::FILTER_SHAPE_NORMAL).toInt(&conv_ok);
+
+    if (flo != fhi)
+        rx->set_filter(flo, fhi, receiver::filter_shape(int_val));
+
+    if (ver < 4)
+    {
+        settings->endGroup();
+        settings->beginGroup("audio");
+    }
+    int_val = settings->value("gain", QVariant(-60)).toInt(&conv_ok);
+    if (conv_ok)
+        if (!rx->get_agc_on())
+            rx->set_agc_manual_gain(float(int_val)*0.1f);
+
+    QString rec_dir = settings->value("rec_dir", QDir::homePath()).toString();
+    rx->set_audio_rec_dir(rec_dir.toStdString());
+
+    bool squelch_triggered = settings->value("squelch_triggered_recording", false).toBool();
+    rx->set_audio_rec_sql_triggered(squelch_triggered);
+
+    int_val = settings->value("rec_min_time", 0).toInt(&conv_ok);
+    if (!conv_ok)
+        int_val = 0;
+    rx->set_audio_rec_min_time(int_val);
+
+    int_val = settings->value("rec_max_gap", 0).toInt(&conv_ok);
+    if (!conv_ok)
+        int_val = 0;
+    rx->set_audio_rec_max_gap(int_val);
+
+    QString udp_host = settings->value("udp_host", "127.0.0.1").toString();
+    rx->set_udp_host(udp_host.toStdString());
+
+    int_val = settings->value("udp_port", 7355).toInt(&conv_ok);
+    if (!conv_ok)
+        int_val = 7355;
+    rx->set_udp_port(int_val);
+
+    bool udp_stereo = settings->value("udp_stereo", false).toBool();
+    rx->set_udp_stereo(udp_stereo);
+}
+
+/** Get the filter edges of a passband width for a mode and filter preset. */
+void passband_to_filter(Modulations::idx mode, int preset, int bandwidth, int &lo, int &hi)
+{
+    /* Check if filter is symmetric or not by checking the presets */
+    Modulations::GetFilterPreset(mode, preset, lo, hi);
+
+    if (lo + hi == 0)
+    {
+        lo = -bandwidth / 2;
+        hi =  bandwidth / 2;
+    }
+    else if (lo >= 0 && hi >= 0)
+    {
+        hi = lo + bandwidth;
+    }
+    else if (lo <= 0 && hi <= 0)
+    {
+        lo = hi - bandwidth;
+    }
+}
+
+/**
+ * @brief Translate VFO changes of the remote control for the receiver.
+ * @param lnb_lo LNB LO frequency in Hz.
+ *
+ * A new mode gets the normal filter preset, or the passband of the change.
+ */
+std::vector<receiver::vfo_change> remote_to_vfo_changes(receiver *rx, qint64 lnb_lo,
+                                                        const RemoteVfoChanges &changes)
+{
+    std::vector<receiver::vfo_change> rx_changes;
+
+    for (auto &c : changes)
+    {
+        receiver::vfo_change rc;
+
+        rc.vfo = c.vfo;
+        switch (c.what)
+        {
+        case RemoteVfoChange::FREQ:
+            rc.what = receiver::vfo_change::OFFSET;
+            rc.value = c.freq - rx->get_rf_freq() - lnb_lo;
+            rx_changes.push_back(rc);
+            break;
+
+        case RemoteVfoChange::MODE:
+            rc.what = receiver::vfo_change::DEMOD;
+            rc.demod = c.mode;
+            rx_changes.push_back(rc);
+            rc.what = receiver::vfo_change::FILTER;
+            if (c.passband > 0)
+                passband_to_filter(c.mode, FILTER_PRESET_NORMAL, c.passband, rc.low, rc.high);
+            else
+                Modulations::GetFilterPreset(c.mode, FILTER_PRESET_NORMAL, rc.low, rc.high);
+            if (c.mode != Modulations::MODE_OFF)
+                rx_changes.push_back(rc);
+            break;
+
+        case RemoteVfoChange::SQL:
+            rc.what = receiver::vfo_change::SQL_LEVEL;
+            rc.value = c.squelch_level;
+            rx_changes.push_back(rc);
+            break;
+        }
+    }
+    return rx_changes;
+}
+
+/**
+ * @brief Get the gain stages of the input device.
+ * @param read_from_device If true, the gains are read from the device,
+ *                         otherwise they are set to the midpoint.
+ */
+gain_list_t read_gain_stages(receiver *rx, bool read_from_device)
+{
+    gain_list_t gain_list;
+    gain_t gain;
+
+    for (auto &name : rx->get_gain_names())
+    {
+        gain.name = name;
+        rx->get_gain_range(gain.name, &gain.start, &gain.stop, &gain.step);
+        if (read_from_device)
+        {
+            gain.value = rx->get_gain(gain.name);
+        }
+        else
+        {
+            gain.value = (gain.start + gain.stop) / 2;
+            rx->set_gain(gain.name, gain.value);
+        }
+        gain_list.push_back(gain);
+    }
+    return gain_list;
+}
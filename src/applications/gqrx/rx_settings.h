@@ -0,0 +1,42 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef RX_SETTINGS_H
+#define RX_SETTINGS_H
+
+#include <vector>
+#include <QSettings>
+#include "receiver.h"
+#include "remote_control.h"
+
+/*
+ * Settings shared by the GUI and gqrx-headless. They only touch the
+ * receiver, the GUI is updated from the receiver afterwards.
+ */
+
+void read_vfo_settings(QSettings *settings, receiver *rx, int ver, double actual_rate);
+void passband_to_filter(Modulations::idx mode, int preset, int bandwidth, int &lo, int &hi);
+std::vector<receiver::vfo_change> remote_to_vfo_changes(receiver *rx, qint64 lnb_lo,
+                                                        const RemoteVfoChanges &changes);
+gain_list_t read_gain_stages(receiver *rx, bool read_from_device);
+
+#endif // RX_SETTINGS_H
@@ -0,0 +1,974 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Batch demodulator for recorded I/Q files.
+ *
+ * Demodulates a list of VFOs, taken from a bookmarks file or from the
+ * command line, over a whole recording and writes one WAV file per VFO.
+ *
+ * The recording is cut into segments, that are demodulated by independent
+ * flowgraphs, several of them at once. Every segment is read with some
+ * overlap before and after it, so that the filters, AGC and PLLs have
+ * settled at its start and the audio delayed by the filters is complete at
+ * its end. The audio of the overlap is dropped and every segment writes its
+ * audio straight to its place in the WAV files, so the output needs no
+ * stitching pass and the memory use does not grow with the recording.
+ *
+ * Segment boundaries are put on sample positions, that map to whole audio
+ * samples, so the segments join without a timing step.
+ */
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include <gnuradio/io_signature.h>
+#include <gnuradio/sync_block.h>
+#include <gnuradio/top_block.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "dsp/format_converter.h"
+#include "interfaces/chunked_iq.h"
+#include "interfaces/file_source.h"
+#include "receivers/modulations.h"
+#include "receivers/nbrx.h"
+#include "receivers/vfo.h"
+#include "receivers/wfmrx.h"
+
+#define WAV_HEADER_SIZE 44
+
+namespace
+{
+
+/* The recording and what is known about it. */
+struct input_file
+{
+    QString      filename;
+    file_formats fmt{FILE_FORMAT_NONE};
+    double       rate{0.0};
+    qint64       center{0};
+    bool         center_ok{false};
+    uint64_t     samples{0};
+};
+
+/* VFO to demodulate and its WAV file. */
+struct vfo_plan
+{
+    qint64      freq;
+    QString     name;
+    vfo_s::sptr settings;
+    QString     wav_file;
+    int         fd{-1};    /*!< Open WAV file, shared by all segments. */
+    uint64_t    frames;    /*!< Audio frames written so far. */
+};
+
+/* Part of the recording, that is demodulated by one flowgraph (in samples). */
+struct segment
+{
+    uint64_t read_start;   /*!< First sample read, including the overlap. */
+    uint64_t read_end;
+    uint64_t start;        /*!< First sample, whose audio is kept. */
+    uint64_t end;
+};
+
+uint64_t gcd(uint64_t a, uint64_t b)
+{
+    while (b)
+    {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+void put_le(uint8_t *&p, uint32_t v, int bytes)
+{
+    for (int k = 0; k < bytes; k++, v >>= 8)
+        *p++ = uint8_t(v & 0xff);
+}
+
+#ifdef _MSC_VER
+/* No pwrite(), the segments take turns on the file position. */
+bool write_at(int fd, const void * data, size_t len, uint64_t offset)
+{
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return (_lseeki64(fd, offset, SEEK_SET) == (__int64)offset) &&
+           (_write(fd, data, (unsigned int)len) == (int)len);
+}
+#else
+/* Write at a position without moving the file offset, safe from any thread. */
+bool write_at(int fd, const void * data, size_t len, uint64_t offset)
+{
+    const char * p = (const char *) data;
+
+    while (len > 0)
+    {
+        ssize_t n = pwrite(fd, p, len, off_t(offset));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= size_t(n);
+        offset += uint64_t(n);
+    }
+    return true;
+}
+#endif
+
+/* 16 bit PCM header, the sizes saturate for recordings over 4 GiB. */
+bool write_wav_header(int fd, int rate, int channels, uint64_t frames)
+{
+    const uint64_t data = std::min<uint64_t>(frames * channels * 2, 0xffffffffull - 36);
+    uint8_t h[WAV_HEADER_SIZE];
+    uint8_t * p = h;
+
+    memcpy(p, "RIFF", 4);
+    p += 4;
+    put_le(p, uint32_t(data + 36), 4);
+    memcpy(p, "WAVEfmt ", 8);
+    p += 8;
+    put_le(p, 16, 4);
+    put_le(p, 1, 2);                    // PCM
+    put_le(p, channels, 2);
+    put_le(p, rate, 4);
+    put_le(p, rate * channels * 2, 4);  // byte rate
+    put_le(p, channels * 2, 2);         // block align
+    put_le(p, 16, 2);
+    memcpy(p, "data", 4);
+    p += 4;
+    put_le(p, uint32_t(data), 4);
+
+    return write_at(fd, h, sizeof(h), 0);
+}
+
+/*
+ * Audio sink, that writes one VFO over one segment to its place in the WAV
+ * file. The audio of the overlap with the neighbouring segments is dropped.
+ * The file is opened once by main() and shared by the sinks of all
+ * segments, they write disjoint ranges with write_at().
+ */
+class segment_wav_sink : public gr::sync_block
+{
+public:
+#if GNURADIO_VERSION < 0x030900
+    typedef boost::shared_ptr<segment_wav_sink> sptr;
+#else
+    typedef std::shared_ptr<segment_wav_sink> sptr;
+#endif
+
+    /*!
+     * \param skip Audio frames to drop at the start.
+     * \param first Frame in the file, where the kept audio goes.
+     * \param frames Frames to keep.
+     */
+    static sptr make(const std::string &filename, int fd, int channels,
+                     uint64_t skip, uint64_t first, uint64_t frames)
+    {
+        return gnuradio::get_initial_sptr(new segment_wav_sink(filename, fd, channels,
+                                                               skip, first, frames));
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items) override
+    {
+        (void) output_items;
+        const float * l = (const float *) input_items[0];
+        const float * r = (const float *) input_items[1];
+        const uint64_t pos = d_pos;
+
+        d_pos += noutput_items;
+        const uint64_t from = std::max(pos, d_skip);
+        const uint64_t to = std::min(d_pos, d_skip + d_frames);
+        if (!d_ok || from >= to)
+            return noutput_items;
+
+        d_pcm.resize((to - from) * d_channels * 2);
+        uint8_t * p = d_pcm.data();
+        for (uint64_t n = from; n < to; n++)
+        {
+            const size_t k = n - pos;
+            if (d_channels == 1)
+                put_sample(p, 0.5f * (l[k] + r[k]));
+            else
+            {
+                put_sample(p, l[k]);
+                put_sample(p, r[k]);
+            }
+        }
+
+        const uint64_t offset = WAV_HEADER_SIZE + (d_first + from - d_skip) * d_channels * 2;
+        if (!write_at(d_fd, d_pcm.data(), d_pcm.size(), offset))
+        {
+            std::cerr << "Write error: " << d_filename << ": " << strerror(errno) << std::endl;
+            d_ok = false;
+            return noutput_items;
+        }
+        d_written = to - d_skip;
+        return noutput_items;
+    }
+
+    bool ok() const { return d_ok; }
+    uint64_t written() const { return d_written; }
+
+private:
+    segment_wav_sink(const std::string &filename, int fd, int channels,
+                     uint64_t skip, uint64_t first, uint64_t frames)
+        : gr::sync_block("segment_wav_sink",
+                         gr::io_signature::make(2, 2, sizeof(float)),
+                         gr::io_signature::make(0, 0, 0)),
+          d_filename(filename),
+          d_fd(fd),
+          d_channels(channels),
+          d_skip(skip),
+          d_first(first),
+          d_frames(frames)
+    {
+    }
+
+    static void put_sample(uint8_t *&p, float v)
+    {
+        int16_t s = int16_t(lrintf(std::max(-1.f, std::min(1.f, v)) * 32767.f));
+        put_le(p, uint16_t(s), 2);
+    }
+
+    std::string          d_filename;
+    int                  d_fd;          /*!< Owned by main(). */
+    bool                 d_ok{true};
+    int                  d_channels;
+    uint64_t             d_skip;
+    uint64_t             d_first;
+    uint64_t             d_frames;
+    uint64_t             d_pos{0};      /*!< Frames received. */
+    uint64_t             d_written{0};  /*!< Frames written. */
+    std::vector<uint8_t> d_pcm;
+};
+
+/* Converter to gr_complex, the same as receiver::convert_from. */
+any_to_any_base::sptr make_converter(file_formats fmt)
+{
+    switch (fmt)
+    {
+    case FILE_FORMAT_CS8:    return any_to_any<std::complex<int8_t>,gr_complex>::make();
+    case FILE_FORMAT_CS16L:  return any_to_any<std::complex<int16_t>,gr_complex>::make();
+    case FILE_FORMAT_CS32L:  return any_to_any<std::complex<int32_t>,gr_complex>::make();
+    case FILE_FORMAT_CS8U:   return any_to_any<std::complex<uint8_t>,gr_complex>::make();
+    case FILE_FORMAT_CS16LU: return any_to_any<std::complex<uint16_t>,gr_complex>::make();
+    case FILE_FORMAT_CS32LU: return any_to_any<std::complex<uint32_t>,gr_complex>::make();
+    case FILE_FORMAT_CS10L:  return any_to_any<std::array<int8_t,40>,gr_complex>::make();
+    case FILE_FORMAT_CS12L:  return any_to_any<std::array<int8_t,24>,gr_complex>::make();
+    case FILE_FORMAT_CS14L:  return any_to_any<std::array<int8_t,56>,gr_complex>::make();
+    case FILE_FORMAT_S8:     return any_to_any<int8_t,gr_complex>::make();
+    case FILE_FORMAT_S16L:   return any_to_any<int16_t,gr_complex>::make();
+    case FILE_FORMAT_S10L:   return any_to_any<std::array<int16_t,20>,gr_complex>::make();
+    case FILE_FORMAT_S12L:   return any_to_any<std::array<int16_t,12>,gr_complex>::make();
+    case FILE_FORMAT_S14L:   return any_to_any<std::array<int16_t,28>,gr_complex>::make();
+    case FILE_FORMAT_CS16Z:  return any_to_any<std::complex<int16_t>,gr_complex>::make();
+    default:                 return nullptr;
+    }
+}
+
+file_formats parse_format(const QString &str, bool is_filename)
+{
+    file_formats best = FILE_FORMAT_NONE;
+    int best_len = 0;
+    for (int k = FILE_FORMAT_CF; k < FILE_FORMAT_COUNT; k++)
+    {
+        const char * suffix = any_to_any_base::fmt[k].suffix;
+        if (!suffix)
+            continue;
+        QString s(suffix);
+        bool match = is_filename ? str.endsWith(s) :
+                     (str == s || str + ".raw" == s || str == any_to_any_base::fmt[k].name);
+        if (match && s.length() > best_len)
+        {
+            best = file_formats(k);
+            best_len = s.length();
+        }
+    }
+    return best;
+}
+
+/* Sample rate and frequency from a name like CIqTool writes it. */
+void parse_file_name(const QString &filename, input_file &in)
+{
+    // gqrx_yyyyMMdd_hhmmss_freq_samprate_fc.raw
+    QStringList list = QFileInfo(filename).fileName().split('_');
+    bool ok;
+
+    if (list.size() < 6 || list.at(0) != "gqrx")
+        return;
+    qint64 center = list.at(3).toLongLong(&ok);
+    if (ok)
+    {
+        in.center = center;
+        in.center_ok = true;
+    }
+    qint64 rate = list.at(4).toLongLong(&ok);
+    if (ok && rate > 0)
+        in.rate = double(rate);
+}
+
+/* Sample format, rate and frequency from the SigMF metadata. */
+bool read_sigmf_meta(const QString &filename, input_file &in)
+{
+    static const std::map<QString, file_formats> types = {
+        {"cf32_le", FILE_FORMAT_SIGMF},
+        {"ci32_le", FILE_FORMAT_CS32L},
+        {"ci16_le", FILE_FORMAT_CS16L},
+        {"ci8",     FILE_FORMAT_CS8},
+        {"cu32_le", FILE_FORMAT_CS32LU},
+        {"cu16_le", FILE_FORMAT_CS16LU},
+        {"cu8",     FILE_FORMAT_CS8U},
+    };
+    QFile file(filename);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        std::cerr << "Can not read " << filename.toStdString() << std::endl;
+        return false;
+    }
+    QJsonObject meta = QJsonDocument::fromJson(file.readAll()).object();
+    QJsonObject global = meta["global"].toObject();
+    QString type = global["core:datatype"].toString();
+    auto it = types.find(type);
+    if (it == types.end())
+    {
+        std::cerr << "Unsupported SigMF data type \"" << type.toStdString() << "\"" << std::endl;
+        return false;
+    }
+    in.fmt = it->second;
+    if (global.contains("core:sample_rate"))
+        in.rate = global["core:sample_rate"].toDouble();
+    QJsonArray captures = meta["captures"].toArray();
+    if (!captures.isEmpty() && captures[0].toObject().contains("core:frequency"))
+    {
+        in.center = qint64(captures[0].toObject()["core:frequency"].toDouble());
+        in.center_ok = true;
+    }
+    return true;
+}
+
+/* Rows of a ';' separated file with '"' quoted fields, as CommaSeparated writes it. */
+std::vector<QStringList> read_csv(const QString &filename, bool &ok)
+{
+    std::vector<QStringList> rows;
+    QFile file(filename);
+
+    ok = file.open(QIODevice::ReadOnly | QIODevice::Text);
+    if (!ok)
+        return rows;
+
+    const QString text = QString::fromUtf8(file.readAll());
+    QStringList row;
+    QString field;
+    bool quoted = false;
+    for (int k = 0; k < text.size(); k++)
+    {
+        const QChar c = text[k];
+        if (quoted)
+        {
+            if (c != '"')
+                field += c;
+            else if (k + 1 < text.size() && text[k + 1] == '"')
+                field += text[++k];
+            else
+                quoted = false;
+        }
+        else if (c == '"')
+            quoted = true;
+        else if (c == ';')
+        {
+            row.append(field);
+            field.clear();
+        }
+        else if (c == '\n')
+        {
+            row.append(field);
+            field.clear();
+            rows.push_back(row);
+            row.clear();
+        }
+        else
+            field += c;
+    }
+    if (!field.isEmpty() || !row.isEmpty())
+    {
+        row.append(field);
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+typedef std::function<void(vfo_s &, const QString &)> column_setter;
+
+/* The columns of bookmarks.csv, that affect the demodulation. */
+const std::map<QString, column_setter> &bookmark_columns()
+{
+    static const std::map<QString, column_setter> columns = {
+        {"Modulation", [](vfo_s &v, const QString &s) {
+            v.set_demod(Modulations::GetEnumForModulationString(s.toStdString())); }},
+        {"Filter Low", [](vfo_s &v, const QString &s) { v.set_filter_low(s.toInt()); }},
+        {"Filter High", [](vfo_s &v, const QString &s) { v.set_filter_high(s.toInt()); }},
+        {"Filter TW", [](vfo_s &v, const QString &s) { v.set_filter_tw(s.toInt()); }},
+        {"AGC On", [](vfo_s &v, const QString &s) { v.set_agc_on(s == "true"); }},
+        {"AGC Target Level", [](vfo_s &v, const QString &s) { v.set_agc_target_level(s.toInt()); }},
+        {"AGC Manual Gain", [](vfo_s &v, const QString &s) { v.set_agc_manual_gain(s.toFloat()); }},
+        {"AGC Max Gain", [](vfo_s &v, const QString &s) { v.set_agc_max_gain(s.toInt()); }},
+        {"AGC Attack", [](vfo_s &v, const QString &s) { v.set_agc_attack(s.toInt()); }},
+        {"AGC Decay", [](vfo_s &v, const QString &s) { v.set_agc_decay(s.toInt()); }},
+        {"AGC Hang", [](vfo_s &v, const QString &s) { v.set_agc_hang(s.toInt()); }},
+        {"Panning", [](vfo_s &v, const QString &s) { v.set_agc_panning(s.toInt()); }},
+        {"Auto Panning", [](vfo_s &v, const QString &s) { v.set_agc_panning_auto(s == "true"); }},
+        {"CW Offset", [](vfo_s &v, const QString &s) { v.set_cw_offset(s.toInt()); }},
+        {"FM Max Deviation", [](vfo_s &v, const QString &s) { v.set_fm_maxdev(s.toFloat()); }},
+        {"FM Deemphasis", [](vfo_s &v, const QString &s) { v.set_fm_deemph(s.toDouble()); }},
+        {"AM DCR", [](vfo_s &v, const QString &s) { v.set_am_dcr(s == "true"); }},
+        {"AM SYNC DCR", [](vfo_s &v, const QString &s) { v.set_amsync_dcr(s == "true"); }},
+        {"PLL BW", [](vfo_s &v, const QString &s) { v.set_pll_bw(s.toFloat()); }},
+        {"NB1 ON", [](vfo_s &v, const QString &s) { v.set_nb_on(1, s == "true"); }},
+        {"NB1 Threshold", [](vfo_s &v, const QString &s) { v.set_nb_threshold(1, s.toFloat()); }},
+        {"NB2 ON", [](vfo_s &v, const QString &s) { v.set_nb_on(2, s == "true"); }},
+        {"NB2 Threshold", [](vfo_s &v, const QString &s) { v.set_nb_threshold(2, s.toFloat()); }},
+    };
+    return columns;
+}
+
+/* Use the normal filter preset, if the filter was not set. */
+void finish_settings(vfo_s &v)
+{
+    int low, high;
+
+    if (v.get_filter_low() != v.get_filter_high())
+        v.filter_adjust();
+    else if (Modulations::GetFilterPreset(v.get_demod(), FILTER_PRESET_NORMAL, low, high))
+        v.set_filter(low, high, Modulations::TwFromFilterShape(low, high, Modulations::FILTER_SHAPE_NORMAL));
+}
+
+/* Bookmarks with one of the tags (all bookmarks, if tags is empty). */
+bool read_bookmarks(const QString &filename, const QStringList &tags,
+                    Modulations::idx default_mode, std::vector<vfo_plan> &plan)
+{
+    bool ok;
+    std::vector<QStringList> rows = read_csv(filename, ok);
+
+    if (!ok || rows.empty())
+    {
+        std::cerr << "Can not read " << filename.toStdString() << std::endl;
+        return false;
+    }
+    const QStringList &header = rows[0];
+    const int freq_col = header.indexOf("Frequency");
+    const int name_col = header.indexOf("Name");
+    const int tags_col = header.indexOf("Tags");
+    if (freq_col < 0)
+    {
+        std::cerr << filename.toStdString() << " has no Frequency column." << std::endl;
+        return false;
+    }
+
+    const auto &columns = bookmark_columns();
+    for (size_t r = 1; r < rows.size(); r++)
+    {
+        const QStringList &row = rows[r];
+        if (row.size() != header.size())
+            continue;
+        if (!tags.isEmpty())
+        {
+            QStringList row_tags;
+            if (tags_col >= 0)
+                for (auto &t : row[tags_col].split(','))
+                    if (!t.trimmed().isEmpty())
+                        row_tags.append(t.trimmed());
+            if (row_tags.isEmpty())
+                row_tags.append("Untagged");
+            bool found = false;
+            for (auto &t : row_tags)
+                found = found || tags.contains(t);
+            if (!found)
+                continue;
+        }
+
+        vfo_s::sptr v = vfo_s::make();
+        v->set_demod(default_mode);
+        v->set_filter(0, 0, 0);
+        for (int k = 0; k < header.size(); k++)
+        {
+            auto it = columns.find(header[k]);
+            if (it != columns.end() && !row[k].isEmpty())
+                it->second(*v, row[k]);
+        }
+        finish_settings(*v);
+        plan.push_back({row[freq_col].toLongLong(), name_col >= 0 ? row[name_col] : QString(), v,
+                        QString(), -1, 0});
+    }
+    return true;
+}
+
+/* VFO given as freq[:mode[:low:high]]. */
+bool parse_vfo(const QString &spec, Modulations::idx default_mode, vfo_plan &vfo)
+{
+    QStringList parts = spec.split(':');
+    bool ok;
+
+    vfo.freq = qint64(parts[0].toDouble(&ok));
+    if (!ok || parts.size() > 4 || parts.size() == 3)
+        return false;
+    vfo.settings = vfo_s::make();
+    vfo.settings->set_demod(default_mode);
+    vfo.settings->set_filter(0, 0, 0);
+    vfo.frames = 0;
+    if (parts.size() > 1)
+    {
+        if (!Modulations::IsModulationValid(parts[1].toStdString()))
+            return false;
+        vfo.settings->set_demod(Modulations::GetEnumForModulationString(parts[1].toStdString()));
+    }
+    if (parts.size() == 4)
+    {
+        bool low_ok, high_ok;
+        vfo.settings->set_filter_low(parts[2].toInt(&low_ok));
+        vfo.settings->set_filter_high(parts[3].toInt(&high_ok));
+        if (!low_ok || !high_ok)
+            return false;
+    }
+    finish_settings(*vfo.settings);
+    return true;
+}
+
+bool is_wfm(Modulations::idx mode)
+{
+    return (mode == Modulations::MODE_WFM_MONO) ||
+           (mode == Modulations::MODE_WFM_STEREO) ||
+           (mode == Modulations::MODE_WFM_STEREO_OIRT);
+}
+
+QString sanitize(const QString &str)
+{
+    QString s = str;
+    s.replace(QRegularExpression("[^A-Za-z0-9.+-]+"), "_");
+    while (s.startsWith('_'))
+        s.remove(0, 1);
+    while (s.endsWith('_'))
+        s.chop(1);
+    return s;
+}
+
+/*
+ * Demodulate one segment on its own flowgraph.
+ * \param written Audio frames written per VFO.
+ */
+bool run_segment(const input_file &in, const segment &seg, const std::vector<vfo_plan> &plan,
+                 int audio_rate, int channels, std::vector<uint64_t> &written)
+{
+    const auto &f = any_to_any_base::fmt[in.fmt];
+    const uint64_t rate = uint64_t(llround(in.rate));
+    auto frame_at = [&](uint64_t sample) { return sample * audio_rate / rate; };
+    const uint64_t skip = frame_at(seg.start) - frame_at(seg.read_start);
+    const uint64_t first = frame_at(seg.start);
+    const uint64_t frames = frame_at(seg.end) - first;
+
+    gr::top_block_sptr tb = gr::make_top_block("gqrx_batch");
+    file_source::sptr src;
+    try
+    {
+        src = file_source::make(f.size, in.filename.toStdString().c_str(),
+                                seg.read_start / f.nsamples,
+                                (seg.read_end - seg.read_start) / f.nsamples,
+                                int(in.rate / f.nsamples), 0, false, 1);
+    }
+    catch (std::exception &x)
+    {
+        std::cerr << "Can not read " << in.filename.toStdString() << ": " << x.what() << std::endl;
+        return false;
+    }
+    src->set_realtime(false);
+
+    gr::basic_block_sptr iq = src;
+    any_to_any_base::sptr conv = make_converter(in.fmt);
+    if (conv)
+    {
+        tb->connect(src, 0, conv, 0);
+        iq = conv;
+    }
+
+    std::vector<segment_wav_sink::sptr> sinks;
+    for (auto &v : plan)
+    {
+        receiver_base_cf_sptr rxc;
+        if (is_wfm(v.settings->get_demod()))
+            rxc = make_wfmrx(in.rate, audio_rate);
+        else
+            rxc = make_nbrx(in.rate, audio_rate);
+        rxc->restore_settings(*v.settings);
+        rxc->set_offset(int(v.freq - in.center));
+        if (rxc->get_agc_panning_auto())
+            rxc->set_agc_panning(int((v.freq - in.center) * 200.0 / in.rate));
+
+        segment_wav_sink::sptr sink = segment_wav_sink::make(v.wav_file.toStdString(), v.fd,
+                                                             channels, skip, first, frames);
+        tb->connect(iq, 0, rxc, 0);
+        tb->connect(rxc, 0, sink, 0);
+        tb->connect(rxc, 1, sink, 1);
+        sinks.push_back(sink);
+    }
+
+    tb->run();
+
+    written.clear();
+    bool ok = true;
+    for (auto &sink : sinks)
+    {
+        ok = ok && sink->ok();
+        written.push_back(first + sink->written());
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("gqrx-batch");
+    QCoreApplication::setApplicationVersion(VERSION);
+    qputenv("GR_CONF_CONTROLPORT_ON", "False");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Gqrx batch demodulator for I/Q recordings " VERSION);
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("input", "I/Q file, raw or SigMF (.sigmf-data or .sigmf-meta)");
+    parser.addOptions({
+        {{"b", "bookmarks"}, "Demodulate the bookmarks in this file, that are inside the recording", "file"},
+        {{"t", "tags"}, "Only bookmarks with one of these comma separated tags", "tags"},
+        {{"v", "vfo"}, "Demodulate this VFO, can be repeated", "freq[:mode[:low:high]]"},
+        {{"m", "mode"}, "Demodulator of VFOs without one (default NFM)", "mode"},
+        {{"f", "freq"}, "Center frequency (default: from the metadata or file name)", "Hz"},
+        {{"r", "rate"}, "Input sample rate (default: from the metadata or file name)", "Hz"},
+        {"iq-format", "I/Q file format, e.g. fc, 16, 8u, 16z (default: from the file name)", "suffix"},
+        {{"o", "output"}, "Directory for the WAV files (default: the current one)", "dir"},
+        {{"a", "audio-rate"}, "Audio sample rate (default 48000)", "Hz"},
+        {"mono", "Write mono WAV files"},
+        {{"q", "squelch"}, "Squelch level of all VFOs (default: open)", "dBFS"},
+        {{"j", "jobs"}, "Segments to demodulate at once (default: number of CPUs)", "count"},
+        {"segment", "Segment length (default 60, shorter to keep all jobs busy)", "seconds"},
+        {"overlap", "Overlap with the neighbouring segments (default 1)", "seconds"},
+    });
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(2);
+    if (!parser.isSet("bookmarks") && !parser.isSet("vfo"))
+    {
+        std::cerr << "Either --bookmarks or --vfo is required." << std::endl;
+        return 2;
+    }
+
+    /* Input */
+    input_file in;
+    in.filename = parser.positionalArguments().at(0);
+    if (in.filename.endsWith(".sigmf-meta"))
+        in.filename.replace(in.filename.size() - 4, 4, "data");
+    if (in.filename.endsWith(".sigmf-data"))
+    {
+        QString meta = in.filename;
+        meta.replace(meta.size() - 4, 4, "meta");
+        if (!read_sigmf_meta(meta, in))
+            return 2;
+    }
+    else
+    {
+        parse_file_name(in.filename, in);
+        in.fmt = parse_format(in.filename, true);
+    }
+    if (parser.isSet("iq-format"))
+        in.fmt = parse_format(parser.value("iq-format"), false);
+    if (in.fmt == FILE_FORMAT_NONE)
+        in.fmt = FILE_FORMAT_CF;
+    if (parser.isSet("rate"))
+        in.rate = parser.value("rate").toDouble();
+    if (parser.isSet("freq"))
+    {
+        in.center = qint64(parser.value("freq").toDouble());
+        in.center_ok = true;
+    }
+    if (in.rate <= 0.0)
+    {
+        std::cerr << "Unknown sample rate, use --rate." << std::endl;
+        return 2;
+    }
+    if (!in.center_ok)
+    {
+        std::cerr << "Unknown center frequency, use --freq." << std::endl;
+        return 2;
+    }
+
+    const auto &f = any_to_any_base::fmt[in.fmt];
+    uint64_t items = 0;
+    if (!((f.size == int(chunked_iq::ITEM_SIZE)) &&
+          chunked_iq::probe(in.filename.toStdString(), &items)))
+        items = uint64_t(QFileInfo(in.filename).size()) / f.size;
+    in.samples = items * f.nsamples;
+    if (in.samples == 0)
+    {
+        std::cerr << "Can not read " << in.filename.toStdString() << std::endl;
+        return 2;
+    }
+
+    /* VFOs */
+    Modulations::idx default_mode = Modulations::MODE_NFM;
+    if (parser.isSet("mode"))
+    {
+        if (!Modulations::IsModulationValid(parser.value("mode").toStdString()))
+        {
+            std::cerr << "Unknown mode " << parser.value("mode").toStdString() << std::endl;
+            return 2;
+        }
+        default_mode = Modulations::GetEnumForModulationString(parser.value("mode").toStdString());
+    }
+
+    std::vector<vfo_plan> all;
+    if (parser.isSet("bookmarks"))
+    {
+#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
+        QStringList tags = parser.value("tags").split(',', QString::SkipEmptyParts);
+#else
+        QStringList tags = parser.value("tags").split(',', Qt::SkipEmptyParts);
+#endif
+        for (auto &t : tags)
+            t = t.trimmed();
+        if (!read_bookmarks(parser.value("bookmarks"), tags, default_mode, all))
+            return 2;
+    }
+    for (auto &spec : parser.values("vfo"))
+    {
+        vfo_plan v;
+        if (!parse_vfo(spec, default_mode, v))
+        {
+            std::cerr << "Invalid VFO " << spec.toStdString() << std::endl;
+            return 2;
+        }
+        all.push_back(v);
+    }
+
+    const double squelch = parser.isSet("squelch") ? parser.value("squelch").toDouble() : -150.0;
+    std::vector<vfo_plan> plan;
+    int outside = 0;
+    for (auto &v : all)
+    {
+        const double edge = std::abs(double(v.freq - in.center)) +
+                            std::max(std::abs(v.settings->get_filter_low()),
+                                     std::abs(v.settings->get_filter_high()));
+        if (v.settings->get_demod() == Modulations::MODE_OFF)
+            continue;
+        if (edge > in.rate / 2.0)
+        {
+            outside++;
+            continue;
+        }
+        v.settings->set_sql_level(squelch);
+        plan.push_back(v);
+    }
+    if (outside > 0)
+        std::cout << "Skipping " << outside << " VFOs outside of the recording." << std::endl;
+    if (plan.empty())
+    {
+        std::cerr << "No VFO inside of the recording ("
+                  << qint64(in.center - in.rate / 2) << " - " << qint64(in.center + in.rate / 2)
+                  << " Hz)." << std::endl;
+        return 2;
+    }
+
+    /* Output files */
+    const int audio_rate = parser.isSet("audio-rate") ? parser.value("audio-rate").toInt() : 48000;
+    const int channels = parser.isSet("mono") ? 1 : 2;
+    if (audio_rate <= 0)
+    {
+        std::cerr << "Invalid audio rate." << std::endl;
+        return 2;
+    }
+    QDir outdir(parser.isSet("output") ? parser.value("output") : QString("."));
+    if (!outdir.exists() && !outdir.mkpath("."))
+    {
+        std::cerr << "Can not create " << outdir.path().toStdString() << std::endl;
+        return 2;
+    }
+    QString base = QFileInfo(in.filename).completeBaseName();
+    if (base.endsWith(".sigmf"))
+        base.chop(6);
+    QSet<QString> used;
+    for (auto &v : plan)
+    {
+        QString label = sanitize(v.name.isEmpty() ?
+            QString(Modulations::GetStringForModulationIndex(v.settings->get_demod())) : v.name);
+        QString name = QString("%1_%2_%3").arg(base).arg(v.freq).arg(label);
+        QString unique = name;
+        for (int k = 2; used.contains(unique); k++)
+            unique = QString("%1_%2").arg(name).arg(k);
+        used.insert(unique);
+        v.wav_file = outdir.filePath(unique + ".wav");
+
+        // Open once for all segments, a descriptor per segment and VFO
+        // runs out of descriptors with many bookmarks
+#ifdef _MSC_VER
+        v.fd = _open(v.wav_file.toLocal8Bit().constData(),
+                     _O_RDWR | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        v.fd = open(v.wav_file.toLocal8Bit().constData(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+#endif
+        if (v.fd < 0 || !write_wav_header(v.fd, audio_rate, channels, 0))
+        {
+            std::cerr << "Can not create " << v.wav_file.toStdString() << std::endl;
+            return 2;
+        }
+    }
+
+    /* Segments on a grid of samples, that map to whole audio samples */
+    const uint64_t rate = uint64_t(llround(in.rate));
+    uint64_t grid = f.nsamples;
+    uint64_t step = rate / gcd(rate, uint64_t(audio_rate));
+    step = step / gcd(step, grid) * grid;
+    if (step <= rate)
+        grid = step;
+    auto to_grid = [&](double seconds) {
+        uint64_t s = uint64_t(std::max(0.0, seconds) * in.rate);
+        return std::max(grid, (s + grid - 1) / grid * grid);
+    };
+
+    int jobs = parser.isSet("jobs") ? parser.value("jobs").toInt() : int(std::thread::hardware_concurrency());
+    jobs = std::max(1, jobs);
+    const double duration = double(in.samples) / in.rate;
+    const double overlap_s = parser.isSet("overlap") ? parser.value("overlap").toDouble() : 1.0;
+    const uint64_t overlap = overlap_s > 0.0 ? to_grid(overlap_s) : 0;
+    uint64_t seg_len;
+    if (parser.isSet("segment"))
+        seg_len = to_grid(parser.value("segment").toDouble());
+    else
+        seg_len = std::min(to_grid(60.0),
+                           std::max(to_grid(std::max(10.0, 4.0 * overlap_s)), to_grid(duration / jobs)));
+
+    std::vector<segment> segments;
+    for (uint64_t s = 0; s < in.samples; s += seg_len)
+    {
+        segment seg;
+        seg.start = s;
+        seg.end = std::min(in.samples, s + seg_len);
+        seg.read_start = (s > overlap) ? s - overlap : 0;
+        seg.read_end = std::min(in.samples, seg.end + overlap);
+        segments.push_back(seg);
+    }
+    jobs = std::min(jobs, int(segments.size()));
+
+    std::printf("input:    %s (%s), %.0f Hz at %.0f sps, %.1f s\n",
+                in.filename.toStdString().c_str(), f.name, double(in.center), in.rate, duration);
+    std::printf("vfos:     %d\n", int(plan.size()));
+    std::printf("segments: %d of %.1f s, %d at once\n", int(segments.size()),
+                double(seg_len) / in.rate, jobs);
+
+    /* Demodulate */
+    std::mutex mutex;   // protects plan[].frames and the console
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    size_t done = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int j = 0; j < jobs; j++)
+        workers.emplace_back([&]() {
+            std::vector<uint64_t> written;
+            for (size_t k = next++; k < segments.size() && !failed; k = next++)
+            {
+                bool ok = run_segment(in, segments[k], plan, audio_rate, channels, written);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ok)
+                {
+                    failed = true;
+                    break;
+                }
+                for (size_t i = 0; i < plan.size(); i++)
+                    plan[i].frames = std::max(plan[i].frames, written[i]);
+                double seconds = std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - t0).count();
+                std::printf("segment %d/%d done, %.1f s\n", int(++done), int(segments.size()), seconds);
+                std::fflush(stdout);
+            }
+        });
+    for (auto &w : workers)
+        w.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    /* The sizes in the WAV headers */
+    int ret = failed ? 1 : 0;
+    for (auto &v : plan)
+    {
+        bool ok = write_wav_header(v.fd, audio_rate, channels, v.frames);
+#ifdef _MSC_VER
+        ok = (_close(v.fd) == 0) && ok;
+#else
+        ok = (close(v.fd) == 0) && ok;
+#endif
+        v.fd = -1;
+        if (!ok)
+        {
+            std::cerr << "Can not write " << v.wav_file.toStdString() << std::endl;
+            ret = 1;
+        }
+        std::printf("%s: %.1f s\n", v.wav_file.toStdString().c_str(), double(v.frames) / audio_rate);
+    }
+    std::printf("%.1f s of I/Q in %.1f s, %.1fx real time\n", duration, seconds,
+                seconds > 0.0 ? duration / seconds : 0.0);
+    return ret;
+}
@@ -0,0 +1,656 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Microbenchmarks for the hot DSP blocks and the I/Q format converters.
+ *
+ * Every benchmark processes synthetic signals and is repeated with 1, 2, 4...
+ * up to --threads independent instances running in parallel. The reported
+ * figures are:
+ *
+ *   samples/s      total input samples per second over all instances
+ *   cycles/sample  TSC cycles per input sample of one instance (x86 only)
+ *   scaling        samples/s relative to the single instance run
+ *
+ * Converters and the packed format kernels are called directly in a loop.
+ * Blocks run in a flowgraph: repeating vector source -> head -> block ->
+ * null sinks, so the numbers include the scheduler overhead, seen by the
+ * block in the receiver. fft_channelizer_cc/mt uses a single instance and
+ * scales the internal worker threads of the block instead.
+ */
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QRegularExpression>
+#include <QString>
+
+#if GNURADIO_VERSION < 0x030800
+#include <gnuradio/blocks/vector_source_c.h>
+#include <gnuradio/blocks/vector_source_f.h>
+#else
+#include <gnuradio/blocks/vector_source.h>
+#endif
+#include <gnuradio/blocks/head.h>
+#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/top_block.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define BENCH_HAVE_TSC 1
+#endif
+
+#include "dsp/filter/fir_decim.h"
+#include "dsp/format_converter.h"
+#include "dsp/format_converter_simd.h"
+#include "dsp/rx_agc_xx.h"
+#include "dsp/rx_fft.h"
+#include "dsp/rx_filter.h"
+#include "dsp/rx_noise_blanker_cc.h"
+#include "dsp/stereo_demod.h"
+#include "receivers/defines.h"
+
+namespace
+{
+
+/* Samples per converter call and length of the repeated source vectors. */
+constexpr size_t CHUNK = 65536;
+
+struct result
+{
+    std::string name;
+    int         threads;
+    int         instances;
+    uint64_t    samples;    // total over all instances
+    double      seconds;
+    double      cycles;     // TSC cycles, negative if not available
+    double      scaling;
+};
+
+struct options
+{
+    uint64_t nsamples{10000000};
+    int max_threads{1};
+    QRegularExpression filter;
+    bool list{false};
+};
+
+inline uint64_t tsc()
+{
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/* Wall clock and TSC interval around a run. */
+class stopwatch
+{
+public:
+    stopwatch() : d_t0(std::chrono::steady_clock::now()), d_c0(tsc()) {}
+
+    void stop(result &r) const
+    {
+        uint64_t c1 = tsc();
+        auto t1 = std::chrono::steady_clock::now();
+        r.seconds = std::chrono::duration<double>(t1 - d_t0).count();
+#ifdef BENCH_HAVE_TSC
+        r.cycles = double(c1 - d_c0);
+#else
+        (void)c1;
+        r.cycles = -1.0;
+#endif
+    }
+
+private:
+    std::chrono::steady_clock::time_point d_t0;
+    uint64_t d_c0;
+};
+
+/*
+ * Synthetic test signals. The seed is varied per instance so parallel
+ * instances do not process identical data.
+ */
+
+/* A few carriers, -40 dBFS noise and a short impulse every 4096 samples. */
+std::vector<gr_complex> make_iq_signal(size_t n, unsigned seed)
+{
+    std::vector<gr_complex> v(n);
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> noise(0.f, 0.01f);
+    const double w[] = {0.0123, -0.0871, 0.2113, 0.3733};
+    for (size_t k = 0; k < n; k++)
+    {
+        gr_complex s(noise(gen), noise(gen));
+        for (double f : w)
+            s += std::polar(0.15f, float(2.0 * M_PI * f * double(k)));
+        if (k % 4096 < 4)
+            s *= 5.f;
+        v[k] = s;
+    }
+    return v;
+}
+
+/* Stereo FM multiplex at WFM_PREF_QUAD_RATE: L+R, 19 kHz pilot, L-R on 38 kHz. */
+std::vector<float> make_mpx_signal(size_t n, unsigned seed)
+{
+    std::vector<float> v(n);
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> noise(0.f, 0.001f);
+    const double rate = WFM_PREF_QUAD_RATE;
+    for (size_t k = 0; k < n; k++)
+    {
+        double t = double(k) / rate;
+        double l = std::sin(2.0 * M_PI * 1000.0 * t);
+        double r = std::sin(2.0 * M_PI * 2500.0 * t);
+        double mpx = 0.4 * (l + r) + 0.1 * std::cos(2.0 * M_PI * 19000.0 * t)
+                   + 0.4 * (l - r) * std::cos(2.0 * M_PI * 38000.0 * t);
+        v[k] = float(mpx) + noise(gen);
+    }
+    return v;
+}
+
+/* Demodulated audio with a slowly varying envelope for the AGC. */
+std::vector<float> make_audio_signal(size_t n, unsigned seed)
+{
+    std::vector<float> v(n);
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> noise(0.f, 0.001f);
+    for (size_t k = 0; k < n; k++)
+    {
+        double t = double(k) / 48000.0;
+        double env = 0.5 + 0.45 * std::sin(2.0 * M_PI * 0.7 * t);
+        v[k] = float(env * std::sin(2.0 * M_PI * 700.0 * t)) + noise(gen);
+    }
+    return v;
+}
+
+std::vector<int> thread_counts(int max_threads)
+{
+    std::vector<int> n;
+    for (int k = 1; k < max_threads; k *= 2)
+        n.push_back(k);
+    n.push_back(max_threads);
+    return n;
+}
+
+/* Releases the benchmark threads together, once all of them are set up. */
+struct start_gate
+{
+    std::atomic<int>  ready{0};
+    std::atomic<bool> go{false};
+
+    void wait()
+    {
+        ready++;
+        while (!go)
+            std::this_thread::yield();
+    }
+};
+
+/*
+ * Run fn(instance, gate) on nthreads threads at once and time the whole run.
+ * fn sets up its buffers, calls gate.wait() and runs the benchmark loop.
+ */
+result run_parallel(int nthreads, uint64_t samples_per_thread,
+                    const std::function<void(int, start_gate &)> &fn)
+{
+    result r{"", nthreads, nthreads, samples_per_thread * uint64_t(nthreads), 0.0, 0.0, 1.0};
+    start_gate gate;
+    std::vector<std::thread> threads;
+    for (int k = 0; k < nthreads; k++)
+        threads.emplace_back([&, k]() { fn(k, gate); });
+    while (gate.ready < nthreads)
+        std::this_thread::yield();
+    stopwatch sw;
+    gate.go = true;
+    for (auto &t : threads)
+        t.join();
+    sw.stop(r);
+    return r;
+}
+
+/*
+ * Format converters, called through any_to_any_base::convert(), as the file
+ * source and sink do. The sample count is the number of complex samples on
+ * the gr_complex side of the converter. Without threads only the name is
+ * set.
+ */
+template <typename T_IN, typename T_OUT>
+result bench_converter(int nthreads, uint64_t nsamples, std::string &name)
+{
+    name = "any_to_any/" + any_to_any<T_IN, T_OUT>::make()->name();
+    if (nthreads == 0)
+        return result{name, 0, 0, 0, 0.0, -1.0, 0.0};
+    const uint64_t ncalls = std::max<uint64_t>(1, nsamples / CHUNK);
+    return run_parallel(nthreads, ncalls * CHUNK,
+                        [ncalls](int instance, start_gate &gate) {
+        any_to_any_base::sptr conv = any_to_any<T_IN, T_OUT>::make();
+        const int dec = conv->decimation();
+        const int interp = conv->interpolation();
+        const int noutput = std::is_same<T_OUT, gr_complex>::value ?
+                            int(CHUNK) : int(CHUNK) * interp / dec;
+        const int ninput = noutput * dec / interp;
+
+        std::vector<T_IN> in(ninput);
+        std::vector<T_OUT> out(noutput);
+        if (std::is_same<T_IN, gr_complex>::value)
+        {
+            std::vector<gr_complex> s = make_iq_signal(ninput, instance);
+            memcpy(in.data(), s.data(), ninput * sizeof(T_IN));
+        }
+        else
+        {
+            std::mt19937 gen(instance);
+            uint8_t *p = (uint8_t *)in.data();
+            for (size_t k = 0; k < ninput * sizeof(T_IN); k++)
+                p[k] = gen();
+        }
+        gate.wait();
+        for (uint64_t k = 0; k < ncalls; k++)
+            conv->convert(in.data(), out.data(), noutput);
+    });
+}
+
+typedef std::function<result(int, uint64_t, std::string &)> converter_fn;
+
+std::vector<converter_fn> converter_benches()
+{
+    return {
+        bench_converter<gr_complex, gr_complex>,
+        bench_converter<gr_complex, std::complex<int32_t>>,
+        bench_converter<std::complex<int32_t>, gr_complex>,
+        bench_converter<gr_complex, std::complex<uint32_t>>,
+        bench_converter<std::complex<uint32_t>, gr_complex>,
+        bench_converter<gr_complex, std::complex<int16_t>>,
+        bench_converter<std::complex<int16_t>, gr_complex>,
+        bench_converter<gr_complex, std::complex<uint16_t>>,
+        bench_converter<std::complex<uint16_t>, gr_complex>,
+        bench_converter<gr_complex, std::complex<int8_t>>,
+        bench_converter<std::complex<int8_t>, gr_complex>,
+        bench_converter<gr_complex, std::complex<uint8_t>>,
+        bench_converter<std::complex<uint8_t>, gr_complex>,
+        bench_converter<gr_complex, std::array<int8_t,40>>,
+        bench_converter<std::array<int8_t,40>, gr_complex>,
+        bench_converter<gr_complex, std::array<int8_t,24>>,
+        bench_converter<std::array<int8_t,24>, gr_complex>,
+        bench_converter<gr_complex, std::array<int8_t,56>>,
+        bench_converter<std::array<int8_t,56>, gr_complex>,
+        bench_converter<gr_complex, int8_t>,
+        bench_converter<int8_t, gr_complex>,
+        bench_converter<gr_complex, int16_t>,
+        bench_converter<int16_t, gr_complex>,
+        bench_converter<gr_complex, std::array<int16_t,20>>,
+        bench_converter<std::array<int16_t,20>, gr_complex>,
+        bench_converter<gr_complex, std::array<int16_t,12>>,
+        bench_converter<std::array<int16_t,12>, gr_complex>,
+        bench_converter<gr_complex, std::array<int16_t,28>>,
+        bench_converter<std::array<int16_t,28>, gr_complex>,
+    };
+}
+
+/*
+ * Packed format kernels for every instruction set, this CPU supports,
+ * independent of the GQRX_SIMD selection used by the converters above.
+ */
+result bench_packed(packed_simd::isa level, int bits, bool cplx, bool unpack,
+                    int nthreads, uint64_t nsamples)
+{
+    const uint64_t ncalls = std::max<uint64_t>(1, nsamples / CHUNK);
+    return run_parallel(nthreads, ncalls * CHUNK,
+                        [=](int instance, start_gate &gate) {
+        packed_simd::kernels k = packed_simd::get(level);
+        const size_t nvalues = CHUNK * (cplx ? 2 : 1);
+        std::vector<uint8_t> packed(nvalues * bits / 8);
+        std::vector<gr_complex> samples = make_iq_signal(CHUNK, instance);
+        k.pack(bits, cplx, (const float *)samples.data(), packed.data(), nvalues,
+               float(1 << (bits - 1)) * 0.9f);
+        gate.wait();
+        for (uint64_t n = 0; n < ncalls; n++)
+        {
+            if (unpack)
+                k.unpack(bits, cplx, packed.data(), (float *)samples.data(), nvalues,
+                         1.f / float(1 << (bits - 1)));
+            else
+                k.pack(bits, cplx, (const float *)samples.data(), packed.data(), nvalues,
+                       float(1 << (bits - 1)));
+        }
+    });
+}
+
+/*
+ * Block benchmarks. build() adds one instance to the flowgraph: the source
+ * vector is repeated until the head block has passed nsamples samples.
+ */
+struct block_bench
+{
+    std::string name;
+    std::function<void(gr::top_block_sptr, int instance, uint64_t nsamples)> build;
+};
+
+gr::basic_block_sptr make_source(const std::vector<gr_complex> &v)
+{
+    return gr::blocks::vector_source_c::make(v, true);
+}
+
+gr::basic_block_sptr make_source(const std::vector<float> &v)
+{
+    return gr::blocks::vector_source_f::make(v, true);
+}
+
+/* source -> head -> all inputs of blk, every output of blk -> null sink */
+template <typename T>
+void connect_chain(gr::top_block_sptr tb, const std::vector<T> &signal, uint64_t nsamples,
+                   gr::basic_block_sptr blk, int ninputs, int noutputs, size_t out_size)
+{
+    gr::basic_block_sptr src = make_source(signal);
+    gr::basic_block_sptr head = gr::blocks::head::make(sizeof(T), nsamples);
+    tb->connect(src, 0, head, 0);
+    for (int k = 0; k < ninputs; k++)
+        tb->connect(head, 0, blk, k);
+    for (int k = 0; k < noutputs; k++)
+        tb->connect(blk, k, gr::blocks::null_sink::make(out_size), 0);
+}
+
+std::vector<block_bench> block_benches()
+{
+    std::vector<block_bench> b;
+
+    b.push_back({"fft_channelizer_cc", [](gr::top_block_sptr tb, int i, uint64_t n) {
+        fft_channelizer_cc::sptr chan = fft_channelizer_cc::make(8*4, 4, gr::fft::window::WIN_KAISER, 1);
+        for (int k = 0; k < 4; k++)
+            chan->map_output(k, k * 5);
+        connect_chain(tb, make_iq_signal(CHUNK, i), n, chan, 1, 4, sizeof(gr_complex));
+    }});
+    b.push_back({"rx_agc_2f", [](gr::top_block_sptr tb, int i, uint64_t n) {
+        rx_agc_2f_sptr agc = make_rx_agc_2f(48000.0, true, 0, 0, 100, 20, 500, 0, 0);
+        connect_chain(tb, make_audio_signal(CHUNK, i), n, agc, 2, 4, sizeof(float));
+    }});
+    b.push_back({"rx_nb_cc", [](gr::top_block_sptr tb, int i, uint64_t n) {
+        rx_nb_cc_sptr nb = make_rx_nb_cc((double)NB_PREF_QUAD_RATE, 3.3, 2.5);
+        nb->set_nb1_on(true);
+        nb->set_nb2_on(true);
+        connect_chain(tb, make_iq_signal(CHUNK, i), n, nb, 1, 1, sizeof(gr_complex));
+    }});
+    b.push_back({"rx_filter/nfm", [](gr::top_block_sptr tb, int i, uint64_t n) {
+        rx_filter_sptr filter = make_rx_filter((double)NB_PREF_QUAD_RATE, -5000.0, 5000.0, 1000.0);
+        connect_chain(tb, make_iq_signal(CHUNK, i), n, filter, 1, 1, sizeof(gr_complex));
+    }});
+    b.push_back({"rx_filter/wfm", [](gr::top_block_sptr tb, int i, uint64_t n) {
+        rx_filter_sptr filter = make_rx_filter((double)WFM_PREF_QUAD_RATE, -80000.0, 80000.0, 20000.0);
+        connect_chain(tb, make_iq_signal(CHUNK, i), n, filter, 1, 1, sizeof(gr_complex));
+    }});
+    for (unsigned decim : {2u, 4u, 8u, 16u, 32u, 64u, 128u, 256u})
+        b.push_back({"fir_decim_cc/" + std::to_string(decim),
+                     [decim](gr::top_block_sptr tb, int i, uint64_t n) {
+            fir_decim_cc_sptr fir = make_fir_decim_cc(decim);
+            connect_chain(tb, make_iq_signal(CHUNK, i), n, fir, 1, 1, sizeof(gr_complex));
+        }});
+    b.push_back({"stereo_demod/stereo", [](gr::top_block_sptr tb, int i, uint64_t n) {
+        stereo_demod_sptr demod = make_stereo_demod(WFM_PREF_QUAD_RATE, 48000.f, true);
+        connect_chain(tb, make_mpx_signal(CHUNK, i), n, demod, 1, 2, sizeof(float));
+    }});
+    b.push_back({"stereo_demod/mono", [](gr::top_block_sptr tb, int i, uint64_t n) {
+        stereo_demod_sptr demod = make_stereo_demod(WFM_PREF_QUAD_RATE, 48000.f, false);
+        connect_chain(tb, make_mpx_signal(CHUNK, i), n, demod, 1, 2, sizeof(float));
+    }});
+    return b;
+}
+
+result run_flowgraph(int instances, uint64_t nsamples,
+                     const std::function<void(gr::top_block_sptr, int)> &build)
+{
+    result r{"", instances, instances, nsamples * uint64_t(instances), 0.0, 0.0, 1.0};
+    gr::top_block_sptr tb = gr::make_top_block("gqrx_bench");
+    for (int k = 0; k < instances; k++)
+        build(tb, k);
+    stopwatch sw;
+    tb->run();
+    sw.stop(r);
+    return r;
+}
+
+/*
+ * Output
+ */
+void print_header(const QString &format, const options &opt)
+{
+    const char *simd = packed_simd::isa_name(packed_simd::get().level);
+    if (format == "json")
+    {
+        std::printf("{\n  \"version\": \"%s\",\n  \"simd\": \"%s\",\n"
+                    "  \"hardware_threads\": %u,\n  \"samples\": %llu,\n"
+                    "  \"results\": [",
+                    VERSION, simd, std::thread::hardware_concurrency(),
+                    (unsigned long long)opt.nsamples);
+    }
+    else if (format == "csv")
+    {
+        std::printf("name,threads,samples,seconds,samples_per_sec,cycles_per_sample,scaling\n");
+    }
+    else
+    {
+        std::printf("gqrx_bench %s  simd: %s  hardware threads: %u\n\n", VERSION, simd,
+                    std::thread::hardware_concurrency());
+        std::printf("%-36s %7s %14s %12s %14s %8s\n", "benchmark", "threads",
+                    "samples/s", "ns/sample", "cycles/sample", "scaling");
+    }
+}
+
+void print_result(const QString &format, const result &r, bool first)
+{
+    const double rate = r.seconds > 0.0 ? double(r.samples) / r.seconds : 0.0;
+    // each instance processed samples / instances samples in the interval
+    const double cps = r.cycles >= 0.0 && r.samples ?
+                       r.cycles * r.instances / double(r.samples) : -1.0;
+    if (format == "json")
+    {
+        std::printf("%s\n    {\"name\": \"%s\", \"threads\": %d, \"samples\": %llu, "
+                    "\"seconds\": %.6f, \"samples_per_sec\": %.1f, "
+                    "\"cycles_per_sample\": ",
+                    first ? "" : ",", r.name.c_str(), r.threads,
+                    (unsigned long long)r.samples, r.seconds, rate);
+        if (cps >= 0.0)
+            std::printf("%.3f", cps);
+        else
+            std::printf("null");
+        std::printf(", \"scaling\": %.3f}", r.scaling);
+    }
+    else if (format == "csv")
+    {
+        std::printf("%s,%d,%llu,%.6f,%.1f,", r.name.c_str(), r.threads,
+                    (unsigned long long)r.samples, r.seconds, rate);
+        if (cps >= 0.0)
+            std::printf("%.3f", cps);
+        std::printf(",%.3f\n", r.scaling);
+    }
+    else
+    {
+        char cbuf[32] = "-";
+        if (cps >= 0.0)
+            std::snprintf(cbuf, sizeof(cbuf), "%.2f", cps);
+        std::printf("%-36s %7d %14.4g %12.3f %14s %8.2f\n", r.name.c_str(), r.threads,
+                    rate, rate > 0.0 ? 1e9 * r.threads / rate : 0.0, cbuf, r.scaling);
+    }
+    std::fflush(stdout);
+}
+
+void print_footer(const QString &format)
+{
+    if (format == "json")
+        std::printf("\n  ]\n}\n");
+}
+
+class reporter
+{
+public:
+    reporter(const QString &format, const options &opt) : d_format(format), d_opt(opt) {}
+
+    bool wanted(const std::string &name) const
+    {
+        return d_opt.filter.match(QString::fromStdString(name)).hasMatch();
+    }
+
+    /* Run bench for every thread count and print the results. */
+    void run(const std::string &name, const std::function<result(int)> &bench)
+    {
+        if (!wanted(name))
+            return;
+        if (d_opt.list)
+        {
+            std::printf("%s\n", name.c_str());
+            return;
+        }
+        double base = 0.0;
+        for (int n : thread_counts(d_opt.max_threads))
+        {
+            result r = bench(n);
+            r.name = name;
+            double rate = r.seconds > 0.0 ? double(r.samples) / r.seconds : 0.0;
+            if (n == 1)
+                base = rate;
+            r.scaling = base > 0.0 ? rate / base : 0.0;
+            print_result(d_format, r, d_first);
+            d_first = false;
+        }
+    }
+
+private:
+    QString d_format;
+    const options &d_opt;
+    bool d_first{true};
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("gqrx_bench");
+    QCoreApplication::setApplicationVersion(VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Gqrx DSP block and format converter benchmarks " VERSION);
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {{"n", "samples"}, "Input samples per instance and benchmark (default 10000000)", "count"},
+        {{"t", "threads"}, "Scale up to this many parallel instances (default: all cores)", "count"},
+        {{"f", "format"}, "Output format: text, csv or json (default text)", "format"},
+        {{"b", "bench"}, "Only run benchmarks matching this regular expression", "regex"},
+        {{"l", "list"}, "List the benchmarks and exit"},
+    });
+    parser.process(app);
+
+    options opt;
+    opt.max_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (parser.isSet("samples"))
+        opt.nsamples = std::max(CHUNK, (size_t)parser.value("samples").toULongLong());
+    if (parser.isSet("threads"))
+        opt.max_threads = std::max(1, parser.value("threads").toInt());
+    opt.filter = QRegularExpression(parser.isSet("bench") ? parser.value("bench") : ".*");
+    if (!opt.filter.isValid())
+    {
+        std::cerr << "Invalid benchmark expression: "
+                  << opt.filter.errorString().toStdString() << std::endl;
+        return 1;
+    }
+    opt.list = parser.isSet("list");
+    QString format = parser.value("format");
+    if (format.isEmpty())
+        format = "text";
+    if (format != "text" && format != "csv" && format != "json")
+    {
+        std::cerr << "Unknown output format: " << format.toStdString() << std::endl;
+        return 1;
+    }
+
+    reporter rep(format, opt);
+    if (!opt.list)
+        print_header(format, opt);
+
+    for (const converter_fn &fn : converter_benches())
+    {
+        std::string name;
+        bool warm = false;
+        fn(0, 0, name);
+        rep.run(name, [&](int n) {
+            if (!warm)
+                fn(1, CHUNK, name);
+            warm = true;
+            return fn(n, opt.nsamples, name);
+        });
+    }
+
+    for (int level = packed_simd::ISA_NONE; level <= packed_simd::ISA_AVX512; level++)
+    {
+        packed_simd::isa isa = packed_simd::isa(level);
+        if (!packed_simd::supported(isa))
+            continue;
+        for (bool unpack : {true, false})
+            for (bool cplx : {true, false})
+                for (int bits : {10, 12, 14})
+                {
+                    std::string name = std::string("packed_simd/") + packed_simd::isa_name(isa)
+                                     + (unpack ? "/unpack" : "/pack") + std::to_string(bits)
+                                     + (cplx ? "c" : "");
+                    rep.run(name, [&](int n) {
+                        return bench_packed(isa, bits, cplx, unpack, n, opt.nsamples);
+                    });
+                }
+    }
+
+    for (const block_bench &b : block_benches())
+        rep.run(b.name, [&](int n) {
+            return run_flowgraph(n, opt.nsamples, [&](gr::top_block_sptr tb, int i) {
+                b.build(tb, i, opt.nsamples);
+            });
+        });
+
+    rep.run("fft_channelizer_cc/mt", [&](int n) {
+        result r = run_flowgraph(1, opt.nsamples, [&](gr::top_block_sptr tb, int i) {
+            fft_channelizer_cc::sptr chan = fft_channelizer_cc::make(8*4, 4, gr::fft::window::WIN_KAISER, n);
+            for (int k = 0; k < 4; k++)
+                chan->map_output(k, k * 5);
+            connect_chain(tb, make_iq_signal(CHUNK, i), opt.nsamples, chan, 1, 4, sizeof(gr_complex));
+        });
+        r.threads = n;
+        return r;
+    });
+
+    if (!opt.list)
+        print_footer(format);
+    return 0;
+}
@@ -0,0 +1,663 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cmath>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QMap>
+#include <QVariant>
+#include "applications/gqrx/rx_settings.h"
+#include "dsp/rx_fft.h"
+#include "interfaces/udp_audio_sender.h"
+#include "headless.h"
+
+HeadlessReceiver::HeadlessReceiver(QObject *parent)
+    : QObject(parent),
+      m_settings(nullptr),
+      d_fft_interval(1000 / DEFAULT_FFT_RATE),
+      d_lnb_lo(0),
+      d_hw_freq(0),
+      d_ignore_limits(false),
+      d_running(false),
+      d_fftAvg(1.f)
+{
+    QByteArray xdg_dir = qgetenv("XDG_CONFIG_HOME");
+
+    if (xdg_dir.isEmpty())
+        m_cfg_dir = QString("%1/.config/gqrx").arg(QDir::homePath());
+    else
+        m_cfg_dir = QString("%1/gqrx").arg(xdg_dir.data());
+
+    rx = new receiver("", "", 1);
+    remote = new RemoteControl();
+
+    status_timer = new QTimer(this);
+    connect(status_timer, SIGNAL(timeout()), this, SLOT(statusTimeout()));
+    dsp_load_timer = new QTimer(this);
+    connect(dsp_load_timer, SIGNAL(timeout()), this, SLOT(dspLoadTimeout()));
+    fft_timer = new QTimer(this);
+    connect(fft_timer, SIGNAL(timeout()), this, SLOT(fftTimeout()));
+
+    connect(remote, SIGNAL(newFrequency(qint64)), this, SLOT(setNewFrequency(qint64)));
+    connect(remote, SIGNAL(newFilterOffset(qint64)), this, SLOT(setFilterOffset(qint64)));
+    connect(remote, SIGNAL(newLnbLo(double)), this, SLOT(setLnbLo(double)));
+    connect(remote, SIGNAL(newMode(Modulations::idx)), this, SLOT(selectDemod(Modulations::idx)));
+    connect(remote, SIGNAL(newSquelchLevel(double)), this, SLOT(setSqlLevel(double)));
+    connect(remote, SIGNAL(newAudioGain(float)), this, SLOT(setAudioGain(float)));
+    connect(remote, SIGNAL(startAudioRecorderEvent()), this, SLOT(startAudioRec()));
+    connect(remote, SIGNAL(stopAudioRecorderEvent()), this, SLOT(stopAudioRec()));
+    connect(remote, SIGNAL(gainChanged(QString, double)), this, SLOT(setGain(QString,double)));
+    connect(remote, SIGNAL(newPassband(int)), this, SLOT(setPassband(int)));
+    connect(remote, SIGNAL(dspChanged(bool)), this, SLOT(setDsp(bool)));
+    connect(remote, SIGNAL(newRDSmode(bool)), this, SLOT(setRdsDecoder(bool)));
+    connect(remote, SIGNAL(newLatencyProbes(bool)), this, SLOT(setLatencyProbes(bool)));
+    connect(remote, SIGNAL(newLatencyProfile(int)), this, SLOT(setLatencyProfile(int)));
+    connect(remote, SIGNAL(newShmExport(bool)), this, SLOT(setShmExport(bool)));
+    connect(remote, SIGNAL(newVfoChanges(RemoteVfoChanges)), this, SLOT(applyRemoteVfoChanges(RemoteVfoChanges)));
+    connect(remote, SIGNAL(newIqStream(quint64,int,int,int)), this, SLOT(startIqStream(quint64,int,int,int)));
+    connect(remote, SIGNAL(iqStreamClosed(quint64)), this, SLOT(stopIqStream(quint64)));
+}
+
+HeadlessReceiver::~HeadlessReceiver()
+{
+    remote->stop_server();
+    setDsp(false);
+
+    for (auto &tap : iq_streams)
+        rx->stop_iq_stream(tap);
+    iq_streams.clear();
+    shm_spectrum.reset();
+
+    if (m_settings)
+    {
+        m_settings->setValue("crashed", false);
+        m_settings->sync();
+        delete m_settings;
+    }
+
+    delete remote;
+    delete rx;
+}
+
+/**
+ * @brief Load a configuration written by the GUI.
+ * @param cfgfile The configuration file, absolute or relative to the
+ *                configuration directory.
+ * @param udp Start the UDP audio stream of every VFO.
+ * @param record Start the audio recorder of every VFO.
+ * @returns False, if there is no usable input device.
+ *
+ * Reads the settings the same way as MainWindow::loadConfig() and the
+ * docks do, skipping the ones, that only affect the GUI. The
+ * configuration is never written back, except for the crash flag.
+ */
+bool HeadlessReceiver::loadConfig(const QString &cfgfile, bool udp, bool record)
+{
+    double      actual_rate;
+    qint64      int64_val;
+    int         int_val;
+    bool        conv_ok;
+    int         ver;
+    qint64      hw_freq;
+
+    if (QDir::isAbsolutePath(cfgfile))
+        m_settings = new QSettings(cfgfile, QSettings::IniFormat);
+    else
+        m_settings = new QSettings(QString("%1/%2").arg(m_cfg_dir).arg(cfgfile),
+                                   QSettings::IniFormat);
+
+    qInfo() << "Configuration file:" << m_settings->fileName();
+
+    QString indev = m_settings->value("input/device", "").toString();
+    if (indev.isEmpty())
+    {
+        qCritical() << "No input device in" << m_settings->fileName();
+        return false;
+    }
+
+    ver = m_settings->value("configversion").toInt(&conv_ok);
+
+    int_val = m_settings->value("output/sample_rate", 48000).toInt(&conv_ok);
+    if (conv_ok && (int_val > 0))
+        rx->set_audio_rate(int_val);
+
+    rx->set_udp_options(m_settings->value("output/udp_payload", UDP_AUDIO_DEFAULT_PAYLOAD).toInt(),
+                        m_settings->value("output/udp_rtp", false).toBool(),
+                        m_settings->value("output/udp_multicast_ttl", 1).toInt());
+
+    try
+    {
+        rx->set_input_device(indev.toStdString());
+    }
+    catch (std::runtime_error &x)
+    {
+        qCritical() << "Failed to set input device:" << x.what();
+        return false;
+    }
+
+    QString outdev = m_settings->value("output/device", "").toString();
+    try
+    {
+        rx->set_output_device(outdev.toStdString());
+    }
+    catch (std::exception &x)
+    {
+        qWarning() << "Failed to set output device:" << x.what();
+    }
+
+    int_val = m_settings->value("input/sample_rate", 0).toInt(&conv_ok);
+    if (conv_ok && (int_val > 0))
+    {
+        actual_rate = rx->set_input_rate(int_val);
+        if (actual_rate == 0)
+        {
+            qWarning() << "There was an error configuring the input device";
+            actual_rate = int_val;
+        }
+    }
+    else
+        actual_rate = rx->get_input_rate();
+
+    if (actual_rate > 0.)
+    {
+        int_val = m_settings->value("input/decimation", 1).toInt(&conv_ok);
+        if (conv_ok && int_val >= 2)
+        {
+            if (rx->set_input_decim(int_val) != (unsigned int)int_val)
+                qWarning() << "Failed to set decimation" << int_val;
+            else
+                actual_rate /= (double)int_val;
+        }
+        else
+            rx->set_input_decim(1);
+
+        remote->setBandwidth((qint64)actual_rate);
+    }
+    else
+        qWarning() << "Actual sample rate is" << actual_rate;
+
+    int64_val = m_settings->value("input/bandwidth", 0).toInt(&conv_ok);
+    if (conv_ok)
+        rx->set_analog_bandwidth((double) int64_val);
+
+    /* Input controls, see DockInputCtl::readSettings() */
+    int64_val = m_settings->value("input/corr_freq", 0).toLongLong(&conv_ok);
+    rx->set_freq_corr(std::min(std::max(int64_val / 1.0e6, -200.0), 200.0));
+    rx->set_iq_swap(m_settings->value("input/swap_iq", false).toBool());
+    rx->set_dc_cancel(m_settings->value("input/dc_cancel", false).toBool());
+    try
+    {
+        rx->set_iq_balance(m_settings->value("input/iq_balance", false).toBool());
+    }
+    catch (std::exception &x)
+    {
+        qWarning() << "Failed to set IQ balance:" << x.what();
+    }
+    d_ignore_limits = m_settings->value("input/ignore_limits", false).toBool();
+
+    int64_val = m_settings->value("input/lnb_lo", 0).toLongLong(&conv_ok);
+    if (conv_ok)
+        d_lnb_lo = int64_val;
+    remote->setLnbLo(d_lnb_lo / 1.0e6);
+
+    if (rx->get_antennas().size() > 1)
+    {
+        QString ant = m_settings->value("input/antenna", "").toString();
+        if (!ant.isEmpty())
+            rx->set_antenna(ant.toStdString());
+    }
+
+    // rtlsdr gain is 0 by default, see MainWindow::loadConfig()
+    updateGainStages(!indev.contains("rtl", Qt::CaseInsensitive) ||
+                     m_settings->contains("input/gains"));
+    if (m_settings->contains("input/gains"))
+    {
+        QMap<QString, QVariant> allgains = m_settings->value("input/gains").toMap();
+
+        for (auto it = allgains.constBegin(); it != allgains.constEnd(); ++it)
+            rx->set_gain(it.key().toStdString(), 0.1 * (double)(it.value().toInt()));
+        updateGainStages(true);
+    }
+    rx->set_auto_gain(m_settings->value("input/hwagc", false).toBool());
+
+    int_val = m_settings->value("gui/fft_channelizer", 0).toInt(&conv_ok);
+    rx->set_channelizer(conv_ok ? int_val : 0);
+
+    /* Frequency and VFOs, see MainWindow::readRXSettings() */
+    int64_val = m_settings->value("input/frequency", 14236000).toLongLong(&conv_ok);
+    hw_freq = int64_val - d_lnb_lo;
+    if (!d_ignore_limits)
+    {
+        double start, stop, step;
+
+        if (rx->get_rf_range(&start, &stop, &step) == receiver::STATUS_OK &&
+            (hw_freq < start || hw_freq > stop))
+            hw_freq = (stop - start) / 2;
+    }
+    rx->set_rf_freq(hw_freq);
+    d_hw_freq = d_ignore_limits ? hw_freq : (qint64)rx->get_rf_freq();
+
+    while (rx->get_rx_count() > 1)
+        rx->delete_rx();
+    QString grp = (ver >= 4) ? QString("rx0") : "receiver";
+    for (int i = 1; ; i++)
+    {
+        m_settings->beginGroup(grp);
+        read_vfo_settings(m_settings, rx, ver, actual_rate);
+        m_settings->endGroup();
+        if (ver < 4)
+            break;
+        grp = QString("rx%1").arg(i);
+        if (!m_settings->contains(grp + "/offset"))
+            break;
+        rx->add_rx();
+    }
+
+    for (int i = 0; i < rx->get_rx_count(); i++)
+    {
+        rx->select_rx(i);
+        if (rx->get_demod() == Modulations::MODE_OFF)
+            continue;
+        if (udp && rx->set_udp_streaming(true) != receiver::STATUS_OK)
+            qWarning() << "Failed to start the UDP stream of VFO" << i;
+        if (record && rx->start_audio_recording())
+            qWarning() << "Failed to start the audio recorder of VFO" << i;
+    }
+
+    if (ver >= 4)
+        int_val = m_settings->value("gui/current_rx", 0).toInt(&conv_ok);
+    else
+        conv_ok = false;
+    if (!conv_ok || int_val < 0 || int_val >= rx->get_rx_count())
+        int_val = 0;
+    rx->select_rx(int_val);
+    if (ver < 4)
+        rx->set_rf_freq(hw_freq - rx->get_filter_offset());
+    setNewFrequency(d_lnb_lo + d_hw_freq + (qint64)rx->get_filter_offset());
+
+    /* Spectrum, see DockFft::readSettings() */
+    m_settings->beginGroup("fft");
+    int_val = m_settings->value("fft_rate", DEFAULT_FFT_RATE).toInt(&conv_ok);
+    if (conv_ok && int_val > 0)
+        d_fft_interval = 1000 / int_val;
+    int_val = m_settings->value("fft_size", DEFAULT_FFT_SIZE).toInt(&conv_ok);
+    if (!conv_ok || int_val <= 0 || int_val > MAX_FFT_SIZE)
+        int_val = DEFAULT_FFT_SIZE;
+    rx->set_iq_fft_size(int_val);
+    rx->set_iq_fft_window(m_settings->value("fft_window", DEFAULT_FFT_WINDOW).toInt(),
+                          m_settings->value("fft_window_correction",
+                                            DEFAULT_FFT_WINDOW_CORRECTION).toInt());
+    d_fftAvg = std::pow(10.0, -m_settings->value("averaging", DEFAULT_FFT_AVG).toInt() / 20.0);
+    m_settings->endGroup();
+    rx->set_iq_fft_enabled(false);
+
+    int_val = m_settings->value("dsp_load/latency_profile", 0).toInt(&conv_ok);
+    if (conv_ok && int_val > 0)
+        setLatencyProfile(int_val);
+
+    rx->commit_audio_rate();
+
+    /*
+     * The remote control is the only way to control the receiver, it is
+     * started regardless of remote_control/enabled.
+     */
+    setShmExport(m_settings->value("output/shm_export", false).toBool());
+    remote->readSettings(m_settings);
+    remote->start_server();
+
+    m_settings->setValue("crashed", true);
+    m_settings->sync();
+
+    return true;
+}
+
+/**
+ * @brief Start or stop the DSP.
+ *
+ * Also run for the remote command U DSP.
+ */
+void HeadlessReceiver::setDsp(bool running)
+{
+    if (running == d_running)
+        return;
+    d_running = running;
+    remote->setReceiverStatus(running);
+
+    if (running)
+    {
+        rx->start();
+        status_timer->start(100);
+        dsp_load_timer->start(1000);
+        fft_timer->start(d_fft_interval);
+    }
+    else
+    {
+        status_timer->stop();
+        dsp_load_timer->stop();
+        fft_timer->stop();
+        rx->stop();
+        remote->setDspLoad(std::vector<dsp_load_vfo>(), std::vector<dsp_load_block>());
+        remote->setLatency(std::vector<latency_stage>());
+    }
+}
+
+/**
+ * @brief Tune the current VFO.
+ *
+ * Same as MainWindow::setNewFrequency(), locked VFOs keep their frequency,
+ * those, that leave the band, are removed. There are no auto bookmarks.
+ */
+void HeadlessReceiver::setNewFrequency(qint64 rx_freq)
+{
+    auto new_offset = rx->get_filter_offset();
+    auto hw_freq = (double)(rx_freq - d_lnb_lo) - new_offset;
+    auto delta_freq = d_hw_freq;
+    auto max_offset = rx->get_input_rate() / 2;
+    bool update_offset = rx->is_playing_iq() || rx->is_recording_iq();
+
+    rx->set_rf_freq(hw_freq);
+    d_hw_freq = d_ignore_limits ? hw_freq : (qint64)rx->get_rf_freq();
+    update_offset |= (d_hw_freq != (qint64)hw_freq);
+
+    if (rx_freq - d_lnb_lo - d_hw_freq > max_offset)
+        rx_freq = d_lnb_lo + d_hw_freq + max_offset;
+    if (rx_freq - d_lnb_lo - d_hw_freq < -max_offset)
+        rx_freq = d_lnb_lo + d_hw_freq - max_offset;
+    if (update_offset)
+        rx->set_filter_offset((double)(rx_freq - d_lnb_lo - d_hw_freq));
+    delta_freq -= d_hw_freq;
+
+    remote->setNewFrequency(rx_freq);
+    remote->setFilterOffset(rx_freq - d_lnb_lo - d_hw_freq);
+    if (rx->is_rds_decoder_active())
+        rx->reset_rds_parser();
+
+    if (delta_freq && rx->get_rx_count() > 1)
+        rx->delete_rx(rx->move_locked_vfos(delta_freq));
+}
+
+void HeadlessReceiver::setFilterOffset(qint64 freq_hz)
+{
+    rx->set_filter_offset((double) freq_hz);
+    setNewFrequency(d_hw_freq + d_lnb_lo + freq_hz);
+}
+
+void HeadlessReceiver::setLnbLo(double freq_mhz)
+{
+    auto rf_freq = d_hw_freq + (qint64)rx->get_filter_offset();
+
+    d_lnb_lo = qint64(freq_mhz * 1e6);
+    setNewFrequency(d_lnb_lo + rf_freq);
+}
+
+/**
+ * @brief Select a demodulator with the normal filter preset.
+ *
+ * The GUI uses the preset selected in the receiver options, which has
+ * no counterpart here.
+ */
+void HeadlessReceiver::selectDemod(Modulations::idx mode_idx)
+{
+    int     flo = 0, fhi = 0;
+    Modulations::filter_shape filter_shape;
+
+    if (mode_idx < Modulations::MODE_OFF || mode_idx >= Modulations::MODE_COUNT)
+        mode_idx = Modulations::MODE_OFF;
+
+    rx->get_filter(flo, fhi, filter_shape);
+    Modulations::GetFilterPreset(mode_idx, FILTER_PRESET_NORMAL, flo, fhi);
+
+    if (mode_idx != rx->get_demod())
+    {
+        bool rds_enabled = rx->is_rds_decoder_active();
+
+        if (rds_enabled)
+            setRdsDecoder(false);
+        if (mode_idx == Modulations::MODE_OFF && rx->is_recording_audio())
+            stopAudioRec();
+        rx->set_demod(mode_idx);
+        if (rds_enabled && (mode_idx == Modulations::MODE_WFM_MONO ||
+                            mode_idx == Modulations::MODE_WFM_STEREO ||
+                            mode_idx == Modulations::MODE_WFM_STEREO_OIRT))
+            setRdsDecoder(true);
+    }
+    rx->set_filter(flo, fhi, filter_shape);
+
+    remote->setMode(mode_idx);
+    remote->setPassband(flo, fhi);
+}
+
+void HeadlessReceiver::setSqlLevel(double level_db)
+{
+    rx->set_sql_level(level_db);
+}
+
+void HeadlessReceiver::setAudioGain(float value)
+{
+    rx->set_agc_manual_gain(value);
+}
+
+void HeadlessReceiver::startAudioRec()
+{
+    if (rx->get_demod() == Modulations::MODE_OFF)
+        qWarning() << "Recording audio requires a demodulator";
+    else if (rx->start_audio_recording())
+        qWarning() << "Error starting audio recorder";
+}
+
+void HeadlessReceiver::stopAudioRec()
+{
+    if (rx->stop_audio_recording())
+        qWarning() << "Error stopping audio recorder";
+}
+
+void HeadlessReceiver::setGain(QString name, double gain)
+{
+    rx->set_gain(name.toStdString(), gain);
+}
+
+void HeadlessReceiver::setPassband(int bandwidth)
+{
+    int lo, hi;
+    Modulations::filter_shape filter_shape;
+
+    rx->get_filter(lo, hi, filter_shape);
+    passband_to_filter(rx->get_demod(), FILTER_PRESET_NORMAL, bandwidth, lo, hi);
+    rx->set_filter(lo, hi, filter_shape);
+    remote->setPassband(lo, hi);
+}
+
+void HeadlessReceiver::setRdsDecoder(bool enabled)
+{
+    if (enabled)
+    {
+        rx->start_rds_decoder();
+        rx->reset_rds_parser();
+    }
+    else
+        rx->stop_rds_decoder();
+    remote->setRDSstatus(enabled);
+}
+
+void HeadlessReceiver::setLatencyProbes(bool enabled)
+{
+    rx->set_latency_probes(enabled);
+    remote->setLatencyProbes(enabled);
+}
+
+void HeadlessReceiver::setLatencyProfile(int profile)
+{
+    rx->set_latency_profile((latency_profile)profile);
+    remote->setLatencyProfile(profile);
+}
+
+void HeadlessReceiver::setShmExport(bool enabled)
+{
+    if (rx->set_shm_export(enabled) != receiver::STATUS_OK)
+        enabled = false;
+    if (!enabled)
+        shm_spectrum.reset();
+    remote->setShmExport(rx->get_shm_export());
+}
+
+/** Same as MainWindow::applyRemoteVfoChanges() without the plotter. */
+void HeadlessReceiver::applyRemoteVfoChanges(const RemoteVfoChanges &changes)
+{
+    rx->apply_vfo_changes(remote_to_vfo_changes(rx, d_lnb_lo, changes));
+    updateRemoteVfos();
+}
+
+void HeadlessReceiver::startIqStream(quint64 client, int vfo, int stage, int format)
+{
+    iq_stream_sink_sptr tap = rx->start_iq_stream(vfo < 0 ? rx->get_current() : vfo,
+                                                  iq_stream_sink::stage(stage),
+                                                  file_formats(format));
+
+    if (tap)
+        iq_streams.insert(client, tap);
+    remote->attachIqStream(client, tap);
+}
+
+void HeadlessReceiver::stopIqStream(quint64 client)
+{
+    rx->stop_iq_stream(iq_streams.take(client));
+}
+
+void HeadlessReceiver::updateGainStages(bool read_from_device)
+{
+    remote->setGainStages(read_gain_stages(rx, read_from_device));
+}
+
+/** Send the state of all VFOs to the remote control. */
+void HeadlessReceiver::updateRemoteVfos()
+{
+    std::vector<RemoteVfo> vfos;
+    double rf_freq = rx->get_rf_freq() + d_lnb_lo;
+
+    for (int i = 0; i < rx->get_rx_count(); i++)
+    {
+        vfo::sptr v = rx->get_vfo(i);
+        RemoteVfo rv;
+
+        rv.freq = qint64(rf_freq + v->get_offset());
+        rv.mode = v->get_demod();
+        rv.passband_lo = v->get_filter_low();
+        rv.passband_hi = v->get_filter_high();
+        rv.signal_level = rx->get_signal_pwr(i);
+        rv.squelch_open = rx->get_sql_open(i);
+        rv.squelch_level = v->get_sql_level();
+        vfos.push_back(rv);
+    }
+    remote->setVfos(vfos, rx->get_current());
+}
+
+/** Pass the RDS data to the remote control, see DockRDS::updateRDS(). */
+void HeadlessReceiver::readRdsData()
+{
+    std::string buffer;
+    int num;
+
+    rx->get_rds_data(buffer, num);
+    while (num != -1)
+    {
+        QString text = QString::fromStdString(buffer);
+
+        switch (num)
+        {
+        case 0:
+            remote->rdsPI(text);
+            break;
+        case 1:
+            remote->setRdsStation(text);
+            break;
+        case 4:
+            remote->setRdsRadiotext(text);
+            break;
+        default:
+            break;
+        }
+        rx->get_rds_data(buffer, num);
+    }
+}
+
+void HeadlessReceiver::statusTimeout()
+{
+    remote->setSignalLevel(rx->get_signal_pwr());
+    updateRemoteVfos();
+    if (rx->is_rds_decoder_active())
+        readRdsData();
+}
+
+void HeadlessReceiver::dspLoadTimeout()
+{
+    std::vector<dsp_load_block> blocks;
+    std::vector<dsp_load_vfo> vfos;
+    std::vector<latency_stage> stages;
+
+    rx->get_dsp_load(blocks, vfos);
+    remote->setDspLoad(vfos, blocks);
+    if (rx->get_latency(stages))
+        remote->setLatency(stages);
+
+    rx->release_idle_demods();
+}
+
+/**
+ * @brief Spectrum for the remote control and the shared memory export.
+ *
+ * The FFT of the receiver is only enabled, while someone wants it.
+ */
+void HeadlessReceiver::fftTimeout()
+{
+    unsigned int fftsize;
+    qint64 timestamp;
+    bool wanted = remote->spectrumWanted() || rx->get_shm_export();
+
+    rx->set_iq_fft_enabled(wanted);
+    if (!wanted)
+        return;
+
+    if (d_fftData.empty())
+    {
+        d_fftData.resize(MAX_FFT_SIZE);
+        d_realFftData.resize(MAX_FFT_SIZE);
+        d_iirFftData.resize(MAX_FFT_SIZE, -140.0);  // dBFS
+    }
+
+    rx->get_iq_fft_data(d_fftData.data(), fftsize);
+    timestamp = rx->is_playing_iq() ? rx->get_filesource_timestamp_ms()
+                                    : QDateTime::currentMSecsSinceEpoch();
+    if (fftsize == 0)
+        return;
+
+    fft_to_db(fftsize, d_fftData.data(), d_realFftData.data());
+    fft_average(fftsize, d_realFftData.data(), d_iirFftData.data(), d_fftAvg);
+
+    if (remote->spectrumWanted())
+        remote->setSpectrum(d_iirFftData.data(), fftsize, d_hw_freq + d_lnb_lo,
+                            (qint64)rx->get_quad_rate(), timestamp);
+    if (rx->get_shm_export())
+        shm_spectrum.write(d_iirFftData.data(), fftsize, d_hw_freq + d_lnb_lo,
+                           (qint64)rx->get_quad_rate(), timestamp);
+}
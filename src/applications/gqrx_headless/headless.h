@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <complex>
+#include <vector>
+#include <QHash>
+#include <QObject>
+#include <QSettings>
+#include <QString>
+#include <QTimer>
+#include "applications/gqrx/receiver.h"
+#include "applications/gqrx/remote_control.h"
+#include "interfaces/shm_sink.h"
+
+/*! \brief The receiver without GUI, controlled over the remote protocol.
+ *
+ * Loads the same configuration as the GUI and does what MainWindow does
+ * for the remote control, leaving out everything, that only updates the
+ * widgets. The timers only sample the receiver state for the clients,
+ * the spectrum is computed only while a client or the shared memory
+ * export wants it.
+ */
+class HeadlessReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HeadlessReceiver(QObject *parent = nullptr);
+    ~HeadlessReceiver() override;
+
+    bool loadConfig(const QString &cfgfile, bool udp, bool record);
+
+public slots:
+    void setDsp(bool running);
+
+private slots:
+    void setNewFrequency(qint64 rx_freq);
+    void setFilterOffset(qint64 freq_hz);
+    void setLnbLo(double freq_mhz);
+    void selectDemod(Modulations::idx mode_idx);
+    void setSqlLevel(double level_db);
+    void setAudioGain(float value);
+    void startAudioRec();
+    void stopAudioRec();
+    void setGain(QString name, double gain);
+    void setPassband(int bandwidth);
+    void setRdsDecoder(bool enabled);
+    void setLatencyProbes(bool enabled);
+    void setLatencyProfile(int profile);
+    void setShmExport(bool enabled);
+    void applyRemoteVfoChanges(const RemoteVfoChanges &changes);
+    void startIqStream(quint64 client, int vfo, int stage, int format);
+    void stopIqStream(quint64 client);
+
+    void statusTimeout();
+    void dspLoadTimeout();
+    void fftTimeout();
+
+private:
+    void updateGainStages(bool read_from_device);
+    void updateRemoteVfos();
+    void readRdsData();
+
+    receiver      *rx;
+    RemoteControl *remote;
+    QSettings     *m_settings;
+    QString        m_cfg_dir;
+
+    QTimer        *status_timer;     /*!< Signal level, VFOs and RDS. */
+    QTimer        *dsp_load_timer;   /*!< DSP load and latency. */
+    QTimer        *fft_timer;        /*!< Spectrum for the clients. */
+    int            d_fft_interval;
+
+    qint64         d_lnb_lo;
+    qint64         d_hw_freq;
+    bool           d_ignore_limits;
+    bool           d_running;
+    float          d_fftAvg;
+
+    std::vector<std::complex<float>> d_fftData;
+    std::vector<float>  d_realFftData;
+    std::vector<float>  d_iirFftData;
+    shm_spectrum_export shm_spectrum;
+
+    QHash<quint64, iq_stream_sink_sptr> iq_streams;
+};
+
+#endif // HEADLESS_H
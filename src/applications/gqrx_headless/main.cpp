@@ -0,0 +1,120 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <csignal>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QLoggingCategory>
+#include <QtGlobal>
+#ifndef _WIN32
+#include <QSocketNotifier>
+#include <unistd.h>
+#endif
+
+#include "applications/gqrx/gqrx.h"
+#include "headless.h"
+
+#ifndef _WIN32
+static int signal_pipe[2];
+
+/* Leave the event loop from a signal handler, only write() is safe here. */
+static void quit_on_signal(int sig)
+{
+    char c = (char) sig;
+
+    if (::write(signal_pipe[1], &c, 1) < 0)
+        _exit(1);
+}
+#endif
+
+/*
+ * gqrx-headless: the receiver of gqrx without GUI.
+ *
+ * Runs the configuration of the GUI and is controlled over the remote
+ * control port, see remote-control.txt.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName(GQRX_ORG_NAME);
+    QCoreApplication::setOrganizationDomain(GQRX_ORG_DOMAIN);
+    QCoreApplication::setApplicationName(GQRX_APP_NAME);
+    QCoreApplication::setApplicationVersion(VERSION);
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    // Same GNU Radio setup as the GUI, see gqrx/main.cpp
+    qputenv("GR_CONF_CONTROLPORT_ON", "False");
+    if (!qEnvironmentVariableIsSet("GR_CONF_PERFCOUNTERS_ON"))
+        qputenv("GR_CONF_PERFCOUNTERS_ON", "True");
+    if (!qEnvironmentVariableIsSet("GR_CONF_PERFCOUNTERS_CLOCK"))
+        qputenv("GR_CONF_PERFCOUNTERS_CLOCK", "thread");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Gqrx receiver without GUI " VERSION);
+    parser.addHelpOption();
+    parser.addOptions({
+        {{"c", "conf"}, "Use this config file (default.conf)", "file"},
+        {{"u", "udp"}, "Start the UDP audio stream of every VFO"},
+        {{"r", "record"}, "Start the audio recorder of every VFO"},
+        {{"n", "no-dsp"}, "Do not start the DSP, use U DSP 1 to start it"},
+    });
+    parser.process(app);
+
+    QString cfg_file = parser.isSet("conf") ? parser.value("conf") : "default.conf";
+    int return_code = 0;
+
+    try
+    {
+        HeadlessReceiver rx;
+
+        if (!rx.loadConfig(cfg_file, parser.isSet("udp"), parser.isSet("record")))
+            return 1;
+
+#ifndef _WIN32
+        if (::pipe(signal_pipe) == 0)
+        {
+            auto *notifier = new QSocketNotifier(signal_pipe[0], QSocketNotifier::Read, &app);
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+            QObject::connect(notifier, SIGNAL(activated(int)), &app, SLOT(quit()));
+#else
+            QObject::connect(notifier, SIGNAL(activated(QSocketDescriptor)), &app, SLOT(quit()));
+#endif
+            std::signal(SIGINT, quit_on_signal);
+            std::signal(SIGTERM, quit_on_signal);
+        }
+#endif
+
+        if (!parser.isSet("no-dsp"))
+            rx.setDsp(true);
+
+        return_code = QCoreApplication::exec();
+    }
+    catch (std::exception &x)
+    {
+        qCritical() << "gqrx-headless exited with an exception:" << x.what();
+        return_code = 1;
+    }
+
+    return return_code;
+}
@@ -0,0 +1,746 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Offline throughput and regression driver for the receiver.
+ *
+ * Builds the real receiver flowgraph from a saved configuration (or from
+ * defaults), optionally with more VFOs, other modes and the channelizer on
+ * or off, and plays a recorded or synthetic I/Q file through file_source as
+ * fast as possible. At the end of the file it reports
+ *
+ *   - total throughput and process CPU time,
+ *   - CPU time of every flowgraph thread (one per block with the default
+ *     thread-per-block scheduler, named after the block; Linux only),
+ *   - hashes of the mixed audio output: bit exact over the float samples
+ *     and over the samples rounded to 16 bit PCM.
+ *
+ * A report can be saved as JSON and later passed as --golden to check a DSP
+ * change for output equivalence and speed against it.
+ */
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include <gnuradio/io_signature.h>
+#include <gnuradio/sync_block.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+    #include <dirent.h>
+    #include <sys/resource.h>
+    #include <unistd.h>
+#endif
+
+#include "applications/gqrx/receiver.h"
+#include "receivers/modulations.h"
+
+namespace
+{
+
+/* 64 bit FNV-1a, good enough to tell two outputs apart. */
+class fnv1a
+{
+public:
+    void update(const void * data, size_t len)
+    {
+        const uint8_t * p = (const uint8_t *) data;
+        for (size_t k = 0; k < len; k++)
+        {
+            d_hash ^= p[k];
+            d_hash *= 0x100000001b3ull;
+        }
+    }
+    uint64_t value() const { return d_hash; }
+
+private:
+    uint64_t d_hash{0xcbf29ce484222325ull};
+};
+
+/*
+ * Audio sink, that hashes the left and right channel and optionally
+ * writes them to a raw interleaved float file.
+ */
+class audio_hash_sink : public gr::sync_block
+{
+public:
+#if GNURADIO_VERSION < 0x030900
+    typedef boost::shared_ptr<audio_hash_sink> sptr;
+#else
+    typedef std::shared_ptr<audio_hash_sink> sptr;
+#endif
+
+    static sptr make(const std::string &raw_file)
+    {
+        return gnuradio::get_initial_sptr(new audio_hash_sink(raw_file));
+    }
+
+    ~audio_hash_sink()
+    {
+        if (d_fp)
+            fclose(d_fp);
+    }
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items) override
+    {
+        (void) output_items;
+        const float * l = (const float *) input_items[0];
+        const float * r = (const float *) input_items[1];
+
+        d_buf.resize(noutput_items * 2);
+        d_pcm.resize(noutput_items * 2);
+        for (int k = 0; k < noutput_items; k++)
+        {
+            d_buf[2 * k] = l[k];
+            d_buf[2 * k + 1] = r[k];
+            d_sum_l += double(l[k]) * double(l[k]);
+            d_sum_r += double(r[k]) * double(r[k]);
+        }
+        for (size_t k = 0; k < d_buf.size(); k++)
+        {
+            float v = std::max(-1.f, std::min(1.f, d_buf[k])) * 32767.f;
+            d_pcm[k] = int16_t(lrintf(v));
+        }
+        d_hash.update(d_buf.data(), d_buf.size() * sizeof(float));
+        d_pcm_hash.update(d_pcm.data(), d_pcm.size() * sizeof(int16_t));
+        if (d_fp)
+            fwrite(d_buf.data(), sizeof(float), d_buf.size(), d_fp);
+        d_samples += noutput_items;
+        return noutput_items;
+    }
+
+    uint64_t samples() const { return d_samples; }
+    uint64_t hash() const { return d_hash.value(); }
+    uint64_t pcm_hash() const { return d_pcm_hash.value(); }
+    double rms_left() const { return d_samples ? std::sqrt(d_sum_l / d_samples) : 0.0; }
+    double rms_right() const { return d_samples ? std::sqrt(d_sum_r / d_samples) : 0.0; }
+
+private:
+    explicit audio_hash_sink(const std::string &raw_file)
+        : gr::sync_block("audio_hash_sink",
+                         gr::io_signature::make(2, 2, sizeof(float)),
+                         gr::io_signature::make(0, 0, 0))
+    {
+        if (!raw_file.empty())
+        {
+            d_fp = fopen(raw_file.c_str(), "wb");
+            if (!d_fp)
+                std::cerr << "Can not create " << raw_file << std::endl;
+        }
+    }
+
+    FILE *               d_fp{nullptr};
+    std::vector<float>   d_buf;
+    std::vector<int16_t> d_pcm;
+    fnv1a                d_hash;
+    fnv1a                d_pcm_hash;
+    uint64_t             d_samples{0};
+    double               d_sum_l{0.0};
+    double               d_sum_r{0.0};
+};
+
+/*
+ * CPU time of the threads of this process, sampled from /proc while the
+ * flowgraph runs. Threads of finished blocks disappear from /proc, so the
+ * last sample, at most one poll interval old, is used for them.
+ */
+class thread_cpu_monitor
+{
+public:
+    void sample()
+    {
+#ifdef __linux__
+        DIR * dir = opendir("/proc/self/task");
+        if (!dir)
+            return;
+        while (struct dirent * ent = readdir(dir))
+        {
+            if (ent->d_name[0] == '.')
+                continue;
+            long tid = atol(ent->d_name);
+            std::string base = std::string("/proc/self/task/") + ent->d_name;
+            double ns = 0.0;
+            if (FILE * fp = fopen((base + "/schedstat").c_str(), "r"))
+            {
+                unsigned long long run_ns = 0;
+                if (fscanf(fp, "%llu", &run_ns) == 1)
+                    ns = double(run_ns);
+                fclose(fp);
+            }
+            // read every time, the scheduler names a thread after it started
+            entry &e = d_threads[tid];
+            if (FILE * fp = fopen((base + "/comm").c_str(), "r"))
+            {
+                char name[64] = "";
+                if (fgets(name, sizeof(name), fp))
+                    e.name = name;
+                fclose(fp);
+                while (!e.name.empty() && (e.name.back() == '\n'))
+                    e.name.pop_back();
+            }
+            e.seconds = std::max(e.seconds, ns * 1e-9);
+        }
+        closedir(dir);
+#endif
+    }
+
+    /* Seconds per thread name, less the time before the run. */
+    std::map<std::string, double> by_name(const thread_cpu_monitor &before) const
+    {
+        std::map<std::string, double> r;
+        for (auto &t : d_threads)
+        {
+            double s = t.second.seconds;
+            auto it = before.d_threads.find(t.first);
+            if (it != before.d_threads.end())
+                s -= it->second.seconds;
+            if (s > 0.0)
+                r[t.second.name] += s;
+        }
+        return r;
+    }
+
+private:
+    struct entry
+    {
+        std::string name;
+        double seconds{0.0};
+    };
+    std::map<long, entry> d_threads;
+};
+
+double process_cpu_seconds()
+{
+#ifdef __linux__
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+        return double(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)
+             + double(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+#endif
+    return -1.0;
+}
+
+/* VFO to set up: offset and mode, settings from the config group, if any. */
+struct vfo_plan
+{
+    QString          group;
+    qint64           offset;
+    Modulations::idx mode;
+};
+
+file_formats parse_format(const QString &str, bool is_filename)
+{
+    file_formats best = FILE_FORMAT_NONE;
+    int best_len = 0;
+    for (int k = FILE_FORMAT_CF; k < FILE_FORMAT_COUNT; k++)
+    {
+        const char * suffix = any_to_any_base::fmt[k].suffix;
+        if (!suffix)
+            continue;
+        QString s(suffix);
+        bool match = is_filename ? str.endsWith(s) :
+                     (str == s || str + ".raw" == s || str == any_to_any_base::fmt[k].name);
+        if (match && s.length() > best_len)
+        {
+            best = file_formats(k);
+            best_len = s.length();
+        }
+    }
+    return best;
+}
+
+/*
+ * Write a synthetic recording: one carrier per VFO, modulated with a 1 kHz
+ * tone in a way that suits its mode, and white noise.
+ */
+bool write_synthetic(const QString &filename, double rate, double seconds,
+                     const std::vector<vfo_plan> &plan)
+{
+    FILE * fp = fopen(filename.toLocal8Bit().constData(), "wb");
+    if (!fp)
+        return false;
+    std::mt19937 gen(1);
+    std::normal_distribution<float> noise(0.f, 0.003f);
+    std::vector<double> phase(plan.size(), 0.0);
+    std::vector<gr_complex> buf(65536);
+    const uint64_t total = uint64_t(rate * seconds);
+    bool ok = true;
+    for (uint64_t n = 0; n < total && ok; )
+    {
+        size_t count = std::min<uint64_t>(buf.size(), total - n);
+        for (size_t k = 0; k < count; k++, n++)
+        {
+            const double t = double(n) / rate;
+            const double tone = std::sin(2.0 * M_PI * 1000.0 * t);
+            gr_complex s(noise(gen), noise(gen));
+            for (size_t v = 0; v < plan.size(); v++)
+            {
+                double f = double(plan[v].offset);
+                double a = 0.1;
+                switch (Modulations::modes[plan[v].mode].group)
+                {
+                case Modulations::GRP_NFM:
+                case Modulations::GRP_NFMPLL:
+                    f += 2500.0 * tone;
+                    break;
+                case Modulations::GRP_WFM_MONO:
+                case Modulations::GRP_WFM_STEREO:
+                case Modulations::GRP_WFM_STEREO_OIRT:
+                    f += 50000.0 * tone;
+                    break;
+                case Modulations::GRP_AM:
+                case Modulations::GRP_AM_SYNC:
+                    a *= 1.0 + 0.5 * tone;
+                    break;
+                default:
+                    f += (plan[v].mode == Modulations::MODE_LSB ||
+                          plan[v].mode == Modulations::MODE_CWL) ? -1000.0 : 1000.0;
+                }
+                phase[v] = std::fmod(phase[v] + 2.0 * M_PI * f / rate, 2.0 * M_PI);
+                s += std::polar(float(a), float(phase[v]));
+            }
+            buf[k] = s;
+        }
+        ok = fwrite(buf.data(), sizeof(gr_complex), count, fp) == count;
+    }
+    return (fclose(fp) == 0) && ok;
+}
+
+/* The per-VFO part of MainWindow::readRXSettings(), that affects the DSP. */
+void read_vfo_settings(QSettings &s, receiver &rx)
+{
+    bool conv_ok;
+    int int_val;
+    double dbl_val;
+
+    rx.set_am_dcr(s.value("am_dcr", true).toBool());
+    rx.set_amsync_dcr(s.value("amsync_dcr", true).toBool());
+    int_val = s.value("pll_bw", 1000).toInt(&conv_ok);
+    if (conv_ok)
+        rx.set_pll_bw(int_val / 1.0e6);
+    int_val = s.value("cwoffset", 700).toInt(&conv_ok);
+    if (conv_ok)
+        rx.set_cw_offset(int_val);
+    int_val = s.value("fm_maxdev", 2500).toInt(&conv_ok);
+    if (conv_ok)
+        rx.set_fm_maxdev(int_val);
+    dbl_val = s.value("fm_deemph", 75).toDouble(&conv_ok);
+    if (conv_ok && dbl_val >= 0.0)
+        rx.set_fm_deemph(dbl_val);
+    dbl_val = s.value("fmpll_damping_factor", 0.7).toDouble(&conv_ok);
+    if (conv_ok && dbl_val > 0.0)
+        rx.set_fmpll_damping_factor(dbl_val);
+    rx.set_fm_subtone_filter(s.value("subtone_filter", false).toBool());
+    dbl_val = s.value("sql_level", 1.0).toDouble(&conv_ok);
+    if (conv_ok && dbl_val < 1.0)
+        rx.set_sql_level(dbl_val);
+
+    int_val = s.value("agc_target_level", 0).toInt(&conv_ok);
+    if (conv_ok)
+        rx.set_agc_target_level(int_val);
+    int_val = s.value("agc_decay", 500).toInt(&conv_ok);
+    if (conv_ok)
+        rx.set_agc_decay(int_val);
+    int_val = s.value("agc_attack", 20).toInt(&conv_ok);
+    if (conv_ok)
+        rx.set_agc_attack(int_val);
+    int_val = s.value("agc_hang", 0).toInt(&conv_ok);
+    if (conv_ok)
+        rx.set_agc_hang(int_val);
+    int_val = s.value("agc_panning", 0).toInt(&conv_ok);
+    if (conv_ok)
+        rx.set_agc_panning(int_val);
+    rx.set_agc_panning_auto(s.value("agc_panning_auto", false).toBool());
+    int_val = s.value("agc_maxgain", 100).toInt(&conv_ok);
+    if (conv_ok)
+        rx.set_agc_max_gain(int_val);
+    rx.set_agc_on(!s.value("agc_off", false).toBool());
+
+    for (int j = 1; j < RECEIVER_NB_COUNT + 1; j++)
+    {
+        rx.set_nb_on(j, s.value(QString("nb%1on").arg(j), false).toBool());
+        float thr = s.value(QString("nb%1thr").arg(j), 2.0).toFloat(&conv_ok);
+        if (conv_ok)
+            rx.set_nb_threshold(j, thr);
+    }
+
+    int flo = s.value("filter_low_cut", 0).toInt();
+    int fhi = s.value("filter_high_cut", 0).toInt();
+    int_val = s.value("filter_shape", Modulations::FILTER_SHAPE_NORMAL).toInt(&conv_ok);
+    if (flo != fhi)
+        rx.set_filter(flo, fhi, receiver::filter_shape(int_val));
+
+    int_val = s.value("gain", QVariant(-60)).toInt(&conv_ok);
+    if (conv_ok && !rx.get_agc_on())
+        rx.set_agc_manual_gain(float(int_val) * 0.1f);
+}
+
+QString hex(uint64_t v)
+{
+    return QString("%1").arg(qulonglong(v), 16, 16, QChar('0'));
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("gqrx_regress");
+    QCoreApplication::setApplicationVersion(VERSION);
+    qputenv("GR_CONF_CONTROLPORT_ON", "False");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Gqrx offline throughput and regression test " VERSION);
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {{"c", "conf"}, "Gqrx config file to build the receiver from", "file"},
+        {{"i", "input"}, "I/Q file to play", "file"},
+        {{"s", "synthetic"}, "Play a synthetic I/Q signal of this length", "seconds"},
+        {{"r", "rate"}, "Input sample rate (default: from the config or 1 Msps)", "Hz"},
+        {"iq-format", "I/Q file format, e.g. fc, 16, 8u, 16z (default: from the file name)", "suffix"},
+        {{"n", "vfos"}, "Number of VFOs, extra VFOs copy the last configured one", "count"},
+        {"spacing", "Offset between added VFOs (default 25000)", "Hz"},
+        {{"m", "mode"}, "Comma separated demodulators, assigned to the VFOs in turn", "modes"},
+        {"channelizer", "Channelizer threads, 0 = off (default: from the config)", "threads"},
+        {"audio-out", "Write the mixed audio as interleaved float stereo", "file"},
+        {{"o", "output"}, "Write the JSON report to this file", "file"},
+        {{"g", "golden"}, "Compare with a saved JSON report, exit code 1 on mismatch", "file"},
+        {"timeout", "Give up, when no samples were processed for this long (default 30)", "seconds"},
+    });
+    parser.process(app);
+
+    if (!parser.isSet("input") && !parser.isSet("synthetic"))
+    {
+        std::cerr << "Either --input or --synthetic is required." << std::endl;
+        return 2;
+    }
+
+    std::unique_ptr<QSettings> settings;
+    int ver = 0;
+    if (parser.isSet("conf"))
+    {
+        settings.reset(new QSettings(parser.value("conf"), QSettings::IniFormat));
+        if (settings->status() != QSettings::NoError)
+        {
+            std::cerr << "Can not read " << parser.value("conf").toStdString() << std::endl;
+            return 2;
+        }
+        ver = settings->value("configversion", 0).toInt();
+    }
+
+    /* Input */
+    double rate = 1e6;
+    if (settings)
+        rate = settings->value("input/sample_rate", rate).toDouble();
+    if (parser.isSet("rate"))
+        rate = parser.value("rate").toDouble();
+    if (rate <= 0.0)
+    {
+        std::cerr << "Invalid sample rate." << std::endl;
+        return 2;
+    }
+
+    /* VFO plan */
+    std::vector<vfo_plan> plan;
+    if (settings)
+    {
+        QString grp = (ver >= 4) ? "rx0" : "receiver";
+        for (int i = 0; settings->contains(grp + "/offset") || settings->contains(grp + "/demod"); )
+        {
+            Modulations::idx mode = Modulations::MODE_AM;
+            if (settings->contains(grp + "/demod"))
+                mode = (ver >= 3) ?
+                    Modulations::GetEnumForModulationString(settings->value(grp + "/demod").toString().toStdString()) :
+                    Modulations::ConvertFromOld(settings->value(grp + "/demod").toInt());
+            plan.push_back({grp, settings->value(grp + "/offset", 0).toLongLong(), mode});
+            if (ver < 4)
+                break;
+            grp = QString("rx%1").arg(++i);
+        }
+    }
+    if (plan.empty())
+        plan.push_back({QString(), 0, Modulations::MODE_NFM});
+
+    int nvfos = parser.isSet("vfos") ? parser.value("vfos").toInt() : int(plan.size());
+    nvfos = std::max(1, std::min(nvfos, RX_MAX));
+    qint64 spacing = parser.isSet("spacing") ? parser.value("spacing").toLongLong() : 25000;
+    const vfo_plan last = plan.back();
+    for (int k = 0; int(plan.size()) < nvfos; k++)
+    {
+        // alternate around the last configured VFO: +1, -1, +2, -2...
+        vfo_plan v = last;
+        v.offset += ((k % 2) ? -(k / 2 + 1) : (k / 2 + 1)) * spacing;
+        plan.push_back(v);
+    }
+    plan.resize(nvfos, last);
+    if (parser.isSet("mode"))
+    {
+#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
+        QStringList modes = parser.value("mode").split(',', QString::SkipEmptyParts);
+#else
+        QStringList modes = parser.value("mode").split(',', Qt::SkipEmptyParts);
+#endif
+        for (size_t k = 0; k < plan.size() && !modes.isEmpty(); k++)
+            plan[k].mode = Modulations::GetEnumForModulationString(modes[k % modes.size()].trimmed().toStdString());
+    }
+    for (auto &v : plan)
+        if (std::abs(double(v.offset)) > rate * 0.45)
+        {
+            std::cerr << "VFO offset " << v.offset << " is outside of the input bandwidth." << std::endl;
+            return 2;
+        }
+
+    /* I/Q file */
+    QTemporaryDir tmpdir;
+    QString filename;
+    file_formats fmt;
+    if (parser.isSet("synthetic"))
+    {
+        filename = tmpdir.filePath("synthetic_fc.raw");
+        fmt = FILE_FORMAT_CF;
+        if (!tmpdir.isValid() ||
+            !write_synthetic(filename, rate, parser.value("synthetic").toDouble(), plan))
+        {
+            std::cerr << "Can not write the synthetic I/Q file." << std::endl;
+            return 2;
+        }
+    }
+    else
+    {
+        filename = parser.value("input");
+        fmt = parser.isSet("iq-format") ? parse_format(parser.value("iq-format"), false) :
+                                          parse_format(filename, true);
+        if (fmt == FILE_FORMAT_NONE)
+            fmt = FILE_FORMAT_CF;
+    }
+
+    /* Receiver */
+    receiver rx("", "", 1);
+    rx.set_iq_fft_enabled(false);
+    rx.set_audio_fft_enabled(false);
+    int audio_rate = settings ? settings->value("output/sample_rate", 48000).toInt() : 48000;
+    if (audio_rate > 0)
+        rx.set_audio_rate(audio_rate);
+
+    audio_hash_sink::sptr audio = audio_hash_sink::make(parser.value("audio-out").toStdString());
+    rx.set_iq_playback_speed(0.0);
+    rx.set_fast_audio_sink(audio);
+    try
+    {
+        rx.set_input_file(filename.toStdString(), int(rate), fmt, 0, 4, false);
+    }
+    catch (std::exception &x)
+    {
+        std::cerr << "Can not play " << filename.toStdString() << ": " << x.what() << std::endl;
+        return 2;
+    }
+    rx.set_input_rate(rate);
+    if (settings)
+    {
+        int decim = settings->value("input/decimation", 1).toInt();
+        if (decim > 1)
+            rx.set_input_decim(decim);
+    }
+
+    int chan_threads = settings ? settings->value("gui/fft_channelizer", 0).toInt() : 0;
+    if (parser.isSet("channelizer"))
+        chan_threads = parser.value("channelizer").toInt();
+    rx.set_channelizer(chan_threads);
+
+    for (size_t k = 0; k < plan.size(); k++)
+    {
+        if (k > 0)
+            rx.add_rx();
+        rx.set_filter_offset(double(plan[k].offset));
+        rx.set_demod(plan[k].mode);
+        int low, high;
+        if (Modulations::GetFilterPreset(plan[k].mode, FILTER_PRESET_NORMAL, low, high))
+            rx.set_filter(low, high, Modulations::FILTER_SHAPE_NORMAL);
+        if (settings && !plan[k].group.isEmpty())
+        {
+            settings->beginGroup(plan[k].group);
+            read_vfo_settings(*settings, rx);
+            settings->endGroup();
+        }
+    }
+    rx.commit_audio_rate();
+
+    /* Run to the end of the file */
+    const int timeout = parser.isSet("timeout") ? parser.value("timeout").toInt() : 30;
+    thread_cpu_monitor before, during;
+    before.sample();
+    const double cpu0 = process_cpu_seconds();
+    std::atomic<bool> done{false};
+    auto t0 = std::chrono::steady_clock::now();
+    rx.start();
+    std::thread waiter([&]() {
+        rx.wait();
+        done = true;
+    });
+
+    size_t last_pos = 0;
+    auto last_progress = std::chrono::steady_clock::now();
+    while (!done)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        during.sample();
+        receiver::iq_tool_stats stats;
+        rx.get_iq_tool_stats(stats);
+        auto now = std::chrono::steady_clock::now();
+        if (stats.file_pos != last_pos)
+        {
+            last_pos = stats.file_pos;
+            last_progress = now;
+        }
+        else if (!done && now - last_progress > std::chrono::seconds(timeout))
+        {
+            std::cerr << "The flowgraph stalled at sample " << stats.sample_pos << "." << std::endl;
+            std::_Exit(2);
+        }
+    }
+    waiter.join();
+    auto t1 = std::chrono::steady_clock::now();
+    const double cpu1 = process_cpu_seconds();
+
+    receiver::iq_tool_stats stats;
+    rx.get_iq_tool_stats(stats);
+    const double seconds = std::chrono::duration<double>(t1 - t0).count();
+    const double samples = double(stats.sample_pos);
+
+    /* Report */
+    QJsonObject report;
+    report["version"] = VERSION;
+    report["input"] = parser.isSet("synthetic") ? QString("synthetic") : filename;
+    report["format"] = any_to_any_base::fmt[fmt].name;
+    report["sample_rate"] = rate;
+    report["channelizer"] = chan_threads;
+    QJsonArray vfos;
+    for (auto &v : plan)
+        vfos.append(QJsonObject{{"offset", double(v.offset)},
+                                {"mode", Modulations::GetStringForModulationIndex(v.mode)}});
+    report["vfos"] = vfos;
+    report["samples"] = samples;
+    report["seconds"] = seconds;
+    report["samples_per_sec"] = seconds > 0.0 ? samples / seconds : 0.0;
+    report["realtime_factor"] = seconds > 0.0 ? samples / rate / seconds : 0.0;
+    if (cpu0 >= 0.0)
+        report["cpu_seconds"] = cpu1 - cpu0;
+
+    std::vector<std::pair<std::string, double>> threads;
+    for (auto &t : during.by_name(before))
+        threads.push_back(t);
+    std::sort(threads.begin(), threads.end(),
+              [](const std::pair<std::string, double> &a,
+                 const std::pair<std::string, double> &b) { return a.second > b.second; });
+    QJsonArray jthreads;
+    for (auto &t : threads)
+        jthreads.append(QJsonObject{{"name", QString::fromStdString(t.first)},
+                                    {"cpu_seconds", t.second}});
+    report["threads"] = jthreads;
+
+    QJsonObject jaudio;
+    jaudio["samples"] = double(audio->samples());
+    jaudio["hash"] = hex(audio->hash());
+    jaudio["pcm16_hash"] = hex(audio->pcm_hash());
+    jaudio["rms_left"] = audio->rms_left();
+    jaudio["rms_right"] = audio->rms_right();
+    report["audio"] = jaudio;
+
+    std::printf("input:       %s (%s)\n", report["input"].toString().toStdString().c_str(),
+                any_to_any_base::fmt[fmt].name);
+    std::printf("vfos:        %d, channelizer %s\n", int(plan.size()),
+                chan_threads ? QString("%1 threads").arg(chan_threads).toStdString().c_str() : "off");
+    std::printf("samples:     %.0f in %.3f s, %.4g samples/s, %.2fx real time\n", samples,
+                seconds, report["samples_per_sec"].toDouble(), report["realtime_factor"].toDouble());
+    if (cpu0 >= 0.0)
+        std::printf("cpu:         %.3f s\n", cpu1 - cpu0);
+    for (auto &t : threads)
+        std::printf("  %-20s %8.3f s\n", t.first.c_str(), t.second);
+    std::printf("audio:       %llu samples, hash %s, pcm16 %s, rms %.4f %.4f\n",
+                (unsigned long long)audio->samples(),
+                jaudio["hash"].toString().toStdString().c_str(),
+                jaudio["pcm16_hash"].toString().toStdString().c_str(),
+                audio->rms_left(), audio->rms_right());
+
+    if (parser.isSet("output"))
+    {
+        QFile out(parser.value("output"));
+        if (!out.open(QIODevice::WriteOnly) ||
+            out.write(QJsonDocument(report).toJson()) < 0)
+        {
+            std::cerr << "Can not write " << parser.value("output").toStdString() << std::endl;
+            return 2;
+        }
+    }
+
+    int ret = 0;
+    if (parser.isSet("golden"))
+    {
+        QFile in(parser.value("golden"));
+        if (!in.open(QIODevice::ReadOnly))
+        {
+            std::cerr << "Can not read " << parser.value("golden").toStdString() << std::endl;
+            return 2;
+        }
+        QJsonObject golden = QJsonDocument::fromJson(in.readAll()).object();
+        QJsonObject gaudio = golden["audio"].toObject();
+        bool same_samples = gaudio["samples"].toDouble() == jaudio["samples"].toDouble();
+        bool same_hash = gaudio["hash"].toString() == jaudio["hash"].toString();
+        bool same_pcm = gaudio["pcm16_hash"].toString() == jaudio["pcm16_hash"].toString();
+        const char * verdict = "MISMATCH";
+        if (same_samples && same_hash)
+            verdict = "identical";
+        else if (same_samples && same_pcm)
+            verdict = "equivalent (16 bit PCM)";
+        else
+            ret = 1;
+        std::printf("golden:      %s", verdict);
+        double grate = golden["samples_per_sec"].toDouble();
+        if (grate > 0.0)
+            std::printf(", throughput %+.1f%%", 100.0 * (report["samples_per_sec"].toDouble() / grate - 1.0));
+        std::printf("\n");
+    }
+    return ret;
+}
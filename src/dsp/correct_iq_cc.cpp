@@ -23,7 +23,6 @@
 #include <gnuradio/io_signature.h>
 #include <gnuradio/gr_complex.h>
 #include <iostream>
-#include <QDebug>
 #include "dsp/correct_iq_cc.h"
 
 
@@ -46,8 +45,6 @@ dc_corr_cc::dc_corr_cc(double sample_rate, double tau)
     d_tau = tau;
     d_alpha = 1.0 / (1.0 + d_tau * sample_rate);
 
-    qDebug() << "IQ DCR alpha:" << d_alpha;
-
     d_iir = gr::filter::single_pole_iir_filter_cc::make(d_alpha, 1);
     d_sub = gr::blocks::sub_cc::make(1);
 
@@ -69,9 +66,6 @@ void dc_corr_cc::set_sample_rate(double sample_rate)
     d_alpha = 1.0 / (1.0 + d_tau * sample_rate);
 
     d_iir->set_taps(d_alpha);
-
-    qDebug() << "IQ DCR samp_rate:" << sample_rate;
-    qDebug() << "IQ DCR alpha:" << d_alpha;
 }
 
 /*! \brief Set new time constant. */
@@ -81,8 +75,6 @@ void dc_corr_cc::set_tau(double tau)
     d_alpha = 1.0 / (1.0 + d_tau * d_sr);
 
     d_iir->set_taps(d_alpha);
-
-    qDebug() << "IQ DCR alpha:" << d_alpha;
 }
 
 
@@ -111,8 +103,6 @@ void iq_swap_cc::set_enabled(bool enabled)
     if (enabled == d_enabled)
         return;
 
-    qDebug() << "IQ swap:" << enabled;
-
     d_enabled = enabled;
 }
 
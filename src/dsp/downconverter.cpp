@@ -20,6 +20,7 @@
  * the Free Software Foundation, Inc., 51 Franklin Street,
  * Boston, MA 02110-1301, USA.
  */
+#include <algorithm>
 #include <math.h>
 #include <gnuradio/filter/firdes.h>
 #include <gnuradio/io_signature.h>
@@ -39,7 +40,9 @@ downconverter_cc::downconverter_cc(unsigned int decim, double center_freq, doubl
           gr::io_signature::make(1, 1, sizeof(gr_complex))),
       d_decim(decim),
       d_center_freq(center_freq),
-      d_samp_rate(samp_rate)
+      d_samp_rate(samp_rate),
+      d_output_multiple(0),
+      d_max_buffer(0)
 {
     connect_all();
     update_proto_taps();
@@ -72,18 +75,52 @@ void downconverter_cc::set_center_freq(double center_freq)
     update_phase_inc();
 }
 
+/*! \brief Set the output multiple and the maximum output buffer.
+ *  \param output_multiple Output multiple of the decimating filter, 0 for
+ *                         the default of 50 ms.
+ *  \param max_buffer Maximum output buffer in items, 0 for the GNU Radio default.
+ *
+ * Takes effect, when the flowgraph is restarted or unlocked.
+ */
+void downconverter_cc::set_buffering(int output_multiple, int max_buffer)
+{
+    d_output_multiple = output_multiple;
+    d_max_buffer = max_buffer;
+    if (d_decim > 1)
+    {
+        filt->set_output_multiple(this->output_multiple());
+        filt->set_max_output_buffer(d_max_buffer);
+    }
+    else
+    {
+        rot->set_max_output_buffer(d_max_buffer);
+    }
+}
+
+/*! \brief Output multiple of the decimating filter, 1 without decimation. */
+int downconverter_cc::output_multiple() const
+{
+    if (d_decim <= 1)
+        return 1;
+    if (d_output_multiple > 0)
+        return d_output_multiple;
+    return std::max(1, int(d_samp_rate / (d_decim * 20)));
+}
+
 void downconverter_cc::connect_all()
 {
     if (d_decim > 1)
     {
         filt = gr::filter::freq_xlating_fir_filter_ccf::make(d_decim, {1}, 0.0, d_samp_rate);
-        filt->set_output_multiple(d_samp_rate/(d_decim*20));
+        filt->set_output_multiple(output_multiple());
+        filt->set_max_output_buffer(d_max_buffer);
         connect(self(), 0, filt, 0);
         connect(filt, 0, self(), 0);
     }
     else
     {
         rot = gr::blocks::rotator_cc::make(0.0);
+        rot->set_max_output_buffer(d_max_buffer);
         connect(self(), 0, rot, 0);
         connect(rot, 0, self(), 0);
     }
@@ -49,11 +49,15 @@ public:
     ~downconverter_cc();
     void set_decim_and_samp_rate(unsigned int decim, double samp_rate);
     void set_center_freq(double center_freq);
+    void set_buffering(int output_multiple, int max_buffer);
+    int  output_multiple() const;
 
 private:
     unsigned int d_decim;
     double d_center_freq;
     double d_samp_rate;
+    int d_output_multiple;
+    int d_max_buffer;
     std::vector<float> d_proto_taps;
 
     void connect_all();
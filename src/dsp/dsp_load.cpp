@@ -0,0 +1,289 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <set>
+#include <gnuradio/block_detail.h>
+#include <gnuradio/buffer.h>
+#if GNURADIO_VERSION >= 0x031000
+#include <gnuradio/buffer_reader.h>
+#endif
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/prefs.h>
+#include "dsp/dsp_load.h"
+
+namespace
+{
+    typedef std::vector<gr::block_sptr> block_vector;
+
+    /* Blocks reading from the outputs of block. */
+    void readers(const gr::block_sptr &block, block_vector &out)
+    {
+        gr::block_detail_sptr d = block->detail();
+
+        if (!d)
+            return;
+        for (int i = 0; i < d->noutputs(); i++)
+        {
+            gr::buffer_sptr buf = d->output(i);
+            for (size_t k = 0; k < buf->nreaders(); k++)
+                out.push_back(buf->reader(k)->link());
+        }
+    }
+
+    /* Blocks writing to the inputs of block. */
+    void writers(const gr::block_sptr &block, block_vector &out)
+    {
+        gr::block_detail_sptr d = block->detail();
+
+        if (!d)
+            return;
+        for (int i = 0; i < d->ninputs(); i++)
+            out.push_back(d->input(i)->buffer()->link());
+    }
+
+    /* Collect the blocks connected to start without passing a block in stop. */
+    void component(const gr::block_sptr &start, const std::set<gr::block *> &stop,
+                   std::set<gr::block *> &seen, block_vector &out)
+    {
+        block_vector todo{start};
+        block_vector next;
+
+        seen.insert(start.get());
+        while (!todo.empty())
+        {
+            gr::block_sptr b = todo.back();
+            todo.pop_back();
+            out.push_back(b);
+            next.clear();
+            readers(b, next);
+            writers(b, next);
+            for (auto &n : next)
+                if (stop.count(n.get()) == 0 && seen.insert(n.get()).second)
+                    todo.push_back(n);
+        }
+    }
+
+    /* Fullness of the fullest output buffer, or input buffer for sinks. */
+    float buffer_full(const gr::block_detail_sptr &d)
+    {
+        float full = 0.f;
+
+        if (d->noutputs() > 0)
+        {
+            for (int i = 0; i < d->noutputs(); i++)
+            {
+                gr::buffer_sptr buf = d->output(i);
+                int size = buf->bufsize();
+                if (size > 0)
+                    full = std::max(full, float(size - buf->space_available()) / size);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < d->ninputs(); i++)
+            {
+                gr::buffer_reader_sptr r = d->input(i);
+                int size = r->buffer()->bufsize();
+                if (size > 0)
+                    full = std::max(full, float(r->items_available()) / size);
+            }
+        }
+        return std::min(full, 1.f);
+    }
+
+    /* Memory of the output buffers and of the internal buffers of a block. */
+    size_t block_memory(const gr::block_sptr &block, const gr::block_detail_sptr &d)
+    {
+        size_t bytes = 0;
+
+        for (int i = 0; i < d->noutputs(); i++)
+            bytes += size_t(d->output(i)->bufsize()) *
+                     block->output_signature()->sizeof_stream_item(i);
+
+        auto *user = dynamic_cast<dsp_memory_user *>(block.get());
+        if (user)
+            bytes += user->memory_bytes();
+        return bytes;
+    }
+}
+
+dsp_load_sampler::dsp_load_sampler()
+    : d_valid(false),
+      d_has_work_time(true)
+{
+}
+
+void dsp_load_sampler::sample(const gr::block_sptr &fork,
+                              const std::vector<gr::block_sptr> &merge,
+                              const std::map<int, int> &port_vfo,
+                              std::vector<dsp_load_block> &blocks,
+                              std::vector<dsp_load_vfo> &vfos)
+{
+    clock::time_point now = clock::now();
+    double elapsed = std::chrono::duration<double>(now - d_last).count();
+    double tps = double(gr::high_res_timer_tps());
+    bool valid = d_valid && elapsed > 0.0;
+
+    blocks.clear();
+    vfos.clear();
+    if (!fork || !fork->detail())
+    {
+        reset();
+        return;
+    }
+
+    // Mixer input buffers by port
+    std::map<gr::buffer *, int> merge_port;
+    std::set<gr::block *> stop{fork.get()};
+    for (auto &m : merge)
+    {
+        gr::block_detail_sptr d = m->detail();
+
+        stop.insert(m.get());
+        if (!d)
+            continue;
+        for (int i = 0; i < d->ninputs(); i++)
+            merge_port[d->input(i)->buffer().get()] = i;
+    }
+
+    // Every reader of the fork starts either a VFO or a shared branch,
+    // like the I/Q FFT. A VFO branch ends at the mixer.
+    std::map<gr::block *, int> group;
+    std::set<gr::block *> to_merge;
+    std::set<gr::block *> seen(stop);
+    block_vector entries;
+    readers(fork, entries);
+    for (auto &e : entries)
+    {
+        block_vector branch;
+        int vfo = -1;
+
+        if (seen.count(e.get()))
+            continue;
+        component(e, stop, seen, branch);
+        for (auto &b : branch)
+        {
+            gr::block_detail_sptr d = b->detail();
+            for (int i = 0; d && i < d->noutputs(); i++)
+            {
+                auto port = merge_port.find(d->output(i).get());
+                if (port == merge_port.end())
+                    continue;
+                to_merge.insert(b.get());
+                auto v = port_vfo.find(port->second);
+                if (v != port_vfo.end())
+                    vfo = v->second;
+            }
+        }
+        for (auto &b : branch)
+            group[b.get()] = vfo;
+    }
+
+    block_vector all;
+    seen.clear();
+    component(fork, std::set<gr::block *>(), seen, all);
+
+    std::map<long, uint64_t> items;
+    std::map<int, double> vfo_rate;
+    bool any_items = false;
+    bool any_time = false;
+    for (auto &b : all)
+    {
+        gr::block_detail_sptr d = b->detail();
+        dsp_load_block l;
+        uint64_t n = 0;
+
+        if (!d)
+            continue;
+        if (d->noutputs() > 0)
+            n = b->nitems_written(0);
+        else if (d->ninputs() > 0)
+            n = b->nitems_read(0);
+        items[b->unique_id()] = n;
+
+        auto g = group.find(b.get());
+        auto prev = d_items.find(b->unique_id());
+        bool active = valid && prev != d_items.end() && n > prev->second;
+
+        // The work time total restarts with the first work() call after
+        // the reset, so it is stale for blocks, that did not run since.
+        double work = b->pc_work_time_total() / tps;
+        b->reset_perf_counters();
+
+        l.name = b->name() + std::to_string(b->unique_id());
+        l.vfo = (g == group.end()) ? -1 : g->second;
+        l.load = active ? work / elapsed : 0.0;
+        l.items_per_sec = active ? double(n - prev->second) / elapsed : 0.0;
+        l.buffer_full = buffer_full(d);
+        l.memory = block_memory(b, d);
+        blocks.push_back(l);
+
+        if (active)
+        {
+            any_items = true;
+            any_time |= work > 0.0;
+        }
+        if (to_merge.count(b.get()))
+            vfo_rate[l.vfo] = std::max(vfo_rate[l.vfo], l.items_per_sec);
+    }
+    if (any_items)
+        d_has_work_time = any_time;
+
+    std::stable_sort(blocks.begin(), blocks.end(),
+                     [](const dsp_load_block &a, const dsp_load_block &b) { return a.vfo < b.vfo; });
+    vfos.push_back({-1, 0, 0.0, 0.0, 0.f, 0});
+    for (auto &l : blocks)
+    {
+        if (vfos.back().vfo != l.vfo)
+            vfos.push_back({l.vfo, 0, 0.0, vfo_rate[l.vfo], 0.f, 0});
+        dsp_load_vfo &v = vfos.back();
+        v.blocks++;
+        v.load += l.load;
+        v.buffer_full = std::max(v.buffer_full, l.buffer_full);
+        v.memory += l.memory;
+    }
+
+    d_items.swap(items);
+    d_last = now;
+    d_valid = true;
+}
+
+void dsp_load_sampler::reset()
+{
+    d_items.clear();
+    d_valid = false;
+}
+
+bool dsp_load_sampler::perf_counters_enabled()
+{
+    return gr::prefs::singleton()->get_bool("PerfCounters", "on", false);
+}
+
+gr::block_sptr dsp_load_sampler::writer(const gr::block_sptr &block, int port)
+{
+    gr::block_detail_sptr d = block->detail();
+
+    if (!d || port >= d->ninputs())
+        return gr::block_sptr();
+    return d->input(port)->buffer()->link();
+}
@@ -0,0 +1,130 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef DSP_LOAD_H
+#define DSP_LOAD_H
+
+#include <gnuradio/block.h>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/*! \brief Load of one primitive block between two samples. */
+struct dsp_load_block
+{
+    std::string name;          /*!< Block name and unique id, e.g. rx_agc_2f42. */
+    int         vfo;           /*!< VFO index or -1 for the blocks shared by all VFOs. */
+    double      load;          /*!< Work time per wall time, 1.0 is one core. */
+    double      items_per_sec; /*!< Items produced per second (consumed for sinks). */
+    float       buffer_full;   /*!< Fullest output (input for sinks) buffer, 0 to 1. */
+    size_t      memory;        /*!< Bytes of the output buffers and internal history. */
+};
+
+/*! \brief Load of one VFO or of the shared blocks, summed over its blocks. */
+struct dsp_load_vfo
+{
+    int         vfo;           /*!< VFO index or -1 for the shared blocks. */
+    int         blocks;        /*!< Number of primitive blocks. */
+    double      load;          /*!< Sum of the block loads. */
+    double      items_per_sec; /*!< Audio samples per second delivered to the mixer. */
+    float       buffer_full;   /*!< Fullest buffer of all blocks. */
+    size_t      memory;        /*!< Sum of the block memory. */
+};
+
+/*!
+ * \brief Interface of blocks with a large internal buffer.
+ *
+ * The sampler adds the memory reported here to the memory of the output
+ * buffers of the block, e.g. for the sample history of FFTs and meters.
+ */
+class dsp_memory_user
+{
+public:
+    virtual ~dsp_memory_user() {}
+
+    /*! \brief Bytes allocated for internal buffers. */
+    virtual size_t memory_bytes() const = 0;
+};
+
+/*!
+ * \brief Sample per-block DSP load of a running flowgraph.
+ *
+ * Hier blocks do not exist in the running flowgraph, so the primitive
+ * blocks are found by following the buffers between them, starting at the
+ * block that feeds the VFOs (fork). The blocks connected to a reader of
+ * the fork, without passing the fork or the audio mixer (merge), belong
+ * to the VFO connected to that mixer port. Everything else is shared.
+ *
+ * Work time comes from the GNU Radio performance counters, which have to
+ * be enabled before the flowgraph is started ([PerfCounters] on = True),
+ * and is reset on every sample. Item counts and buffer fullness do not
+ * depend on the counters. Call sample() from the thread, that (re)connects
+ * the flowgraph, and only while it is running.
+ */
+class dsp_load_sampler
+{
+public:
+    dsp_load_sampler();
+
+    /*!
+     * \brief Sample all blocks.
+     * \param fork The primitive block, that feeds the VFOs.
+     * \param merge The primitive audio mixer blocks.
+     * \param port_vfo VFO index by mixer input port.
+     * \param blocks Block loads, ordered by VFO.
+     * \param vfos Loads of the shared blocks (vfo = -1) and of every VFO.
+     */
+    void sample(const gr::block_sptr &fork,
+                const std::vector<gr::block_sptr> &merge,
+                const std::map<int, int> &port_vfo,
+                std::vector<dsp_load_block> &blocks,
+                std::vector<dsp_load_vfo> &vfos);
+
+    /*! \brief Forget the previous sample, e.g. after the flowgraph was stopped. */
+    void reset();
+
+    /*! \brief Whether the performance counters are enabled in the GNU Radio preferences. */
+    static bool perf_counters_enabled();
+
+    /*!
+     * \brief Whether work time is available.
+     *
+     * False if items were processed, but no block reported work time,
+     * i.e. GNU Radio was built without performance counters.
+     */
+    bool has_work_time() const { return d_has_work_time; }
+
+    /*! \brief The primitive block writing to input port of block. */
+    static gr::block_sptr writer(const gr::block_sptr &block, int port);
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    std::map<long, uint64_t>  d_items;     /*!< Item count of the previous sample by block id. */
+    clock::time_point         d_last;      /*!< Time of the previous sample. */
+    bool                      d_valid;     /*!< d_last and d_items are valid. */
+    bool                      d_has_work_time;
+};
+
+#endif // DSP_LOAD_H
@@ -22,6 +22,19 @@
  */
 
 #include "format_converter.h"
+#include <cmath>
+
+/*
+ * Packed formats: clamp to the int16 range and round to nearest even, same
+ * as volk_32f_s32f_convert_16i in the 32/64 bit converters and the SIMD
+ * kernels. NaN ends up at the upper limit.
+ */
+static inline int round16(float x)
+{
+    x = (x < 32767.f) ? x : 32767.f;
+    x = (x > -32768.f) ? x : -32768.f;
+    return int(lrintf(x));
+}
 
 void any_to_any_impl::convert(const gr_complex *in, gr_complex * out, int noutput_items)
 {
@@ -124,14 +137,14 @@ void any_to_any_impl::convert(const gr_complex *in, std::array<int8_t,40> * out,
     {
         int i;
         int q;
-        i = std::round(in->real()*d_scale);
-        q = std::round(in->imag()*d_scale);
+        i = round16(in->real()*d_scale);
+        q = round16(in->imag()*d_scale);
         in++;
         p[0] = i & 0xff;
         p[1] = ((i & 0x0300) >> 8) | ((q & 0x3f) << 2);
         p[2] = (q >> 6) & 0x0f;
-        i = std::round(in->real()*d_scale);
-        q = std::round(in->imag()*d_scale);
+        i = round16(in->real()*d_scale);
+        q = round16(in->imag()*d_scale);
         in++;
         p[2] |= (i & 0x0f) << 4;
         p[3] = ((i & 0x3f0) >> 4) | ((q & 0x03) << 6);
@@ -169,8 +182,8 @@ void any_to_any_impl::convert(const gr_complex *in, std::array<int8_t,24> * out,
     {
         int i;
         int q;
-        i = std::round(in->real()*d_scale);
-        q = std::round(in->imag()*d_scale);
+        i = round16(in->real()*d_scale);
+        q = round16(in->imag()*d_scale);
         in++;
         p[0] = i & 0xff;
         p[1] = (i & 0x0f00) >> 8 | (q & 0x0f)<<4;
@@ -224,15 +237,15 @@ void any_to_any_impl::convert(const gr_complex *in, std::array<int8_t,56> * out,
     {
         int i;
         int q;
-        i = std::round(in->real()*d_scale);
-        q = std::round(in->imag()*d_scale);
+        i = round16(in->real()*d_scale);
+        q = round16(in->imag()*d_scale);
         in++;
         p[0] = i & 0xff;
         p[1] = ((i & 0x3f00) >> 8) | ((q & 0x03) << 6);
         p[2] = (q >> 2) & 0xff;
         p[3] = (q >> 10) & 0x0f;
-        i = std::round(in->real()*d_scale);
-        q = std::round(in->imag()*d_scale);
+        i = round16(in->real()*d_scale);
+        q = round16(in->imag()*d_scale);
         in++;
         p[3] |= (i & 0x0f) << 4;
         p[4] = (i >> 4) & 0xff;
@@ -275,16 +288,16 @@ void any_to_any_impl::convert(const gr_complex *in, std::array<int16_t,20> * out
     {
         int i0;
         int i1;
-        i0 = std::round(in->real()*d_scale);
+        i0 = round16(in->real()*d_scale);
         in++;
-        i1 = std::round(in->real()*d_scale);
+        i1 = round16(in->real()*d_scale);
         in++;
         p[0] = i0 & 0xff;
         p[1] = ((i0 & 0x0300) >> 8) | ((i1 & 0x3f) << 2);
         p[2] = (i1 >> 6) & 0x0f;
-        i0 = std::round(in->real()*d_scale);
+        i0 = round16(in->real()*d_scale);
         in++;
-        i1 = std::round(in->real()*d_scale);
+        i1 = round16(in->real()*d_scale);
         in++;
         p[2] |= (i0 & 0x0f) << 4;
         p[3] = ((i0 & 0x3f0) >> 4) | ((i1 & 0x03) << 6);
@@ -314,7 +327,7 @@ void any_to_any_impl::convert(const std::array<int16_t,20> *in, gr_complex * out
         *out=gr_complex(float((i1&(1<<9))?i1-1024:i1)*d_scale_i);
         out++;
         p+=5;
-        noutput_items-=2;
+        noutput_items-=4;
     }
 }
 
@@ -326,9 +339,9 @@ void any_to_any_impl::convert(const gr_complex *in, std::array<int16_t,12> * out
     {
         int i0;
         int i1;
-        i0 = std::round(in->real()*d_scale);
+        i0 = round16(in->real()*d_scale);
         in++;
-        i1 = std::round(in->real()*d_scale);
+        i1 = round16(in->real()*d_scale);
         in++;
         p[0] = i0 & 0xff;
         p[1] = (i0 & 0x0f00) >> 8 | (i1 & 0x0f)<<4;
@@ -352,7 +365,7 @@ void any_to_any_impl::convert(const std::array<int16_t,12> *in, gr_complex * out
         *out=gr_complex(float((i1&(1<<11))?i1-4096:i1)*d_scale_i);
         out++;
         p+=3;
-        noutput_items--;
+        noutput_items-=2;
     }
 }
 
@@ -388,17 +401,17 @@ void any_to_any_impl::convert(const gr_complex *in, std::array<int16_t,28> * out
     {
         int i0;
         int i1;
-        i0 = std::round(in->real()*d_scale);
+        i0 = round16(in->real()*d_scale);
         in++;
-        i1 = std::round(in->real()*d_scale);
+        i1 = round16(in->real()*d_scale);
         in++;
         p[0] = i0 & 0xff;
         p[1] = ((i0 & 0x3f00) >> 8) | ((i1 & 0x03) << 6);
         p[2] = (i1 >> 2) & 0xff;
         p[3] = (i1 >> 10) & 0x0f;
-        i0 = std::round(in->real()*d_scale);
+        i0 = round16(in->real()*d_scale);
         in++;
-        i1 = std::round(in->real()*d_scale);
+        i1 = round16(in->real()*d_scale);
         in++;
         p[3] |= (i0 & 0x0f) << 4;
         p[4] = (i0 >> 4) & 0xff;
@@ -1991,4 +2004,70 @@ void any_to_any_impl_bmi64::convert(const std::array<int8_t,56> *in, gr_complex
 
 #endif
 
+#ifdef FORMAT_CONVERTER_SIMD
+////////////////////////////////////////
+// runtime dispatched SIMD converters
+////////////////////////////////////////
+
+void any_to_any_impl_simd::convert(const gr_complex *in, std::array<int8_t,40> * out, int noutput_items)
+{
+    pack<10, true>(in, out, noutput_items);
+}
+
+void any_to_any_impl_simd::convert(const std::array<int8_t,40> *in, gr_complex * out, int noutput_items)
+{
+    unpack<10, true>(in, out, noutput_items);
+}
+
+void any_to_any_impl_simd::convert(const gr_complex *in, std::array<int8_t,24> * out, int noutput_items)
+{
+    pack<12, true>(in, out, noutput_items);
+}
+
+void any_to_any_impl_simd::convert(const std::array<int8_t,24> *in, gr_complex * out, int noutput_items)
+{
+    unpack<12, true>(in, out, noutput_items);
+}
+
+void any_to_any_impl_simd::convert(const gr_complex *in, std::array<int8_t,56> * out, int noutput_items)
+{
+    pack<14, true>(in, out, noutput_items);
+}
+
+void any_to_any_impl_simd::convert(const std::array<int8_t,56> *in, gr_complex * out, int noutput_items)
+{
+    unpack<14, true>(in, out, noutput_items);
+}
+
+void any_to_any_impl_simd::convert(const gr_complex *in, std::array<int16_t,20> * out, int noutput_items)
+{
+    pack<10, false>(in, out, noutput_items);
+}
+
+void any_to_any_impl_simd::convert(const std::array<int16_t,20> *in, gr_complex * out, int noutput_items)
+{
+    unpack<10, false>(in, out, noutput_items);
+}
+
+void any_to_any_impl_simd::convert(const gr_complex *in, std::array<int16_t,12> * out, int noutput_items)
+{
+    pack<12, false>(in, out, noutput_items);
+}
+
+void any_to_any_impl_simd::convert(const std::array<int16_t,12> *in, gr_complex * out, int noutput_items)
+{
+    unpack<12, false>(in, out, noutput_items);
+}
+
+void any_to_any_impl_simd::convert(const gr_complex *in, std::array<int16_t,28> * out, int noutput_items)
+{
+    pack<14, false>(in, out, noutput_items);
+}
+
+void any_to_any_impl_simd::convert(const std::array<int16_t,28> *in, gr_complex * out, int noutput_items)
+{
+    unpack<14, false>(in, out, noutput_items);
+}
+#endif
+
 constexpr std::array<any_to_any_base::format_descriptor, FILE_FORMAT_COUNT> any_to_any_base::fmt;
@@ -28,6 +28,7 @@
 #include <limits.h>
 #include <volk/volk.h>
 #include <array>
+#include "dsp/format_converter_simd.h"
 #ifdef __BMI2__
     #include <x86intrin.h>
 #endif
@@ -41,6 +42,7 @@ template <typename T_IN, typename T_OUT> class any_to_any_32;
 template <typename T_IN, typename T_OUT> class any_to_any_bmi32;
 template <typename T_IN, typename T_OUT> class any_to_any_64;
 template <typename T_IN, typename T_OUT> class any_to_any_bmi64;
+template <typename T_IN, typename T_OUT> class any_to_any_simd;
 
 enum file_formats {
     FILE_FORMAT_LAST=0,
@@ -61,6 +63,7 @@ enum file_formats {
     FILE_FORMAT_S12L,
     FILE_FORMAT_S14L,
     FILE_FORMAT_SIGMF,
+    FILE_FORMAT_CS16Z,
     FILE_FORMAT_COUNT,
 };
 
@@ -101,6 +104,7 @@ public:
         {3*8,2*8,"12i.raw","12 bit i"},
         {7*8,4*8,"14i.raw","14 bit i"},
         {8,1,"fc.sigmf-data","SIGMF"},
+        {4,1,"16z.raw","short 16 compressed"},
     };
 
     void set_decimation(unsigned decimation)
@@ -307,6 +311,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>6),16,1,"f32s10c"));
+                #endif
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
                     return gnuradio::get_initial_sptr(new any_to_any_bmi64<T_IN, T_OUT>(-float(INT16_MIN>>6),16,1,"f32s10c"));
@@ -326,6 +334,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>6),1,16,"s10f32c"));
+                #endif
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
                     return gnuradio::get_initial_sptr(new any_to_any_bmi64<T_IN, T_OUT>(-float(INT16_MIN),1,16,"s10f32c"));
@@ -345,6 +357,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>4),8,1,"f32s12c"));
+                #endif
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
                     return gnuradio::get_initial_sptr(new any_to_any_bmi64<T_IN, T_OUT>(-float(INT16_MIN>>4),8,1,"f32s12c"));
@@ -364,6 +380,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>4),1,8,"s12f32c"));
+                #endif
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
                     return gnuradio::get_initial_sptr(new any_to_any_bmi64<T_IN, T_OUT>(-float(INT16_MIN),1,8,"s12f32c"));
@@ -383,6 +403,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>2),16,1,"f32s14c"));
+                #endif
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
                     return gnuradio::get_initial_sptr(new any_to_any_bmi64<T_IN, T_OUT>(-float(INT16_MIN>>2),16,1,"f32s14c"));
@@ -402,6 +426,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>2),1,16,"s14f32c"));
+                #endif
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
                     return gnuradio::get_initial_sptr(new any_to_any_bmi64<T_IN, T_OUT>(-float(INT16_MIN),1,16,"s14f32c"));
@@ -441,6 +469,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>6),32,1,"f32s10"));
+                #endif
                 #if 0
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
@@ -462,6 +494,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>6),1,32,"s10f32"));
+                #endif
                 #if 0
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
@@ -483,6 +519,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>4),16,1,"f32s12"));
+                #endif
 #if 0
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
@@ -504,6 +544,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>4),1,16,"s12f32"));
+                #endif
 #if 0
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
@@ -525,6 +569,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>2),16,1,"f32s14"));
+                #endif
 #if 0
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
@@ -546,6 +594,10 @@ using any_to_any_base::sptr;
         {
             if(UINTPTR_MAX == 0xffffffffffffffff)
             {
+                #ifdef FORMAT_CONVERTER_SIMD
+                if(packed_simd::get().level != packed_simd::ISA_NONE)
+                    return gnuradio::get_initial_sptr(new any_to_any_simd<T_IN, T_OUT>(-float(INT16_MIN>>2),1,16,"s14f32"));
+                #endif
 #if 0
                 #ifdef __BMI2__
                 if( __builtin_cpu_supports("bmi2"))
@@ -807,4 +859,87 @@ private:
 };
 #endif
 
+#ifdef FORMAT_CONVERTER_SIMD
+////////////////////////////////////////
+// runtime dispatched SIMD converters
+////////////////////////////////////////
+
+class any_to_any_impl_simd : virtual public gr::sync_block, virtual public any_to_any_base
+{
+public:
+    using any_to_any_base::convert;
+protected:
+    void convert(const gr_complex *in, std::array<int8_t,40> * out, int noutput_items);
+    void convert(const std::array<int8_t,40> *in, gr_complex * out, int noutput_items);
+    void convert(const gr_complex *in, std::array<int8_t,24> * out, int noutput_items);
+    void convert(const std::array<int8_t,24> *in, gr_complex * out, int noutput_items);
+    void convert(const gr_complex *in, std::array<int8_t,56> * out, int noutput_items);
+    void convert(const std::array<int8_t,56> *in, gr_complex * out, int noutput_items);
+    void convert(const gr_complex *in, std::array<int16_t,20> * out, int noutput_items);
+    void convert(const std::array<int16_t,20> *in, gr_complex * out, int noutput_items);
+    void convert(const gr_complex *in, std::array<int16_t,12> * out, int noutput_items);
+    void convert(const std::array<int16_t,12> *in, gr_complex * out, int noutput_items);
+    void convert(const gr_complex *in, std::array<int16_t,28> * out, int noutput_items);
+    void convert(const std::array<int16_t,28> *in, gr_complex * out, int noutput_items);
+
+private:
+    template<int BITS, bool CPLX, typename T> void pack(const gr_complex *in, T * out, int noutput_items)
+    {
+        packed_simd::get().pack(BITS, CPLX, (const float *)in, (uint8_t *)out,
+                                size_t(noutput_items) * sizeof(T) * 8 / BITS, d_scale);
+    }
+
+    template<int BITS, bool CPLX, typename T> void unpack(const T *in, gr_complex * out, int noutput_items)
+    {
+        packed_simd::get().unpack(BITS, CPLX, (const uint8_t *)in, (float *)out,
+                                  size_t(noutput_items) * (CPLX ? 2 : 1), d_scale_i);
+    }
+};
+
+template <typename T_IN, typename T_OUT> class BLOCKS_API any_to_any_simd : virtual public gr::sync_block, virtual public any_to_any_base, virtual private any_to_any_impl_simd
+{
+public:
+
+    any_to_any_simd(const float scale, unsigned decimation, unsigned interpolation, const std::string bname):sync_block(bname,
+                gr::io_signature::make (1, 1, sizeof(T_IN)),
+                gr::io_signature::make (1, 1, sizeof(T_OUT)))
+    {
+        set_scale(scale);
+        set_decimation(decimation);
+        set_interpolation(interpolation);
+    }
+
+    int work(int noutput_items, gr_vector_const_void_star &input_items,
+    gr_vector_void_star &output_items) override
+    {
+        return work(noutput_items, input_items, output_items, dispatcher::tag<any_to_any_simd>());
+    }
+
+    void convert(const void *in, void *out, int noutput_items) override
+    {
+        convert(in, out, noutput_items, dispatcher::tag<any_to_any_simd>());
+    }
+
+private:
+    template<typename U_IN, typename U_OUT> int work(int noutput_items, gr_vector_const_void_star &input_items,
+    gr_vector_void_star &output_items, dispatcher::tag<any_to_any_simd<U_IN, U_OUT>>)
+    {
+        const U_IN *in = (const U_IN *) input_items[0];
+        U_OUT *out = (U_OUT *) output_items[0];
+
+        any_to_any_impl_simd::convert(in, out, noutput_items);
+        return noutput_items;
+    }
+
+    template<typename U_IN, typename U_OUT> void convert(const void *in, void *out, int noutput_items, dispatcher::tag<any_to_any_simd<U_IN, U_OUT>>)
+    {
+        const U_IN *u_in = (const U_IN *) in;
+        U_OUT *u_out = (U_OUT *) out;
+
+        any_to_any_impl_simd::convert(u_in, u_out, noutput_items);
+    }
+
+};
+#endif
+
 #endif /* INCLUDED_FORMAT_CONVERTER_H */
@@ -0,0 +1,504 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "dsp/format_converter_simd.h"
+#include "dsp/format_converter.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifdef FORMAT_CONVERTER_SIMD
+    #include <immintrin.h>
+#endif
+
+namespace packed_simd
+{
+
+///////////////////////
+// Portable reference
+///////////////////////
+
+static void unpack_ref(int bits, bool cplx, const uint8_t * in, float * out,
+                       size_t nvalues, float scale)
+{
+    const int sh = 64 - bits;
+    uint64_t acc = 0;
+    int nacc = 0;
+
+    for (size_t k = 0; k < nvalues; k++)
+    {
+        while (nacc < bits)
+        {
+            acc |= uint64_t(*in++) << nacc;
+            nacc += 8;
+        }
+        int32_t v = int32_t(int64_t(acc << sh) >> sh);
+        acc >>= bits;
+        nacc -= bits;
+        *out++ = float(v) * scale;
+        if (!cplx)
+            *out++ = 0.f;
+    }
+}
+
+static void pack_ref(int bits, bool cplx, const float * in, uint8_t * out,
+                     size_t nvalues, float scale)
+{
+    const uint32_t mask = (1u << bits) - 1;
+    uint64_t acc = 0;
+    int nacc = 0;
+
+    for (size_t k = 0; k < nvalues; k++)
+    {
+        float x = *in * scale;
+        in += cplx ? 1 : 2;
+        // same clamping and rounding as minps/maxps/cvtps2dq and round16()
+        // in format_converter.cpp, NaN ends up at the upper limit
+        x = (x < 32767.f) ? x : 32767.f;
+        x = (x > -32768.f) ? x : -32768.f;
+        acc |= uint64_t(uint32_t(lrintf(x)) & mask) << nacc;
+        nacc += bits;
+        while (nacc >= 8)
+        {
+            *out++ = acc & 0xff;
+            acc >>= 8;
+            nacc -= 8;
+        }
+    }
+    if (nacc > 0)
+        *out = acc & 0xff;
+}
+
+#ifdef FORMAT_CONVERTER_SIMD
+
+///////////////////////
+// AVX2
+///////////////////////
+
+/*
+ * 8 values are processed per iteration, 4 in each 128 bit lane. Every value
+ * is shuffled into a 32 bit element together with the bytes around it,
+ * shifted to the top and sign extended by an arithmetic right shift.
+ * The lanes are loaded separately, so that the shuffle does not need to
+ * cross them.
+ */
+__attribute__((target("avx2")))
+static void unpack_avx2(int bits, bool cplx, const uint8_t * in, float * out,
+                        size_t nvalues, float scale)
+{
+    const int half = bits / 2; // bytes per 4 values
+    uint8_t shuf[16];
+    int32_t cnt[8];
+
+    for (int k = 0; k < 4; k++)
+    {
+        int off = k * bits;
+        for (int j = 0; j < 4; j++)
+            shuf[k * 4 + j] = (off >> 3) + j;
+        cnt[k] = cnt[k + 4] = 32 - bits - (off & 7);
+    }
+    const __m256i vshuf = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)shuf));
+    const __m256i lcnt = _mm256_loadu_si256((const __m256i *)cnt);
+    const __m128i rcnt = _mm_cvtsi32_si128(32 - bits);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    const __m256 zero = _mm256_setzero_ps();
+    size_t nbytes = nvalues * bits / 8;
+
+    while ((nvalues >= 8) && (nbytes >= size_t(half + 16)))
+    {
+        __m256i x = _mm256_inserti128_si256(
+                        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)in)),
+                        _mm_loadu_si128((const __m128i *)(in + half)), 1);
+        x = _mm256_shuffle_epi8(x, vshuf);
+        x = _mm256_sra_epi32(_mm256_sllv_epi32(x, lcnt), rcnt);
+        __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(x), vscale);
+        if (cplx)
+        {
+            _mm256_storeu_ps(out, f);
+            out += 8;
+        }
+        else
+        {
+            __m256 lo = _mm256_unpacklo_ps(f, zero);
+            __m256 hi = _mm256_unpackhi_ps(f, zero);
+            _mm256_storeu_ps(out, _mm256_permute2f128_ps(lo, hi, 0x20));
+            _mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+            out += 16;
+        }
+        in += bits;
+        nbytes -= bits;
+        nvalues -= 8;
+    }
+    unpack_ref(bits, cplx, in, out, nvalues, scale);
+}
+
+/*
+ * Pairs of 32 bit elements are merged into 64 bit elements, then pairs of
+ * these into the low half of each 128 bit lane, which holds 4 packed values
+ * then. The lanes are stored with overlapping 8 byte writes.
+ */
+__attribute__((target("avx2")))
+static void pack_avx2(int bits, bool cplx, const float * in, uint8_t * out,
+                      size_t nvalues, float scale)
+{
+    const int half = bits / 2;
+    const __m256 vscale = _mm256_set1_ps(scale);
+    const __m256 vmax = _mm256_set1_ps(32767.f);
+    const __m256 vmin = _mm256_set1_ps(-32768.f);
+    const __m256i mask = _mm256_set1_epi32((1 << bits) - 1);
+    const __m256i lo32 = _mm256_set1_epi64x(0xffffffffll);
+    const __m128i c1 = _mm_cvtsi32_si128(bits);
+    const __m128i c2 = _mm_cvtsi32_si128(bits * 2);
+    size_t nbytes = nvalues * bits / 8;
+
+    while ((nvalues >= 8) && (nbytes >= size_t(half + 8)))
+    {
+        __m256 f;
+        if (cplx)
+        {
+            f = _mm256_loadu_ps(in);
+            in += 8;
+        }
+        else
+        {
+            f = _mm256_shuffle_ps(_mm256_loadu_ps(in), _mm256_loadu_ps(in + 8),
+                                  _MM_SHUFFLE(2, 0, 2, 0));
+            f = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(f), 0xd8));
+            in += 16;
+        }
+        f = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(f, vscale), vmax), vmin);
+        __m256i v = _mm256_and_si256(_mm256_cvtps_epi32(f), mask);
+        __m256i t = _mm256_or_si256(_mm256_and_si256(v, lo32),
+                                    _mm256_sll_epi64(_mm256_srli_epi64(v, 32), c1));
+        t = _mm256_or_si256(t, _mm256_sll_epi64(_mm256_srli_si256(t, 8), c2));
+        _mm_storel_epi64((__m128i *)out, _mm256_castsi256_si128(t));
+        _mm_storel_epi64((__m128i *)(out + half), _mm256_extracti128_si256(t, 1));
+        out += bits;
+        nbytes -= bits;
+        nvalues -= 8;
+    }
+    pack_ref(bits, cplx, in, out, nvalues, scale);
+}
+
+///////////////////////
+// AVX-512 VBMI
+///////////////////////
+
+/*
+ * Same algorithm as AVX2 with 16 values per iteration. vpermb gathers the
+ * bytes across the whole register and masked loads and stores keep the
+ * accesses inside the buffers.
+ *
+ * The zero masking forms with a full mask are used, where the unmasked
+ * intrinsic starts from _mm512_undefined_*(), that GCC reports with
+ * -Wmaybe-uninitialized. They compile to the same unmasked instructions.
+ */
+static const __mmask8 ALL8 = 0xff;
+static const __mmask16 ALL16 = 0xffff;
+static const __mmask64 ALL64 = ~__mmask64(0);
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+static void unpack_avx512(int bits, bool cplx, const uint8_t * in, float * out,
+                          size_t nvalues, float scale)
+{
+    uint8_t idx[64] = {0};
+    int32_t cnt[16];
+
+    for (int k = 0; k < 16; k++)
+    {
+        int off = k * bits;
+        for (int j = 0; j < 4; j++)
+            idx[k * 4 + j] = (off >> 3) + j;
+        cnt[k] = 32 - bits - (off & 7);
+    }
+    const __m512i vidx = _mm512_loadu_si512(idx);
+    const __m512i lcnt = _mm512_loadu_si512(cnt);
+    const __m128i rcnt = _mm_cvtsi32_si128(32 - bits);
+    const __m512 vscale = _mm512_set1_ps(scale);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512i zidx0 = _mm512_setr_epi32(0, 16, 1, 16, 2, 16, 3, 16,
+                                            4, 16, 5, 16, 6, 16, 7, 16);
+    const __m512i zidx1 = _mm512_setr_epi32(8, 16, 9, 16, 10, 16, 11, 16,
+                                            12, 16, 13, 16, 14, 16, 15, 16);
+
+    while (nvalues >= 16)
+    {
+        size_t nbytes = nvalues * bits / 8;
+        __mmask64 m = (nbytes >= 64) ? ~__mmask64(0) : ((__mmask64(1) << nbytes) - 1);
+        __m512i x = _mm512_maskz_loadu_epi8(m, in);
+        x = _mm512_maskz_permutexvar_epi8(ALL64, vidx, x);
+        x = _mm512_maskz_sra_epi32(ALL16, _mm512_maskz_sllv_epi32(ALL16, x, lcnt), rcnt);
+        __m512 f = _mm512_mul_ps(_mm512_maskz_cvtepi32_ps(ALL16, x), vscale);
+        if (cplx)
+        {
+            _mm512_storeu_ps(out, f);
+            out += 16;
+        }
+        else
+        {
+            _mm512_storeu_ps(out, _mm512_permutex2var_ps(f, zidx0, zero));
+            _mm512_storeu_ps(out + 16, _mm512_permutex2var_ps(f, zidx1, zero));
+            out += 32;
+        }
+        in += bits * 2;
+        nvalues -= 16;
+    }
+    unpack_ref(bits, cplx, in, out, nvalues, scale);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+static void pack_avx512(int bits, bool cplx, const float * in, uint8_t * out,
+                        size_t nvalues, float scale)
+{
+    const int half = bits / 2;
+    uint8_t idx[64] = {0};
+
+    for (int j = 0; j < bits * 2; j++)
+        idx[j] = (j / half) * 16 + j % half;
+    const __m512i vidx = _mm512_loadu_si512(idx);
+    const __mmask64 smask = (__mmask64(1) << (bits * 2)) - 1;
+    const __m512i ridx = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14,
+                                           16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512 vscale = _mm512_set1_ps(scale);
+    const __m512 vmax = _mm512_set1_ps(32767.f);
+    const __m512 vmin = _mm512_set1_ps(-32768.f);
+    const __m512i mask = _mm512_set1_epi32((1 << bits) - 1);
+    const __m512i lo32 = _mm512_set1_epi64(0xffffffffll);
+    const __m128i c1 = _mm_cvtsi32_si128(bits);
+    const __m128i c2 = _mm_cvtsi32_si128(bits * 2);
+
+    while (nvalues >= 16)
+    {
+        __m512 f;
+        if (cplx)
+        {
+            f = _mm512_loadu_ps(in);
+            in += 16;
+        }
+        else
+        {
+            f = _mm512_permutex2var_ps(_mm512_loadu_ps(in), ridx, _mm512_loadu_ps(in + 16));
+            in += 32;
+        }
+        f = _mm512_maskz_max_ps(ALL16, _mm512_maskz_min_ps(ALL16, _mm512_mul_ps(f, vscale), vmax), vmin);
+        __m512i v = _mm512_and_si512(_mm512_maskz_cvtps_epi32(ALL16, f), mask);
+        __m512i t = _mm512_or_si512(_mm512_and_si512(v, lo32),
+                                    _mm512_maskz_sll_epi64(ALL8, _mm512_maskz_srli_epi64(ALL8, v, 32), c1));
+        t = _mm512_or_si512(t, _mm512_maskz_sll_epi64(ALL8, _mm512_bsrli_epi128(t, 8), c2));
+        _mm512_mask_storeu_epi8(out, smask, _mm512_maskz_permutexvar_epi8(ALL64, vidx, t));
+        out += bits * 2;
+        nvalues -= 16;
+    }
+    pack_ref(bits, cplx, in, out, nvalues, scale);
+}
+
+#endif /* FORMAT_CONVERTER_SIMD */
+
+kernels get(isa level)
+{
+    switch (level)
+    {
+#ifdef FORMAT_CONVERTER_SIMD
+    case ISA_AVX512:
+        return {ISA_AVX512, unpack_avx512, pack_avx512};
+    case ISA_AVX2:
+        return {ISA_AVX2, unpack_avx2, pack_avx2};
+#endif
+    default:
+        return {ISA_NONE, unpack_ref, pack_ref};
+    }
+}
+
+bool supported(isa level)
+{
+#ifdef FORMAT_CONVERTER_SIMD
+    __builtin_cpu_init();
+    switch (level)
+    {
+    case ISA_AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+               __builtin_cpu_supports("avx512vbmi");
+    case ISA_AVX2:
+        return __builtin_cpu_supports("avx2");
+    default:
+        return true;
+    }
+#else
+    return level == ISA_NONE;
+#endif
+}
+
+/*
+ * Compare the kernels with the scalar converters of the packed format, which
+ * are used on big endian hosts. T is the packed item type.
+ */
+template <typename T>
+static bool verify_scalar(const kernels &k, int bits, bool cplx,
+                          const std::vector<uint8_t> &packed, const std::vector<float> &samples)
+{
+    const float scale = float(1 << (bits - 1));
+    const int nitems = 9;
+    const size_t nvalues = nitems * sizeof(T) * 8 / bits;
+    const int nsamples = int(cplx ? nvalues / 2 : nvalues);
+
+    any_to_any_base::sptr to = gnuradio::get_initial_sptr(
+        new any_to_any<gr_complex, T>(scale, 1, 1, "verify_pack"));
+    std::vector<uint8_t> bi(nitems * sizeof(T), 0xa5);
+    std::vector<uint8_t> bk(nitems * sizeof(T), 0xa5);
+    to->convert(samples.data(), bi.data(), nitems);
+    k.pack(bits, cplx, samples.data(), bk.data(), nvalues, scale);
+    if (bi != bk)
+        return false;
+
+    any_to_any_base::sptr from = gnuradio::get_initial_sptr(
+        new any_to_any<T, gr_complex>(scale, 1, 1, "verify_unpack"));
+    std::vector<gr_complex> fi(nsamples);
+    std::vector<gr_complex> fk(nsamples);
+    from->convert(packed.data(), fi.data(), nsamples);
+    k.unpack(bits, cplx, packed.data(), (float *)fk.data(), nvalues, 1.f / scale);
+    return !memcmp(fi.data(), fk.data(), nsamples * sizeof(gr_complex));
+}
+
+bool verify(isa level)
+{
+    const kernels k = get(level);
+    const kernels r = get(ISA_NONE);
+    const size_t nvalues = 16 * 37 + 12; // not a multiple of the vector width
+    const size_t guard = 64;
+    uint32_t seed = 0x2545f491;
+    auto rnd = [&seed]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    std::vector<uint8_t> packed(nvalues * 2 + guard);
+    for (auto &b : packed)
+        b = rnd();
+    std::vector<float> samples(nvalues * 2);
+
+    for (int bits = 10; bits <= 14; bits += 2)
+    {
+        const float scale = float(1 << (bits - 1));
+        const size_t nbytes = (nvalues * bits + 7) / 8;
+        for (size_t n = 0; n < samples.size(); n++)
+        {
+            switch (n % 8)
+            {
+            case 0: // exact ties, rounded to even
+                samples[n] = (float(int(rnd() % 64) - 32) + 0.5f) / scale;
+                break;
+            case 1: // out of range
+                samples[n] = float(int(rnd() % 2000) - 1000);
+                break;
+            default:
+                samples[n] = float(int32_t(rnd())) / float(INT32_MAX) * 1.25f;
+            }
+        }
+        for (int c = 0; c < 2; c++)
+        {
+            const bool cplx = c;
+            const size_t nout = nvalues * (cplx ? 1 : 2) + guard;
+            std::vector<float> fr(nout, -7.f);
+            std::vector<float> fk(nout, -7.f);
+            r.unpack(bits, cplx, packed.data(), fr.data(), nvalues, 1.f / scale);
+            k.unpack(bits, cplx, packed.data(), fk.data(), nvalues, 1.f / scale);
+            if (memcmp(fr.data(), fk.data(), nout * sizeof(float)))
+                return false;
+
+            std::vector<uint8_t> br(nbytes + guard, 0xa5);
+            std::vector<uint8_t> bk(nbytes + guard, 0xa5);
+            r.pack(bits, cplx, samples.data(), br.data(), nvalues, scale);
+            k.pack(bits, cplx, samples.data(), bk.data(), nvalues, scale);
+            if (br != bk)
+                return false;
+        }
+        bool ok = true;
+        switch (bits)
+        {
+        case 10:
+            ok = verify_scalar<std::array<int8_t,40>>(k, bits, true, packed, samples) &&
+                 verify_scalar<std::array<int16_t,20>>(k, bits, false, packed, samples);
+            break;
+        case 12:
+            ok = verify_scalar<std::array<int8_t,24>>(k, bits, true, packed, samples) &&
+                 verify_scalar<std::array<int16_t,12>>(k, bits, false, packed, samples);
+            break;
+        case 14:
+            ok = verify_scalar<std::array<int8_t,56>>(k, bits, true, packed, samples) &&
+                 verify_scalar<std::array<int16_t,28>>(k, bits, false, packed, samples);
+            break;
+        }
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+const char * isa_name(isa level)
+{
+    switch (level)
+    {
+    case ISA_AVX512:
+        return "avx512vbmi";
+    case ISA_AVX2:
+        return "avx2";
+    default:
+        return "none";
+    }
+}
+
+static kernels select()
+{
+    isa limit = ISA_AVX512;
+    const char * env = getenv("GQRX_SIMD");
+
+    if (env)
+    {
+        std::string s(env);
+        if (s == "none")
+            limit = ISA_NONE;
+        else if (s == "avx2")
+            limit = ISA_AVX2;
+    }
+    for (int level = limit; level > ISA_NONE; level--)
+    {
+        if (!supported(isa(level)))
+            continue;
+        if (verify(isa(level)))
+            return get(isa(level));
+        std::cerr << "packed_simd: " << isa_name(isa(level))
+                  << " kernels do not match the reference, disabled" << std::endl;
+    }
+    return get(ISA_NONE);
+}
+
+const kernels & get()
+{
+    static const kernels selected = select();
+    return selected;
+}
+
+}
@@ -0,0 +1,97 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef INCLUDED_FORMAT_CONVERTER_SIMD_H
+#define INCLUDED_FORMAT_CONVERTER_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define FORMAT_CONVERTER_SIMD 1
+#endif
+
+/*
+ * Runtime dispatched kernels for the packed 10/12/14 bit formats.
+ *
+ * All packed formats are a little endian bit stream of signed values:
+ * I/Q pairs for the complex formats and single values for the real ones.
+ * The kernels are compiled for AVX2 and AVX-512 VBMI with function target
+ * attributes, so the binary does not depend on the build host CPU. The
+ * kernel set is selected once on the first call to get() and only if it
+ * produces bit exact results against the portable reference and the scalar
+ * any_to_any converters of every packed format on a test vector. The GQRX_SIMD environment variable (none, avx2, avx512) limits
+ * the selection, for example to benchmark or to rule out a kernel.
+ *
+ * Rounding follows the volk converters, used by the 32 and 64 bit
+ * converters, and the scalar converters: values are scaled, clamped to the
+ * int16 range and rounded to nearest even before the low bits are stored.
+ */
+namespace packed_simd
+{
+    enum isa {
+        ISA_NONE = 0,
+        ISA_AVX2,
+        ISA_AVX512,
+    };
+
+    /*!
+     * \brief Unpack nvalues values to floats.
+     * \param cplx Values are I/Q pairs, otherwise every value becomes
+     *        the real part of a complex output sample with zero imaginary part.
+     * \param scale Multiplier applied to the sign extended value.
+     */
+    typedef void (*unpack_fn)(int bits, bool cplx, const uint8_t * in, float * out,
+                              size_t nvalues, float scale);
+
+    /*!
+     * \brief Pack nvalues values.
+     * \param cplx Read consecutive floats, otherwise read the real part of
+     *        every complex input sample.
+     * \param scale Multiplier applied before rounding.
+     */
+    typedef void (*pack_fn)(int bits, bool cplx, const float * in, uint8_t * out,
+                            size_t nvalues, float scale);
+
+    struct kernels
+    {
+        isa       level;
+        unpack_fn unpack;
+        pack_fn   pack;
+    };
+
+    /*! \brief Kernels for the best instruction set, this CPU supports. */
+    const kernels & get();
+
+    /*! \brief Kernels for a given instruction set, the reference for ISA_NONE. */
+    kernels get(isa level);
+
+    /*! \brief Check if this CPU and OS support an instruction set. */
+    bool supported(isa level);
+
+    /*! \brief Compare the kernels against the reference on a test vector. */
+    bool verify(isa level);
+
+    const char * isa_name(isa level);
+}
+
+#endif /* INCLUDED_FORMAT_CONVERTER_SIMD_H */
@@ -0,0 +1,150 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <gnuradio/io_signature.h>
+#include "dsp/latency_probe.h"
+
+
+latency_meter::latency_meter()
+{
+    reset();
+}
+
+void latency_meter::add(const std::vector<gr::tag_t> &tags, double extra)
+{
+    for (const auto &tag : tags)
+        add(tag, extra);
+}
+
+void latency_meter::add(const gr::tag_t &tag, double extra)
+{
+    uint64_t now = now_ns();
+
+    if (!pmt::eq(tag.key, key()))
+        return;
+
+    uint64_t stamp = pmt::to_uint64(tag.value);
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    d_last = (now > stamp ? double(now - stamp) * 1e-9 : 0.0) + extra;
+    d_sum += d_last;
+    d_max = std::max(d_max, d_last);
+    d_count++;
+}
+
+latency_stats latency_meter::get()
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    latency_stats stats;
+
+    stats.last = d_last;
+    stats.count = d_count;
+    stats.avg = d_count ? d_sum / d_count : d_last;
+    stats.max = d_count ? d_max : d_last;
+    d_sum = 0.0;
+    d_max = 0.0;
+    d_count = 0;
+    return stats;
+}
+
+void latency_meter::reset()
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    d_last = -1.0;
+    d_sum = 0.0;
+    d_max = 0.0;
+    d_count = 0;
+}
+
+const pmt::pmt_t &latency_meter::key()
+{
+    static const pmt::pmt_t k = pmt::intern("latency_probe");
+    return k;
+}
+
+uint64_t latency_meter::now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+latency_tagger_cc_sptr make_latency_tagger_cc(double period)
+{
+    return gnuradio::get_initial_sptr(new latency_tagger_cc(period));
+}
+
+latency_tagger_cc::latency_tagger_cc(double period)
+    : gr::sync_block ("latency_tagger_cc",
+          gr::io_signature::make(1, 1, sizeof(gr_complex)),
+          gr::io_signature::make(1, 1, sizeof(gr_complex))),
+      d_period_ns(uint64_t(period * 1e9)),
+      d_next_ns(0)
+{
+}
+
+int latency_tagger_cc::work(int noutput_items,
+                            gr_vector_const_void_star &input_items,
+                            gr_vector_void_star &output_items)
+{
+    uint64_t now = latency_meter::now_ns();
+
+    if (now >= d_next_ns)
+    {
+        add_item_tag(0, nitems_written(0), latency_meter::key(), pmt::from_uint64(now));
+        d_next_ns = now + d_period_ns;
+    }
+    std::memcpy(output_items[0], input_items[0], noutput_items * sizeof(gr_complex));
+
+    return noutput_items;
+}
+
+
+latency_probe_sink_sptr make_latency_probe_sink(size_t itemsize)
+{
+    return gnuradio::get_initial_sptr(new latency_probe_sink(itemsize));
+}
+
+latency_probe_sink::latency_probe_sink(size_t itemsize)
+    : gr::sync_block ("latency_probe_sink",
+          gr::io_signature::make(1, 1, itemsize),
+          gr::io_signature::make(0, 0, 0))
+{
+}
+
+int latency_probe_sink::work(int noutput_items,
+                             gr_vector_const_void_star &input_items,
+                             gr_vector_void_star &output_items)
+{
+    (void) input_items;
+    (void) output_items;
+
+    get_tags_in_window(d_tags, 0, 0, noutput_items, latency_meter::key());
+    if (!d_tags.empty())
+        d_meter.add(d_tags);
+
+    return noutput_items;
+}
@@ -0,0 +1,163 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <gnuradio/sync_block.h>
+#include <gnuradio/tags.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Latency probes are stream tags with the key "latency_probe" and the
+ * time, when the tagged sample entered the flowgraph, as value (steady
+ * clock, nanoseconds). latency_tagger_cc adds them right after the signal
+ * source, the GNU Radio blocks carry them through rate changes and every
+ * measurement point compares the time, when a tag arrives, to its value.
+ */
+
+/*! \brief Latency statistics of one measurement point. */
+struct latency_stats
+{
+    double last;   /*!< Latest latency in seconds, -1 if no probe arrived yet. */
+    double avg;    /*!< Average since the previous get(), last if no probe arrived. */
+    double max;    /*!< Maximum since the previous get(), last if no probe arrived. */
+    int    count;  /*!< Number of probes since the previous get(). */
+};
+
+/*! \brief Latency of one stage, as reported by the receiver. */
+struct latency_stage
+{
+    std::string name;   /*!< channelizer, vfo, mixer or audio. */
+    int         vfo;    /*!< VFO index or -1. */
+    double      total;  /*!< Average latency since the input in seconds, -1 if unknown. */
+    double      stage;  /*!< Part of total added by this stage. */
+    double      max;    /*!< Maximum latency since the input. */
+    double      budget; /*!< Longest time the stage can hold a sample, -1 if unknown. */
+};
+
+/*! \brief Thread safe accumulator of probe latencies. */
+class latency_meter
+{
+public:
+    latency_meter();
+
+    /*!
+     * \brief Record the latency of the probe tags arriving now.
+     * \param tags Tags of the current work() call, other keys are ignored.
+     * \param extra Latency after this point, e.g. of the sound card buffer.
+     */
+    void add(const std::vector<gr::tag_t> &tags, double extra = 0.0);
+    void add(const gr::tag_t &tag, double extra = 0.0);
+
+    /*! \brief Get and restart the statistics. */
+    latency_stats get();
+    void reset();
+
+    static const pmt::pmt_t &key();
+    static uint64_t now_ns();
+
+private:
+    std::mutex d_mutex;
+    double     d_last;
+    double     d_sum;
+    double     d_max;
+    int        d_count;
+};
+
+
+class latency_tagger_cc;
+class latency_probe_sink;
+
+#if GNURADIO_VERSION < 0x030900
+typedef boost::shared_ptr<latency_tagger_cc> latency_tagger_cc_sptr;
+typedef boost::shared_ptr<latency_probe_sink> latency_probe_sink_sptr;
+#else
+typedef std::shared_ptr<latency_tagger_cc> latency_tagger_cc_sptr;
+typedef std::shared_ptr<latency_probe_sink> latency_probe_sink_sptr;
+#endif
+
+/*! \brief Return a shared_ptr to a new instance of latency_tagger_cc.
+ *  \param period Time between two probes in seconds.
+ */
+latency_tagger_cc_sptr make_latency_tagger_cc(double period = 0.2);
+
+/*! \brief Return a shared_ptr to a new instance of latency_probe_sink.
+ *  \param itemsize Size of the input items.
+ */
+latency_probe_sink_sptr make_latency_probe_sink(size_t itemsize);
+
+
+/*! \brief Pass-through block adding latency probe tags (complex).
+ *  \ingroup DSP
+ *
+ * The first sample of a work() call is tagged, if at least one period has
+ * passed since the previous probe.
+ */
+class latency_tagger_cc : public gr::sync_block
+{
+    friend latency_tagger_cc_sptr make_latency_tagger_cc(double period);
+
+protected:
+    latency_tagger_cc(double period);
+
+public:
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items);
+
+private:
+    uint64_t d_period_ns;
+    uint64_t d_next_ns;
+};
+
+
+/*! \brief Sink measuring the latency of the probe tags at its input.
+ *  \ingroup DSP
+ *
+ * The sink consumes its input as fast as possible, so it measures the
+ * time, when the upstream block has produced the tagged sample.
+ */
+class latency_probe_sink : public gr::sync_block
+{
+    friend latency_probe_sink_sptr make_latency_probe_sink(size_t itemsize);
+
+protected:
+    latency_probe_sink(size_t itemsize);
+
+public:
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items);
+
+    /*! \brief Get and restart the statistics. */
+    latency_stats get() { return d_meter.get(); }
+
+private:
+    latency_meter         d_meter;
+    std::vector<gr::tag_t> d_tags;
+};
+
+#endif /* LATENCY_PROBE_H */
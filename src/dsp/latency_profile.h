@@ -0,0 +1,91 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef LATENCY_PROFILE_H
+#define LATENCY_PROFILE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+/*
+ * A latency profile sizes the batches (output multiple) and the output
+ * buffers of the blocks. Every sample may wait for one batch to fill and
+ * for one output buffer to drain in each block, so both are limited to a
+ * time budget in the low latency profile. The throughput profile keeps
+ * the large batches and the GNU Radio default buffers, which need the
+ * least CPU.
+ */
+
+/*! \brief Flowgraph latency profiles. */
+enum latency_profile
+{
+    LATENCY_PROFILE_THROUGHPUT = 0,  /*!< Large batches, default buffers. */
+    LATENCY_PROFILE_LOW        = 1   /*!< Small batches, bounded buffers. */
+};
+
+#define LATENCY_LOW_BATCH_TIME   0.005  /*!< Batch of one block in the low latency profile [s]. */
+#define LATENCY_LOW_BUFFER_TIME  0.010  /*!< Output buffer of one block in the low latency profile [s]. */
+#define LATENCY_LOW_AUDIO_TIME   0.030  /*!< Sound card buffer in the low latency profile [s]. */
+#define LATENCY_DEFAULT_BUFFER   32768  /*!< GNU Radio default output buffer [bytes]. */
+
+/*! \brief Number of items lasting at least seconds at rate. */
+static inline int latency_items(double seconds, double rate, int min_items = 1)
+{
+    return std::max(min_items, (int)std::ceil(seconds * rate));
+}
+
+/*! \brief Output multiple of a block producing rate items per second.
+ *  \param dflt Output multiple in the throughput profile.
+ */
+static inline int latency_batch_items(latency_profile profile, double rate, int dflt)
+{
+    if (profile == LATENCY_PROFILE_LOW)
+        return latency_items(LATENCY_LOW_BATCH_TIME, rate);
+    return dflt;
+}
+
+/*! \brief Maximum output buffer of a block producing rate items per second.
+ *  \return 0 (GNU Radio default) in the throughput profile.
+ */
+static inline int latency_buffer_items(latency_profile profile, double rate)
+{
+    if (profile == LATENCY_PROFILE_LOW)
+        return latency_items(LATENCY_LOW_BUFFER_TIME, rate);
+    return 0;
+}
+
+/*! \brief Longest time a sample can spend in one block.
+ *  \param multiple The output multiple.
+ *  \param max_buffer The maximum output buffer, 0 for the GNU Radio default.
+ *  \param itemsize Size of the output items.
+ *  \param rate Output rate in items per second.
+ */
+static inline double latency_block_time(int multiple, int max_buffer, size_t itemsize, double rate)
+{
+    int buffer = (max_buffer > 0) ? max_buffer : int(LATENCY_DEFAULT_BUFFER / itemsize);
+
+    // GNU Radio makes the buffer at least twice the output multiple
+    return (std::max(multiple, 1) + std::max(buffer, 2 * multiple)) / rate;
+}
+
+#endif /* LATENCY_PROFILE_H */
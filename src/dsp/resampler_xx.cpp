@@ -20,13 +20,12 @@
  * the Free Software Foundation, Inc., 51 Franklin Street,
  * Boston, MA 02110-1301, USA.
  */
+#include <algorithm>
 #include <cstdio>
 #include <gnuradio/io_signature.h>
 #include <gnuradio/filter/firdes.h>
 #include "dsp/resampler_xx.h"
 
-#define RESAMPLER_OUTPUT_MULTIPLE 4096
-
 /* Create a new instance of resampler_cc and return
  * a shared_ptr. This is effectively the public constructor.
  */
@@ -38,7 +37,9 @@ resampler_cc_sptr make_resampler_cc(float rate)
 resampler_cc::resampler_cc(float rate)
     : gr::hier_block2 ("resampler_cc",
           gr::io_signature::make (1, 1, sizeof(gr_complex)),
-          gr::io_signature::make (1, 1, sizeof(gr_complex)))
+          gr::io_signature::make (1, 1, sizeof(gr_complex))),
+      d_output_multiple(RESAMPLER_OUTPUT_MULTIPLE),
+      d_max_buffer(0)
 {
     /* I created this code based on:
        http://gnuradio.squarespace.com/blog/2010/12/6/new-interface-for-pfb_arb_resampler_ccf.html
@@ -58,7 +59,8 @@ resampler_cc::resampler_cc(float rate)
 
     /* create the filter */
     d_filter = gr::filter::pfb_arb_resampler_ccf::make(rate, d_taps, flt_size);
-    d_filter->set_output_multiple(RESAMPLER_OUTPUT_MULTIPLE);
+    d_filter->set_output_multiple(d_output_multiple);
+    d_filter->set_max_output_buffer(d_max_buffer);
 
     /* connect filter */
     connect(self(), 0, d_filter, 0);
@@ -83,11 +85,26 @@ void resampler_cc::set_rate(float rate)
     disconnect(d_filter, 0, self(), 0);
     d_filter.reset();
     d_filter = gr::filter::pfb_arb_resampler_ccf::make(rate, d_taps, flt_size);
-    d_filter->set_output_multiple(RESAMPLER_OUTPUT_MULTIPLE);
+    d_filter->set_output_multiple(d_output_multiple);
+    d_filter->set_max_output_buffer(d_max_buffer);
     connect(self(), 0, d_filter, 0);
     connect(d_filter, 0, self(), 0);
 }
 
+/*! \brief Set the output multiple and the maximum output buffer.
+ *  \param output_multiple Output multiple of the filter.
+ *  \param max_buffer Maximum output buffer in items, 0 for the GNU Radio default.
+ *
+ * Takes effect, when the flowgraph is restarted or unlocked.
+ */
+void resampler_cc::set_buffering(int output_multiple, int max_buffer)
+{
+    d_output_multiple = std::max(output_multiple, 1);
+    d_max_buffer = max_buffer;
+    d_filter->set_output_multiple(d_output_multiple);
+    d_filter->set_max_output_buffer(d_max_buffer);
+}
+
 /* Create a new instance of resampler_ff and return
  * a shared_ptr. This is effectively the public constructor.
  */
@@ -99,7 +116,9 @@ resampler_ff_sptr make_resampler_ff(float rate)
 resampler_ff::resampler_ff(float rate)
     : gr::hier_block2 ("resampler_ff",
           gr::io_signature::make (1, 1, sizeof(float)),
-          gr::io_signature::make (1, 1, sizeof(float)))
+          gr::io_signature::make (1, 1, sizeof(float))),
+      d_output_multiple(1),
+      d_max_buffer(0)
 {
     /* I created this code based on:
        http://gnuradio.squarespace.com/blog/2010/12/6/new-interface-for-pfb_arb_resampler_ccf.html
@@ -119,6 +138,8 @@ resampler_ff::resampler_ff(float rate)
 
     /* create the filter */
     d_filter = gr::filter::pfb_arb_resampler_fff::make(rate, d_taps, flt_size);
+    d_filter->set_output_multiple(d_output_multiple);
+    d_filter->set_max_output_buffer(d_max_buffer);
 
     /* connect filter */
     connect(self(), 0, d_filter, 0);
@@ -143,6 +164,22 @@ void resampler_ff::set_rate(float rate)
     disconnect(d_filter, 0, self(), 0);
     d_filter.reset();
     d_filter = gr::filter::pfb_arb_resampler_fff::make(rate, d_taps, flt_size);
+    d_filter->set_output_multiple(d_output_multiple);
+    d_filter->set_max_output_buffer(d_max_buffer);
     connect(self(), 0, d_filter, 0);
     connect(d_filter, 0, self(), 0);
 }
+
+/*! \brief Set the output multiple and the maximum output buffer.
+ *  \param output_multiple Output multiple of the filter.
+ *  \param max_buffer Maximum output buffer in items, 0 for the GNU Radio default.
+ *
+ * Takes effect, when the flowgraph is restarted or unlocked.
+ */
+void resampler_ff::set_buffering(int output_multiple, int max_buffer)
+{
+    d_output_multiple = std::max(output_multiple, 1);
+    d_max_buffer = max_buffer;
+    d_filter->set_output_multiple(d_output_multiple);
+    d_filter->set_max_output_buffer(d_max_buffer);
+}
@@ -27,6 +27,8 @@
 #include <gnuradio/filter/pfb_arb_resampler_ccf.h>
 #include <gnuradio/filter/pfb_arb_resampler_fff.h>
 
+#define RESAMPLER_OUTPUT_MULTIPLE 4096  /*!< Default output multiple of resampler_cc. */
+
 
 class resampler_cc;
 class resampler_ff;
@@ -63,8 +65,13 @@ public:
 
     void set_rate(float rate);
 
+    void set_buffering(int output_multiple, int max_buffer);
+    int  output_multiple() const { return d_output_multiple; }
+
 private:
     std::vector<float>            d_taps;
+    int                           d_output_multiple;
+    int                           d_max_buffer;
     gr::filter::pfb_arb_resampler_ccf::sptr d_filter;
 };
 
@@ -93,8 +100,13 @@ public:
 
     void set_rate(float rate);
 
+    void set_buffering(int output_multiple, int max_buffer);
+    int  output_multiple() const { return d_output_multiple; }
+
 private:
     std::vector<float>            d_taps;
+    int                           d_output_multiple;
+    int                           d_max_buffer;
     gr::filter::pfb_arb_resampler_fff::sptr d_filter;
 };
 
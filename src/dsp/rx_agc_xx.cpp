@@ -134,10 +134,16 @@ int rx_agc_2f::work(int noutput_items,
         std::vector<gr::tag_t> work_tags;
         get_tags_in_window(work_tags, 0, 0, noutput_items);
         for (const auto& tag : work_tags)
+        {
             add_item_tag(0, tag.offset + d_buf_samples, tag.key, tag.value);
+            add_item_tag(2, tag.offset + d_buf_samples + d_delay_l, tag.key, tag.value);
+        }
         get_tags_in_window(work_tags, 1, 0, noutput_items);
         for (const auto& tag : work_tags)
+        {
             add_item_tag(1, tag.offset + d_buf_samples, tag.key, tag.value);
+            add_item_tag(3, tag.offset + d_buf_samples + d_delay_r, tag.key, tag.value);
+        }
         if (d_refill)
         {
             d_refill = false;
@@ -223,10 +229,16 @@ int rx_agc_2f::work(int noutput_items,
         std::vector<gr::tag_t> work_tags;
         get_tags_in_window(work_tags, 0, 0, noutput_items);
         for (const auto& tag : work_tags)
+        {
             add_item_tag(0, tag.offset, tag.key, tag.value);
+            add_item_tag(2, tag.offset + d_delay_l, tag.key, tag.value);
+        }
         get_tags_in_window(work_tags, 1, 0, noutput_items);
         for (const auto& tag : work_tags)
+        {
             add_item_tag(1, tag.offset, tag.key, tag.value);
+            add_item_tag(3, tag.offset + d_delay_r, tag.key, tag.value);
+        }
         if (d_mute)
         {
             std::memset(out2, 0, sizeof(float) * noutput_items);
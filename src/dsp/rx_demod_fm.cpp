@@ -24,7 +24,6 @@
 #include <gnuradio/io_signature.h>
 #include <iostream>
 #include <math.h>
-#include <QDebug>
 
 #include "dsp/rx_demod_fm.h"
 
@@ -52,8 +51,6 @@ rx_demod_fm::rx_demod_fm(float quad_rate, float max_dev, double tau)
     /* demodulator gain */
     gain = d_quad_rate / (2 * (float)M_PI * d_max_dev);
 
-    qDebug() << "FM demod gain:" << gain;
-
     /* demodulator */
     d_quad = gr::analog::quadrature_demod_cf::make(gain);
 
@@ -144,8 +141,6 @@ rx_demod_fmpll::rx_demod_fmpll(float quad_rate, float max_dev, double pllbw)
     /* demodulator gain */
     gain = d_quad_rate / (2.0f * (float)M_PI * d_max_dev);
 
-    qDebug() << "FM demod gain:" << gain;
-
     /* demodulator */
     d_pll_demod = gr::analog::pll_freqdet_cf::make(d_pll_bw,
                                                    (2.f*(float)M_PI*max_dev/quad_rate),
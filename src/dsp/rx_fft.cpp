@@ -195,21 +195,11 @@ rx_fft_c::rx_fft_c(unsigned int fftsize, double quad_rate, int wintype)
           gr::io_signature::make(0, 0, 0)),
       fft_c_basic(fftsize, wintype),
       d_quadrate(quad_rate),
-      d_enabled(true)
+      d_enabled(true),
+      d_bufsize(0)
 {
-
-    /* create FFT object */
-
     /* allocate circular buffer */
-#if GNURADIO_VERSION < 0x031000
-    d_writer = gr::make_buffer(MAX_FFT_SIZE * 2, sizeof(gr_complex));
-#else
-    d_writer = gr::make_buffer(MAX_FFT_SIZE * 2, sizeof(gr_complex), 1, 1);
-#endif
-    d_reader = gr::buffer_add_reader(d_writer, 0);
-
-    memset(d_writer->write_pointer(), 0, sizeof(gr_complex) * MAX_FFT_SIZE);
-    d_writer->update_write_pointer(MAX_FFT_SIZE);
+    resize_buffer(d_fftsize);
 
     d_lasttime = std::chrono::steady_clock::now();
 }
@@ -255,8 +245,8 @@ bool rx_fft_c::start()
 {
     std::lock_guard<std::mutex> lock(d_mutex);
     d_lasttime = std::chrono::steady_clock::now();
-    if (d_reader->items_available() > MAX_FFT_SIZE)
-        d_reader->update_read_pointer(d_reader->items_available() - MAX_FFT_SIZE);
+    if (d_reader->items_available() > int(d_bufsize))
+        d_reader->update_read_pointer(d_reader->items_available() - d_bufsize);
     return true;
 }
 
@@ -274,8 +264,8 @@ void rx_fft_c::get_fft_data(std::complex<float>* fftPoints, unsigned int &fftSiz
     d_lasttime = now;
 
     /* perform FFT */
-    d_reader->update_read_pointer(std::min((int)(diff.count() * d_quadrate * 1.001), d_reader->items_available() - MAX_FFT_SIZE));
-    apply_window(d_fftsize, ((gr_complex *)d_reader->read_pointer())+(MAX_FFT_SIZE - d_fftsize));
+    d_reader->update_read_pointer(std::min((int)(diff.count() * d_quadrate * 1.001), d_reader->items_available() - (int)d_bufsize));
+    apply_window(d_fftsize, ((gr_complex *)d_reader->read_pointer())+(d_bufsize - d_fftsize));
     lock.unlock();
 
     /* compute FFT */
@@ -286,15 +276,81 @@ void rx_fft_c::get_fft_data(std::complex<float>* fftPoints, unsigned int &fftSiz
     fftSize = d_fftsize;
 }
 
+/*! \brief Set new FFT size and resize the circular buffer. */
+void rx_fft_c::set_fft_size(unsigned int fftsize)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    fft_c_basic::set_fft_size(fftsize);
+}
+
 /*! \brief Set new quadrature rate. */
 void rx_fft_c::set_quad_rate(double quad_rate)
 {
+    std::lock_guard<std::mutex> lock(d_mutex);
+
     if (quad_rate != d_quadrate) {
         d_quadrate = quad_rate;
         set_params();
     }
 }
 
+/*! \brief Update FFT object and circular buffer, the caller holds d_mutex. */
+void rx_fft_c::set_params()
+{
+    fft_c_basic::set_params();
+    if (d_fftsize != d_bufsize)
+        resize_buffer(d_fftsize);
+}
+
+/*! \brief Memory of the circular buffer in bytes. */
+size_t rx_fft_c::memory_bytes() const
+{
+    return size_t(d_writer->bufsize()) * sizeof(gr_complex);
+}
+
+/*!
+ * \brief Reallocate the circular buffer for size samples.
+ *
+ * The buffer holds twice the FFT size: the samples of the next FFT and
+ * the samples that arrived since, which get_fft_data() consumes at the
+ * sample rate. The newest samples of the old buffer are kept, so the
+ * spectrum continues without a gap, when the FFT size is changed.
+ * Called from the constructor or with d_mutex held.
+ */
+void rx_fft_c::resize_buffer(unsigned int size)
+{
+    gr::buffer_sptr writer;
+    gr::buffer_reader_sptr reader;
+
+#if GNURADIO_VERSION < 0x031000
+    writer = gr::make_buffer(size * 2, sizeof(gr_complex));
+#else
+    writer = gr::make_buffer(size * 2, sizeof(gr_complex), 1, 1);
+#endif
+    reader = gr::buffer_add_reader(writer, 0);
+
+    // The FFT window ends d_bufsize samples after the read pointer and is
+    // followed by the samples, that have not been shown yet.
+    const gr_complex *old = d_reader ? (const gr_complex *)d_reader->read_pointer() : nullptr;
+    int available = d_reader ? d_reader->items_available() : 0;
+    int end = std::min(available, (int)d_bufsize);
+    int head = std::min(end, (int)size);
+    int tail = std::min(available - end, writer->space_available() - (int)size);
+    gr_complex *dst = (gr_complex *)writer->write_pointer();
+
+    memset(dst, 0, sizeof(gr_complex) * (size - head));
+    if (head > 0)
+        memcpy(dst + (size - head), old + (end - head), sizeof(gr_complex) * head);
+    if (tail > 0)
+        memcpy(dst + size, old + end, sizeof(gr_complex) * tail);
+    writer->update_write_pointer(size + std::max(tail, 0));
+
+    d_writer = writer;
+    d_reader = reader;
+    d_bufsize = size;
+}
+
 /**   rx_fft_f     **/
 
 rx_fft_f_sptr make_rx_fft_f(unsigned int fftsize, double audio_rate, int wintype)
@@ -483,6 +539,12 @@ unsigned int rx_fft_f::get_fft_size() const
     return d_fftsize;
 }
 
+/*! \brief Memory of the circular buffer in bytes. */
+size_t rx_fft_f::memory_bytes() const
+{
+    return size_t(d_writer->bufsize()) * sizeof(float);
+}
+
 /*! \brief Set new window type. */
 void rx_fft_f::set_window_type(int wintype)
 {
@@ -542,7 +604,7 @@ fft_channelizer_cc::fft_channelizer_cc(int nchannels, int osr, int wintype, int
     set_window_type(wintype);
     set_history(2048);
     d_map.resize(RX_MAX);
-    set_output_multiple(8192);
+    set_output_multiple(CHANNELIZER_OUTPUT_MULTIPLE);
 }
 
 fft_channelizer_cc::~fft_channelizer_cc()
@@ -788,3 +850,25 @@ void fft_channelizer_cc::set_params(int fftsize, int wintype, int osr, float fil
     for(int j = 0; j < d_noutputs ; j++)
         d_map[j] %= d_fftsize * d_osr;
 }
+
+#define LOG2_10 3.321928094887362
+
+void fft_to_db(unsigned int fftsize, const gr_complex *fft, float *db)
+{
+    // NB: without cast to float the multiplication will overflow at 64k
+    // and pwr_scale will be inf
+    float pwr_scale = 1.0f / ((float)fftsize * (float)fftsize);
+
+    /* Normalize, calculate power and shift the FFT */
+    volk_32fc_magnitude_squared_32f(db, fft + (fftsize/2), fftsize/2);
+    volk_32fc_magnitude_squared_32f(db + (fftsize/2), fft, fftsize/2);
+    volk_32f_s32f_multiply_32f(db, db, pwr_scale, fftsize);
+    volk_32f_log2_32f(db, db, fftsize);
+    volk_32f_s32f_multiply_32f(db, db, 10 / LOG2_10, fftsize);
+}
+
+void fft_average(unsigned int fftsize, const float *db, float *iir, float avg)
+{
+    for (unsigned int i = 0; i < fftsize; i++)
+        iir[i] += avg * (db[i] - iir[i]);
+}
@@ -36,10 +36,19 @@
 #include <chrono>
 #include <thread>
 #include <condition_variable>
+#include "dsp/dsp_load.h"
 
 
 #define MAX_FFT_SIZE 1048576*4
 #define AUDIO_BUFFER_SIZE 65536
+#define CHANNELIZER_OUTPUT_MULTIPLE 8192  /* Default output multiple of fft_channelizer_cc */
+
+/* Defaults of the spectrum settings, used by the FFT dock and gqrx-headless. */
+#define DEFAULT_FFT_RATE        25
+#define DEFAULT_FFT_SIZE        8192
+#define DEFAULT_FFT_WINDOW      1       // Hann
+#define DEFAULT_FFT_WINDOW_CORRECTION 1 // Amplitude
+#define DEFAULT_FFT_AVG         0
 
 class rx_fft_c;
 class rx_fft_f;
@@ -98,14 +107,15 @@ rx_fft_c_sptr make_rx_fft_c(unsigned int fftsize=4096, double quad_rate=0, int w
  *
  * This block is used to compute the FFT of the received spectrum.
  *
- * The samples are collected in a circular buffer with size FFT_SIZE.
- * When the GUI asks for a new set of FFT data via get_fft_data() an FFT
- * will be performed on the data stored in the circular buffer - assuming
- * of course that the buffer contains at least fftsize samples.
+ * The samples are collected in a circular buffer of twice the FFT size,
+ * which is reallocated when the FFT size is changed. When the GUI asks for
+ * a new set of FFT data via get_fft_data() an FFT will be performed on the
+ * data stored in the circular buffer - assuming of course that the buffer
+ * contains at least fftsize samples.
  *
  * \note Uses code from qtgui_sink_c
  */
-class rx_fft_c : public gr::sync_block, public fft_c_basic
+class rx_fft_c : public gr::sync_block, public fft_c_basic, public dsp_memory_user
 {
     friend rx_fft_c_sptr make_rx_fft_c(unsigned int fftsize, double quad_rate, int wintype);
 
@@ -123,12 +133,19 @@ public:
     void get_fft_data(std::complex<float>* fftPoints, unsigned int &fftSize);
     using fft_c_basic::get_fft_data;
 
+    void set_fft_size(unsigned int fftsize) override;
     void set_quad_rate(double quad_rate);
     void set_enabled(bool enabled) { d_enabled=enabled; };
 
+    size_t memory_bytes() const override;
+
+protected:
+    void set_params() override;
+
 private:
     double       d_quadrate;
     bool         d_enabled;
+    unsigned int d_bufsize;  /*! Samples kept for the FFT, equal to the FFT size. */
 
     std::mutex   d_mutex;  /*! Used to lock FFT output buffer. */
 
@@ -136,6 +153,7 @@ private:
     gr::buffer_reader_sptr d_reader;
     std::chrono::time_point<std::chrono::steady_clock> d_lasttime;
 
+    void resize_buffer(unsigned int size);
 };
 
 
@@ -164,7 +182,7 @@ rx_fft_f_sptr make_rx_fft_f(unsigned int fftsize=1024, double audio_rate=48000,
  *
  * \note Uses code from qtgui_sink_f
  */
-class rx_fft_f : public gr::sync_block
+class rx_fft_f : public gr::sync_block, public dsp_memory_user
 {
     friend rx_fft_f_sptr make_rx_fft_f(unsigned int fftsize, double audio_rate, int wintype);
 
@@ -189,6 +207,8 @@ public:
     unsigned int get_fft_size() const;
     void set_enabled(bool enabled) { d_enabled=enabled; };
 
+    size_t memory_bytes() const override;
+
 private:
     unsigned int d_fftsize;   /*! Current FFT size. */
     double       d_audiorate;
@@ -304,6 +324,10 @@ private:
     void start_threads();
 };
 
+/*! \brief Power spectrum in dBFS of an FFT, lowest frequency first. */
+void fft_to_db(unsigned int fftsize, const gr_complex *fft, float *db);
 
+/*! \brief Average the spectrum, avg is the IIR gain, 1.0 for none. */
+void fft_average(unsigned int fftsize, const float *db, float *iir, float avg);
 
 #endif /* RX_FFT_H */
@@ -25,7 +25,6 @@
 #include <gnuradio/filter/firdes.h>
 #include <volk/volk.h>
 #include <iostream>
-#include <QDebug>
 #include "dsp/rx_filter.h"
 
 static const int MIN_IN = 1;  /* Minimum number of input streams. */
@@ -98,9 +97,6 @@ void rx_filter::set_param(double low, double high, double trans_width)
                                                    d_high + d_cw_offset,
                                                    d_trans_width);
 
-    qDebug() << "Generating taps for new filter   LO:" << d_low
-             << "  HI:" << d_high << "  TW:" << d_trans_width
-             << "  Taps:" << d_taps.size();
     if(d_taps.size()>d_max_taps)
         throw std::runtime_error("Failed to configure rx_filter low="+std::to_string(d_low)+
             " high="+std::to_string(d_high)+" tw="+std::to_string(d_trans_width)+" with "
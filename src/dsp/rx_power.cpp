@@ -0,0 +1,125 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2011 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <math.h>
+#include <volk/volk.h>
+#include <gnuradio/io_signature.h>
+#include "dsp/rx_power.h"
+
+
+rx_power_cc_sptr make_rx_power_cc(double quad_rate, double db, double alpha)
+{
+    return gnuradio::get_initial_sptr(new rx_power_cc(quad_rate, db, alpha));
+}
+
+rx_power_cc::rx_power_cc(double quad_rate, double db, double alpha)
+    : gr::sync_block ("rx_power_cc",
+          gr::io_signature::make(1, 1, sizeof(gr_complex)),
+          gr::io_signature::make(1, 1, sizeof(gr_complex))),
+      d_avgsize(std::max(1u, (unsigned int)(quad_rate * 0.100))),
+      d_wsum(0.0),
+      d_wcount(0),
+      d_level(-1.f),
+      d_pwr(0.f),
+      d_unmuted(false),
+      d_tags(false)
+{
+    set_threshold(db);
+    set_alpha(alpha);
+    d_sob_key = pmt::intern("squelch_sob");
+    d_eob_key = pmt::intern("squelch_eob");
+}
+
+rx_power_cc::~rx_power_cc()
+{
+}
+
+
+int rx_power_cc::work(int noutput_items,
+                      gr_vector_const_void_star &input_items,
+                      gr_vector_void_star &output_items)
+{
+    const gr_complex *in = (const gr_complex *) input_items[0];
+    gr_complex *out = (gr_complex *) output_items[0];
+    float threshold = d_threshold;
+    float alpha = d_alpha;
+    bool unmuted = d_unmuted;
+    bool tags = d_tags;
+
+    if (d_mag.size() < (size_t)noutput_items)
+        d_mag.resize(noutput_items);
+    volk_32fc_magnitude_squared_32f(d_mag.data(), in, noutput_items);
+
+    for (int i = 0; i < noutput_items; i++)
+    {
+        float p = d_mag[i];
+
+        // Meter window
+        d_wsum += p;
+        if (++d_wcount == d_avgsize)
+        {
+            d_level = float(d_wsum / d_avgsize);
+            d_wsum = 0.0;
+            d_wcount = 0;
+        }
+
+        // Squelch
+        d_pwr = alpha * p + (1.f - alpha) * d_pwr;
+        if ((d_pwr >= threshold) != unmuted)
+        {
+            unmuted = !unmuted;
+            if (tags)
+                add_item_tag(0, nitems_written(0) + i,
+                             unmuted ? d_sob_key : d_eob_key, pmt::PMT_NIL);
+        }
+        out[i] = unmuted ? in[i] : gr_complex(0.f, 0.f);
+    }
+    d_unmuted = unmuted;
+
+    return noutput_items;
+}
+
+
+float rx_power_cc::get_level_db() const
+{
+    float level = d_level;
+
+    if (level < 0.f)
+        return 0;
+    return 10.f * log10f(level + 1.0e-20f);
+}
+
+double rx_power_cc::threshold() const
+{
+    return 10.0 * log10(d_threshold);
+}
+
+void rx_power_cc::set_threshold(double db)
+{
+    d_threshold = powf(10.f, float(db) / 10.f);
+}
+
+void rx_power_cc::set_alpha(double alpha)
+{
+    d_alpha = float(alpha);
+}
@@ -0,0 +1,113 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2011 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef RX_POWER_H
+#define RX_POWER_H
+
+#include <gnuradio/sync_block.h>
+#include <atomic>
+#include <vector>
+
+
+class rx_power_cc;
+
+#if GNURADIO_VERSION < 0x030900
+typedef boost::shared_ptr<rx_power_cc> rx_power_cc_sptr;
+#else
+typedef std::shared_ptr<rx_power_cc> rx_power_cc_sptr;
+#endif
+
+
+/*! \brief Return a shared_ptr to a new instance of rx_power_cc.
+ *  \param quad_rate The input sample rate.
+ *  \param db Squelch threshold in dBFS.
+ *  \param alpha Gain of the squelch averaging filter.
+ *
+ * This is effectively the public constructor. To avoid accidental use
+ * of raw pointers, the rx_power_cc constructor is private.
+ * make_rx_power_cc is the public interface for creating new instances.
+ */
+rx_power_cc_sptr make_rx_power_cc(double quad_rate, double db, double alpha = 0.0001);
+
+
+/*! \brief Channel power estimator with squelch (complex input).
+ *  \ingroup DSP
+ *
+ * This block computes the power of every sample once and maintains two
+ * estimates:
+ *  - an exponential average with gain alpha, which opens and closes the
+ *    squelch like gr::analog::simple_squelch_cc,
+ *  - the average over the latest complete 100 ms window, returned by
+ *    get_level_db() for the signal meter.
+ *
+ * The output is the input while the squelch is open and zero otherwise.
+ * With set_tags(true) the block adds squelch_sob and squelch_eob tags,
+ * where the squelch opens and closes, like gr::analog::pwr_squelch_cc,
+ * to trigger the squelch triggered audio recorder.
+ */
+class rx_power_cc : public gr::sync_block
+{
+    friend rx_power_cc_sptr make_rx_power_cc(double quad_rate, double db, double alpha);
+
+protected:
+    rx_power_cc(double quad_rate, double db, double alpha);
+
+public:
+    ~rx_power_cc();
+
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items) override;
+
+    /*! \brief Get the signal level in dBFS, averaged over 100 ms. */
+    float get_level_db() const;
+
+    /* Squelch */
+    double threshold() const;
+    void set_threshold(double db);
+    void set_alpha(double alpha);
+    bool unmuted() const { return d_unmuted; }
+
+    /*! \brief Enable the squelch_sob and squelch_eob tags. */
+    void set_tags(bool enabled) { d_tags = enabled; }
+    bool get_tags() const { return d_tags; }
+
+private:
+    unsigned int       d_avgsize;   /*! Number of samples in the meter window. */
+    double             d_wsum;      /*! Power sum of the current window. */
+    unsigned int       d_wcount;    /*! Samples in the current window. */
+    std::atomic<float> d_level;     /*! Average power of the latest window, -1 if none. */
+
+    std::atomic<float> d_threshold; /*! Squelch threshold, linear power. */
+    std::atomic<float> d_alpha;
+    float              d_pwr;       /*! Exponential power average. */
+    std::atomic<bool>  d_unmuted;
+    std::atomic<bool>  d_tags;
+
+    std::vector<float> d_mag;       /*! Power of the samples of one work() call. */
+
+    pmt::pmt_t         d_sob_key;
+    pmt::pmt_t         d_eob_key;
+};
+
+
+#endif /* RX_POWER_H */
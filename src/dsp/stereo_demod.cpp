@@ -173,3 +173,13 @@ void stereo_demod::set_audio_rate(float audio_rate)
         }
     }
 }
+
+/*! \brief Set the output multiple and the maximum output buffer of the
+ *         audio resamplers (see resampler_ff::set_buffering()).
+ */
+void stereo_demod::set_buffering(int output_multiple, int max_buffer)
+{
+    audio_rr0->set_buffering(output_multiple, max_buffer);
+    if (d_stereo)
+        audio_rr1->set_buffering(output_multiple, max_buffer);
+}
@@ -95,6 +95,7 @@ public:
     ~stereo_demod();
     void set_tau(double tau);
     void set_audio_rate(float audio_rate);
+    void set_buffering(int output_multiple, int max_buffer);
 
 private:
     /* GR blocks */
@@ -0,0 +1,46 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef GQRX_DSP_H
+#define GQRX_DSP_H
+
+/*
+ * Public interface of the gqrx-dsp library: the receiver with its VFOs,
+ * the FFT channelizer, the format converters and the I/Q and audio
+ * interfaces, without Qt. Programs, tests and benchmarks link gqrx-dsp
+ * and include this header instead of the headers below.
+ *
+ * GQRX_DSP_API_VERSION is increased, when a change of these headers
+ * breaks code using them.
+ */
+#define GQRX_DSP_API_VERSION 1
+
+#include "applications/gqrx/receiver.h"
+#include "dsp/format_converter.h"
+#include "dsp/rx_fft.h"
+#include "dsp/rx_filter.h"
+#include "interfaces/file_sink.h"
+#include "interfaces/file_source.h"
+#include "receivers/modulations.h"
+#include "receivers/vfo.h"
+
+#endif // GQRX_DSP_H
@@ -33,6 +33,7 @@
 
 #include <gnuradio/basic_block.h>
 #include <string>
+#include "dsp/latency_probe.h"
 
 
 static inline gr::basic_block_sptr create_audio_sink(std::string audio_device, int audio_rate, std::string sink_name)
@@ -47,5 +48,60 @@ static inline gr::basic_block_sptr create_audio_sink(std::string audio_device, i
 
 }
 
+/*! \brief Set the amount of audio buffered by the sound system.
+ *  \param latency Latency in seconds, 0 for the default.
+ *  \return false if the sink does not support it (GNU Radio audio sink).
+ */
+static inline bool set_audio_sink_latency(gr::basic_block_sptr sink, double latency)
+{
+#if defined(WITH_PULSEAUDIO) || defined(WITH_PORTAUDIO)
+#ifdef WITH_PULSEAUDIO
+    typedef pa_sink sink_type;
+#else
+    typedef portaudio_sink sink_type;
+#endif
+#if GNURADIO_VERSION < 0x030900
+    auto snk = boost::dynamic_pointer_cast<sink_type>(sink);
+#else
+    auto snk = std::dynamic_pointer_cast<sink_type>(sink);
+#endif
+    if (!snk)
+        return false;
+    snk->set_target_latency(latency);
+    return true;
+#else
+    (void) sink;
+    (void) latency;
+    return false;
+#endif
+}
+
+/*! \brief Get the latency of the probe tags until they are played.
+ *  \return false if the sink can not measure it (GNU Radio audio sink).
+ */
+static inline bool get_audio_sink_latency(gr::basic_block_sptr sink, latency_stats &stats)
+{
+#if defined(WITH_PULSEAUDIO) || defined(WITH_PORTAUDIO)
+#ifdef WITH_PULSEAUDIO
+    typedef pa_sink sink_type;
+#else
+    typedef portaudio_sink sink_type;
+#endif
+#if GNURADIO_VERSION < 0x030900
+    auto snk = boost::dynamic_pointer_cast<sink_type>(sink);
+#else
+    auto snk = std::dynamic_pointer_cast<sink_type>(sink);
+#endif
+    if (!snk)
+        return false;
+    stats = snk->get_latency();
+    return true;
+#else
+    (void) sink;
+    (void) stats;
+    return false;
+#endif
+}
+
 #endif //AUDIO_SINK_H
 
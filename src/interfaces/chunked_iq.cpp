@@ -0,0 +1,651 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "chunked_iq.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace chunked_iq
+{
+
+static const char FILE_MAGIC[8] = {'G','Q','R','X','C','I','Q','1'};
+static const char INDEX_MAGIC[8] = {'G','Q','R','X','C','I','D','X'};
+static const char CHUNK_MAGIC[4] = {'C','H','N','K'};
+static constexpr uint32_t FILE_VERSION = 1;
+// two values (I and Q) per sample
+static constexpr uint32_t BLOCK_VALUES = BLOCK_ITEMS * 2;
+static constexpr int MAX_WIDTH = 17;
+static constexpr uint8_t RAW_FLAG = 0x80;
+
+static inline void put16(uint8_t * p, int16_t v)
+{
+    p[0] = uint16_t(v) & 0xff;
+    p[1] = uint16_t(v) >> 8;
+}
+
+static inline int16_t get16(const uint8_t * p)
+{
+    return int16_t(uint16_t(p[0]) | (uint16_t(p[1]) << 8));
+}
+
+static inline void put32(uint8_t * p, uint32_t v)
+{
+    for (int k = 0; k < 4; k++)
+        p[k] = (v >> (8 * k)) & 0xff;
+}
+
+static inline uint32_t get32(const uint8_t * p)
+{
+    uint32_t v = 0;
+    for (int k = 0; k < 4; k++)
+        v |= uint32_t(p[k]) << (8 * k);
+    return v;
+}
+
+static inline void put64(uint8_t * p, uint64_t v)
+{
+    for (int k = 0; k < 8; k++)
+        p[k] = (v >> (8 * k)) & 0xff;
+}
+
+static inline uint64_t get64(const uint8_t * p)
+{
+    uint64_t v = 0;
+    for (int k = 0; k < 8; k++)
+        v |= uint64_t(p[k]) << (8 * k);
+    return v;
+}
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return (uint32_t(v) << 1) ^ uint32_t(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+    return int32_t(v >> 1) ^ -int32_t(v & 1);
+}
+
+static inline int bit_width(uint32_t v)
+{
+    int w = 0;
+    while (v)
+    {
+        w++;
+        v >>= 1;
+    }
+    return w;
+}
+
+/* Pack BLOCK_VALUES values, w bits each, into BLOCK_VALUES * w / 8 bytes. */
+static inline void pack(const uint32_t * v, int w, uint8_t * out)
+{
+    uint64_t acc = 0;
+    int bits = 0;
+    for (unsigned k = 0; k < BLOCK_VALUES; k++)
+    {
+        acc |= uint64_t(v[k]) << bits;
+        bits += w;
+        while (bits >= 8)
+        {
+            *out++ = acc & 0xff;
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+}
+
+static inline void unpack(const uint8_t * in, int w, uint32_t * v)
+{
+    const uint64_t mask = (uint64_t(1) << w) - 1;
+    uint64_t acc = 0;
+    int bits = 0;
+    for (unsigned k = 0; k < BLOCK_VALUES; k++)
+    {
+        while (bits < w)
+        {
+            acc |= uint64_t(*in++) << bits;
+            bits += 8;
+        }
+        v[k] = acc & mask;
+        acc >>= w;
+        bits -= w;
+    }
+}
+
+size_t max_payload(size_t nitems)
+{
+    // raw mode never needs more than 16 bits
+    return (nitems + BLOCK_ITEMS - 1) / BLOCK_ITEMS * (1 + BLOCK_VALUES * 16 / 8);
+}
+
+size_t encode(const uint8_t * in, size_t nitems, uint8_t * out)
+{
+    uint32_t vd[BLOCK_VALUES];
+    uint32_t vr[BLOCK_VALUES];
+    int32_t prev[2] = {0, 0};
+    uint8_t * start = out;
+
+    for (size_t item = 0; item < nitems; item += BLOCK_ITEMS)
+    {
+        const unsigned count = std::min<size_t>(BLOCK_ITEMS, nitems - item) * 2;
+        const uint8_t * p = in + item * ITEM_SIZE;
+        uint32_t or_delta = 0;
+        uint32_t or_raw = 0;
+        unsigned k;
+        for (k = 0; k < count; k++)
+        {
+            int32_t x = get16(p + k * 2);
+            vd[k] = zigzag(x - prev[k & 1]);
+            vr[k] = zigzag(x);
+            prev[k & 1] = x;
+            or_delta |= vd[k];
+            or_raw |= vr[k];
+        }
+        for (; k < BLOCK_VALUES; k++)
+            vd[k] = vr[k] = 0;
+        int w_delta = bit_width(or_delta);
+        int w_raw = bit_width(or_raw);
+        if (w_raw < w_delta)
+        {
+            *out++ = uint8_t(w_raw) | RAW_FLAG;
+            pack(vr, w_raw, out);
+            out += BLOCK_VALUES * w_raw / 8;
+        }
+        else
+        {
+            *out++ = uint8_t(w_delta);
+            pack(vd, w_delta, out);
+            out += BLOCK_VALUES * w_delta / 8;
+        }
+    }
+    return out - start;
+}
+
+bool decode(const uint8_t * in, size_t in_size, size_t nitems, uint8_t * out)
+{
+    uint32_t v[BLOCK_VALUES];
+    int32_t prev[2] = {0, 0};
+    const uint8_t * end = in + in_size;
+
+    for (size_t item = 0; item < nitems; item += BLOCK_ITEMS)
+    {
+        const unsigned count = std::min<size_t>(BLOCK_ITEMS, nitems - item) * 2;
+        uint8_t * p = out + item * ITEM_SIZE;
+        if (in >= end)
+            return false;
+        const bool raw = (*in & RAW_FLAG);
+        const int w = *in & 0x1f;
+        in++;
+        if (w > (raw ? 16 : MAX_WIDTH) || size_t(end - in) < BLOCK_VALUES * w / 8)
+            return false;
+        unpack(in, w, v);
+        in += BLOCK_VALUES * w / 8;
+        for (unsigned k = 0; k < count; k++)
+        {
+            int32_t x = unzigzag(v[k]);
+            if (!raw)
+                x += prev[k & 1];
+            prev[k & 1] = x;
+            put16(p + k * 2, int16_t(x));
+        }
+    }
+    return in == end;
+}
+
+bool probe(const std::string &filename, uint64_t * items)
+{
+    uint8_t hdr[HEADER_SIZE];
+    FILE * fp = fopen(filename.c_str(), "rb");
+    if (!fp)
+        return false;
+    bool ok = (fread(hdr, 1, HEADER_SIZE, fp) == HEADER_SIZE) &&
+              (memcmp(hdr, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0);
+    fclose(fp);
+    if (!ok || !items)
+        return ok;
+    try
+    {
+        reader r(filename, 1);
+        *items = r.get_items();
+    }
+    catch (std::runtime_error &)
+    {
+        return false;
+    }
+    return true;
+}
+
+// chunked_iq::pool
+
+pool::pool(unsigned nthreads)
+{
+    if (nthreads == 0)
+        nthreads = std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+    for (unsigned k = 1; k < nthreads; k++)
+        d_threads.emplace_back(&pool::thread_func, this);
+}
+
+pool::~pool()
+{
+    {
+        std::unique_lock<std::mutex> lock(d_mutex);
+        d_finish = true;
+    }
+    d_wake.notify_all();
+    for (auto &t : d_threads)
+        t.join();
+}
+
+void pool::work()
+{
+    size_t k;
+    while ((k = d_next++) < d_n)
+        (*d_fn)(k);
+}
+
+void pool::run(size_t n, const std::function<void(size_t)> &fn)
+{
+    if (d_threads.empty() || n < 2)
+    {
+        for (size_t k = 0; k < n; k++)
+            fn(k);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(d_mutex);
+    d_fn = &fn;
+    d_n = n;
+    d_next = 0;
+    d_active = d_threads.size();
+    d_generation++;
+    lock.unlock();
+    d_wake.notify_all();
+    work();
+    lock.lock();
+    while (d_active > 0)
+        d_done.wait(lock);
+    d_fn = nullptr;
+}
+
+void pool::thread_func()
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(d_mutex);
+    while (true)
+    {
+        while (!d_finish && d_generation == seen)
+            d_wake.wait(lock);
+        if (d_finish)
+            return;
+        seen = d_generation;
+        lock.unlock();
+        work();
+        lock.lock();
+        if (--d_active == 0)
+            d_done.notify_one();
+    }
+}
+
+// chunked_iq::writer
+
+writer::writer(FILE * fp, unsigned nthreads)
+    : d_fp(fp),
+      d_pool(nthreads)
+{
+    uint8_t hdr[HEADER_SIZE] = {};
+
+    d_pending.resize(CHUNK_ITEMS * ITEM_SIZE);
+    // two chunks per thread in flight keep the workers busy
+    d_out.resize(d_pool.size() * 2);
+    d_out_size.resize(d_out.size());
+    for (auto &o : d_out)
+        o.resize(CHUNK_HEADER_SIZE + max_payload(CHUNK_ITEMS));
+
+    memcpy(hdr, FILE_MAGIC, sizeof(FILE_MAGIC));
+    put32(&hdr[8], FILE_VERSION);
+    put32(&hdr[12], ITEM_SIZE);
+    put32(&hdr[16], CHUNK_ITEMS);
+    put32(&hdr[20], BLOCK_ITEMS);
+    if (fwrite(hdr, 1, HEADER_SIZE, d_fp) != HEADER_SIZE)
+        d_failed = true;
+    d_offset = HEADER_SIZE;
+}
+
+/* Encode up to d_out.size() chunks in parallel and write them in order. */
+bool writer::flush_chunks(const std::vector<const uint8_t *> &chunks, size_t nitems)
+{
+    for (size_t base = 0; base < chunks.size(); base += d_out.size())
+    {
+        size_t n = std::min(d_out.size(), chunks.size() - base);
+        d_pool.run(n, [&](size_t k) {
+            uint8_t * o = d_out[k].data();
+            size_t size = encode(chunks[base + k], nitems, o + CHUNK_HEADER_SIZE);
+            memcpy(o, CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+            put32(o + 4, nitems);
+            put32(o + 8, size);
+            put32(o + 12, 0);
+            d_out_size[k] = CHUNK_HEADER_SIZE + size;
+        });
+        for (size_t k = 0; k < n; k++)
+        {
+            if (fwrite(d_out[k].data(), 1, d_out_size[k], d_fp) != d_out_size[k])
+            {
+                std::cerr << "chunked_iq: write failed: " << strerror(errno) << std::endl;
+                d_failed = true;
+                return false;
+            }
+            d_index.push_back(d_offset);
+            d_offset += d_out_size[k];
+            d_items += nitems;
+        }
+    }
+    return true;
+}
+
+bool writer::write(const void * data, size_t bytes)
+{
+    const size_t chunk_bytes = CHUNK_ITEMS * ITEM_SIZE;
+    const uint8_t * p = (const uint8_t *)data;
+    std::vector<const uint8_t *> chunks;
+
+    if (d_failed || d_finished)
+        return false;
+    if (d_pending_bytes > 0)
+    {
+        size_t n = std::min(bytes, chunk_bytes - d_pending_bytes);
+        memcpy(&d_pending[d_pending_bytes], p, n);
+        d_pending_bytes += n;
+        p += n;
+        bytes -= n;
+        if (d_pending_bytes == chunk_bytes)
+            chunks.push_back(d_pending.data());
+    }
+    // full chunks are encoded in place
+    while (bytes >= chunk_bytes)
+    {
+        chunks.push_back(p);
+        p += chunk_bytes;
+        bytes -= chunk_bytes;
+    }
+    if (!flush_chunks(chunks, CHUNK_ITEMS))
+        return false;
+    if (d_pending_bytes == chunk_bytes)
+        d_pending_bytes = 0;
+    if (bytes > 0)
+    {
+        memcpy(&d_pending[d_pending_bytes], p, bytes);
+        d_pending_bytes += bytes;
+    }
+    return true;
+}
+
+bool writer::finish()
+{
+    if (d_finished)
+        return !d_failed;
+    d_finished = true;
+    if (d_failed)
+        return false;
+    size_t nitems = d_pending_bytes / ITEM_SIZE;
+    if (nitems > 0)
+    {
+        std::vector<const uint8_t *> chunks(1, d_pending.data());
+        if (!flush_chunks(chunks, nitems))
+            return false;
+    }
+    d_pending_bytes = 0;
+
+    std::vector<uint8_t> idx(d_index.size() * 8 + TRAILER_SIZE);
+    uint8_t * p = idx.data();
+    for (auto offset : d_index)
+    {
+        put64(p, offset);
+        p += 8;
+    }
+    memcpy(p, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    put64(p + 8, d_offset);
+    put64(p + 16, d_index.size());
+    put64(p + 24, d_items);
+    if ((fwrite(idx.data(), 1, idx.size(), d_fp) != idx.size()) || fflush(d_fp))
+    {
+        std::cerr << "chunked_iq: index write failed: " << strerror(errno) << std::endl;
+        d_failed = true;
+        return false;
+    }
+    return true;
+}
+
+// chunked_iq::reader
+
+reader::reader(const std::string &filename, unsigned nthreads)
+    : d_nthreads(nthreads)
+{
+    uint64_t file_size = 0;
+    uint8_t hdr[HEADER_SIZE];
+
+#ifdef _WIN32
+    d_fp = fopen(filename.c_str(), "rb");
+    if (!d_fp)
+        throw std::runtime_error(filename + ": " + strerror(errno));
+    _fseeki64(d_fp, 0, SEEK_END);
+    file_size = _ftelli64(d_fp);
+#else
+    d_fd = ::open(filename.c_str(), O_RDONLY);
+    if (d_fd < 0)
+        throw std::runtime_error(filename + ": " + strerror(errno));
+    struct stat st;
+    if (fstat(d_fd, &st) == 0)
+        file_size = st.st_size;
+#endif
+    if (file_size < HEADER_SIZE || !read_at(0, hdr, HEADER_SIZE) ||
+        memcmp(hdr, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+        get32(&hdr[8]) != FILE_VERSION || get32(&hdr[12]) != ITEM_SIZE ||
+        get32(&hdr[16]) != CHUNK_ITEMS || get32(&hdr[20]) != BLOCK_ITEMS)
+    {
+#ifdef _WIN32
+        fclose(d_fp);
+#else
+        ::close(d_fd);
+#endif
+        throw std::runtime_error(filename + ": not a compressed I/Q file");
+    }
+    if (!load_index(file_size))
+        rebuild_index(file_size);
+}
+
+reader::~reader()
+{
+    d_pool.reset();
+#ifdef _WIN32
+    fclose(d_fp);
+#else
+    ::close(d_fd);
+#endif
+}
+
+bool reader::read_at(uint64_t offset, void * buf, size_t len)
+{
+#ifdef _WIN32
+    std::unique_lock<std::mutex> lock(d_io_mutex);
+    if (_fseeki64(d_fp, offset, SEEK_SET))
+        return false;
+    return fread(buf, 1, len, d_fp) == len;
+#else
+    uint8_t * p = (uint8_t *)buf;
+    while (len > 0)
+    {
+        ssize_t count = pread(d_fd, p, len, offset);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        p += count;
+        offset += count;
+        len -= count;
+    }
+    return true;
+#endif
+}
+
+bool reader::load_index(uint64_t file_size)
+{
+    uint8_t tr[TRAILER_SIZE];
+    if (file_size < uint64_t(HEADER_SIZE + TRAILER_SIZE))
+        return false;
+    if (!read_at(file_size - TRAILER_SIZE, tr, TRAILER_SIZE) ||
+        memcmp(tr, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0)
+        return false;
+    uint64_t index_offset = get64(&tr[8]);
+    uint64_t nchunks = get64(&tr[16]);
+    uint64_t items = get64(&tr[24]);
+    if (nchunks != (items + CHUNK_ITEMS - 1) / CHUNK_ITEMS ||
+        index_offset + nchunks * 8 + TRAILER_SIZE != file_size)
+        return false;
+    std::vector<uint8_t> idx(nchunks * 8);
+    if (nchunks > 0 && !read_at(index_offset, idx.data(), idx.size()))
+        return false;
+    d_index.resize(nchunks + 1);
+    for (uint64_t k = 0; k < nchunks; k++)
+        d_index[k] = get64(&idx[k * 8]);
+    d_index[nchunks] = index_offset;
+    d_items = items;
+    return true;
+}
+
+/* No trailer: the recording is in progress or was interrupted. */
+void reader::rebuild_index(uint64_t file_size)
+{
+    uint8_t ch[CHUNK_HEADER_SIZE];
+    uint64_t offset = HEADER_SIZE;
+
+    d_index.clear();
+    d_items = 0;
+    while (offset + CHUNK_HEADER_SIZE <= file_size)
+    {
+        if (!read_at(offset, ch, CHUNK_HEADER_SIZE) ||
+            memcmp(ch, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0)
+            break;
+        uint32_t nitems = get32(&ch[4]);
+        uint64_t size = get32(&ch[8]);
+        // the last chunk may be incomplete
+        if (nitems == 0 || nitems > CHUNK_ITEMS ||
+            offset + CHUNK_HEADER_SIZE + size > file_size)
+            break;
+        d_index.push_back(offset);
+        d_items += nitems;
+        offset += CHUNK_HEADER_SIZE + size;
+        if (nitems < CHUNK_ITEMS)
+            break;
+    }
+    d_index.push_back(offset);
+}
+
+bool reader::decode_chunk(uint64_t chunk, uint8_t * out)
+{
+    thread_local std::vector<uint8_t> buf;
+    const uint64_t offset = d_index[chunk];
+    const uint64_t len = d_index[chunk + 1] - offset;
+    const uint64_t nitems = std::min<uint64_t>(CHUNK_ITEMS, d_items - chunk * CHUNK_ITEMS);
+
+    if (len < uint64_t(CHUNK_HEADER_SIZE) || len > CHUNK_HEADER_SIZE + max_payload(CHUNK_ITEMS))
+        return false;
+    buf.resize(len);
+    if (!read_at(offset, buf.data(), len))
+        return false;
+    if (memcmp(buf.data(), CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0 ||
+        get32(&buf[4]) != nitems || get32(&buf[8]) != len - CHUNK_HEADER_SIZE)
+        return false;
+    return decode(&buf[CHUNK_HEADER_SIZE], len - CHUNK_HEADER_SIZE, nitems, out);
+}
+
+/*!
+ * \brief Read samples.
+ * \param pos First sample.
+ * \param out Output buffer for nitems samples.
+ * \param nitems Number of samples to read.
+ * \param parallel Decode chunks on the thread pool.
+ * \return Number of samples read; less than nitems at the end of file
+ *         or on error.
+ */
+size_t reader::read(uint64_t pos, void * out, size_t nitems, bool parallel)
+{
+    if (pos >= d_items || nitems == 0)
+        return 0;
+    nitems = std::min<uint64_t>(nitems, d_items - pos);
+    const uint64_t first = pos / CHUNK_ITEMS;
+    const uint64_t last = (pos + nitems - 1) / CHUNK_ITEMS;
+    std::vector<uint8_t> ok(last - first + 1);
+
+    auto job = [&](size_t k) {
+        const uint64_t chunk = first + k;
+        const uint64_t start = chunk * CHUNK_ITEMS;
+        const uint64_t end = std::min<uint64_t>(start + CHUNK_ITEMS, d_items);
+        const uint64_t from = std::max<uint64_t>(pos, start);
+        const uint64_t to = std::min<uint64_t>(pos + nitems, end);
+        uint8_t * dst = (uint8_t *)out + (from - pos) * ITEM_SIZE;
+        if (from == start && to == end)
+        {
+            ok[k] = decode_chunk(chunk, dst);
+        }
+        else
+        {
+            thread_local std::vector<uint8_t> tmp;
+            tmp.resize((end - start) * ITEM_SIZE);
+            ok[k] = decode_chunk(chunk, tmp.data());
+            if (ok[k])
+                memcpy(dst, &tmp[(from - start) * ITEM_SIZE], (to - from) * ITEM_SIZE);
+        }
+    };
+
+    if (parallel && ok.size() > 1)
+    {
+        if (!d_pool)
+            d_pool.reset(new pool(d_nthreads));
+        d_pool->run(ok.size(), job);
+    }
+    else
+    {
+        for (size_t k = 0; k < ok.size(); k++)
+            job(k);
+    }
+    for (size_t k = 0; k < ok.size(); k++)
+        if (!ok[k])
+        {
+            std::cerr << "chunked_iq: chunk " << first + k << " is corrupted" << std::endl;
+            d_failed = true;
+            uint64_t good = (first + k) * CHUNK_ITEMS;
+            return good > pos ? good - pos : 0;
+        }
+    return nitems;
+}
+
+}
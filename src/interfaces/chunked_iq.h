@@ -0,0 +1,184 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2021 vladisslav2011@gmail.com.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef GQRX_CHUNKED_IQ_H
+#define GQRX_CHUNKED_IQ_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Chunked, seekable, losslessly compressed I/Q container.
+ *
+ * Samples are 16 bit little endian I/Q pairs (the same items as the
+ * "16.raw" format). The file consists of
+ *
+ *   file header   32 bytes
+ *   chunk 0..N-1  16 byte chunk header + compressed payload
+ *   chunk index   N x 64 bit offset of the chunk header
+ *   trailer       32 bytes
+ *
+ * All chunks except the last one hold CHUNK_ITEMS samples, so the chunk,
+ * containing a sample, is found by division and the index maps it to a
+ * file offset. Chunks are coded independently: blocks of BLOCK_ITEMS samples
+ * are stored either as per-channel deltas or as raw values, whichever needs
+ * less bits, zigzag mapped and bit packed at the block's width.
+ * A recording, that was cut short, has no index and trailer. The reader
+ * rebuilds the index by walking the chunk headers then.
+ */
+namespace chunked_iq
+{
+    static constexpr uint32_t ITEM_SIZE = 4;
+    static constexpr uint32_t CHUNK_ITEMS = 65536;
+    static constexpr uint32_t BLOCK_ITEMS = 64;
+    static constexpr int HEADER_SIZE = 32;
+    static constexpr int CHUNK_HEADER_SIZE = 16;
+    static constexpr int TRAILER_SIZE = 32;
+
+    /*! \brief Worst case payload size for nitems samples. */
+    size_t max_payload(size_t nitems);
+
+    /*!
+     * \brief Compress one chunk.
+     * \param in nitems samples.
+     * \param out output buffer of at least max_payload(nitems) bytes.
+     * \return payload size in bytes.
+     */
+    size_t encode(const uint8_t * in, size_t nitems, uint8_t * out);
+
+    /*!
+     * \brief Decompress one chunk.
+     * \return false if the payload is truncated or corrupted.
+     */
+    bool decode(const uint8_t * in, size_t in_size, size_t nitems, uint8_t * out);
+
+    /*! \brief Check the file header and get the number of samples. */
+    bool probe(const std::string &filename, uint64_t * items = nullptr);
+
+    /*!
+     * \brief Minimal fork-join thread pool for chunk coding.
+     *
+     * run() calls fn(0)..fn(n-1) on the worker threads and the calling
+     * thread and returns, when all of them are done. Only one thread may
+     * call run() at a time.
+     */
+    class pool
+    {
+    public:
+        explicit pool(unsigned nthreads = 0);
+        ~pool();
+        void run(size_t n, const std::function<void(size_t)> &fn);
+        unsigned size() const { return d_threads.size() + 1; }
+
+    private:
+        void thread_func();
+        void work();
+
+        std::vector<std::thread> d_threads;
+        std::mutex d_mutex;
+        std::condition_variable d_wake;
+        std::condition_variable d_done;
+        const std::function<void(size_t)> * d_fn{nullptr};
+        size_t d_n{0};
+        std::atomic<size_t> d_next{0};
+        unsigned d_active{0};
+        uint64_t d_generation{0};
+        bool d_finish{false};
+    };
+
+    /*!
+     * \brief Write samples to a compressed file.
+     *
+     * The writer does not own the FILE pointer. finish() must be called
+     * before the file is closed to write the index and trailer.
+     */
+    class writer
+    {
+    public:
+        explicit writer(FILE * fp, unsigned nthreads = 0);
+        bool write(const void * data, size_t bytes);
+        bool finish();
+        uint64_t get_items() const { return d_items; }
+        uint64_t get_compressed_size() const { return d_offset; }
+
+    private:
+        bool flush_chunks(const std::vector<const uint8_t *> &chunks, size_t nitems);
+
+        FILE * d_fp;
+        pool d_pool;
+        std::vector<uint8_t> d_pending;
+        size_t d_pending_bytes{0};
+        std::vector<std::vector<uint8_t>> d_out;
+        std::vector<size_t> d_out_size;
+        std::vector<uint64_t> d_index;
+        uint64_t d_offset{0};
+        uint64_t d_items{0};
+        bool d_failed{false};
+        bool d_finished{false};
+    };
+
+    /*!
+     * \brief Random access reader.
+     *
+     * read() with parallel == false may be called from several threads at
+     * once, chunks are decoded on the calling thread then.
+     */
+    class reader
+    {
+    public:
+        /*! \throws std::runtime_error if the file can not be opened. */
+        explicit reader(const std::string &filename, unsigned nthreads = 0);
+        ~reader();
+        uint64_t get_items() const { return d_items; }
+        bool get_failed() const { return d_failed; }
+        size_t read(uint64_t pos, void * out, size_t nitems, bool parallel = true);
+
+    private:
+        bool read_at(uint64_t offset, void * buf, size_t len);
+        bool load_index(uint64_t file_size);
+        void rebuild_index(uint64_t file_size);
+        bool decode_chunk(uint64_t chunk, uint8_t * out);
+
+#ifdef _WIN32
+        FILE * d_fp{nullptr};
+        std::mutex d_io_mutex;
+#else
+        int d_fd{-1};
+#endif
+        std::vector<uint64_t> d_index; // chunk offsets + end of data
+        uint64_t d_items{0};
+        std::atomic<bool> d_failed{false};
+        std::unique_ptr<pool> d_pool;
+        unsigned d_nthreads;
+    };
+}
+
+#endif
@@ -33,6 +33,14 @@
 #include <gnuradio/thread/thread.h>
 #include <gnuradio/io_signature.h>
 #include <stdexcept>
+#include <cstring>
+#include <iostream>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 // win32 (mingw/msvc) specific
 #ifdef HAVE_IO_H
@@ -51,12 +59,61 @@
 #define	OUR_O_LARGEFILE 0
 #endif
 
+// O_DIRECT/fallocate backend is Linux-only
+#if defined(__linux__) && defined(O_DIRECT)
+#define FILE_SINK_DIRECT_IO
+#endif
+
+constexpr int file_sink::DIRECT_IO_ALIGN;
+constexpr int file_sink::DIRECT_IO_DEPTH;
+constexpr int64_t file_sink::DIRECT_IO_PREALLOC;
+
+static char * alloc_aligned(size_t size)
+{
+#ifdef _WIN32
+    return (char *)_aligned_malloc(size, file_sink::DIRECT_IO_ALIGN);
+#else
+    void * p = nullptr;
+    if (posix_memalign(&p, file_sink::DIRECT_IO_ALIGN, size))
+        return nullptr;
+    return (char *)p;
+#endif
+}
+
+static void free_aligned(char * p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+void file_sink::update_latency(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<float, std::milli> diff = std::chrono::steady_clock::now() - start;
+    float ms = diff.count();
+    d_latency = (d_latency == 0.f) ? ms : d_latency * 0.9f + ms * 0.1f;
+    if (ms > d_latency_max)
+        d_latency_max = ms;
+}
+
+/* Return the buffer to the free pool. Called with d_mutex held. */
+void file_sink::release_buffer(s_data &item, int written)
+{
+    item.len = 0;
+    d_free.push(item);
+    d_buffers_used--;
+    d_written += written;
+}
+
 void file_sink::writer()
 {
     s_data item;
     int written = 0;
     char * p;
     FILE * old_fp = NULL;
+    std::unique_ptr<chunked_iq::writer> old_zw;
     int count = 0;
     while (true)
     {
@@ -67,6 +124,7 @@ void file_sink::writer()
             d_queue.pop();
             written = 0;
             p = item.data;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
             while (written < item.len)
             {
                 if(d_updated)
@@ -74,16 +132,21 @@ void file_sink::writer()
                     old_fp = d_fp;
                     d_fp = d_new_fp;                     // install new file pointer
                     d_new_fp = 0;
+                    old_zw = std::move(d_zw);
+                    d_zw = std::move(d_new_zw);
                     d_updated = false;
                 }
                 if (d_fp && !d_failed)
                 {
                     guard.unlock();
-                    count = fwrite(p, 1, item.len-written, d_fp);
+                    if (d_zw)
+                        count = d_zw->write(p, item.len-written) ? item.len-written : 0;
+                    else
+                        count = fwrite(p, 1, item.len-written, d_fp);
                     guard.lock();
                     if(count == 0)
                     {
-                        if(ferror(d_fp))
+                        if(ferror(d_fp) || d_zw)
                         {
                             std::cerr << "file_sink write failed with error " << fileno(d_fp) << std::endl;
                             d_failed=true;
@@ -98,17 +161,19 @@ void file_sink::writer()
                 written += count;
                 p += count;
             }
-            item.len = 0;
-            d_free.push(item);
+            if (written > 0)
+                update_latency(start);
+            release_buffer(item, written);
             if (old_fp)
             {
                 guard.unlock();
+                if (old_zw)
+                    old_zw->finish();
+                old_zw.reset();
                 fclose(old_fp);
                 guard.lock();
                 old_fp = NULL;
             }
-            d_buffers_used--;
-            d_written += written;
         }
         if (d_writer_finish)
         {
@@ -128,67 +193,326 @@ void file_sink::writer()
     }
 }
 
-file_sink::sptr file_sink::make(size_t itemsize, const char *filename, int sample_rate, bool append, int buffers_max)
+#ifdef FILE_SINK_DIRECT_IO
+/* Write the whole buffer with pwrite, retrying on short writes. */
+static int pwrite_all(int fd, const char * p, int len, int64_t offset)
+{
+    int written = 0;
+    while (written < len)
+    {
+        ssize_t count = pwrite(fd, p + written, len - written, offset + written);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        if (count == 0)
+            break;
+        written += count;
+    }
+    return written;
+}
+
+/* Switch the descriptor to buffered mode for unaligned writes. */
+static void clear_o_direct(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0 && (flags & O_DIRECT))
+        fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+}
+#endif
+
+/*
+ * Direct I/O writer. Full buffers are aligned and are written with O_DIRECT
+ * at explicit offsets, up to DIRECT_IO_DEPTH at a time when io_uring is
+ * available. The last (partial) buffer is written after all previous writes
+ * have completed, with O_DIRECT cleared on the descriptor.
+ */
+void file_sink::writer_direct()
+{
+#ifdef FILE_SINK_DIRECT_IO
+    struct io_slot
+    {
+        s_data item;
+        int64_t offset;
+        std::chrono::steady_clock::time_point start;
+        bool busy{false};
+    };
+    std::vector<io_slot> slots(DIRECT_IO_DEPTH);
+    std::vector<int> free_slots;
+    int inflight = 0;
+    int depth = 1;
+    int fd = -1;
+    int64_t offset = 0;
+    int64_t allocated = 0;
+    bool can_prealloc = true;
+    int64_t prealloc_step = std::max(DIRECT_IO_PREALLOC, int64_t(d_sd_max) * d_buffers_max);
+
+#ifdef ENABLE_LIBURING
+    if (d_ring_ok)
+        depth = DIRECT_IO_DEPTH;
+#endif
+    for (int k = depth - 1; k >= 0; k--)
+        free_slots.push_back(k);
+
+    std::unique_lock<std::mutex> guard(d_mutex);
+    while (true)
+    {
+        if (d_updated && inflight == 0)
+        {
+            int old_fd = fd;
+            int64_t old_offset = offset;
+            fd = d_new_fd;
+            offset = allocated = d_new_offset;
+            d_new_fd = -1;
+            d_updated = false;
+            can_prealloc = true;
+            if (old_fd >= 0)
+            {
+                guard.unlock();
+                // release preallocated blocks past the end of data
+                if (ftruncate(old_fd, old_offset) != 0)
+                    perror("file_sink ftruncate");
+                ::close(old_fd);
+                guard.lock();
+            }
+        }
+        while (!d_queue.empty() && !free_slots.empty())
+        {
+            s_data item = d_queue.front();
+            if (fd < 0 || d_failed)
+            {
+                d_queue.pop();
+                release_buffer(item, 0);
+                continue;
+            }
+            bool aligned = (item.len % DIRECT_IO_ALIGN == 0) && (offset % DIRECT_IO_ALIGN == 0);
+            // unaligned writes must not overtake queued ones
+            if (!aligned && inflight > 0)
+                break;
+            d_queue.pop();
+            int slot = free_slots.back();
+            free_slots.pop_back();
+            slots[slot].item = item;
+            slots[slot].offset = offset;
+            slots[slot].busy = true;
+            slots[slot].start = std::chrono::steady_clock::now();
+            offset += item.len;
+            guard.unlock();
+            if (can_prealloc && offset > allocated)
+            {
+                if (fallocate(fd, FALLOC_FL_KEEP_SIZE, allocated, std::max(prealloc_step, offset - allocated)) == 0)
+                    allocated += std::max(prealloc_step, offset - allocated);
+                else
+                    can_prealloc = false;
+            }
+            int result = 0;
+            bool submitted = false;
+#ifdef ENABLE_LIBURING
+            if (d_ring_ok && aligned)
+            {
+                struct io_uring_sqe *sqe = io_uring_get_sqe(&d_ring);
+                if (sqe)
+                {
+                    io_uring_prep_write(sqe, fd, item.data, item.len, slots[slot].offset);
+                    io_uring_sqe_set_data(sqe, (void *)(intptr_t)slot);
+                    submitted = (io_uring_submit(&d_ring) == 1);
+                }
+            }
+#endif
+            if (!submitted)
+            {
+                if (!aligned)
+                    clear_o_direct(fd);
+                result = pwrite_all(fd, item.data, item.len, slots[slot].offset);
+            }
+            guard.lock();
+            if (submitted)
+            {
+                inflight++;
+                continue;
+            }
+            if (result < 0)
+            {
+                std::cerr << "file_sink write failed with error " << -result << std::endl;
+                d_failed = true;
+                result = 0;
+            }
+            else
+                update_latency(slots[slot].start);
+            slots[slot].busy = false;
+            release_buffer(item, result);
+            free_slots.push_back(slot);
+        }
+#ifdef ENABLE_LIBURING
+        if (inflight > 0)
+        {
+            struct io_uring_cqe *cqe = nullptr;
+            guard.unlock();
+            int ret = io_uring_wait_cqe(&d_ring, &cqe);
+            guard.lock();
+            if (ret < 0)
+            {
+                if (ret == -EINTR)
+                    continue;
+                std::cerr << "file_sink io_uring wait failed with error " << -ret << std::endl;
+                d_failed = true;
+                // give up on the writes in flight
+                for (int k = 0; k < depth; k++)
+                    if (slots[k].busy)
+                    {
+                        slots[k].busy = false;
+                        release_buffer(slots[k].item, 0);
+                        free_slots.push_back(k);
+                    }
+                inflight = 0;
+                continue;
+            }
+            int slot = (intptr_t)io_uring_cqe_get_data(cqe);
+            int result = cqe->res;
+            io_uring_cqe_seen(&d_ring, cqe);
+            io_slot &s = slots[slot];
+            if (result >= 0 && result < s.item.len)
+            {
+                // short write: finish synchronously
+                guard.unlock();
+                int rest = pwrite_all(fd, s.item.data + result, s.item.len - result, s.offset + result);
+                guard.lock();
+                result = (rest < 0) ? rest : result + rest;
+            }
+            if (result < 0)
+            {
+                std::cerr << "file_sink write failed with error " << -result << std::endl;
+                d_failed = true;
+                result = 0;
+            }
+            else
+                update_latency(s.start);
+            s.busy = false;
+            release_buffer(s.item, result);
+            free_slots.push_back(slot);
+            inflight--;
+            continue;
+        }
+#endif
+        if (!d_queue.empty())
+            continue;
+        if (d_writer_finish)
+        {
+            if (fd >= 0)
+            {
+                if (ftruncate(fd, offset) != 0)
+                    perror("file_sink ftruncate");
+                ::close(fd);
+            }
+            return;
+        }
+        d_writer_ready.notify_one();
+        d_writer_trigger.wait(guard);
+    }
+#endif
+}
+
+file_sink::sptr file_sink::make(size_t itemsize, const char *filename, int sample_rate, bool append, int buffers_max, bool direct_io,
+                                bool compress)
 {
     return gnuradio::get_initial_sptr
-        (new file_sink(itemsize, filename, sample_rate, append, buffers_max));
+        (new file_sink(itemsize, filename, sample_rate, append, buffers_max, direct_io, compress));
 }
 
 
-file_sink::file_sink(size_t itemsize, const char *filename, int sample_rate, bool append, int buffers_max)
+file_sink::file_sink(size_t itemsize, const char *filename, int sample_rate, bool append, int buffers_max, bool direct_io,
+                     bool compress)
     : sync_block("file_sink",
                     gr::io_signature::make(1, 1, itemsize),
                     gr::io_signature::make(0, 0, 0)),
                     d_itemsize(itemsize),
                     d_fp(0), d_new_fp(0), d_updated(false), d_is_binary(true),
                     d_append(append), d_writer_finish(false),
-                    d_sd_max(std::max(8192, sample_rate) * itemsize), d_buffers_used(0), d_buffers_max(buffers_max)
+                    d_sd_max(std::max(8192, sample_rate) * itemsize), d_buffers_used(0), d_buffers_max(buffers_max),
+                    d_failed(false), d_closing(false), d_written(0),
+                    d_direct(direct_io), d_new_fd(-1), d_new_offset(0),
+                    d_buffers_hwm(0), d_latency(0.f), d_latency_max(0.f),
+                    d_compress(compress)
 {
-    if (!open(filename))
-        throw std::runtime_error ("can't open file");
-    d_writer_thread = new std::thread(std::bind(&file_sink::writer, this));
+#ifndef FILE_SINK_DIRECT_IO
+    d_direct = false;
+#endif
+    if (d_compress)
+    {
+        if (itemsize != chunked_iq::ITEM_SIZE)
+            throw std::runtime_error ("unsupported item size for compressed file");
+        // the compressed file ends with the chunk index and is written
+        // through stdio
+        d_append = false;
+        d_direct = false;
+    }
+#ifdef ENABLE_LIBURING
+    d_ring_ok = false;
+    if (d_direct)
+        d_ring_ok = (io_uring_queue_init(DIRECT_IO_DEPTH, &d_ring, 0) == 0);
+#endif
+    // Buffers are aligned and sized to a multiple of DIRECT_IO_ALIGN, so that
+    // every full buffer can be written with O_DIRECT.
+    d_sd_max = (d_sd_max + DIRECT_IO_ALIGN - 1) / DIRECT_IO_ALIGN * DIRECT_IO_ALIGN;
     d_sd.data = NULL;
     d_sd.len = 0;
-    d_buffers_used = 0;
-    d_closing = false;
     if(d_buffers_max < 2)
         d_buffers_max = 2;
-    for (int k = 0; k < d_buffers_max; k++)
+    d_pool.resize(d_buffers_max);
+    d_queue.reserve(d_buffers_max);
+    d_free.reserve(d_buffers_max);
+    for (auto &b : d_pool)
     {
-        d_sd.data = new char [d_sd_max];
-        d_sd.size = d_sd_max;
-        d_sd.len = 0;
-        memset(d_sd.data, 0x01, d_sd.size);
-        d_free.push(d_sd);
+        b.data = alloc_aligned(d_sd_max);
+        if (!b.data)
+            throw std::runtime_error ("can't allocate buffers");
+        b.size = d_sd_max;
+        b.len = 0;
+        memset(b.data, 0x01, b.size);
+        d_free.push(b);
     }
-    d_sd.data = NULL;
+    if (!open(filename))
+        throw std::runtime_error ("can't open file");
+    if (d_direct)
+        d_writer_thread = new std::thread(std::bind(&file_sink::writer_direct, this));
+    else
+        d_writer_thread = new std::thread(std::bind(&file_sink::writer, this));
 }
 
 file_sink::~file_sink()
 {
     d_closing=true;
-    if (d_sd.len > 0)
+    close();
     {
-        d_queue.push(d_sd);
-        d_sd.len = 0;
-        d_sd.data = NULL;
+        std::unique_lock<std::mutex> guard(d_mutex);
+        d_writer_finish = true;
+        d_writer_trigger.notify_one();
     }
-    close();
-    d_writer_finish = true;
-    d_writer_trigger.notify_one();
     d_writer_thread->join();
     delete d_writer_thread;
-    while (!d_free.empty())
-    {
-        d_sd = d_free.front();
-        d_free.pop();
-        delete [] d_sd.data;
-    }
+    for (auto &b : d_pool)
+        free_aligned(b.data);
+    d_pool.clear();
     if (d_fp)
     {
+        if (d_zw)
+            d_zw->finish();
+        d_zw.reset();
         fclose(d_fp);
         d_fp = 0;
     }
+    d_new_zw.reset();
+#ifdef FILE_SINK_DIRECT_IO
+    if (d_new_fd >= 0)
+        ::close(d_new_fd);
+    d_new_fd = -1;
+#endif
+#ifdef ENABLE_LIBURING
+    if (d_ring_ok)
+        io_uring_queue_exit(&d_ring);
+#endif
 }
 
 bool file_sink::open(const char *filename)
@@ -207,6 +531,39 @@ bool file_sink::open(const char *filename)
     {
         flags = O_WRONLY|O_CREAT|O_TRUNC|OUR_O_LARGEFILE|OUR_O_BINARY;
     }
+#ifdef FILE_SINK_DIRECT_IO
+    if (d_direct)
+    {
+        // writes go to explicit offsets, so O_APPEND is not used
+        flags &= ~O_APPEND;
+        fd = ::open(filename, flags | O_DIRECT, 0664);
+        if (fd < 0 && errno == EINVAL)
+        {
+            // filesystem does not support O_DIRECT (tmpfs etc)
+            std::cerr << "file_sink: O_DIRECT is not supported for " << filename << std::endl;
+            fd = ::open(filename, flags, 0664);
+        }
+        if (fd < 0)
+        {
+            perror(filename);
+            return false;
+        }
+        std::unique_lock<std::mutex> guard(d_mutex);
+        if (d_new_fd >= 0)
+            ::close(d_new_fd);
+        d_new_fd = fd;
+        d_new_offset = d_append ? lseek(fd, 0, SEEK_END) : 0;
+        if (d_new_offset < 0)
+            d_new_offset = 0;
+        d_updated = true;
+        d_failed = false;
+        d_closing = false;
+        d_written = 0;
+        d_buffers_hwm = 0;
+        d_latency = d_latency_max = 0.f;
+        return true;
+    }
+#endif
     if((fd = ::open(filename, flags, 0664)) < 0)
     {
         perror(filename);
@@ -226,10 +583,15 @@ bool file_sink::open(const char *filename)
 
     {
         std::unique_lock<std::mutex> guard(d_mutex);
+        d_new_zw.reset();
+        if (d_compress && d_new_fp)
+            d_new_zw.reset(new chunked_iq::writer(d_new_fp));
         d_updated = true;
         d_failed = false;
         d_closing = false;
         d_written = 0;
+        d_buffers_hwm = 0;
+        d_latency = d_latency_max = 0.f;
     }
     return d_new_fp != 0;
 }
@@ -240,21 +602,36 @@ void file_sink::close()
     //prevent new buffers submission
     d_closing = true;
     //submit last buffer
-    if (d_sd.len > 0)
+    if (d_sd.data != NULL)
     {
-        d_queue.push(d_sd);
+        if (d_sd.len > 0)
+            d_queue.push(d_sd);
+        else
+        {
+            d_free.push(d_sd);
+            d_buffers_used--;
+        }
         d_sd.data = NULL;
         d_sd.len = 0;
     }
     //wake the thread
     d_writer_trigger.notify_one();
     //wait for thread to finish writeng buffers
-    d_writer_ready.wait(guard);
+    while (d_buffers_used > 0)
+        d_writer_ready.wait(guard);
     if (d_new_fp)
     {
+        d_new_zw.reset();
         fclose(d_new_fp);
         d_new_fp = 0;
     }
+#ifdef FILE_SINK_DIRECT_IO
+    if (d_new_fd >= 0)
+    {
+        ::close(d_new_fd);
+        d_new_fd = -1;
+    }
+#endif
     d_updated = true;
 }
 
@@ -268,59 +645,47 @@ int file_sink::work(int noutput_items,
                         gr_vector_const_void_star &input_items,
                         gr_vector_void_star &output_items)
 {
-    char *inbuf = (char*)input_items[0];
+    const char *inbuf = (const char*)input_items[0];
     int len_bytes = noutput_items * d_itemsize;
     //do not queue more buffers if we are closing the file
     std::unique_lock<std::mutex> guard(d_mutex);
     if (d_closing || d_failed)
         return noutput_items;
-    if (d_sd.data == NULL)
+    // Fill the buffers completely, so that only the last one may be
+    // of unaligned size
+    while (len_bytes > 0)
     {
-        if(!d_free.empty())
-        {
-            d_sd = d_free.front();
-            d_free.pop();
-        }
-        else
-        {
-            d_failed = true;
-                d_sd.data = NULL;
-            return noutput_items;
-        }
-    }
-    if (d_sd.len + len_bytes > d_sd_max)
-    {
-        d_queue.push(d_sd);
-        d_writer_trigger.notify_one();
-        if (!d_free.empty())
+        if (d_sd.data == NULL)
         {
+            if (d_free.empty())
+            {
+                d_failed = true;
+                return noutput_items;
+            }
             d_sd = d_free.front();
             d_free.pop();
+            d_sd.len = 0;
+            ++d_buffers_used;
+            if (d_buffers_used > d_buffers_hwm)
+                d_buffers_hwm = d_buffers_used;
+            if (d_buffers_used > d_buffers_max)
+            {
+                d_failed = true;
+            }
         }
-        else
+        int count = std::min(len_bytes, d_sd.size - d_sd.len);
+        memcpy(&d_sd.data[d_sd.len], inbuf, count);
+        d_sd.len += count;
+        inbuf += count;
+        len_bytes -= count;
+        if (d_sd.len == d_sd.size)
         {
-            d_failed = true;
+            d_queue.push(d_sd);
             d_sd.data = NULL;
-            return noutput_items;
-        }
-
-        if (len_bytes > d_sd_max)
-            d_sd_max = len_bytes;
-        if (d_sd.size < d_sd_max)
-        {
-            delete [] d_sd.data;
-            d_sd.data = new char [d_sd_max];
-            d_sd.size = d_sd_max;
-        }
-        d_sd.len = 0;
-        ++d_buffers_used;
-        if (d_buffers_used > d_buffers_max)
-        {
-            d_failed = true;
+            d_sd.len = 0;
+            d_writer_trigger.notify_one();
         }
     }
-    memcpy(&d_sd.data[d_sd.len], inbuf, len_bytes);
-    d_sd.len += len_bytes;
     return noutput_items;
 }
 
@@ -329,6 +694,21 @@ int file_sink::get_buffer_usage()
     return d_buffers_used * 100 / d_buffers_max;
 }
 
+int file_sink::get_buffer_hwm()
+{
+    return d_buffers_hwm * 100 / d_buffers_max;
+}
+
+float file_sink::get_write_latency()
+{
+    return d_latency;
+}
+
+float file_sink::get_write_latency_max()
+{
+    return d_latency_max;
+}
+
 int file_sink::get_buffers_max()
 {
     return d_buffers_max;
@@ -27,9 +27,50 @@
 #include <gnuradio/blocks/api.h>
 #include <gnuradio/sync_block.h>
 #include <thread>
-#include <queue>
+#include <vector>
+#include <chrono>
 #include <condition_variable>
-		
+#include <memory>
+#include "chunked_iq.h"
+#ifdef ENABLE_LIBURING
+#include <liburing.h>
+#endif
+
+/*!
+ * \brief Fixed capacity FIFO.
+ *
+ * Storage is allocated once, so that pushing and popping buffers
+ * in the GNU Radio thread never calls the allocator.
+ */
+template <typename T> class fixed_queue
+{
+public:
+    void reserve(size_t capacity)
+    {
+        d_items.resize(capacity);
+        d_head = 0;
+        d_count = 0;
+    }
+    bool empty() const { return d_count == 0; }
+    size_t size() const { return d_count; }
+    T &front() { return d_items[d_head]; }
+    void push(const T &item)
+    {
+        d_items[(d_head + d_count) % d_items.size()] = item;
+        d_count++;
+    }
+    void pop()
+    {
+        d_head = (d_head + 1) % d_items.size();
+        d_count--;
+    }
+
+private:
+    std::vector<T> d_items;
+    size_t d_head{0};
+    size_t d_count{0};
+};
+
 
 /*!
     * \brief Write stream to file without blocking.
@@ -55,8 +96,22 @@ public:
     * \param filename name of the file to open and write output to.
     * \param append if true, data is appended to the file instead of
     *        overwriting the initial content.
+    * \param direct_io write with O_DIRECT (and io_uring, if available)
+    *        bypassing stdio and the page cache.
+    * \param compress write a chunked compressed file (see chunked_iq.h),
+    *        itemsize must be chunked_iq::ITEM_SIZE. Implies !append and
+    *        !direct_io.
     */
-    static sptr make(size_t itemsize, const char *filename, int sample_rate, bool append=false, int buffers_max=8);
+    static sptr make(size_t itemsize, const char *filename, int sample_rate, bool append=false, int buffers_max=8, bool direct_io=false,
+                     bool compress=false);
+
+    /*! Alignment of buffers, file offsets and write sizes in direct I/O mode. */
+    static constexpr int DIRECT_IO_ALIGN = 4096;
+    /*! Maximum number of writes in flight in direct I/O mode. */
+    static constexpr int DIRECT_IO_DEPTH = 8;
+    /*! Minimum file preallocation step in direct I/O mode. */
+    static constexpr int64_t DIRECT_IO_PREALLOC = 64ll * 1024ll * 1024ll;
+
     private:
       size_t d_itemsize;
 
@@ -68,8 +123,9 @@ public:
       std::mutex d_mutex;
       bool         d_unbuffered;
       bool         d_append;
-      std::queue<s_data> d_queue;
-      std::queue<s_data> d_free;
+      std::vector<s_data> d_pool;
+      fixed_queue<s_data> d_queue;
+      fixed_queue<s_data> d_free;
       std::condition_variable d_writer_trigger;
       std::condition_variable d_writer_ready;
       bool         d_writer_finish;
@@ -81,12 +137,29 @@ public:
       bool         d_failed;
       bool         d_closing;
       size_t       d_written;
+      bool         d_direct;      // direct I/O backend requested
+      int          d_new_fd;      // new file descriptor (direct I/O)
+      int64_t      d_new_offset;  // initial write offset of d_new_fd
+      int          d_buffers_hwm; // buffer usage high-water mark
+      float        d_latency;     // average write latency, ms
+      float        d_latency_max; // maximum write latency, ms
+      bool         d_compress;    // chunked compressed output
+      std::unique_ptr<chunked_iq::writer> d_zw;     // current compressor
+      std::unique_ptr<chunked_iq::writer> d_new_zw; // compressor for d_new_fp
+#ifdef ENABLE_LIBURING
+      struct io_uring d_ring;
+      bool         d_ring_ok;
+#endif
 
     private:
     void writer();
+    void writer_direct();
+    void update_latency(std::chrono::steady_clock::time_point start);
+    void release_buffer(s_data &item, int written);
 
     public:
-      file_sink(size_t itemsize, const char *filename, int sample_rate, bool append, int buffers_max=8);
+      file_sink(size_t itemsize, const char *filename, int sample_rate, bool append, int buffers_max=8, bool direct_io=false,
+                bool compress=false);
       file_sink() {}
       ~file_sink();
 
@@ -109,6 +182,9 @@ public:
       void set_unbuffered(bool unbuffered);
 
       int  get_buffer_usage();
+      int  get_buffer_hwm();
+      float get_write_latency();
+      float get_write_latency_max();
       int  get_buffers_max();
       bool get_failed();
       size_t get_written();
@@ -24,12 +24,20 @@
 #include "file_source.h"
 #include <gnuradio/io_signature.h>
 #include <fcntl.h>
+#include <chrono>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <cstdio>
+#include <cstring>
 #include <stdexcept>
 #include <vector>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <unistd.h>
+#define FILE_SOURCE_COPY_RANGE
+#endif
 
 #ifdef _MSC_VER
 #define GR_FSEEK _fseeki64
@@ -47,6 +55,10 @@
 #endif
 
 #define READ_MAX (16*1024*1024)
+// conversion block, a multiple of nsamples of every format
+#define SAVE_BLOCK_SAMPLES (1024*1024)
+// copy_file_range step between progress updates
+#define SAVE_COPY_STEP (64*1024*1024)
 #define NO_WAIT_START
 
 void file_source::reader()
@@ -54,6 +66,7 @@ void file_source::reader()
     uint8_t * last=&d_buf.data()[d_buf.size()];
     uint8_t * p;
     FILE * old_fp = NULL;
+    std::shared_ptr<chunked_iq::reader> old_zr;
     int count = 0;
     while (true)
     {
@@ -67,6 +80,10 @@ void file_source::reader()
                 old_fp = d_fp;
                 d_fp = d_new_fp;                     // install new file pointer
                 d_new_fp = 0;
+                old_zr = d_zr;
+                d_zr = d_new_zr;
+                d_new_zr.reset();
+                d_read_pos = d_start_offset_items;
                 d_updated = false;
                 d_file_begin = true;
                 d_eof = false;
@@ -75,9 +92,18 @@ void file_source::reader()
             {
                 d_buffering = true;
                 p=d_rp=d_wp=d_buf.data();
-                guard.unlock();
-                d_seek_ok = (GR_FSEEK((FILE*)d_fp, d_seek_point * d_itemsize, SEEK_SET) == 0);
-                guard.lock();
+                if (d_zr)
+                {
+                    // compressed file: the chunk is located on the next read
+                    d_read_pos = d_seek_point;
+                    d_seek_ok = true;
+                }
+                else
+                {
+                    guard.unlock();
+                    d_seek_ok = (GR_FSEEK((FILE*)d_fp, d_seek_point * d_itemsize, SEEK_SET) == 0);
+                    guard.lock();
+                }
                 d_seek = false;
                 d_items_remaining = d_length_items + d_start_offset_items - d_seek_point;
                 d_eof = false;
@@ -104,11 +130,15 @@ void file_source::reader()
                 if (read_bytes > READ_MAX)
                     read_bytes = READ_MAX;
                 guard.unlock();
-                count = fread(p, d_itemsize, read_bytes / d_itemsize, d_fp) * d_itemsize;
+                if (d_zr)
+                    count = d_zr->read(d_read_pos, p, read_bytes / d_itemsize) * d_itemsize;
+                else
+                    count = fread(p, d_itemsize, read_bytes / d_itemsize, d_fp) * d_itemsize;
                 guard.lock();
+                d_read_pos += count / d_itemsize;
                 if (count == 0)
                 {
-                    if (ferror(d_fp))
+                    if (d_zr ? d_zr->get_failed() : ferror(d_fp))
                     {
                         std::cerr << "file_source read failed with error " << fileno(d_fp) << std::endl;
                         d_failed = true;
@@ -117,6 +147,7 @@ void file_source::reader()
                     {
                         if (d_repeat && d_seekable)
                         {
+                            d_read_pos = d_start_offset_items;
                             guard.unlock();
                             d_seek_ok = (GR_FSEEK((FILE*)d_fp, d_start_offset_items * d_itemsize, SEEK_SET) == 0);
                             guard.lock();
@@ -136,6 +167,7 @@ void file_source::reader()
         if (old_fp)
         {
             guard.unlock();
+            old_zr.reset();
             fclose(old_fp);
             guard.lock();
             old_fp = NULL;
@@ -178,6 +210,7 @@ file_source::file_source(size_t itemsize,
       d_length_items(length_items),
       d_fp(0),
       d_new_fp(0),
+      d_read_pos(0),
       d_repeat(repeat),
       d_updated(false),
       d_file_begin(true),
@@ -299,6 +332,7 @@ void file_source::open(const char* filename,
         fclose(d_new_fp);
         d_new_fp = 0;
     }
+    d_new_zr.reset();
 
     if ((d_new_fp = fopen(filename, "rb")) == NULL)
     {
@@ -324,6 +358,23 @@ void file_source::open(const char* filename,
         GR_FSEEK(d_new_fp, 0, SEEK_END);
         file_size = GR_FTELL(d_new_fp);
 
+        // Compressed file: decoded items are read through the chunk index
+        if ((d_itemsize == chunked_iq::ITEM_SIZE) && chunked_iq::probe(filename))
+        {
+            try
+            {
+                d_new_zr = std::make_shared<chunked_iq::reader>(filename);
+            }
+            catch (std::runtime_error &e)
+            {
+                std::cerr << e.what() << "\n";
+                fclose(d_new_fp);
+                d_new_fp = 0;
+                throw;
+            }
+            file_size = d_new_zr->get_items() * d_itemsize;
+        }
+
         // Make sure there will be at least one item available
         if ((file_size / d_itemsize) < (start_offset_items + 1))
         {
@@ -336,6 +387,8 @@ void file_source::open(const char* filename,
                 std::cerr<<"file is too small\n";
             }
             fclose(d_new_fp);
+            d_new_fp = 0;
+            d_new_zr.reset();
             throw std::runtime_error("file is too small");
         }
     }
@@ -388,11 +441,18 @@ void file_source::close()
         fclose(d_new_fp);
         d_new_fp = NULL;
     }
+    d_new_zr.reset();
     d_updated = true;
 }
 
 void file_source::set_begin_tag(pmt::pmt_t val) { d_add_begin_tag = val; }
 
+void file_source::set_realtime(bool realtime)
+{
+    d_realtime = realtime;
+    d_reader_ready.notify_all();
+}
+
 int file_source::work(int noutput_items,
                            gr_vector_const_void_star& input_items,
                            gr_vector_void_star& output_items)
@@ -416,6 +476,14 @@ int file_source::work(int noutput_items,
         d_reader_wake.notify_one();
         if(d_wp == d_rp)
             d_buffering = true;
+        if(d_buffering && !d_realtime && !d_failed && !d_eof)
+        {
+            // Not bound to the sample clock: wait for the reader instead of
+            // inserting a gap. The reader always wakes us up: it either
+            // fills the buffer, hits EOF or fails.
+            d_reader_ready.wait_for(guard, std::chrono::milliseconds(100));
+            continue;
+        }
         if(d_buffering)
         {
             //d_reader_ready.wait(guard);
@@ -514,7 +582,9 @@ uint64_t file_source::get_items_remaining()
     return d_items_remaining;
 }
 
-bool file_source::save_ts(const uint64_t from_ms, const uint64_t len_ms, const std::string name)
+bool file_source::save_ts(const uint64_t from_ms, const uint64_t len_ms, const std::string name,
+                          file_formats in_fmt, file_formats out_fmt,
+                          any_to_any_base::sptr conv_from, any_to_any_base::sptr conv_to)
 {
     if(from_ms < 1000llu)
         return false;
@@ -533,12 +603,161 @@ bool file_source::save_ts(const uint64_t from_ms, const uint64_t len_ms, const s
     d_save_from_ms = from_ms;
     d_save_len_ms = len_ms;
     d_save_to = name;
+    d_save_in_fmt = in_fmt;
+    d_save_out_fmt = out_fmt;
+    d_save_conv_from = conv_from;
+    d_save_conv_to = conv_to;
     d_save_written_ms = 0;
     d_save_terminate=false;
     d_save_thread = new std::thread(&file_source::save_thread_fn,this);
     return true;
 }
 
+/* Update save progress. Returns false if the save has been cancelled. */
+bool file_source::save_report(uint64_t written)
+{
+    d_save_written_ms = written * 1000llu / d_sample_rate;
+    if(d_save_terminate)
+    {
+        d_save_terminate=false;
+        return false;
+    }
+    if(d_save_progress)
+        d_save_progress(d_save_written_ms);
+    return true;
+}
+
+/*
+ * Copy the range inside the kernel: reflink the block aligned part, if the
+ * filesystem supports it, then copy_file_range the rest. Nothing passes
+ * through user space, and on btrfs/xfs/NFS no data is copied at all.
+ * Returns the number of items copied, or -1 if cancelled. Whatever is left
+ * is copied by the caller with stdio.
+ */
+int64_t file_source::save_copy_range(FILE * ffrom, FILE * fto, uint64_t from_item, uint64_t nitems)
+{
+#ifdef FILE_SOURCE_COPY_RANGE
+    const int fd_in = GR_FILENO(ffrom);
+    const int fd_out = GR_FILENO(fto);
+    const uint64_t src = from_item * d_itemsize;
+    const uint64_t len = nitems * d_itemsize;
+    uint64_t done = 0;
+
+#ifdef FICLONERANGE
+    struct stat st;
+    if(fstat(fd_in, &st) == 0 && st.st_blksize > 0 && src % st.st_blksize == 0)
+    {
+        struct file_clone_range range;
+        range.src_fd = fd_in;
+        range.src_offset = src;
+        range.src_length = len / st.st_blksize * st.st_blksize;
+        range.dest_offset = 0;
+        if(range.src_length > 0 && ioctl(fd_out, FICLONERANGE, &range) == 0)
+            done = range.src_length;
+    }
+#endif
+    while(done < len)
+    {
+        loff_t off_in = src + done;
+        loff_t off_out = done;
+        ssize_t count = copy_file_range(fd_in, &off_in, fd_out, &off_out,
+                                        std::min<uint64_t>(len - done, SAVE_COPY_STEP), 0);
+        if(count < 0 && errno == EINTR)
+            continue;
+        // EXDEV, ENOSYS, EINVAL etc: let stdio finish
+        if(count <= 0)
+            break;
+        done += count;
+        if(!save_report(done / d_itemsize))
+            return -1;
+    }
+    return done / d_itemsize;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Convert the range to another format: source items -> gr_complex ->
+ * output items. Blocks are read and written in order and converted in
+ * parallel.
+ */
+bool file_source::save_convert(FILE * ffrom, FILE * fto, chunked_iq::reader * zr,
+                               uint64_t from_item, uint64_t nitems)
+{
+    const int in_ns = any_to_any_base::fmt[d_save_in_fmt].nsamples;
+    const int out_ns = any_to_any_base::fmt[d_save_out_fmt].nsamples;
+    const int out_size = any_to_any_base::fmt[d_save_out_fmt].size;
+    const uint64_t block_items = SAVE_BLOCK_SAMPLES / in_ns;
+    chunked_iq::pool workers;
+    const unsigned nblocks = workers.size();
+    std::vector<std::vector<uint8_t>> in_buf(nblocks);
+    std::vector<std::vector<gr_complex>> cplx_buf(nblocks);
+    std::vector<std::vector<uint8_t>> out_buf(nblocks);
+    std::vector<uint64_t> nsamples(nblocks);
+    std::unique_ptr<chunked_iq::writer> zw;
+    uint64_t done = 0;
+    bool ok = true;
+    bool eof = false;
+
+    for(unsigned k = 0; k < nblocks; k++)
+    {
+        in_buf[k].resize(block_items * d_itemsize);
+        cplx_buf[k].resize(SAVE_BLOCK_SAMPLES);
+        out_buf[k].resize(SAVE_BLOCK_SAMPLES / out_ns * out_size);
+    }
+    if(d_save_out_fmt == FILE_FORMAT_CS16Z)
+        zw.reset(new chunked_iq::writer(fto));
+    if(!zr)
+        GR_FSEEK(ffrom, from_item * d_itemsize, SEEK_SET);
+    while(ok && !eof && done < nitems)
+    {
+        unsigned n = 0;
+        while(n < nblocks && done < nitems && !eof)
+        {
+            size_t want = std::min<uint64_t>(block_items, nitems - done);
+            size_t got;
+            if(zr)
+                got = zr->read(from_item + done, in_buf[n].data(), want);
+            else
+                got = fread(in_buf[n].data(), d_itemsize, want, ffrom);
+            eof = (got < want);
+            done += got;
+            // nsamples are powers of 2, keep whole output items
+            nsamples[n] = got * in_ns / out_ns * out_ns;
+            if(nsamples[n] > 0)
+                n++;
+        }
+        workers.run(n, [&](size_t k) {
+            const void * cplx = in_buf[k].data();
+            if(d_save_conv_from)
+            {
+                d_save_conv_from->convert(in_buf[k].data(), cplx_buf[k].data(), nsamples[k]);
+                cplx = cplx_buf[k].data();
+            }
+            if(d_save_conv_to)
+                d_save_conv_to->convert(cplx, out_buf[k].data(), nsamples[k] / out_ns);
+            else
+                memcpy(out_buf[k].data(), cplx, nsamples[k] * sizeof(gr_complex));
+        });
+        for(unsigned k = 0; k < n && ok; k++)
+        {
+            size_t bytes = nsamples[k] / out_ns * out_size;
+            if(zw)
+                ok = zw->write(out_buf[k].data(), bytes);
+            else
+                ok = (fwrite(out_buf[k].data(), 1, bytes, fto) == bytes);
+        }
+        if(!ok)
+            std::cerr << "file_source: " << d_save_to << ": write failed\n";
+        else if(!save_report(done))
+            break;
+    }
+    if(zw && !zw->finish())
+        ok = false;
+    return ok;
+}
+
 void file_source::save_thread_fn()
 {
     std::unique_lock<std::mutex> guard(d_save_mutex);
@@ -551,20 +770,73 @@ void file_source::save_thread_fn()
     seek_point /= 1000;
     len *= d_sample_rate;
     len /= 1000;
+    std::unique_ptr<chunked_iq::reader> zr;
+    std::unique_ptr<chunked_iq::writer> zw;
+    if ((itemsize == chunked_iq::ITEM_SIZE) && chunked_iq::probe(d_filename))
+    {
+        try
+        {
+            zr.reset(new chunked_iq::reader(d_filename));
+        }
+        catch (std::runtime_error &e)
+        {
+            std::cerr << e.what() << "\n";
+            if(d_save_progress)
+                d_save_progress(-1);
+            return;
+        }
+    }
     FILE * ffrom = fopen(d_filename.c_str(), "rb");
     FILE * fto = fopen(d_save_to.c_str(),"wb");
+    if(!ffrom || !fto)
+    {
+        std::cerr << "file_source: " << (ffrom ? d_save_to : d_filename) << ": " << strerror(errno) << "\n";
+        if(ffrom)
+            fclose(ffrom);
+        if(fto)
+            fclose(fto);
+        if(d_save_progress)
+            d_save_progress(-1);
+        return;
+    }
+    // the same sample format (or gr_complex to SigMF): copy raw data
+    if((d_save_conv_from || d_save_conv_to) && (d_save_in_fmt != d_save_out_fmt))
+    {
+        save_convert(ffrom, fto, zr.get(), seek_point, len);
+        fclose(ffrom);
+        fclose(fto);
+        if(d_save_progress)
+            d_save_progress(-1);
+        return;
+    }
+    int64_t copied = 0;
+    if(!zr)
+        copied = save_copy_range(ffrom, fto, seek_point, len);
+    size_t written = std::max<int64_t>(copied, 0);
     size_t block_len = 1024*1024;
     std::vector<uint8_t> copybuf;
-    copybuf.resize(itemsize * block_len);
-    GR_FSEEK(ffrom, seek_point * itemsize, SEEK_SET);
-    size_t written = 0;
-    while(written <len)
+    if(copied >= 0 && written < len)
+        copybuf.resize(itemsize * block_len);
+    GR_FSEEK(ffrom, (seek_point + written) * itemsize, SEEK_SET);
+    GR_FSEEK(fto, written * itemsize, SEEK_SET);
+    // compressed source: the fragment is re-encoded
+    if (zr)
+        zw.reset(new chunked_iq::writer(fto));
+    while((copied >= 0) && (written <len))
     {
         size_t bb = std::min(block_len,len-written);
-        size_t rr = fread(copybuf.data(),itemsize,bb,ffrom);
+        size_t rr;
+        if (zr)
+            rr = zr->read(seek_point + written, copybuf.data(), bb);
+        else
+            rr = fread(copybuf.data(),itemsize,bb,ffrom);
         if(rr == 0)
             break;
-        size_t ww = fwrite(copybuf.data(),itemsize,rr,fto);
+        size_t ww;
+        if (zw)
+            ww = zw->write(copybuf.data(), rr * itemsize) ? rr : 0;
+        else
+            ww = fwrite(copybuf.data(),itemsize,rr,fto);
         //fprintf(stderr,"\r %lu %lu             ",written,len);
         d_save_written_ms = written * 1000llu / d_sample_rate;
         if(ww == 0)
@@ -578,6 +850,19 @@ void file_source::save_thread_fn()
         if(d_save_progress)
             d_save_progress(d_save_written_ms);
     }
+    if (zw)
+        zw->finish();
+    zw.reset();
+    zr.reset();
+#ifdef FILE_SOURCE_COPY_RANGE
+    // copy_file_range may stop in the middle of an item
+    if (copied > 0)
+    {
+        fflush(fto);
+        if (ftruncate(GR_FILENO(fto), written * itemsize) != 0)
+            perror("file_source ftruncate");
+    }
+#endif
     fclose(ffrom);
     fclose(fto);
     if(d_save_progress)
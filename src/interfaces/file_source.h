@@ -29,6 +29,9 @@
 #include <atomic>
 #include <queue>
 #include <condition_variable>
+#include <memory>
+#include "chunked_iq.h"
+#include "dsp/format_converter.h"
 
 class BLOCKS_API file_source : public gr::sync_block
 {
@@ -58,6 +61,9 @@ private:
     std::atomic<uint64_t> d_items_remaining;
     FILE* d_fp;
     FILE* d_new_fp;
+    std::shared_ptr<chunked_iq::reader> d_zr;     // compressed file reader
+    std::shared_ptr<chunked_iq::reader> d_new_zr;
+    uint64_t d_read_pos;                          // next item to read from d_zr
     bool d_repeat;
     bool d_updated;
     bool d_file_begin;
@@ -79,6 +85,7 @@ private:
     bool         d_seek;
     int          d_sample_rate;
     bool         d_buffering;
+    std::atomic<bool> d_realtime{true};
     uint64_t     d_seek_point;
     uint64_t     d_buffer_size;
     int          d_seek_ok;
@@ -90,6 +97,10 @@ private:
     uint64_t     d_save_from_ms;
     uint64_t     d_save_len_ms;
     std::string  d_save_to;
+    file_formats d_save_in_fmt{FILE_FORMAT_LAST};
+    file_formats d_save_out_fmt{FILE_FORMAT_LAST};
+    any_to_any_base::sptr d_save_conv_from;
+    any_to_any_base::sptr d_save_conv_to;
     iq_save_progress_t d_save_progress{};
     uint64_t     d_save_written_ms{0};
     std::atomic<bool> d_save_terminate{false};
@@ -98,6 +109,10 @@ private:
 #endif
     void reader();
     void save_thread_fn();
+    bool save_report(uint64_t written);
+    int64_t save_copy_range(FILE * ffrom, FILE * fto, uint64_t from_item, uint64_t nitems);
+    bool save_convert(FILE * ffrom, FILE * fto, chunked_iq::reader * zr,
+                      uint64_t from_item, uint64_t nitems);
 
 public:
     file_source(size_t itemsize,
@@ -124,9 +139,26 @@ public:
             gr_vector_void_star& output_items);
 
     void set_begin_tag(pmt::pmt_t val);
+    /*!
+     * \brief Select what happens, when the reader falls behind.
+     * \param realtime Output zeros to keep up with the sample clock if true,
+     *        wait for the data otherwise, so that no gaps are inserted when
+     *        the file is played back faster than real time.
+     */
+    void set_realtime(bool realtime);
     uint64_t get_timestamp_ms();
     uint64_t get_items_remaining();
-    bool save_ts(const uint64_t from_ms, const uint64_t len_ms, const std::string name);
+    /*!
+     * \brief Save a time range to a new file in a background thread.
+     * \param in_fmt Format of this file.
+     * \param out_fmt Output format. Data is copied as is if it is the same
+     *        as in_fmt, or both converters are null.
+     * \param conv_from Converter from in_fmt to gr_complex.
+     * \param conv_to Converter from gr_complex to out_fmt.
+     */
+    bool save_ts(const uint64_t from_ms, const uint64_t len_ms, const std::string name,
+                 file_formats in_fmt = FILE_FORMAT_LAST, file_formats out_fmt = FILE_FORMAT_LAST,
+                 any_to_any_base::sptr conv_from = nullptr, any_to_any_base::sptr conv_to = nullptr);
     template<typename T> void set_save_progress_cb(T save_progress)
     {
         d_save_progress = save_progress;
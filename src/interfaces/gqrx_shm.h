@@ -0,0 +1,146 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Shared memory export of the audio, the I/Q samples and the spectrum.
+ *
+ * This header describes the layout for local consumers and can be copied
+ * into other programs, it only needs a C99 or C++ compiler with the GCC
+ * atomic builtins (GCC, Clang).
+ *
+ * Every export is a ring in a memfd with one writer (gqrx). A consumer
+ * connects to the Unix socket $XDG_RUNTIME_DIR/gqrx-<name>.sock (/tmp if
+ * XDG_RUNTIME_DIR is not set), where <name> is audio, iq or spectrum, and
+ * receives two file descriptors with SCM_RIGHTS: the memfd, opened
+ * read-only, so it can only be mapped with PROT_READ, and an eventfd, which
+ * is signalled after new data has been written. Keep the connection open, gqrx stops signalling the eventfd
+ * when it is closed.
+ *
+ * The memfd starts with struct gqrx_shm_header, the data follows at
+ * header_size. The writer never waits for the readers: it overwrites the
+ * oldest data and a reader, that falls behind, loses data. Use
+ * gqrx_shm_read() to copy the data out consistently.
+ *
+ *   audio      Interleaved float samples, one item per channel pair.
+ *   iq         Complex float samples (I, Q), at the input rate.
+ *   spectrum   One item per FFT frame: struct gqrx_shm_frame followed by
+ *              bins float values, power in dBFS, lowest frequency first.
+ *
+ * When the format changes (e.g. the FFT size), the writer sets
+ * GQRX_SHM_CLOSED and a new memfd is served on the same socket.
+ */
+#ifndef GQRX_SHM_H
+#define GQRX_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define GQRX_SHM_MAGIC      0x4d485347u  /* "GSHM" */
+#define GQRX_SHM_VERSION    1
+
+#define GQRX_SHM_AUDIO      1
+#define GQRX_SHM_IQ         2
+#define GQRX_SHM_SPECTRUM   3
+
+/* Flags */
+#define GQRX_SHM_CLOSED     1u  /* The writer is gone, reconnect. */
+
+struct gqrx_shm_header
+{
+    uint32_t magic;         /* GQRX_SHM_MAGIC */
+    uint16_t version;       /* GQRX_SHM_VERSION */
+    uint16_t header_size;   /* Offset of the data */
+    uint32_t kind;          /* GQRX_SHM_AUDIO, GQRX_SHM_IQ or GQRX_SHM_SPECTRUM */
+    uint32_t item_size;     /* Bytes per item */
+    uint32_t channels;      /* Audio channels per item, 0 otherwise */
+    uint32_t flags;         /* GQRX_SHM_* flags, atomic */
+    uint64_t capacity;      /* Size of the data, a multiple of item_size */
+    uint64_t max_write;     /* Most bytes the writer publishes at once */
+    double   rate;          /* Items per second, 0 if irregular (spectrum) */
+    uint64_t head;          /* Bytes written since the start, atomic */
+    uint64_t reserved[8];
+};
+
+struct gqrx_shm_frame
+{
+    int64_t  timestamp;     /* ms since the epoch */
+    int64_t  center;        /* Center frequency in Hz */
+    int64_t  span;          /* Span in Hz */
+    uint32_t bins;          /* Number of float values following */
+    uint32_t reserved;
+};
+
+/*
+ * Copy the data after *pos.
+ *   pos      Read position, start with the current head. Advanced past
+ *            the data returned; moved ahead, when data has been lost.
+ *   out      Destination, len bytes; only whole items are copied.
+ *   dropped  Optional, increased by the bytes lost.
+ * Returns the number of bytes copied, 0 if there is no new data.
+ */
+static inline size_t gqrx_shm_read(const struct gqrx_shm_header *hdr, uint64_t *pos,
+                                   void *out, size_t len, uint64_t *dropped)
+{
+    const char *data = (const char *)hdr + hdr->header_size;
+    uint64_t cap = hdr->capacity;
+    uint64_t head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+    uint64_t n, off, first;
+
+    /* Too far behind: skip to half the ring, a margin to the writer */
+    if (head - *pos > cap - hdr->max_write)
+    {
+        uint64_t resync = head - (cap / 2) / hdr->item_size * hdr->item_size;
+        if (dropped)
+            *dropped += resync - *pos;
+        *pos = resync;
+    }
+
+    n = head - *pos;
+    if (n > len / hdr->item_size * hdr->item_size)
+        n = len / hdr->item_size * hdr->item_size;
+    if (n == 0)
+        return 0;
+
+    off = *pos % cap;
+    first = (n < cap - off) ? n : cap - off;
+    memcpy(out, data + off, first);
+    memcpy((char *)out + first, data, n - first);
+
+    /* Discard the data, if the writer may have overwritten it meanwhile */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    head = __atomic_load_n(&hdr->head, __ATOMIC_RELAXED);
+    if (head + hdr->max_write - *pos > cap)
+    {
+        uint64_t resync = head - (cap / 2) / hdr->item_size * hdr->item_size;
+        if (dropped)
+            *dropped += resync - *pos;
+        *pos = resync;
+        return 0;
+    }
+
+    *pos += n;
+    return n;
+}
+
+#endif /* GQRX_SHM_H */
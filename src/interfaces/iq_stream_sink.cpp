@@ -0,0 +1,203 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cstring>
+#include <gnuradio/io_signature.h>
+#include "interfaces/iq_stream_sink.h"
+
+
+iq_ring::iq_ring(size_t capacity, size_t item_size)
+    : d_item_size(item_size),
+      d_head(0)
+{
+    size_t size = 64 * 1024;
+
+    while (size < capacity && size < IQ_RING_MAX_BYTES)
+        size *= 2;
+    d_buf.resize(size);
+    d_mask = size - 1;
+}
+
+void iq_ring::write(const char *data, size_t len)
+{
+    uint64_t head = d_head.load(std::memory_order_relaxed);
+
+    // Publish in chunks, so that a reader can tell, whether the writer
+    // may have touched the data it copied
+    while (len > 0)
+    {
+        size_t n = std::min(len, max_write());
+        size_t off = head & d_mask;
+        size_t first = std::min(n, d_buf.size() - off);
+
+        std::memcpy(&d_buf[off], data, first);
+        std::memcpy(&d_buf[0], data + first, n - first);
+        head += n;
+        d_head.store(head, std::memory_order_release);
+        data += n;
+        len -= n;
+    }
+}
+
+size_t iq_ring::read(uint64_t &pos, char *out, size_t len, uint64_t &dropped) const
+{
+    size_t cap = d_buf.size();
+    uint64_t head = d_head.load(std::memory_order_acquire);
+
+    // Too far behind: drop the oldest data and leave a margin to the writer
+    if (head - pos > cap - max_write())
+    {
+        dropped += head - cap / 2 - pos;
+        pos = head - cap / 2;
+    }
+
+    size_t n = std::min<uint64_t>(head - pos, len / d_item_size * d_item_size);
+    size_t off = pos & d_mask;
+    size_t first = std::min(n, cap - off);
+
+    if (n == 0)
+        return 0;
+
+    std::memcpy(out, &d_buf[off], first);
+    std::memcpy(out + first, &d_buf[0], n - first);
+
+    // The writer may have overwritten the data while it was copied, it
+    // writes at most max_write() bytes past the published head
+    std::atomic_thread_fence(std::memory_order_acquire);
+    head = d_head.load(std::memory_order_relaxed);
+    if (head + max_write() - pos > cap)
+    {
+        dropped += head - cap / 2 - pos;
+        pos = head - cap / 2;
+        return 0;
+    }
+
+    pos += n;
+    return n;
+}
+
+
+iq_ring_sink_sptr make_iq_ring_sink(iq_ring_sptr ring)
+{
+    return gnuradio::get_initial_sptr(new iq_ring_sink(ring));
+}
+
+iq_ring_sink::iq_ring_sink(iq_ring_sptr ring)
+    : gr::sync_block("iq_ring_sink",
+                     gr::io_signature::make(1, 1, ring->item_size()),
+                     gr::io_signature::make(0, 0, 0)),
+      d_ring(ring)
+{
+}
+
+int iq_ring_sink::work(int noutput_items,
+                       gr_vector_const_void_star &input_items,
+                       gr_vector_void_star &output_items)
+{
+    (void) output_items;
+
+    d_ring->write((const char *) input_items[0], noutput_items * d_ring->item_size());
+
+    return noutput_items;
+}
+
+
+iq_stream_sink_sptr make_iq_stream_sink(iq_stream_sink::stage where, file_formats fmt,
+                                        double rate)
+{
+    return gnuradio::get_initial_sptr(new iq_stream_sink(where, fmt, rate));
+}
+
+/*! \brief Whether a format can be streamed, only complex formats with
+ *         one sample per item are. */
+bool iq_stream_sink::supported_format(file_formats fmt)
+{
+    switch (fmt)
+    {
+    case FILE_FORMAT_CF:
+    case FILE_FORMAT_CS8:
+    case FILE_FORMAT_CS16L:
+    case FILE_FORMAT_CS32L:
+    case FILE_FORMAT_CS8U:
+    case FILE_FORMAT_CS16LU:
+    case FILE_FORMAT_CS32LU:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*!
+ * \brief Create a stream sink.
+ * \param where The stage the sink is connected to, see receiver_base_cf::add_iq_tap().
+ * \param fmt Sample format, see supported_format().
+ * \param rate Sample rate, sizes the ring to hold IQ_RING_SECONDS.
+ */
+iq_stream_sink::iq_stream_sink(stage where, file_formats fmt, double rate)
+    : gr::hier_block2("iq_stream_sink",
+                      gr::io_signature::make(1, 1, sizeof(gr_complex)),
+                      gr::io_signature::make(0, 0, 0)),
+      d_stage(where),
+      d_format(fmt),
+      d_rate(rate),
+      d_users(0)
+{
+    size_t item_size = any_to_any_base::fmt[fmt].size;
+
+    d_ring = std::make_shared<iq_ring>(size_t(rate * IQ_RING_SECONDS) * item_size, item_size);
+    d_sink = make_iq_ring_sink(d_ring);
+
+    switch (fmt)
+    {
+    case FILE_FORMAT_CS8:
+        d_conv = any_to_any<gr_complex, std::complex<int8_t>>::make();
+        break;
+    case FILE_FORMAT_CS16L:
+        d_conv = any_to_any<gr_complex, std::complex<int16_t>>::make();
+        break;
+    case FILE_FORMAT_CS32L:
+        d_conv = any_to_any<gr_complex, std::complex<int32_t>>::make();
+        break;
+    case FILE_FORMAT_CS8U:
+        d_conv = any_to_any<gr_complex, std::complex<uint8_t>>::make();
+        break;
+    case FILE_FORMAT_CS16LU:
+        d_conv = any_to_any<gr_complex, std::complex<uint16_t>>::make();
+        break;
+    case FILE_FORMAT_CS32LU:
+        d_conv = any_to_any<gr_complex, std::complex<uint32_t>>::make();
+        break;
+    default:
+        break;
+    }
+
+    if (d_conv)
+    {
+        connect(self(), 0, d_conv, 0);
+        connect(d_conv, 0, d_sink, 0);
+    }
+    else
+    {
+        connect(self(), 0, d_sink, 0);
+    }
+}
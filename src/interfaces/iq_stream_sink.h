@@ -0,0 +1,164 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef IQ_STREAM_SINK_H
+#define IQ_STREAM_SINK_H
+
+#include <gnuradio/hier_block2.h>
+#include <gnuradio/sync_block.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "dsp/format_converter.h"
+
+/* Longest time an I/Q ring holds and largest ring in bytes. */
+#define IQ_RING_SECONDS     0.5
+#define IQ_RING_MAX_BYTES   (16 * 1024 * 1024)
+
+/*!
+ * \brief Byte ring with one writer and any number of readers.
+ *
+ * The writer never waits: it overwrites the oldest data and every reader
+ * keeps its own position, so a slow reader only loses data itself. The
+ * capacity is a power of two and a multiple of the item size, positions
+ * count bytes since the start and are always item aligned.
+ */
+class iq_ring
+{
+public:
+    iq_ring(size_t capacity, size_t item_size);
+
+    /*! \brief Append data, called by the GNU Radio thread only. */
+    void write(const char *data, size_t len);
+
+    /*!
+     * \brief Copy the data after a position, may be called from any thread.
+     * \param pos Position of the reader, advanced past the data returned.
+     *            Set it to head() to start with new data.
+     * \param out Destination.
+     * \param len Size of out, only whole items are copied.
+     * \param dropped Increased by the bytes overwritten before they were read.
+     * \returns The number of bytes copied.
+     */
+    size_t read(uint64_t &pos, char *out, size_t len, uint64_t &dropped) const;
+
+    uint64_t head() const { return d_head.load(std::memory_order_acquire); }
+    size_t   capacity() const { return d_buf.size(); }
+    size_t   item_size() const { return d_item_size; }
+
+    /*!
+     * \brief End the stream, its sample rate has changed.
+     *
+     * Readers disconnect, their clients reconnect to get the new rate.
+     */
+    void close() { d_closed.store(true, std::memory_order_release); }
+    bool closed() const { return d_closed.load(std::memory_order_acquire); }
+
+private:
+    size_t  max_write() const { return d_buf.size() / 4; }
+
+    std::vector<char>       d_buf;
+    size_t                  d_mask;
+    size_t                  d_item_size;
+    std::atomic<uint64_t>   d_head;
+    std::atomic<bool>       d_closed{false};
+};
+
+typedef std::shared_ptr<iq_ring> iq_ring_sptr;
+
+
+class iq_ring_sink;
+class iq_stream_sink;
+
+#if GNURADIO_VERSION < 0x030900
+typedef boost::shared_ptr<iq_ring_sink> iq_ring_sink_sptr;
+typedef boost::shared_ptr<iq_stream_sink> iq_stream_sink_sptr;
+#else
+typedef std::shared_ptr<iq_ring_sink> iq_ring_sink_sptr;
+typedef std::shared_ptr<iq_stream_sink> iq_stream_sink_sptr;
+#endif
+
+/*! \brief Sink writing its input to an I/Q ring. */
+class iq_ring_sink : public gr::sync_block
+{
+    friend iq_ring_sink_sptr make_iq_ring_sink(iq_ring_sptr ring);
+
+protected:
+    iq_ring_sink(iq_ring_sptr ring);
+
+public:
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items);
+
+private:
+    iq_ring_sptr d_ring;
+};
+
+iq_ring_sink_sptr make_iq_ring_sink(iq_ring_sptr ring);
+
+
+/*!
+ * \brief Complex samples of a VFO, converted and written to an I/Q ring.
+ *  \ingroup IO
+ *
+ * One sink serves all clients of the same VFO stage and sample format,
+ * they all read the same ring, so the samples are converted and stored
+ * once no matter how many clients there are.
+ */
+class iq_stream_sink : public gr::hier_block2
+{
+public:
+    /*! \brief Where the samples are taken from. */
+    enum stage {
+        STAGE_INPUT    = 0,  /*!< VFO input: channelizer output or the full input rate. */
+        STAGE_BASEBAND = 1   /*!< After the down-converter and the baseband resampler. */
+    };
+
+    iq_stream_sink(stage where, file_formats fmt, double rate);
+
+    stage           get_stage() const { return d_stage; }
+    file_formats    get_format() const { return d_format; }
+    double          get_rate() const { return d_rate; }
+    iq_ring_sptr    get_ring() const { return d_ring; }
+
+    /* Number of clients, maintained by the receiver */
+    int  ref() { return ++d_users; }
+    int  unref() { return --d_users; }
+
+    static bool supported_format(file_formats fmt);
+
+private:
+    stage                   d_stage;
+    file_formats            d_format;
+    double                  d_rate;
+    int                     d_users;
+    iq_ring_sptr            d_ring;
+    any_to_any_base::sptr   d_conv;  /*!< Null for gr_complex. */
+    iq_ring_sink_sptr       d_sink;
+};
+
+iq_stream_sink_sptr make_iq_stream_sink(iq_stream_sink::stage where, file_formats fmt,
+                                        double rate);
+
+#endif // IQ_STREAM_SINK_H
@@ -0,0 +1,402 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <gnuradio/io_signature.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include "interfaces/shm_sink.h"
+
+/* Offset of the data in the memfd, keeps it page aligned. */
+#define SHM_HEADER_SIZE 4096
+
+shm_ring::shm_ring()
+    : d_item_size(0),
+      d_capacity(0),
+      d_max_write(0),
+      d_head(0),
+      d_hdr(nullptr),
+      d_data(nullptr),
+      d_map_size(0),
+      d_memfd(-1),
+      d_memfd_ro(-1),
+      d_listen(-1),
+      d_wake(-1)
+{
+}
+
+std::string shm_ring::socket_path(const std::string &name)
+{
+    const char *dir = std::getenv("XDG_RUNTIME_DIR");
+
+    return std::string(dir && *dir ? dir : "/tmp") + "/gqrx-" + name + ".sock";
+}
+
+#ifdef __linux__
+
+shm_ring_sptr shm_ring::make(const std::string &name, uint32_t kind, size_t item_size,
+                             uint32_t channels, double rate, size_t capacity)
+{
+    shm_ring_sptr ring(new shm_ring());
+    sockaddr_un addr;
+
+    // At least 8 items, so that max_write holds two
+    capacity = std::max(capacity, 8 * item_size);
+    capacity = std::min(capacity, size_t(SHM_RING_MAX_BYTES));
+    capacity = (capacity + item_size - 1) / item_size * item_size;
+
+    ring->d_item_size = item_size;
+    ring->d_map_size = SHM_HEADER_SIZE + capacity;
+    ring->d_path = socket_path(name);
+    if (ring->d_path.size() >= sizeof(addr.sun_path))
+        return nullptr;
+
+    ring->d_memfd = memfd_create(("gqrx-" + name).c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (ring->d_memfd < 0 || ftruncate(ring->d_memfd, ring->d_map_size) < 0)
+    {
+        std::cerr << "shm_ring: memfd: " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+    // Consumers must not be able to resize it under our feet
+    fcntl(ring->d_memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW);
+    // and get a descriptor, that can not be mapped writable
+    ring->d_memfd_ro = open(("/proc/self/fd/" + std::to_string(ring->d_memfd)).c_str(),
+                            O_RDONLY | O_CLOEXEC);
+    if (ring->d_memfd_ro < 0)
+    {
+        std::cerr << "shm_ring: read-only memfd: " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    void *map = mmap(nullptr, ring->d_map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     ring->d_memfd, 0);
+    if (map == MAP_FAILED)
+    {
+        std::cerr << "shm_ring: mmap: " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+    ring->d_hdr = (gqrx_shm_header *) map;
+    ring->d_data = (char *) map + SHM_HEADER_SIZE;
+
+    gqrx_shm_header *hdr = ring->d_hdr;
+    hdr->magic = GQRX_SHM_MAGIC;
+    hdr->version = GQRX_SHM_VERSION;
+    hdr->header_size = SHM_HEADER_SIZE;
+    hdr->kind = kind;
+    hdr->item_size = item_size;
+    hdr->channels = channels;
+    hdr->flags = 0;
+    ring->d_capacity = capacity;
+    ring->d_max_write = std::max(capacity / 4 / item_size, size_t(1)) * item_size;
+    hdr->capacity = ring->d_capacity;
+    hdr->max_write = ring->d_max_write;
+    hdr->rate = rate;
+    hdr->head = 0;
+
+    // Replaces the socket of a previous run
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, ring->d_path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(ring->d_path.c_str());
+    ring->d_listen = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (ring->d_listen < 0 || bind(ring->d_listen, (sockaddr *) &addr, sizeof(addr)) < 0 ||
+        listen(ring->d_listen, 4) < 0)
+    {
+        std::cerr << "shm_ring: " << ring->d_path << ": " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    ring->d_wake = eventfd(0, EFD_CLOEXEC);
+    if (ring->d_wake < 0)
+        return nullptr;
+
+    ring->d_thread = std::thread(&shm_ring::serve, ring.get());
+    std::cout << "Shared memory export " << name << " on " << ring->d_path << std::endl;
+
+    return ring;
+}
+
+shm_ring::~shm_ring()
+{
+    if (d_thread.joinable())
+    {
+        uint64_t one = 1;
+
+        // Let the consumers see the flag before their eventfds go away
+        __atomic_or_fetch(&d_hdr->flags, GQRX_SHM_CLOSED, __ATOMIC_RELEASE);
+        notify();
+        if (::write(d_wake, &one, sizeof(one)) < 0)
+            std::cerr << "shm_ring: " << std::strerror(errno) << std::endl;
+        d_thread.join();
+    }
+    if (d_hdr)
+        munmap(d_hdr, d_map_size);
+    if (d_listen >= 0)
+    {
+        close(d_listen);
+        unlink(d_path.c_str());
+    }
+    if (d_wake >= 0)
+        close(d_wake);
+    if (d_memfd_ro >= 0)
+        close(d_memfd_ro);
+    if (d_memfd >= 0)
+        close(d_memfd);
+}
+
+void shm_ring::write(const void *data, size_t len)
+{
+    const char *src = (const char *) data;
+
+    // The header is only written, the ring geometry comes from our members
+    while (len > 0)
+    {
+        size_t n = std::min<uint64_t>(len, d_max_write);
+        size_t off = d_head % d_capacity;
+        size_t first = std::min<uint64_t>(n, d_capacity - off);
+
+        std::memcpy(d_data + off, src, first);
+        std::memcpy(d_data, src + first, n - first);
+        d_head += n;
+        __atomic_store_n(&d_hdr->head, d_head, __ATOMIC_RELEASE);
+        src += n;
+        len -= n;
+    }
+
+    notify();
+}
+
+void shm_ring::set_rate(double rate)
+{
+    d_hdr->rate = rate;
+}
+
+/* One wake-up per write() and consumer, a full counter is not an error. */
+void shm_ring::notify()
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+    uint64_t one = 1;
+
+    for (int fd : d_events)
+        if (::write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            std::cerr << "shm_ring: " << std::strerror(errno) << std::endl;
+}
+
+/*
+ * Hand out the memfd and a new eventfd to every consumer connecting to the
+ * socket, and forget the eventfd, when the consumer closes the connection.
+ */
+void shm_ring::serve()
+{
+    std::vector<std::pair<int, int>> consumers;  // socket, eventfd
+
+    for (;;)
+    {
+        std::vector<pollfd> fds;
+
+        fds.push_back({d_wake, POLLIN, 0});
+        fds.push_back({d_listen, POLLIN, 0});
+        for (auto &c : consumers)
+            fds.push_back({c.first, POLLIN, 0});
+
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[0].revents)
+            break;
+
+        // Closed connections first, the indexes match fds
+        for (size_t k = consumers.size(); k-- > 0; )
+        {
+            char b;
+
+            if (!fds[k + 2].revents)
+                continue;
+            ssize_t r = recv(consumers[k].first, &b, sizeof(b), MSG_DONTWAIT);
+            if (r > 0 || (r < 0 && errno == EAGAIN))
+                continue;
+
+            {
+                std::lock_guard<std::mutex> lock(d_mutex);
+                d_events.erase(std::find(d_events.begin(), d_events.end(), consumers[k].second));
+            }
+            close(consumers[k].first);
+            close(consumers[k].second);
+            consumers.erase(consumers.begin() + k);
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            int sock = accept4(d_listen, nullptr, nullptr, SOCK_CLOEXEC);
+            int ev = (sock >= 0) ? eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) : -1;
+
+            if (ev >= 0)
+            {
+                int handles[2] = {d_memfd_ro, ev};
+                char cbuf[CMSG_SPACE(sizeof(handles))];
+                char tag = 'G';
+                iovec iov = {&tag, 1};
+                msghdr msg;
+
+                std::memset(&msg, 0, sizeof(msg));
+                std::memset(cbuf, 0, sizeof(cbuf));
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = cbuf;
+                msg.msg_controllen = sizeof(cbuf);
+                cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(handles));
+                std::memcpy(CMSG_DATA(cmsg), handles, sizeof(handles));
+
+                if (sendmsg(sock, &msg, MSG_NOSIGNAL) == 1)
+                {
+                    std::lock_guard<std::mutex> lock(d_mutex);
+                    d_events.push_back(ev);
+                    consumers.emplace_back(sock, ev);
+                    continue;
+                }
+                close(ev);
+            }
+            if (sock >= 0)
+                close(sock);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(d_mutex);
+    for (auto &c : consumers)
+    {
+        close(c.first);
+        close(c.second);
+    }
+    d_events.clear();
+}
+
+#else
+
+shm_ring_sptr shm_ring::make(const std::string &name, uint32_t kind, size_t item_size,
+                             uint32_t channels, double rate, size_t capacity)
+{
+    (void) kind; (void) item_size; (void) channels; (void) rate; (void) capacity;
+    std::cerr << "Shared memory export " << name << " is only supported on Linux" << std::endl;
+    return nullptr;
+}
+
+shm_ring::~shm_ring()
+{
+}
+
+void shm_ring::write(const void *data, size_t len)
+{
+    (void) data; (void) len;
+}
+
+void shm_ring::set_rate(double rate)
+{
+    (void) rate;
+}
+
+#endif
+
+
+void shm_spectrum_export::write(const float *bins, unsigned int fftsize, int64_t center,
+                                int64_t span, int64_t timestamp)
+{
+    size_t item_size = sizeof(gqrx_shm_frame) + fftsize * sizeof(float);
+
+    if (!d_ring || d_ring->item_size() != item_size)
+    {
+        // Only one ring per socket
+        d_ring.reset();
+        d_ring = shm_ring::make("spectrum", GQRX_SHM_SPECTRUM, item_size, 0, 0,
+                                SHM_SPECTRUM_FRAMES * item_size);
+        if (!d_ring)
+            return;
+    }
+
+    gqrx_shm_frame frame = {};
+
+    frame.timestamp = timestamp;
+    frame.center = center;
+    frame.span = span;
+    frame.bins = fftsize;
+    d_frame.resize(item_size);
+    std::memcpy(d_frame.data(), &frame, sizeof(frame));
+    std::memcpy(d_frame.data() + sizeof(frame), bins, fftsize * sizeof(float));
+    d_ring->write(d_frame.data(), item_size);
+}
+
+shm_sink_sptr make_shm_sink(size_t itemsize, int ninputs, shm_ring_sptr ring)
+{
+    return gnuradio::get_initial_sptr(new shm_sink(itemsize, ninputs, ring));
+}
+
+shm_sink::shm_sink(size_t itemsize, int ninputs, shm_ring_sptr ring)
+    : gr::sync_block("shm_sink",
+                     gr::io_signature::make(ninputs, ninputs, itemsize),
+                     gr::io_signature::make(0, 0, 0)),
+      d_itemsize(itemsize),
+      d_ring(ring)
+{
+}
+
+int shm_sink::work(int noutput_items,
+                   gr_vector_const_void_star &input_items,
+                   gr_vector_void_star &output_items)
+{
+    (void) output_items;
+
+    size_t ninputs = input_items.size();
+
+    if (ninputs == 1)
+    {
+        d_ring->write(input_items[0], noutput_items * d_itemsize);
+        return noutput_items;
+    }
+
+    d_buf.resize(noutput_items * ninputs * d_itemsize);
+    char *out = d_buf.data();
+    for (int i = 0; i < noutput_items; i++)
+        for (size_t k = 0; k < ninputs; k++)
+        {
+            std::memcpy(out, (const char *) input_items[k] + i * d_itemsize, d_itemsize);
+            out += d_itemsize;
+        }
+    d_ring->write(d_buf.data(), d_buf.size());
+
+    return noutput_items;
+}
@@ -0,0 +1,162 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef SHM_SINK_H
+#define SHM_SINK_H
+
+#include <gnuradio/sync_block.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "interfaces/gqrx_shm.h"
+
+/* Longest time a shared memory ring holds and largest ring in bytes. */
+#define SHM_RING_SECONDS    0.5
+#define SHM_RING_MAX_BYTES  (64 * 1024 * 1024)
+/* Spectrum frames held by the shared memory export. */
+#define SHM_SPECTRUM_FRAMES 16
+
+/*!
+ * \brief Writer of a shared memory export, see gqrx_shm.h.
+ *
+ * Owns the memfd with the ring and a thread handing it out on the Unix
+ * socket of the export, together with an eventfd per consumer. Only
+ * available on Linux, make() returns null elsewhere.
+ *
+ * Only one ring of a name may exist at a time, destroy the old one first.
+ */
+class shm_ring
+{
+public:
+    /*!
+     * \brief Create an export.
+     * \param name Name of the export, selects the socket.
+     * \param kind GQRX_SHM_AUDIO, GQRX_SHM_IQ or GQRX_SHM_SPECTRUM.
+     * \param item_size Bytes per item.
+     * \param channels Audio channels per item, 0 otherwise.
+     * \param rate Items per second, 0 if irregular.
+     * \param capacity Requested size of the ring in bytes.
+     * \returns The ring or null on error.
+     */
+    static std::shared_ptr<shm_ring> make(const std::string &name, uint32_t kind,
+                                          size_t item_size, uint32_t channels,
+                                          double rate, size_t capacity);
+    ~shm_ring();
+
+    /*! \brief Append whole items and wake up the consumers. */
+    void write(const void *data, size_t len);
+    void set_rate(double rate);
+    size_t item_size() const { return d_item_size; }
+
+    static std::string socket_path(const std::string &name);
+
+private:
+    shm_ring();
+
+    void serve();
+    void notify();
+
+    size_t               d_item_size;
+    uint64_t             d_capacity;   /*!< Private copies, consumers may */
+    uint64_t             d_max_write;  /*!< write to the header. */
+    uint64_t             d_head;
+    gqrx_shm_header     *d_hdr;
+    char                *d_data;
+    size_t               d_map_size;
+    int                  d_memfd;
+    int                  d_memfd_ro;   /*!< Read-only descriptor for consumers. */
+    int                  d_listen;
+    int                  d_wake;       /*!< eventfd stopping serve(). */
+    std::string          d_path;
+    std::thread          d_thread;
+    std::mutex           d_mutex;      /*!< Protects d_events. */
+    std::vector<int>     d_events;     /*!< eventfd of every consumer. */
+};
+
+typedef std::shared_ptr<shm_ring> shm_ring_sptr;
+
+/*!
+ * \brief Shared memory export of the spectrum frames.
+ *
+ * Written by the GUI or gqrx-headless, whichever computes the spectrum.
+ * The ring is created again, when the FFT size changes.
+ */
+class shm_spectrum_export
+{
+public:
+    /*!
+     * \brief Append a frame.
+     * \param bins Power in dBFS, lowest frequency first.
+     * \param timestamp Time of the frame in ms since the epoch.
+     */
+    void write(const float *bins, unsigned int fftsize, int64_t center, int64_t span,
+               int64_t timestamp);
+    void reset() { d_ring.reset(); }
+
+private:
+    shm_ring_sptr       d_ring;
+    std::vector<char>   d_frame;
+};
+
+
+class shm_sink;
+
+#if GNURADIO_VERSION < 0x030900
+typedef boost::shared_ptr<shm_sink> shm_sink_sptr;
+#else
+typedef std::shared_ptr<shm_sink> shm_sink_sptr;
+#endif
+
+/*!
+ * \brief Return a shared_ptr to a new instance of shm_sink.
+ * \param itemsize Size of the items of every input.
+ * \param ninputs Number of inputs, interleaved into one ring item.
+ * \param ring The export.
+ */
+shm_sink_sptr make_shm_sink(size_t itemsize, int ninputs, shm_ring_sptr ring);
+
+/*! \brief Sink writing its inputs, interleaved, to a shared memory export.
+ *  \ingroup IO
+ */
+class shm_sink : public gr::sync_block
+{
+    friend shm_sink_sptr make_shm_sink(size_t itemsize, int ninputs, shm_ring_sptr ring);
+
+protected:
+    shm_sink(size_t itemsize, int ninputs, shm_ring_sptr ring);
+
+public:
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items);
+
+    void set_rate(double rate) { d_ring->set_rate(rate); }
+
+private:
+    size_t              d_itemsize;
+    shm_ring_sptr       d_ring;
+    std::vector<char>   d_buf;   /*!< Interleaved items. */
+};
+
+#endif // SHM_SINK_H
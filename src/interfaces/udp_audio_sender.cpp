@@ -0,0 +1,229 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+#include "udp_audio_sender.h"
+
+std::mutex udp_audio_sender::s_mutex;
+std::weak_ptr<udp_audio_sender> udp_audio_sender::s_instance;
+udp_audio_sender::options udp_audio_sender::s_options = {UDP_AUDIO_DEFAULT_PAYLOAD, false, 1};
+
+/*! \brief Get the sender, create it if no stream uses it yet. */
+udp_audio_sender_sptr udp_audio_sender::get()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    udp_audio_sender_sptr sender = s_instance.lock();
+
+    if (!sender)
+    {
+        sender.reset(new udp_audio_sender());
+        s_instance = sender;
+    }
+    return sender;
+}
+
+/*! \brief Set the options of the streams started afterwards.
+ *
+ * The multicast TTL takes effect, when no stream is running.
+ */
+void udp_audio_sender::set_options(const options &opts)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    s_options = opts;
+    s_options.payload = std::min(std::max(opts.payload, UDP_AUDIO_MIN_PAYLOAD),
+                                 UDP_AUDIO_MAX_PAYLOAD);
+    s_options.multicast_ttl = std::min(std::max(opts.multicast_ttl, 0), 255);
+}
+
+udp_audio_sender::options udp_audio_sender::get_options()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    return s_options;
+}
+
+udp_audio_sender::udp_audio_sender()
+    : d_sock4(d_io),
+      d_sock6(d_io),
+      d_stop(false),
+      d_dropped(0)
+{
+    d_queue.reserve(UDP_AUDIO_MAX_QUEUE);
+    d_thread = std::thread(&udp_audio_sender::run, this);
+}
+
+udp_audio_sender::~udp_audio_sender()
+{
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+        d_stop = true;
+    }
+    d_cond.notify_one();
+    d_thread.join();
+
+    if (d_dropped > 0)
+        std::cout << "UDP audio: " << d_dropped << " datagrams dropped" << std::endl;
+}
+
+udp_audio_sender::endpoint udp_audio_sender::resolve(const std::string &host, int port)
+{
+    boost::asio::ip::udp::resolver resolver(d_io);
+    boost::system::error_code ec;
+
+#if BOOST_VERSION < 106600
+    boost::asio::ip::udp::resolver::query query(host, std::to_string(port));
+    auto it = resolver.resolve(query, ec);
+    if (!ec && it != boost::asio::ip::udp::resolver::iterator())
+        return *it;
+#else
+    auto results = resolver.resolve(host, std::to_string(port), ec);
+    if (!ec && !results.empty())
+        return *results.begin();
+#endif
+
+    throw std::runtime_error("UDP audio: can not resolve " + host);
+}
+
+void udp_audio_sender::send(const endpoint &dest, const char *data, size_t len)
+{
+    {
+        std::lock_guard<std::mutex> lock(d_mutex);
+
+        // The network must not stall the DSP
+        if (d_queue.size() >= UDP_AUDIO_MAX_QUEUE)
+        {
+            d_dropped++;
+            return;
+        }
+
+        d_queue.emplace_back();
+        datagram &dgram = d_queue.back();
+        dgram.dest = dest;
+        if (!d_free.empty())
+        {
+            dgram.data.swap(d_free.back());
+            d_free.pop_back();
+        }
+        dgram.data.assign(data, data + len);
+    }
+    d_cond.notify_one();
+}
+
+/*! \brief Send everything queued meanwhile, whenever there is something. */
+void udp_audio_sender::run()
+{
+    std::vector<datagram> batch;
+
+    batch.reserve(UDP_AUDIO_MAX_QUEUE);
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(d_mutex);
+
+            // Return the buffers of the last batch
+            for (auto &dgram : batch)
+                d_free.push_back(std::move(dgram.data));
+            batch.clear();
+
+            d_cond.wait(lock, [this] { return d_stop || !d_queue.empty(); });
+            if (d_stop)
+                break;
+            batch.swap(d_queue);
+        }
+
+        // Runs of the same address family share a socket
+        size_t first = 0;
+        for (size_t k = 1; k <= batch.size(); k++)
+            if (k == batch.size() ||
+                batch[k].dest.protocol() != batch[first].dest.protocol() ||
+                k - first == UDP_AUDIO_BATCH)
+            {
+                send_batch(batch, first, k - first);
+                first = k;
+            }
+    }
+}
+
+boost::asio::ip::udp::socket &udp_audio_sender::socket_for(const endpoint &dest)
+{
+    auto &sock = dest.address().is_v4() ? d_sock4 : d_sock6;
+
+    if (!sock.is_open())
+    {
+        boost::system::error_code ec;
+
+        sock.open(dest.protocol(), ec);
+        if (ec)
+            return sock;
+        sock.set_option(boost::asio::ip::multicast::hops(get_options().multicast_ttl), ec);
+        sock.set_option(boost::asio::ip::multicast::enable_loopback(true), ec);
+    }
+    return sock;
+}
+
+void udp_audio_sender::send_batch(std::vector<datagram> &batch, size_t first, size_t count)
+{
+    auto &sock = socket_for(batch[first].dest);
+
+    if (!sock.is_open())
+        return;
+
+#ifdef __linux__
+    mmsghdr msgs[UDP_AUDIO_BATCH];
+    iovec iovs[UDP_AUDIO_BATCH];
+
+    for (size_t k = 0; k < count; k++)
+    {
+        datagram &dgram = batch[first + k];
+
+        iovs[k].iov_base = dgram.data.data();
+        iovs[k].iov_len = dgram.data.size();
+        msgs[k].msg_hdr = msghdr();
+        msgs[k].msg_hdr.msg_name = dgram.dest.data();
+        msgs[k].msg_hdr.msg_namelen = dgram.dest.size();
+        msgs[k].msg_hdr.msg_iov = &iovs[k];
+        msgs[k].msg_hdr.msg_iovlen = 1;
+    }
+
+    // A datagram, that fails (e.g. no route), is skipped
+    for (size_t sent = 0; sent < count; )
+    {
+        int n = sendmmsg(sock.native_handle(), msgs + sent, count - sent, 0);
+
+        sent += (n > 0) ? n : 1;
+    }
+#else
+    for (size_t k = 0; k < count; k++)
+    {
+        boost::system::error_code ec;
+        datagram &dgram = batch[first + k];
+
+        sock.send_to(boost::asio::buffer(dgram.data), dgram.dest, 0, ec);
+    }
+#endif
+}
@@ -0,0 +1,111 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2013 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef UDP_AUDIO_SENDER_H
+#define UDP_AUDIO_SENDER_H
+
+#include <boost/asio.hpp>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Payload limits of the audio datagrams in bytes, without the RTP header. */
+#define UDP_AUDIO_MIN_PAYLOAD       64
+#define UDP_AUDIO_MAX_PAYLOAD       32768
+#define UDP_AUDIO_DEFAULT_PAYLOAD   1024
+/* Most datagrams waiting to be sent, newer ones are dropped. */
+#define UDP_AUDIO_MAX_QUEUE         4096
+/* Datagrams passed to the kernel at once. */
+#define UDP_AUDIO_BATCH             64
+
+/*! \brief Sender of the UDP audio streams of all VFOs.
+ *
+ * One socket per address family and one thread, that sends the datagrams
+ * queued by the udp_sink_f blocks in batches (sendmmsg() on Linux), so
+ * the DSP threads never wait for the network. Exists while at least one
+ * stream uses it.
+ */
+class udp_audio_sender
+{
+public:
+    typedef boost::asio::ip::udp::endpoint endpoint;
+
+    /*! \brief Options of the streams started afterwards. */
+    struct options
+    {
+        int  payload;        /*!< Audio bytes per datagram. */
+        bool rtp;            /*!< Prepend an RTP header, see udp_sink_f. */
+        int  multicast_ttl;  /*!< Hop limit of multicast datagrams. */
+    };
+
+    static std::shared_ptr<udp_audio_sender> get();
+    static void set_options(const options &opts);
+    static options get_options();
+
+    ~udp_audio_sender();
+
+    /*! \brief Resolve a host name, throws std::runtime_error on failure. */
+    endpoint resolve(const std::string &host, int port);
+
+    /*! \brief Queue one datagram, never blocks. */
+    void send(const endpoint &dest, const char *data, size_t len);
+
+private:
+    udp_audio_sender();
+
+    struct datagram
+    {
+        endpoint          dest;
+        std::vector<char> data;
+    };
+
+    void run();
+    void send_batch(std::vector<datagram> &batch, size_t first, size_t count);
+    boost::asio::ip::udp::socket &socket_for(const endpoint &dest);
+
+#if BOOST_VERSION < 106600
+    boost::asio::io_service         d_io;
+#else
+    boost::asio::io_context         d_io;
+#endif
+    boost::asio::ip::udp::socket    d_sock4;
+    boost::asio::ip::udp::socket    d_sock6;
+
+    std::thread                     d_thread;
+    std::mutex                      d_mutex;     /*!< Protects the queue. */
+    std::condition_variable         d_cond;
+    std::vector<datagram>           d_queue;     /*!< Waiting datagrams. */
+    std::vector<std::vector<char>>  d_free;      /*!< Recycled buffers. */
+    bool                            d_stop;
+    unsigned long                   d_dropped;   /*!< Datagrams lost in the queue. */
+
+    static std::mutex               s_mutex;     /*!< Protects the statics. */
+    static std::weak_ptr<udp_audio_sender> s_instance;
+    static options                  s_options;
+};
+
+typedef std::shared_ptr<udp_audio_sender> udp_audio_sender_sptr;
+
+#endif // UDP_AUDIO_SENDER_H
@@ -20,18 +20,14 @@
  * the Free Software Foundation, Inc., 51 Franklin Street,
  * Boston, MA 02110-1301, USA.
  */
-#if GNURADIO_VERSION < 0x031000
-#include <gnuradio/blocks/udp_sink.h>
-#else
-#include <gnuradio/network/udp_header_types.h>
-#include <gnuradio/network/udp_sink.h>
-#endif
-
-#include <gnuradio/hier_block2.h>
-#include <gnuradio/blocks/float_to_short.h>
 #include <gnuradio/io_signature.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <random>
 
 #include "udp_sink_f.h"
 
@@ -41,9 +37,9 @@
  * upcasted shared_ptr. This is effectively the public
  * constructor.
  */
-udp_sink_f_sptr make_udp_sink_f()
+udp_sink_f_sptr make_udp_sink_f(int sample_rate)
 {
-    return gnuradio::get_initial_sptr(new udp_sink_f());
+    return gnuradio::get_initial_sptr(new udp_sink_f(sample_rate));
 }
 
 static const int MIN_IN = 2;  /*!< Minimum number of input streams. */
@@ -51,30 +47,23 @@ static const int MAX_IN = 2;  /*!< Maximum number of input streams. */
 static const int MIN_OUT = 0; /*!< Minimum number of output streams. */
 static const int MAX_OUT = 0; /*!< Maximum number of output streams. */
 
-// nc is used widely for receiving UDP streams and some versions of nc,
-// notably on MacOS, use a 1024 byte buffer so we need to make sure we
-// don't send packets that are larger than that, otherwise data will be
-// lost.
-static const int PAYLOAD_SIZE = 1024;
-
-udp_sink_f::udp_sink_f()
-    : gr::hier_block2("udp_sink_f",
-                      gr::io_signature::make(MIN_IN, MAX_IN, sizeof(float)),
-                      gr::io_signature::make(MIN_OUT, MAX_OUT, sizeof(float)))
+static const size_t RTP_HEADER_SIZE = 12;
+static const uint8_t RTP_PAYLOAD_TYPE = 96;  /*!< Dynamic, L16 at any rate. */
+
+udp_sink_f::udp_sink_f(int sample_rate)
+    : gr::sync_block("udp_sink_f",
+                     gr::io_signature::make(MIN_IN, MAX_IN, sizeof(float)),
+                     gr::io_signature::make(MIN_OUT, MAX_OUT, sizeof(float))),
+      d_rate(sample_rate),
+      d_channels(1),
+      d_rtp(false),
+      d_header(0),
+      d_payload(UDP_AUDIO_DEFAULT_PAYLOAD),
+      d_fill(0),
+      d_seq(0),
+      d_ts(0),
+      d_ssrc(0)
 {
-
-    d_f2s = gr::blocks::float_to_short::make(1, 32767);
-#if GNURADIO_VERSION < 0x031000
-    d_sink = gr::blocks::udp_sink::make(sizeof(short), "localhost", 7355, PAYLOAD_SIZE);
-    d_sink->disconnect();
-#endif
-
-    d_inter = gr::blocks::interleave::make(sizeof(float));
-    d_null0 = gr::blocks::null_sink::make(sizeof(float));
-    d_null1 = gr::blocks::null_sink::make(sizeof(float));
-
-    connect(self(), 0, d_null0, 0);
-    connect(self(), 1, d_null1, 0);
 }
 
 udp_sink_f::~udp_sink_f()
@@ -82,57 +71,129 @@ udp_sink_f::~udp_sink_f()
 }
 
 /*! \brief Start streaming through the UDP sink
- *  \param host The hostname or IP address of the client.
+ *  \param host The hostname or IP address of the client, may be multicast.
  *  \param port The port used for the UDP stream
  *  \param stereo Select mono or stereo streaming
+ *
+ * Throws std::runtime_error, if the host can not be resolved.
  */
 void udp_sink_f::start_streaming(const std::string host, int port, bool stereo)
 {
-    lock();
-    disconnect_all();
+    udp_audio_sender_sptr sender = udp_audio_sender::get();
+    udp_audio_sender::options opts = udp_audio_sender::get_options();
+    udp_audio_sender::endpoint dest = sender->resolve(host, port);
+    std::lock_guard<std::mutex> lock(d_mutex);
 
     std::cout << "Starting UDP streaming, Host: " << host;
     std::cout << ", Port: " << std::to_string(port) << ", ";
-    std::cout << (stereo ? "Stereo" : "Mono") << std::endl;
+    std::cout << (stereo ? "Stereo" : "Mono");
+    std::cout << (opts.rtp ? ", RTP" : "") << std::endl;
+
+    d_sender = sender;
+    d_dest = dest;
+    d_channels = stereo ? 2 : 1;
+    d_rtp = opts.rtp;
+    d_header = d_rtp ? RTP_HEADER_SIZE : 0;
+    // Whole frames only
+    d_payload = opts.payload / (d_channels * sizeof(int16_t)) * (d_channels * sizeof(int16_t));
+    d_packet.assign(d_header + d_payload, 0);
+    d_fill = d_header;
+    d_seq = std::random_device()();
+    d_ssrc = std::random_device()();
+    start_timestamp();
+}
 
-#if GNURADIO_VERSION >= 0x031000
-    d_sink = gr::network::udp_sink::make(sizeof(short), 1, host, port, HEADERTYPE_NONE, PAYLOAD_SIZE, true);
-#endif
 
-    if (stereo)
-    {
-        connect(self(), 0, d_inter, 0);
-        connect(self(), 1, d_inter, 1);
-        connect(d_inter, 0, d_f2s, 0);
-        connect(d_f2s, 0, d_sink, 0);
-    }
-    else
+void udp_sink_f::stop_streaming(void)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    d_sender.reset();
+    std::cout << "Disconnected UDP streaming" << std::endl;
+}
+
+/*! \brief The audio rate changed, the RTP timestamp starts again. */
+void udp_sink_f::set_sample_rate(int sample_rate)
+{
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    d_rate = sample_rate;
+    if (d_sender)
     {
-        connect(self(), 0, d_f2s, 0);
-        connect(d_f2s, 0, d_sink, 0);
-        connect(self(), 1, d_null0, 0);
+        d_fill = d_header;
+        start_timestamp();
     }
-    unlock();
+}
+
+/* Frames since the epoch for the first sample sent. */
+void udp_sink_f::start_timestamp()
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
 
-#if GNURADIO_VERSION < 0x031000
-    d_sink->connect(host, port);
-#endif
+    d_ts = uint32_t(uint64_t(us) * uint64_t(d_rate) / 1000000u);
 }
 
+/* Send the filled datagram and start the next one. */
+void udp_sink_f::flush()
+{
+    size_t frames = (d_fill - d_header) / (d_channels * sizeof(int16_t));
 
-void udp_sink_f::stop_streaming(void)
+    if (d_rtp)
+    {
+        unsigned char *hdr = (unsigned char *) d_packet.data();
+
+        hdr[0] = 0x80;  // version 2
+        hdr[1] = RTP_PAYLOAD_TYPE;
+        hdr[2] = d_seq >> 8;
+        hdr[3] = d_seq;
+        hdr[4] = d_ts >> 24;
+        hdr[5] = d_ts >> 16;
+        hdr[6] = d_ts >> 8;
+        hdr[7] = d_ts;
+        hdr[8] = d_ssrc >> 24;
+        hdr[9] = d_ssrc >> 16;
+        hdr[10] = d_ssrc >> 8;
+        hdr[11] = d_ssrc;
+    }
+    d_sender->send(d_dest, d_packet.data(), d_fill);
+    d_seq++;
+    d_ts += frames;
+    d_fill = d_header;
+}
+
+int udp_sink_f::work(int noutput_items,
+                     gr_vector_const_void_star &input_items,
+                     gr_vector_void_star &output_items)
 {
-    lock();
-    disconnect_all();
-    connect(self(), 0, d_null0, 0);
-    connect(self(), 1, d_null1, 0);
-    unlock();
+    (void) output_items;
 
-    std::cout << "Disconnected UDP streaming" << std::endl;
+    std::lock_guard<std::mutex> lock(d_mutex);
+
+    if (!d_sender)
+        return noutput_items;
+
+    for (int i = 0; i < noutput_items; i++)
+    {
+        for (int ch = 0; ch < d_channels; ch++)
+        {
+            float v = ((const float *) input_items[ch])[i] * 32767.f;
+            int16_t s = (int16_t) std::lrint(std::min(std::max(v, -32768.f), 32767.f));
+            char *p = d_packet.data() + d_fill;
+
+            if (d_rtp)
+            {
+                // L16 is big endian
+                p[0] = char(uint16_t(s) >> 8);
+                p[1] = char(uint16_t(s));
+            }
+            else
+                std::memcpy(p, &s, sizeof(s));
+            d_fill += sizeof(s);
+        }
+        if (d_fill == d_packet.size())
+            flush();
+    }
 
-#if GNURADIO_VERSION < 0x031000
-    d_sink->disconnect();
-#else
-    d_sink = nullptr;
-#endif
+    return noutput_items;
 }
@@ -23,16 +23,11 @@
 #ifndef UDP_SINK_F_H
 #define UDP_SINK_F_H
 
-#if GNURADIO_VERSION < 0x031000
-#include <gnuradio/blocks/udp_sink.h>
-#else
-#include <gnuradio/network/udp_sink.h>
-#endif
-
-#include <gnuradio/hier_block2.h>
-#include <gnuradio/blocks/float_to_short.h>
-#include <gnuradio/blocks/interleave.h>
-#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/sync_block.h>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "interfaces/udp_audio_sender.h"
 
 
 class udp_sink_f;
@@ -43,28 +38,49 @@ typedef boost::shared_ptr<udp_sink_f> udp_sink_f_sptr;
 typedef std::shared_ptr<udp_sink_f> udp_sink_f_sptr;
 #endif
 
-udp_sink_f_sptr make_udp_sink_f(void);
+udp_sink_f_sptr make_udp_sink_f(int sample_rate);
 
-class udp_sink_f : public gr::hier_block2
+/*! \brief Stream the audio of a VFO as 16 bit PCM over UDP.
+ *  \ingroup IO
+ *
+ * The datagrams are queued to the udp_audio_sender shared by all VFOs.
+ * With the RTP option every datagram starts with an RTP header (RFC 3550,
+ * payload type 96, L16 in network byte order as in RFC 3551), otherwise
+ * it holds only the samples in host byte order. The RTP timestamp counts
+ * audio frames since the Unix epoch (modulo 2^32), so streams at the same
+ * rate share a time base.
+ */
+class udp_sink_f : public gr::sync_block
 {
 public:
-    udp_sink_f(void);
+    udp_sink_f(int sample_rate);
     ~udp_sink_f();
 
+    int work(int noutput_items,
+             gr_vector_const_void_star &input_items,
+             gr_vector_void_star &output_items);
+
     void start_streaming(const std::string host, int port, bool stereo);
     void stop_streaming(void);
+    void set_sample_rate(int sample_rate);
 
 private:
-#if GNURADIO_VERSION < 0x031000
-    gr::blocks::udp_sink::sptr        d_sink;   /*!< The gnuradio UDP sink. */
-#else
-    gr::network::udp_sink::sptr       d_sink;   /*!< The gnuradio UDP sink. */
-#endif
-    gr::blocks::float_to_short::sptr  d_f2s;    /*!< Converts float to short. */
-    gr::blocks::interleave::sptr      d_inter;  /*!< Stereo interleaver. */
-    gr::blocks::null_sink::sptr       d_null0;  /*!< Null sink for mono. */
-    gr::blocks::null_sink::sptr       d_null1;  /*!< Null sink for mono. */
+    void start_timestamp();
+    void flush();
 
+    std::mutex              d_mutex;      /*!< Protects the stream state. */
+    udp_audio_sender_sptr   d_sender;     /*!< Null while not streaming. */
+    udp_audio_sender::endpoint d_dest;
+    int                     d_rate;
+    int                     d_channels;
+    bool                    d_rtp;
+    size_t                  d_header;     /*!< RTP header size or 0. */
+    size_t                  d_payload;    /*!< Audio bytes per datagram. */
+    std::vector<char>       d_packet;     /*!< Datagram being filled. */
+    size_t                  d_fill;       /*!< Bytes in d_packet. */
+    uint16_t                d_seq;        /*!< RTP sequence number. */
+    uint32_t                d_ts;         /*!< RTP timestamp of the first frame in d_packet. */
+    uint32_t                d_ssrc;       /*!< RTP synchronization source. */
 };
 
 
@@ -25,14 +25,91 @@
 #include "wav_sink.h"
 #include <gnuradio/io_signature.h>
 #include <gnuradio/thread/thread.h>
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <ctime>
 #include <stdexcept>
-#include <QDateTime>
-#include <QDir>
 
 static const int SQL_REC_MIN_TIME = 10; /* Minimum squelch recorder time, seconds. */
 static const int SQL_REC_MAX_GAP = 10; /* Maximum squelch recorder gap, seconds. */
 
+constexpr int wavfile_sink_gqrx::s_items_size;
+constexpr unsigned wavfile_sink_gqrx::s_queue_blocks;
+
+wavfile_sink_gqrx::writer_pool & wavfile_sink_gqrx::writer_pool::instance()
+{
+    static writer_pool pool;
+    return pool;
+}
+
+wavfile_sink_gqrx::writer_pool::writer_pool()
+{
+    unsigned nthreads = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2));
+    for (unsigned k = 0; k < nthreads; k++)
+        d_threads.emplace_back(&writer_pool::thread_func, this);
+}
+
+wavfile_sink_gqrx::writer_pool::~writer_pool()
+{
+    {
+        std::unique_lock<std::mutex> guard(d_mutex);
+        d_exit = true;
+        d_wake.notify_all();
+    }
+    for (auto &t : d_threads)
+        t.join();
+}
+
+void wavfile_sink_gqrx::writer_pool::schedule(wavfile_sink_gqrx * sink)
+{
+    std::unique_lock<std::mutex> guard(d_mutex);
+    if (sink->d_scheduled)
+        return;
+    sink->d_scheduled = true;
+    d_ready.push_back(sink);
+    d_wake.notify_one();
+}
+
+/* Wait until the sink has no queued blocks and no thread is working on it. */
+void wavfile_sink_gqrx::writer_pool::drain(wavfile_sink_gqrx * sink)
+{
+    std::unique_lock<std::mutex> guard(d_mutex);
+    while (sink->d_scheduled || sink->queue_pending())
+    {
+        if (!sink->d_scheduled)
+        {
+            sink->d_scheduled = true;
+            d_ready.push_back(sink);
+            d_wake.notify_one();
+        }
+        d_idle.wait(guard);
+    }
+}
+
+void wavfile_sink_gqrx::writer_pool::thread_func()
+{
+    std::unique_lock<std::mutex> guard(d_mutex);
+    while (true)
+    {
+        while (d_ready.empty() && !d_exit)
+            d_wake.wait(guard);
+        if (d_ready.empty())
+            return;
+        wavfile_sink_gqrx * sink = d_ready.front();
+        d_ready.pop_front();
+        guard.unlock();
+        sink->process_queue();
+        guard.lock();
+        // The sink may be destroyed as soon as d_scheduled is cleared
+        if (sink->queue_pending())
+            d_ready.push_back(sink);
+        else
+            sink->d_scheduled = false;
+        d_idle.notify_all();
+    }
+}
+
 wavfile_sink_gqrx::sptr wavfile_sink_gqrx::make(const char* filename,
                                       int n_channels,
                                       unsigned int sample_rate,
@@ -55,7 +132,7 @@ wavfile_sink_gqrx::wavfile_sink_gqrx(const char* filename,
                  gr::io_signature::make(0, 0, 0)),
       d_h{}, // Init with zeros
       d_append(append),
-      d_fp(nullptr),
+      d_active(false),
       d_new_fp(nullptr),
       d_updated(false),
       d_center_freq(0),
@@ -109,7 +186,6 @@ wavfile_sink_gqrx::wavfile_sink_gqrx(const char* filename,
     d_h.bytes_per_sample = d_bytes_per_sample_new;
 
     set_max_noutput_items(s_items_size);
-    d_buffer.resize(s_items_size * d_h.nchans);
 
     if (filename)
         if (!open(filename))
@@ -141,44 +217,60 @@ void wavfile_sink_gqrx::set_rec_dir(std::string dir)
 
 bool wavfile_sink_gqrx::open(const char* filename)
 {
+    wav_header_info h;
+    bool append;
+    {
+        std::unique_lock<std::mutex> guard(d_mutex);
+        queue_alloc();
+        h = d_h;
+        append = d_append;
+    }
+    // Open outside of the lock, so that work() is not stalled by the disk
+    SNDFILE * fp = open_sndfile(filename, h, append);
+    if (!fp)
+        return false;
+
     std::unique_lock<std::mutex> guard(d_mutex);
-    return open_unlocked(filename);
+    if (d_new_fp) // if we've already got a new one open, close it
+        sf_close(d_new_fp);
+    d_new_fp = fp;
+    d_new_filename = filename;
+    d_updated = true;
+
+    return true;
 }
 
-bool wavfile_sink_gqrx::open_unlocked(const char* filename)
+SNDFILE * wavfile_sink_gqrx::open_sndfile(const char* filename, const wav_header_info &h, bool append)
 {
     SF_INFO sfinfo;
+    SNDFILE * fp;
 
-    if (d_new_fp) { // if we've already got a new one open, close it
-        sf_close(d_new_fp);
-        d_new_fp = nullptr;
-    }
-
-    if (d_append) {
+    if (append) {
         // We are appending to an existing file, be extra careful here.
         sfinfo.format = 0;
-        if (!(d_new_fp = sf_open(filename, SFM_RDWR, &sfinfo))) {
+        if (!(fp = sf_open(filename, SFM_RDWR, &sfinfo))) {
             std::cerr << "sf_open failed: " << filename << " " << strerror(errno) << std::endl;
-            return false;
+            return nullptr;
         }
-        if (d_h.sample_rate != sfinfo.samplerate || d_h.nchans != sfinfo.channels ||
-            d_h.format != (sfinfo.format & SF_FORMAT_TYPEMASK) ||
-            d_h.subformat != (sfinfo.format & SF_FORMAT_SUBMASK)) {
+        if (h.sample_rate != sfinfo.samplerate || h.nchans != sfinfo.channels ||
+            h.format != (sfinfo.format & SF_FORMAT_TYPEMASK) ||
+            h.subformat != (sfinfo.format & SF_FORMAT_SUBMASK)) {
             std::cerr << "Existing WAV file is incompatible with configured options."<<std::endl;
-            sf_close(d_new_fp);
-            return false;
+            sf_close(fp);
+            return nullptr;
         }
-        if (sf_seek(d_new_fp, 0, SEEK_END) == -1) {
+        if (sf_seek(fp, 0, SEEK_END) == -1) {
             std::cerr << "Seek error." << std::endl;
-            return false; // This can only happen if the file disappears under our feet.
+            sf_close(fp);
+            return nullptr; // This can only happen if the file disappears under our feet.
         }
     } else {
         memset(&sfinfo, 0, sizeof(sfinfo));
-        sfinfo.samplerate = d_h.sample_rate;
-        sfinfo.channels = d_h.nchans;
-        switch (d_h.format) {
+        sfinfo.samplerate = h.sample_rate;
+        sfinfo.channels = h.nchans;
+        switch (h.format) {
         case FORMAT_WAV:
-            switch (d_h.subformat) {
+            switch (h.subformat) {
             case FORMAT_PCM_U8:
                 sfinfo.format = (SF_FORMAT_WAV | SF_FORMAT_PCM_U8);
                 break;
@@ -200,7 +292,7 @@ bool wavfile_sink_gqrx::open_unlocked(const char* filename)
             }
             break;
         case FORMAT_FLAC:
-            switch (d_h.subformat) {
+            switch (h.subformat) {
             case FORMAT_PCM_S8:
                 sfinfo.format = (SF_FORMAT_FLAC | SF_FORMAT_PCM_S8);
                 break;
@@ -213,14 +305,14 @@ bool wavfile_sink_gqrx::open_unlocked(const char* filename)
             }
             break;
         case FORMAT_OGG:
-            switch (d_h.subformat) {
+            switch (h.subformat) {
             case FORMAT_VORBIS:
                 sfinfo.format = (SF_FORMAT_OGG | SF_FORMAT_VORBIS);
                 break;
             }
             break;
         case FORMAT_RF64:
-            switch (d_h.subformat) {
+            switch (h.subformat) {
             case FORMAT_PCM_U8:
                 sfinfo.format = (SF_FORMAT_RF64 | SF_FORMAT_PCM_U8);
                 break;
@@ -242,55 +334,94 @@ bool wavfile_sink_gqrx::open_unlocked(const char* filename)
             }
             break;
         }
-        if (!(d_new_fp = sf_open(filename, SFM_WRITE, &sfinfo))) {
+        if (!(fp = sf_open(filename, SFM_WRITE, &sfinfo))) {
             std::cerr << "sf_open failed: " << filename << " "
                              << strerror(errno)<<std::endl;
-            return false;
+            return nullptr;
         }
     }
-    d_updated = true;
+    return fp;
+}
 
-    return true;
+std::string wavfile_sink_gqrx::new_filename()
+{
+    // FIXME: option to use local time
+    std::time_t ts = d_ts_src ? std::time_t(d_ts_src->get() / 1000)
+                              : std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm tm_utc;
+    char file_name[32];
+#ifdef _WIN32
+    gmtime_s(&tm_utc, &ts);
+#else
+    gmtime_r(&ts, &tm_utc);
+#endif
+    std::strftime(file_name, sizeof(file_name), "gqrx_%Y%m%d_%H%M%S", &tm_utc);
+    return d_rec_dir + "/" + file_name + "_" +
+           std::to_string((long long)(d_center_freq + d_offset)) + ".wav";
 }
 
 int wavfile_sink_gqrx::open_new()
 {
-    std::unique_lock<std::mutex> guard(d_mutex);
-    return open_new_unlocked();
+    std::string filename;
+    {
+        std::unique_lock<std::mutex> guard(d_mutex);
+        filename = new_filename();
+    }
+    if (!open(filename.data()))
+        return 1;
+    if (d_rec_event)
+        d_rec_event(filename, true);
+    return 0;
 }
 
+/*
+ * Squelch triggered recording start, called by work(). The file is opened
+ * by the writer thread, which also reports the recording start.
+ */
 int wavfile_sink_gqrx::open_new_unlocked()
 {
-    // FIXME: option to use local time
-    QDateTime ts = d_ts_src ? QDateTime::fromMSecsSinceEpoch(d_ts_src->get()).toUTC() : QDateTime::currentDateTime().toUTC();
-    // use toUTC() function compatible with older versions of Qt.
-    QString file_name = ts.toString("gqrx_yyyyMMdd_hhmmss");
-    QString filename = QString("%1/%2_%3.wav").arg(QString(d_rec_dir.data())).arg(file_name).arg(qint64(d_center_freq + d_offset));
-    if (open_unlocked(filename.toStdString().data()))
+    if (!queue_open(new_filename(), nullptr))
     {
-        if (d_rec_event)
-            d_rec_event(d_filename = filename.toStdString(), true);
-        return 0;
+        std::cerr << "wavfile_sink: writer queue full, not starting a recording" << std::endl;
+        return 1;
     }
-    return 1;
+    return 0;
 }
 
 void wavfile_sink_gqrx::close()
 {
     std::unique_lock<std::mutex> guard(d_mutex);
 
-    if (!d_fp)
+    if (d_updated)
+    {
+        // Not installed yet by work(), the writer never saw this file
+        sf_close(d_new_fp);
+        d_new_fp = nullptr;
+        d_updated = false;
+        if (d_rec_event)
+            d_rec_event(d_new_filename, false);
+        return;
+    }
+    if (!d_active)
         return;
     close_wav();
 }
 
 void wavfile_sink_gqrx::close_wav()
 {
-    sf_write_sync(d_fp);
-    sf_close(d_fp);
-    d_fp = nullptr;
-    if (d_rec_event)
-        d_rec_event(d_filename, false);
+    // Publish the block in progress (or a free one, reserved for this) as
+    // the close request. The file is closed and the recording stop is
+    // reported by the writer thread.
+    writer_block &b = d_blocks[d_head % s_queue_blocks];
+    b.filename = d_filename;
+    b.rec_event = d_rec_event;
+    if (d_dropped > 0)
+        std::cerr << "wavfile_sink: " << d_filename << ": " << d_dropped
+                  << " samples replaced with silence in " << d_overruns
+                  << " overruns, writer queue high-water mark "
+                  << d_queue_hwm << "/" << s_queue_blocks << std::endl;
+    queue_publish(CMD_CLOSE, d_fill);
+    d_active = false;
 }
 
 wavfile_sink_gqrx::~wavfile_sink_gqrx()
@@ -301,13 +432,21 @@ wavfile_sink_gqrx::~wavfile_sink_gqrx()
         d_new_fp = nullptr;
     }
     close();
-
+    if (!d_blocks.empty())
+        writer_pool::instance().drain(this);
 }
 
 bool wavfile_sink_gqrx::stop()
 {
-    if (d_fp)
-        sf_write_sync(d_fp);
+    std::unique_lock<std::mutex> guard(d_mutex);
+    if (d_active)
+    {
+        if (d_fill > 0)
+            queue_publish(CMD_WRITE, d_fill);
+        // Only a flush hint, skipped if the writer is behind anyway
+        if (queue_free() > 1)
+            queue_publish(CMD_SYNC, 0);
+    }
     return true;
 }
 
@@ -324,6 +463,11 @@ int wavfile_sink_gqrx::work(int noutput_items,
     std::unique_lock<std::mutex> guard(d_mutex); // hold mutex for duration of this block
     int roffset = 0; /** relative offset*/
 
+    if (d_io_error.exchange(false) && d_active)
+    {
+        std::cerr << "wavfile_sink: stopping recording of " << d_filename << " after I/O error" << std::endl;
+        close_wav();
+    }
 
     if (d_squelch_triggered)
     {
@@ -338,7 +482,7 @@ int wavfile_sink_gqrx::work(int noutput_items,
                 {
                     if (roffset + hist - d_prev_roffset <= d_max_gap_samp)
                     {
-                        if (d_fp)
+                        if (d_active)
                         {
                             writeout(d_prev_roffset, roffset + hist - d_prev_roffset, n_in_chans, in);
                             nwritten = roffset + hist;
@@ -348,27 +492,28 @@ int wavfile_sink_gqrx::work(int noutput_items,
                     }
                     else
                     {
-                        if (d_fp)
+                        if (d_active)
                             close_wav();
                     }
                 }
                 d_prev_roffset = roffset + hist;
-                if (!d_fp)
+                if (!d_active)
                     d_prev_action = ACT_OPEN;
             }
             if (tag.key == d_eob_key)
             {
                 if (d_prev_action == ACT_OPEN)
                 {
-                    if (!d_fp && (roffset + hist - d_prev_roffset >= d_min_time_samp))
+                    if (!d_active && (roffset + hist - d_prev_roffset >= d_min_time_samp))
                     {
-                        open_new_unlocked();
                         do_update();
-                        if (d_fp)
+                        if (!d_active)
+                            open_new_unlocked();
+                        if (d_active)
                             writeout(d_prev_roffset, roffset + hist - d_prev_roffset, n_in_chans, in);
                     }
                 }
-                if (d_fp)
+                if (d_active)
                     d_prev_action = ACT_CLOSE;
                 else
                     d_prev_action = ACT_NONE;
@@ -379,19 +524,20 @@ int wavfile_sink_gqrx::work(int noutput_items,
     switch(d_prev_action)
     {
     case ACT_NONE:
-        do_update();                            // update: d_fp is read
-        if (d_fp && writecount)
+        do_update();                            // update: d_active is read
+        if (d_active && writecount)
             writeout(nwritten, writecount, n_in_chans, in);
         break;
     case ACT_OPEN:
         if (hist - d_prev_roffset >= d_min_time_samp)
         {
             d_prev_action = ACT_NONE;
-            if (!d_fp)
+            if (!d_active)
             {
-                open_new_unlocked();
                 do_update();
-                if (d_fp)
+                if (!d_active)
+                    open_new_unlocked();
+                if (d_active)
                     writeout(d_prev_roffset, hist - d_prev_roffset + writecount, n_in_chans, in);
             }
         }
@@ -399,7 +545,7 @@ int wavfile_sink_gqrx::work(int noutput_items,
     case  ACT_CLOSE:
         if (hist - d_prev_roffset >= d_max_gap_samp)
         {
-            if (d_fp)
+            if (d_active)
             {
                 close_wav();
             }
@@ -417,30 +563,161 @@ void wavfile_sink_gqrx::writeout(const int offset, const int writecount, const i
 {
     int nchans = d_h.nchans;
     int nwritten = 0;
-    int bp = 0;
-    int errnum;
     while (nwritten < writecount)
     {
-        for (bp = 0; (nwritten < writecount) && (bp < s_items_size); nwritten++, bp++)
+        if (d_fill == 0 && !queue_begin_block())
+        {
+            // Overrun: never block the flowgraph, drop and pad with silence
+            d_silence += writecount - nwritten;
+            d_dropped += writecount - nwritten;
+            d_overruns++;
+            return;
+        }
+        float * buf = d_blocks[d_head % s_queue_blocks].data.data();
+        for (; (nwritten < writecount) && (d_fill < s_items_size); nwritten++, d_fill++)
         {
             for (int chan = 0; chan < nchans; chan++)
             {
                 // Write zeros to channels which are in the WAV file
                 // but don't have any inputs here
                 if (chan < n_in_chans)
-                    d_buffer[chan + (bp * nchans)] = in[chan][nwritten + offset];
+                    buf[chan + (d_fill * nchans)] = in[chan][nwritten + offset];
                 else
-                    d_buffer[chan + (bp * nchans)] = 0;
+                    buf[chan + (d_fill * nchans)] = 0;
             }
         }
-        sf_write_float(d_fp, &d_buffer[0], nchans * bp);
+        if (d_fill == s_items_size)
+            queue_publish(CMD_WRITE, d_fill);
+    }
+}
+
+/* Allocate writer queue on first use, most VFOs never record. */
+void wavfile_sink_gqrx::queue_alloc()
+{
+    if (!d_blocks.empty())
+        return;
+    d_blocks.resize(s_queue_blocks);
+    for (auto &b : d_blocks)
+        b.data.resize(s_items_size * d_h.nchans);
+}
+
+unsigned wavfile_sink_gqrx::queue_free()
+{
+    return s_queue_blocks - (d_head.load(std::memory_order_relaxed) - d_tail.load(std::memory_order_acquire));
+}
+
+bool wavfile_sink_gqrx::queue_pending()
+{
+    return d_head.load(std::memory_order_acquire) != d_tail.load(std::memory_order_relaxed);
+}
+
+/* Reserve the block at d_head for data, keeping one block free for CMD_CLOSE. */
+bool wavfile_sink_gqrx::queue_begin_block()
+{
+    if (queue_free() < 2)
+        return false;
+    d_blocks[d_head % s_queue_blocks].nsilence = int(d_silence);
+    d_silence = 0;
+    return true;
+}
+
+/* Start a recording to filename, fp is already open or nullptr. */
+bool wavfile_sink_gqrx::queue_open(const std::string &filename, SNDFILE * fp)
+{
+    // One block for the open and one for the matching close
+    if (d_blocks.empty() || queue_free() < 2)
+        return false;
+    writer_block &b = d_blocks[d_head % s_queue_blocks];
+    b.fp = fp;
+    b.h = d_h;
+    b.append = d_append;
+    b.filename = filename;
+    b.rec_event = fp ? nullptr : d_rec_event;
+    queue_publish(CMD_OPEN, 0);
+    d_active = true;
+    d_filename = filename;
+    d_dropped = 0;
+    d_overruns = 0;
+    d_queue_hwm = 0;
+    return true;
+}
 
-        errnum = sf_error(d_fp);
-        if (errnum) {
-            std::cerr << "sf_error: " << sf_error_number(errnum) << std::endl;
-            close();
-            throw std::runtime_error("File I/O error.");
+void wavfile_sink_gqrx::queue_publish(writer_cmd cmd, int nitems)
+{
+    unsigned head = d_head.load(std::memory_order_relaxed);
+    writer_block &b = d_blocks[head % s_queue_blocks];
+    if (d_fill == 0)
+    {
+        b.nsilence = int(d_silence);
+        d_silence = 0;
+    }
+    b.cmd = cmd;
+    b.nitems = nitems;
+    d_head.store(head + 1, std::memory_order_release);
+    d_fill = 0;
+    unsigned used = head + 1 - d_tail.load(std::memory_order_relaxed);
+    if (used > d_queue_hwm)
+        d_queue_hwm = used;
+    writer_pool::instance().schedule(this);
+}
+
+/* Consumer side, runs in a writer_pool thread. */
+void wavfile_sink_gqrx::process_queue()
+{
+    int nchans = d_h.nchans;
+    while (queue_pending())
+    {
+        unsigned tail = d_tail.load(std::memory_order_relaxed);
+        writer_block &b = d_blocks[tail % s_queue_blocks];
+        if (b.cmd == CMD_OPEN)
+        {
+            if (d_out_fp)
+                sf_close(d_out_fp);
+            d_out_fp = b.fp ? b.fp : open_sndfile(b.filename.data(), b.h, b.append);
+            d_out_error = !d_out_fp;
+            if (d_out_error)
+                d_io_error = true;
+            else if (b.rec_event)
+                b.rec_event(b.filename, true);
+            b.fp = nullptr;
+            b.rec_event = nullptr;
+            d_tail.store(tail + 1, std::memory_order_release);
+            continue;
         }
+        bool ok = d_out_fp && !d_out_error;
+        if (ok && b.nsilence > 0)
+        {
+            if (d_zeros.empty())
+                d_zeros.resize(s_items_size * nchans, 0.f);
+            for (int k = 0; k < b.nsilence; k += s_items_size)
+                sf_write_float(d_out_fp, d_zeros.data(), nchans * std::min(s_items_size, b.nsilence - k));
+        }
+        if (ok && b.nitems > 0)
+            sf_write_float(d_out_fp, b.data.data(), nchans * b.nitems);
+        if (ok && b.cmd != CMD_WRITE)
+            sf_write_sync(d_out_fp);
+        if (ok)
+        {
+            int errnum = sf_error(d_out_fp);
+            if (errnum) {
+                std::cerr << "sf_error: " << sf_error_number(errnum) << std::endl;
+                d_out_error = true;
+                d_io_error = true;
+            }
+        }
+        if (b.cmd == CMD_CLOSE)
+        {
+            if (d_out_fp)
+            {
+                sf_close(d_out_fp);
+                if (b.rec_event)
+                    b.rec_event(b.filename, false);
+            }
+            d_out_fp = nullptr;
+            d_out_error = false;
+            b.rec_event = nullptr;
+        }
+        d_tail.store(tail + 1, std::memory_order_release);
     }
 }
 
@@ -450,6 +727,8 @@ void wavfile_sink_gqrx::set_sql_triggered(const bool enabled)
         return;
     {
         std::unique_lock<std::mutex> guard(d_mutex);
+        if (enabled)
+            queue_alloc();
         d_squelch_triggered = enabled;
         d_prev_action = ACT_NONE;
     }
@@ -466,6 +745,24 @@ void wavfile_sink_gqrx::set_bits_per_sample_unlocked(int bits_per_sample)
     d_bytes_per_sample_new = bits_per_sample / 8;
 }
 
+unsigned wavfile_sink_gqrx::get_queue_hwm()
+{
+    std::unique_lock<std::mutex> guard(d_mutex);
+    return d_queue_hwm;
+}
+
+long long wavfile_sink_gqrx::get_dropped()
+{
+    std::unique_lock<std::mutex> guard(d_mutex);
+    return d_dropped;
+}
+
+unsigned wavfile_sink_gqrx::get_overruns()
+{
+    std::unique_lock<std::mutex> guard(d_mutex);
+    return d_overruns;
+}
+
 void wavfile_sink_gqrx::set_append(bool append)
 {
     std::unique_lock<std::mutex> guard(d_mutex);
@@ -490,10 +787,14 @@ void wavfile_sink_gqrx::do_update()
     if (!d_updated)
         return;
 
-    if (d_fp)
+    // Retry on the next call, if the close and the open can't both be queued
+    if (queue_free() < (d_active ? 3u : 2u))
+        return;
+
+    if (d_active)
         close_wav();
 
-    d_fp = d_new_fp; // install new file pointer
+    queue_open(d_new_filename, d_new_fp); // install new file pointer
     d_new_fp = nullptr;
 
     d_h.bytes_per_sample = d_bytes_per_sample_new;
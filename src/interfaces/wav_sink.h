@@ -29,6 +29,11 @@
 #include <sndfile.h> // for SNDFILE
 #include <thread>
 #include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
 
 class wavfile_sink_gqrx : virtual public gr::sync_block
 {
@@ -93,14 +98,55 @@ private:
         ACT_OPEN,
         ACT_CLOSE
         } sql_action;
+
+    //! Writer queue commands.
+    typedef enum{
+        CMD_OPEN=0,  //!< Open (or take over) a file and report recording start
+        CMD_WRITE,   //!< Write nsilence frames of silence, then nitems frames from data
+        CMD_SYNC,    //!< Write nsilence frames of silence, then flush file
+        CMD_CLOSE    //!< Write like CMD_WRITE, then close file and report recording stop
+        } writer_cmd;
+
+    //! Writer queue block, owned by the producer until published.
+    struct writer_block {
+        writer_cmd cmd;
+        int nsilence;
+        int nitems;
+        std::vector<float> data;
+        SNDFILE * fp;           //!< CMD_OPEN: file opened by the GUI thread or nullptr
+        wav_header_info h;      //!< CMD_OPEN
+        bool append;            //!< CMD_OPEN
+        std::string filename;
+        rec_event_handler_t rec_event;
+    };
+
+    /*!
+     * \brief Shared pool of threads, that encode and write recordings of
+     * all sinks, keeping libsndfile and disk I/O out of the DSP threads.
+     */
+    class writer_pool {
+    public:
+        static writer_pool & instance();
+        void schedule(wavfile_sink_gqrx * sink);
+        void drain(wavfile_sink_gqrx * sink);
+        ~writer_pool();
+    private:
+        writer_pool();
+        void thread_func();
+        std::vector<std::thread> d_threads;
+        std::deque<wavfile_sink_gqrx *> d_ready;
+        std::mutex d_mutex;
+        std::condition_variable d_wake;
+        std::condition_variable d_idle;
+        bool d_exit{false};
+    };
     wav_header_info d_h;
     int d_bytes_per_sample_new;
     bool d_append;
 
-    std::vector<float> d_buffer;
-
-    SNDFILE* d_fp;
+    bool d_active;          //!< A file is open, or queued for opening
     SNDFILE* d_new_fp;
+    std::string d_new_filename;
     bool d_updated;
     std::mutex d_mutex;
     double      d_center_freq;
@@ -110,6 +156,29 @@ private:
 
     static constexpr int s_items_size = 8192;
     static constexpr int s_max_channels = 24;
+    static constexpr unsigned s_queue_blocks = 16; //!< ~2.7 s at 48 kHz
+
+    /*
+     * Single producer (work/GUI thread, under d_mutex), single consumer
+     * (a writer_pool thread) ring of blocks. The producer never waits for
+     * the consumer. On overrun, audio is dropped and replaced with the same
+     * amount of silence, so that the file stays aligned to real time. Data
+     * blocks and CMD_OPEN always leave one block free, so that CMD_CLOSE
+     * can be queued at any time.
+     */
+    std::vector<writer_block> d_blocks;
+    std::atomic<unsigned> d_head{0};    //!< written by the producer
+    std::atomic<unsigned> d_tail{0};    //!< written by the consumer
+    int d_fill{0};                      //!< frames in the block at d_head
+    long long d_silence{0};             //!< dropped frames, not yet queued as silence
+    bool d_scheduled{false};            //!< guarded by writer_pool mutex
+    std::atomic<bool> d_io_error{false};
+    SNDFILE * d_out_fp{nullptr};        //!< consumer only
+    bool d_out_error{false};            //!< consumer only
+    std::vector<float> d_zeros;         //!< consumer only
+    unsigned d_queue_hwm{0};            //!< producer only, also logged on close
+    long long d_dropped{0};             //!< frames replaced with silence
+    unsigned d_overruns{0};
 
     rec_event_handler_t d_rec_event;
     bool d_squelch_triggered;
@@ -135,10 +204,9 @@ private:
     void set_bits_per_sample_unlocked(int bits_per_sample);
 
     /*!
-     * \brief Writes information to the WAV header which is not available
-     * a-priori (chunk size etc.) and closes the file. Not thread-safe and
-     * assumes d_fp is a valid file pointer, should thus only be called by
-     * other methods.
+     * \brief Queues the remaining data and the close of the current file.
+     * Never blocks. Not thread-safe and assumes a file is active, should
+     * thus only be called by other methods.
      */
     void close_wav();
 
@@ -190,15 +258,29 @@ public:
     int get_rec_max_gap() { return d_max_gap_ms; }
     int get_min_time();
     int get_max_gap();
-    bool is_active() { return !! d_fp; }
+    bool is_active() { return d_active || d_updated; }
+
+    /* Writer queue statistics of the current recording */
+    unsigned get_queue_hwm();
+    unsigned get_queue_size() const { return s_queue_blocks; }
+    long long get_dropped();
+    unsigned get_overruns();
     void set_timestamp_source(timestamp_source * value)
     {
         d_ts_src = value;
     }
 private:
-    bool open_unlocked(const char* filename);
+    static SNDFILE * open_sndfile(const char* filename, const wav_header_info &h, bool append);
+    std::string new_filename();
     int  open_new_unlocked();
     void writeout(const int offset, const int writecount, const int n_in_chans, float** in);
+    void queue_alloc();
+    unsigned queue_free();
+    bool queue_begin_block();
+    bool queue_open(const std::string &filename, SNDFILE * fp);
+    void queue_publish(writer_cmd cmd, int nitems);
+    bool queue_pending();
+    void process_queue();
 };
 
 #endif /* GQRX_WAVFILE_SINK_C_H */
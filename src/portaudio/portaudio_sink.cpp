@@ -155,6 +155,20 @@ void portaudio_sink::select_device(string device_name)
 
 }
 
+/*! \brief Set the suggested output latency.
+ *  \param latency Latency in seconds, 0 for the default high latency of the device.
+ *
+ * Takes effect, when the stream is opened in start().
+ */
+void portaudio_sink::set_target_latency(double latency)
+{
+    if (latency > 0.0)
+        d_out_params.suggestedLatency = latency;
+    else
+        d_out_params.suggestedLatency =
+                Pa_GetDeviceInfo(d_out_params.device)->defaultHighOutputLatency;
+}
+
 int portaudio_sink::work(int noutput_items,
                          gr_vector_const_void_star &input_items,
                          gr_vector_void_star &output_items)
@@ -189,6 +203,18 @@ int portaudio_sink::work(int noutput_items,
             Pa_WriteStream(d_stream, d_audio_buffer, noutput_items);
     }
 
+    // After a blocking write the last sample is played after the output latency
+    get_tags_in_window(d_tags, 0, 0, noutput_items, latency_meter::key());
+    if (!d_tags.empty())
+    {
+        const PaStreamInfo *info = Pa_GetStreamInfo(d_stream);
+        double latency = info ? info->outputLatency : 0.0;
+        uint64_t end = nitems_read(0) + noutput_items;
+
+        for (const auto &tag : d_tags)
+            d_latency.add(tag, latency - double(end - tag.offset) / d_audio_rate);
+    }
+
     return noutput_items;
 
 // code below supports 1 or 2 channels
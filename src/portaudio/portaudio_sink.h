@@ -25,6 +25,8 @@
 #include <gnuradio/sync_block.h>
 #include <portaudio.h>
 #include <string>
+#include <vector>
+#include "dsp/latency_probe.h"
 
 #define PORTAUDIO_BUFFER_SIZE 100000
 
@@ -61,6 +63,10 @@ public:
     bool stop();
 
     void select_device(std::string device_name);
+    void set_target_latency(double latency);
+
+    /*! \brief Latency of the probe tags until they are played. */
+    latency_stats get_latency() { return d_latency.get(); }
 
 private:
     PaStream           *d_stream;
@@ -69,4 +75,6 @@ private:
     std::string      d_app_name;          // Descriptive name of the application.
     int         d_audio_rate;
     float       d_audio_buffer[PORTAUDIO_BUFFER_SIZE];
+    latency_meter          d_latency;
+    std::vector<gr::tag_t> d_tags;
 };
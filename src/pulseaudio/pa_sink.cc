@@ -50,30 +50,16 @@ pa_sink::pa_sink(const string device_name, int audio_rate,
   : gr::sync_block ("pa_sink",
         gr::io_signature::make (1, 2, sizeof(float)),
         gr::io_signature::make (0, 0, 0)),
+    d_device_name(device_name),
     d_stream_name(stream_name),
-    d_app_name(app_name)
+    d_app_name(app_name),
+    d_target_latency(0.0)
 {
-    int error;
-
     /* The sample type to use */
     d_ss.format = PA_SAMPLE_FLOAT32LE;
     d_ss.rate = audio_rate;
     d_ss.channels = 2;
-    d_pasink = pa_simple_new(NULL,
-                             d_app_name.c_str(),
-                             PA_STREAM_PLAYBACK,
-                             device_name.empty() ? NULL : device_name.c_str(),
-                             d_stream_name.c_str(),
-                             &d_ss,
-                             NULL,
-                             NULL,
-                             &error);
-
-    if (!d_pasink) {
-        /** FIXME: Throw an exception **/
-        fprintf(stderr, __FILE__": pa_simple_new() failed: %s\n", pa_strerror(error));
-    }
-
+    open_stream();
 }
 
 
@@ -100,18 +86,53 @@ bool pa_sink::stop()
  */
 void pa_sink::select_device(string device_name)
 {
+    if (d_pasink)
+        pa_simple_free(d_pasink);
+
+    d_device_name = device_name;
+    open_stream();
+}
+
+/*! \brief Set the amount of audio buffered by the server.
+ *  \param latency Latency in seconds, 0 for the server default (about 2 s).
+ *
+ * The stream is reopened, so this should be called while the flowgraph is
+ * stopped.
+ */
+void pa_sink::set_target_latency(double latency)
+{
+    if (latency == d_target_latency)
+        return;
+
+    if (d_pasink)
+        pa_simple_free(d_pasink);
+
+    d_target_latency = latency;
+    open_stream();
+}
+
+void pa_sink::open_stream()
+{
+    pa_buffer_attr attr;
     int error;
 
-    pa_simple_free(d_pasink);
+    /* Only the target length matters for playback, the rest is up to the server */
+    attr.maxlength = (uint32_t) -1;
+    attr.tlength = (uint32_t) -1;
+    attr.prebuf = (uint32_t) -1;
+    attr.minreq = (uint32_t) -1;
+    attr.fragsize = (uint32_t) -1;
+    if (d_target_latency > 0.0)
+        attr.tlength = pa_usec_to_bytes((pa_usec_t)(d_target_latency * 1e6), &d_ss);
 
     d_pasink = pa_simple_new(NULL,
                              d_app_name.c_str(),
                              PA_STREAM_PLAYBACK,
-                             device_name.empty() ? NULL : device_name.c_str(),
+                             d_device_name.empty() ? NULL : d_device_name.c_str(),
                              d_stream_name.c_str(),
                              &d_ss,
                              NULL,
-                             NULL,
+                             (d_target_latency > 0.0) ? &attr : NULL,
                              &error);
 
     if (!d_pasink) {
@@ -160,5 +181,16 @@ int pa_sink::work (int noutput_items,
         fprintf(stderr, __FILE__": pa_simple_write() failed: %s\n", pa_strerror(error));
     }
 
+    // The pulseaudio latency is the time until the last written sample is played
+    get_tags_in_window(d_tags, 0, 0, noutput_items, latency_meter::key());
+    if (!d_tags.empty())
+    {
+        pa_usec_t latency = pa_simple_get_latency(d_pasink, &error);
+        uint64_t end = nitems_read(0) + noutput_items;
+
+        for (const auto &tag : d_tags)
+            d_latency.add(tag, latency * 1e-6 - double(end - tag.offset) / d_ss.rate);
+    }
+
     return noutput_items;
 }
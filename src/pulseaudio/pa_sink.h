@@ -26,6 +26,8 @@
 #include <gnuradio/sync_block.h>
 #include <pulse/simple.h>
 #include <string>
+#include <vector>
+#include "dsp/latency_probe.h"
 
 #define PULSE_AUDIO_BUFFER_SIZE 100000
 
@@ -66,13 +68,23 @@ public:
     bool stop();
 
     void select_device(std::string device_name);
+    void set_target_latency(double latency);
+
+    /*! \brief Latency of the probe tags until they are played. */
+    latency_stats get_latency() { return d_latency.get(); }
 
 private:
+    void open_stream();
+
     pa_simple *d_pasink;    /*! The pulseaudio object. */
+    std::string d_device_name;   /*! Name of the output device, empty for default. */
     std::string d_stream_name;   /*! Descriptive name of the stream. */
     std::string d_app_name;      /*! Descriptive name of the application. */
     pa_sample_spec d_ss;    /*! pulseaudio sample specification. */
+    double d_target_latency;     /*! Requested latency in seconds, 0 for server default. */
     float d_audio_buffer[PULSE_AUDIO_BUFFER_SIZE];
+    latency_meter d_latency;
+    std::vector<gr::tag_t> d_tags;
 };
 
 #endif /* PA_SINK_H */
@@ -198,7 +198,7 @@ private:
     Bookmarks(); // Singleton Constructor is private.
     bool fromString(bool & to, const QString & from){to=(from=="true"); return true;}
     bool fromString(int & to, const QString & from){bool ok{false}; to=from.toInt(&ok); return ok;}
-    bool fromString(Modulations::idx & to, const QString & from){to=Modulations::GetEnumForModulationString(from); return true;}
+    bool fromString(Modulations::idx & to, const QString & from){to=Modulations::GetEnumForModulationString(from.toStdString()); return true;}
     bool fromString(long int & to, const QString & from){bool ok{false}; to=from.toLong(&ok); return ok;}
     bool fromString(long long int & to, const QString & from){bool ok{false}; to=from.toLongLong(&ok); return ok;}
     bool fromString(float & to, const QString & from){bool ok{false}; to=from.toFloat(&ok); return ok;}
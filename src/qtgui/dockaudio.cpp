@@ -497,9 +497,26 @@ void DockAudio::audioRecStarted(const QString filename)
     setAudioRecButtonState(true);
 }
 
+/**
+ * @brief Show the writer queue of the running recording.
+ *
+ * The file name turns red, once audio had to be replaced with silence,
+ * because the disk did not keep up.
+ */
+void DockAudio::setAudioRecStats(unsigned queue_hwm, unsigned queue_size, long long dropped,
+                                 unsigned overruns)
+{
+    ui->audioRecLabel->setToolTip(tr("Writer queue high-water mark %1/%2\n"
+                                     "%3 samples replaced with silence in %4 overruns")
+                                  .arg(queue_hwm).arg(queue_size).arg(dropped).arg(overruns));
+    ui->audioRecLabel->setStyleSheet(dropped > 0 ? "color: rgb(255,0,0)" : "");
+}
+
 void DockAudio::audioRecStopped()
 {
     ui->audioRecLabel->setText("<i>DSP</i>");
+    ui->audioRecLabel->setToolTip("");
+    ui->audioRecLabel->setStyleSheet("");
     ui->audioRecButton->setToolTip(tr("Start audio recorder"));
     ui->audioPlayButton->setEnabled(true);
     setAudioRecButtonState(false);
@@ -62,6 +62,8 @@ public:
     void setGainEnabled(bool state);
 
     void setAudioRecButtonState(bool checked);
+    void setAudioRecStats(unsigned queue_hwm, unsigned queue_size, long long dropped,
+                          unsigned overruns);
     void setAudioStreamState(const std::string & host,int port,bool stereo, bool running);
     void setAudioStreamButtonState(bool checked);
     void setDedicatedAudioSink(bool enabled, std::string name);
@@ -288,7 +288,7 @@ void ComboBoxDelegateModulation::setEditorData(QWidget *editor, const QModelInde
 {
     QComboBox *comboBox = static_cast<QComboBox*>(editor);
     QString value = index.model()->data(index, Qt::EditRole).toString();
-    int iModulation = Modulations::GetEnumForModulationString(value);
+    int iModulation = Modulations::GetEnumForModulationString(value.toStdString());
     comboBox->setCurrentIndex(iModulation);
 }
 
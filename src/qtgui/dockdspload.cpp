@@ -0,0 +1,265 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2011-2016 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <QHeaderView>
+#include <QMap>
+#include <QSet>
+#include "dockdspload.h"
+#include "ui_dockdspload.h"
+
+DockDspLoad::DockDspLoad(QWidget *parent) :
+    QDockWidget(parent),
+    ui(new Ui::DockDspLoad)
+{
+    ui->setupUi(this);
+
+    ui->loadTree->header()->setStretchLastSection(false);
+    ui->loadTree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    for (int col = 1; col < ui->loadTree->columnCount(); col++)
+    {
+        ui->loadTree->header()->setSectionResizeMode(col, QHeaderView::ResizeToContents);
+        ui->loadTree->headerItem()->setTextAlignment(col, Qt::AlignRight | Qt::AlignVCenter);
+    }
+    ui->latencyTree->header()->setStretchLastSection(false);
+    ui->latencyTree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    for (int col = 1; col < ui->latencyTree->columnCount(); col++)
+    {
+        ui->latencyTree->header()->setSectionResizeMode(col, QHeaderView::ResizeToContents);
+        ui->latencyTree->headerItem()->setTextAlignment(col, Qt::AlignRight | Qt::AlignVCenter);
+    }
+}
+
+DockDspLoad::~DockDspLoad()
+{
+    delete ui;
+}
+
+/**
+ * @brief Show a new DSP load sample.
+ * @param vfos Load of the shared blocks (vfo = -1) and of every VFO.
+ * @param blocks Load of every block.
+ * @param work_time Whether the block work time is available.
+ *
+ * Rows are updated in place, so that expanded VFOs stay expanded.
+ */
+void DockDspLoad::setDspLoad(const std::vector<dsp_load_vfo> &vfos,
+                             const std::vector<dsp_load_block> &blocks,
+                             bool work_time)
+{
+    QSet<int> groups;
+    double total = 0.0;
+    size_t memory = 0;
+
+    for (auto &v : vfos)
+    {
+        QTreeWidgetItem *item = groupItem(v.vfo);
+
+        setRow(item, (v.vfo < 0) ? tr("Shared") : tr("VFO %1").arg(v.vfo),
+               v.load, v.items_per_sec, v.buffer_full, v.memory, work_time);
+        groups.insert(v.vfo);
+        total += v.load;
+        memory += v.memory;
+    }
+
+    // Drop VFOs, that have been removed or switched off
+    for (int i = ui->loadTree->topLevelItemCount() - 1; i >= 0; i--)
+        if (!groups.contains(ui->loadTree->topLevelItem(i)->data(0, Qt::UserRole).toInt()))
+            delete ui->loadTree->takeTopLevelItem(i);
+
+    QMap<int, int> rows;
+    for (auto &b : blocks)
+    {
+        QTreeWidgetItem *item = groupItem(b.vfo);
+        int row = rows[b.vfo]++;
+        QTreeWidgetItem *child = (row < item->childCount()) ? item->child(row)
+                                                            : new QTreeWidgetItem(item);
+
+        setRow(child, QString::fromStdString(b.name), b.load, b.items_per_sec,
+               b.buffer_full, b.memory, work_time);
+    }
+    for (int i = 0; i < ui->loadTree->topLevelItemCount(); i++)
+    {
+        QTreeWidgetItem *item = ui->loadTree->topLevelItem(i);
+        int used = rows.value(item->data(0, Qt::UserRole).toInt());
+        while (item->childCount() > used)
+            delete item->takeChild(item->childCount() - 1);
+    }
+
+    if (work_time)
+        ui->totalLabel->setText(tr("Total: %1 % of one CPU core, %2 memory")
+                                .arg(total * 100.0, 0, 'f', 1).arg(formatBytes(memory)));
+    else
+        ui->totalLabel->setText(tr("Work time not available, GNU Radio performance "
+                                   "counters are turned off or not built in. Memory: %1")
+                                .arg(formatBytes(memory)));
+}
+
+/** Clear the view, e.g. when the DSP is stopped. */
+void DockDspLoad::clearDspLoad()
+{
+    ui->loadTree->clear();
+    ui->latencyTree->clear();
+    ui->totalLabel->setText(tr("DSP stopped"));
+}
+
+/** Find or create the top level row of a VFO, ordered by VFO index. */
+QTreeWidgetItem *DockDspLoad::groupItem(int vfo)
+{
+    int i;
+
+    for (i = 0; i < ui->loadTree->topLevelItemCount(); i++)
+    {
+        int item_vfo = ui->loadTree->topLevelItem(i)->data(0, Qt::UserRole).toInt();
+        if (item_vfo == vfo)
+            return ui->loadTree->topLevelItem(i);
+        if (item_vfo > vfo)
+            break;
+    }
+
+    auto *item = new QTreeWidgetItem();
+    item->setData(0, Qt::UserRole, vfo);
+    ui->loadTree->insertTopLevelItem(i, item);
+    return item;
+}
+
+QString DockDspLoad::formatBytes(size_t bytes)
+{
+    if (bytes >= (size_t(1) << 20))
+        return QString("%1 MiB").arg(bytes / 1048576.0, 0, 'f', 1);
+    return QString("%1 KiB").arg(bytes / 1024.0, 0, 'f', 0);
+}
+
+void DockDspLoad::setRow(QTreeWidgetItem *item, const QString &name, double load,
+                         double rate, float buffer_full, size_t memory, bool work_time)
+{
+    QString rate_str;
+
+    if (rate >= 1e6)
+        rate_str = QString("%1 M").arg(rate * 1e-6, 0, 'f', 2);
+    else if (rate >= 1e3)
+        rate_str = QString("%1 k").arg(rate * 1e-3, 0, 'f', 1);
+    else
+        rate_str = QString::number(rate, 'f', 0);
+
+    item->setText(0, name);
+    item->setText(1, work_time ? QString("%1 %").arg(load * 100.0, 0, 'f', 1) : QString("-"));
+    item->setText(2, rate_str);
+    item->setText(3, QString("%1 %").arg(qRound(buffer_full * 100.f)));
+    item->setText(4, formatBytes(memory));
+    for (int col = 1; col < 5; col++)
+        item->setTextAlignment(col, Qt::AlignRight | Qt::AlignVCenter);
+}
+
+/**
+ * @brief Show the latency of every stage.
+ * @param stages As returned by receiver::get_latency().
+ */
+void DockDspLoad::setLatency(const std::vector<latency_stage> &stages)
+{
+    auto ms = [](double t) {
+        return (t < 0.0) ? QString("-") : QString::number(t * 1e3, 'f', 1);
+    };
+
+    while (ui->latencyTree->topLevelItemCount() > int(stages.size()))
+        delete ui->latencyTree->takeTopLevelItem(ui->latencyTree->topLevelItemCount() - 1);
+
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        const latency_stage &st = stages[i];
+        QTreeWidgetItem *item = ui->latencyTree->topLevelItem(i);
+        QString name;
+
+        if (!item)
+            item = new QTreeWidgetItem(ui->latencyTree);
+
+        if (st.name == "input")
+            name = tr("Input");
+        else if (st.name == "channelizer")
+            name = tr("Channelizer");
+        else if (st.name == "vfo")
+            name = tr("VFO %1").arg(st.vfo);
+        else if (st.name == "mixer")
+            name = tr("Audio mixer");
+        else if (st.name == "audio")
+            name = tr("Audio output");
+        else
+            name = QString::fromStdString(st.name);
+
+        item->setText(0, name);
+        item->setText(1, ms(st.total));
+        item->setText(2, ms(st.stage));
+        item->setText(3, ms(st.total < 0.0 ? -1.0 : st.max));
+        item->setText(4, ms(st.budget));
+        for (int col = 1; col < 5; col++)
+            item->setTextAlignment(col, Qt::AlignRight | Qt::AlignVCenter);
+    }
+}
+
+/** Set the latency probe checkbox, e.g. from the remote control. */
+void DockDspLoad::setLatencyProbes(bool enabled)
+{
+    ui->latencyCheckBox->setChecked(enabled);
+}
+
+void DockDspLoad::on_latencyCheckBox_toggled(bool checked)
+{
+    emit latencyProbesToggled(checked);
+}
+
+/** Select the latency profile, e.g. from the remote control. */
+void DockDspLoad::setLatencyProfile(int profile)
+{
+    ui->latencyProfileCombo->setCurrentIndex(profile);
+}
+
+void DockDspLoad::on_latencyProfileCombo_currentIndexChanged(int index)
+{
+    emit latencyProfileChanged(index);
+}
+
+void DockDspLoad::saveSettings(QSettings *settings)
+{
+    if (!settings)
+        return;
+
+    settings->beginGroup("dsp_load");
+    if (ui->latencyProfileCombo->currentIndex() != 0)
+        settings->setValue("latency_profile", ui->latencyProfileCombo->currentIndex());
+    else
+        settings->remove("latency_profile");
+    settings->endGroup();
+}
+
+void DockDspLoad::readSettings(QSettings *settings)
+{
+    bool conv_ok = false;
+    int  intval;
+
+    if (!settings)
+        return;
+
+    settings->beginGroup("dsp_load");
+    intval = settings->value("latency_profile", 0).toInt(&conv_ok);
+    if (conv_ok && intval >= 0 && intval < ui->latencyProfileCombo->count())
+        setLatencyProfile(intval);
+    settings->endGroup();
+}
@@ -0,0 +1,79 @@
+/* -*- c++ -*- */
+/*
+ * Gqrx SDR: Software defined radio receiver powered by GNU Radio and Qt
+ *           https://gqrx.dk/
+ *
+ * Copyright 2011-2016 Alexandru Csete OZ9AEC.
+ *
+ * Gqrx is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * Gqrx is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Gqrx; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+#ifndef DOCKDSPLOAD_H
+#define DOCKDSPLOAD_H
+
+#include <QDockWidget>
+#include <QSettings>
+#include <QTreeWidgetItem>
+#include <vector>
+#include "dsp/dsp_load.h"
+#include "dsp/latency_probe.h"
+
+namespace Ui {
+    class DockDspLoad;
+}
+
+
+/*! \brief Dock widget showing the DSP load of the shared blocks and every VFO,
+ *         and optionally the latency of every stage. */
+class DockDspLoad : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DockDspLoad(QWidget *parent = 0);
+    ~DockDspLoad();
+
+    void setDspLoad(const std::vector<dsp_load_vfo> &vfos,
+                    const std::vector<dsp_load_block> &blocks,
+                    bool work_time);
+    void clearDspLoad();
+    void setLatency(const std::vector<latency_stage> &stages);
+
+    void saveSettings(QSettings *settings);
+    void readSettings(QSettings *settings);
+
+public slots:
+    void setLatencyProbes(bool enabled);
+    void setLatencyProfile(int profile);
+
+signals:
+    void latencyProbesToggled(bool enabled);
+    void latencyProfileChanged(int profile);
+
+private slots:
+    void on_latencyCheckBox_toggled(bool checked);
+    void on_latencyProfileCombo_currentIndexChanged(int index);
+
+private:
+    QTreeWidgetItem *groupItem(int vfo);
+    void setRow(QTreeWidgetItem *item, const QString &name, double load,
+                double rate, float buffer_full, size_t memory, bool work_time);
+    static QString formatBytes(size_t bytes);
+
+private:
+    Ui::DockDspLoad *ui;
+};
+
+#endif // DOCKDSPLOAD_H
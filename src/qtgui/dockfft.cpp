@@ -28,17 +28,13 @@
 #include <thread>
 #include "dockfft.h"
 #include "ui_dockfft.h"
+#include "dsp/rx_fft.h"
 
 #define DEFAULT_FFT_MAX_DB     -20
 #define DEFAULT_FFT_MIN_DB     -120
-#define DEFAULT_FFT_RATE        25
-#define DEFAULT_FFT_SIZE        8192
 #define DEFAULT_FFT_ZOOM        1
-#define DEFAULT_FFT_WINDOW      1       // Hann
-#define DEFAULT_FFT_WINDOW_CORRECTION 1       // Amplitude
 #define DEFAULT_WATERFALL_SPAN  0       // Auto
 #define DEFAULT_FFT_SPLIT       35
-#define DEFAULT_FFT_AVG         0
 #define DEFAULT_COLORMAP        "gqrx"
 
 DockFft::DockFft(QWidget *parent) :
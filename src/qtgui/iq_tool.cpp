@@ -36,6 +36,7 @@
 
 #include "iq_tool.h"
 #include "ui_iq_tool.h"
+#include "interfaces/chunked_iq.h"
 
 
 CIqTool::CIqTool(QWidget *parent) :
@@ -68,7 +69,11 @@ CIqTool::CIqTool(QWidget *parent) :
     for(int k=FILE_FORMAT_CF;k<FILE_FORMAT_COUNT;k++)
         ui->formatCombo->addItem(any_to_any_base::fmt[k].name,k);
     ui->bufferStats->hide();
+    ui->writerStats->hide();
     ui->sizeStats->hide();
+#ifndef __linux__
+    ui->directIo->hide();
+#endif
     sliderMenu = new QMenu(this);
     // marker A
     {
@@ -113,6 +118,14 @@ CIqTool::CIqTool(QWidget *parent) :
         selSave=action;
         selSave->setEnabled(false);
     }
+    // Save selection, converted to another format
+    {
+        selSaveAs = sliderMenu->addMenu("Save as");
+        for(int k=FILE_FORMAT_CF;k<FILE_FORMAT_COUNT;k++)
+            selSaveAs->addAction(any_to_any_base::fmt[k].name)->setData(k);
+        connect(selSaveAs, SIGNAL(triggered(QAction*)), this, SLOT(sliderSaveAs(QAction*)));
+        selSaveAs->menuAction()->setEnabled(false);
+    }
     // Go to marker A
     {
         QAction* action = new QAction("Go to A", this);
@@ -166,8 +179,7 @@ void CIqTool::setSampleRate(qint64 sr)
     if (!current_file.isEmpty())
     {
         // Get duration of selected recording and update label
-        QFileInfo info(*recdir, current_file);
-        rec_len = info.size() * samples_per_chunk / (sample_rate * chunk_size);
+        rec_len = recordingLength(current_file);
         refreshTimeWidgets();
     }
 }
@@ -193,10 +205,9 @@ void CIqTool::on_listWidget_currentTextChanged(const QString &currentText)
 void CIqTool::listWidgetFileSelected(const QString &currentText)
 {
     current_file = currentText;
-    QFileInfo info(*recdir, current_file);
 
     parseFileName(currentText);
-    rec_len = info.size() * samples_per_chunk / (sample_rate * chunk_size);
+    rec_len = recordingLength(current_file);
 
     // Get duration of selected recording and update label
     refreshTimeWidgets();
@@ -224,6 +235,7 @@ void CIqTool::switchControlsState(bool recording, bool playback)
     ui->formatCombo->setEnabled(!(recording || playback));
     ui->repeat->setEnabled(!(recording || playback));
     ui->buffersSpinBox->setEnabled(!(recording || playback));
+    ui->directIo->setEnabled(!(recording || playback));
     setA->setEnabled(playback);
     setB->setEnabled(playback);
     if (recording || playback)
@@ -232,8 +244,10 @@ void CIqTool::switchControlsState(bool recording, bool playback)
         ui->buffersLabel->hide();
         ui->formatCombo->hide();
         ui->buffersSpinBox->hide();
+        ui->directIo->hide();
         ui->bufferStats->show();
         ui->sizeStats->show();
+        o_buffersHwm = -1;
     }
     else
     {
@@ -241,7 +255,11 @@ void CIqTool::switchControlsState(bool recording, bool playback)
         ui->buffersLabel->show();
         ui->formatCombo->show();
         ui->buffersSpinBox->show();
+#ifdef __linux__
+        ui->directIo->show();
+#endif
         ui->bufferStats->hide();
+        ui->writerStats->hide();
         ui->sizeStats->hide();
     }
 }
@@ -322,7 +340,8 @@ void CIqTool::on_recButton_clicked(bool checked)
     if (checked)
     {
         switchControlsState(true, false);
-        emit startRecording(recdir->path(), rec_fmt, ui->buffersSpinBox->value());
+        emit startRecording(recdir->path(), rec_fmt, ui->buffersSpinBox->value(),
+                            ui->directIo->isChecked());
 
         refreshDir();
         ui->listWidget->setCurrentRow(ui->listWidget->count()-1);
@@ -386,6 +405,20 @@ void CIqTool::updateStats(bool hasFailed, int buffersUsed, size_t fileSize)
     }
  }
 
+/*! \brief Show I/Q recorder buffer high-water mark and write latency. */
+void CIqTool::updateWriterStats(int buffersHwm, float latency, float latencyMax)
+{
+    if (!is_recording || buffersHwm < 0)
+        return;
+    ui->writerStats->setText(QString("Max: %1% %2/%3 ms")
+                             .arg(buffersHwm)
+                             .arg(double(latency), 0, 'f', 1)
+                             .arg(double(latencyMax), 0, 'f', 1));
+    if (o_buffersHwm < 0)
+        ui->writerStats->show();
+    o_buffersHwm = buffersHwm;
+}
+
 void CIqTool::updateSaveProgress(const qint64 save_progress)
 {
     if(save_progress<0)
@@ -434,6 +467,14 @@ void CIqTool::saveSettings(QSettings *settings)
         settings->remove("baseband/rec_dir");
     settings->setValue("baseband/rec_fmt", rec_fmt);
     settings->setValue("baseband/rec_buffers", ui->buffersSpinBox->value());
+    if (ui->speedCombo->currentIndex() > 0)
+        settings->setValue("baseband/play_speed", ui->speedCombo->currentIndex());
+    else
+        settings->remove("baseband/play_speed");
+    if (ui->directIo->isChecked())
+        settings->setValue("baseband/rec_direct_io", true);
+    else
+        settings->remove("baseband/rec_direct_io");
 }
 
 void CIqTool::readSettings(QSettings *settings)
@@ -454,6 +495,9 @@ void CIqTool::readSettings(QSettings *settings)
         ui->formatCombo->setCurrentIndex(found);
     }
     ui->buffersSpinBox->setValue(settings->value("baseband/rec_buffers", 1).toInt());
+    ui->directIo->setChecked(settings->value("baseband/rec_direct_io", false).toBool());
+    ui->speedCombo->setCurrentIndex(settings->value("baseband/play_speed", 0).toInt());
+    emit playbackSpeedChanged(playbackSpeed());
 }
 
 
@@ -534,6 +578,23 @@ void CIqTool::on_formatCombo_currentIndexChanged(int index)
     rec_fmt = (file_formats)ui->formatCombo->currentData().toInt();
 }
 
+/*! \brief Speed multipliers of the speedCombo items, 0 = unlimited. */
+double CIqTool::playbackSpeed() const
+{
+    static const double speeds[] = {1.0, 2.0, 4.0, 8.0, 0.0};
+    int index = ui->speedCombo->currentIndex();
+
+    if (index < 0 || index >= (int)(sizeof(speeds) / sizeof(speeds[0])))
+        return 1.0;
+    return speeds[index];
+}
+
+void CIqTool::on_speedCombo_currentIndexChanged(int index)
+{
+    Q_UNUSED(index);
+    emit playbackSpeedChanged(playbackSpeed());
+}
+
 void CIqTool::updateSliderStylesheet(qint64 save_progress)
 {
     if((sel_A<0.0)&&(sel_B<0.0))
@@ -543,6 +604,7 @@ void CIqTool::updateSliderStylesheet(qint64 save_progress)
         setB->setText("B");
         selSave->setText("Save");
         selSave->setEnabled(false);
+        selSaveAs->menuAction()->setEnabled(false);
         goA->setEnabled(false);
         goB->setEnabled(false);
         setA->setEnabled(true);
@@ -580,6 +642,7 @@ void CIqTool::updateSliderStylesheet(qint64 save_progress)
         setB->setEnabled(true);
         if(sel_A * double(rec_len) >= 1.0)
             selSave->setEnabled(true);
+            selSaveAs->menuAction()->setEnabled(true);
         selReset->setEnabled(true);
     }
     if(save_progress>0)
@@ -634,6 +697,7 @@ void CIqTool::updateSliderStylesheet(qint64 save_progress)
             );
         if(sel_A * double(rec_len) >= 1.0)
             selSave->setEnabled(true);
+            selSaveAs->menuAction()->setEnabled(true);
     }
 }
 
@@ -673,6 +737,17 @@ void CIqTool::sliderReset()
 }
 
 void CIqTool::sliderSave()
+{
+    saveSelection(fmt);
+}
+
+void CIqTool::sliderSaveAs(QAction *action)
+{
+    saveSelection(file_formats(action->data().toInt()));
+}
+
+/*! \brief Extract the selection to a new file in out_fmt format. */
+void CIqTool::saveSelection(file_formats out_fmt)
 {
     if(sel_A<0.0)
         return;
@@ -681,11 +756,12 @@ void CIqTool::sliderSave()
     quint64 len_ms=(sel_B-sel_A)*double(rec_len)*1000.0;
     if(len_ms<1.0)
         len_ms=1.0;
-    emit saveFileRange(extractDir->path(), fmt, from_ms, len_ms);
+    emit saveFileRange(extractDir->path(), fmt, out_fmt, from_ms, len_ms);
     updateSliderStylesheet(0);
     setA->setEnabled(false);
     setB->setEnabled(false);
     selSave->setEnabled(false);
+    selSaveAs->menuAction()->setEnabled(false);
     selReset->setEnabled(false);
 }
 
@@ -716,9 +792,28 @@ void CIqTool::refreshDir()
     {
         // update rec_len; if the file being recorded is the one selected
         // in the list, the length will update periodically
-        QFileInfo info(*recdir, current_file);
-        rec_len = (int)(info.size() * samples_per_chunk / (sample_rate * chunk_size));
+        if (fmt == FILE_FORMAT_CS16Z)
+            // the chunk index is written at the end of the recording
+            rec_len = (int)(o_fileSize * samples_per_chunk / sample_rate);
+        else
+            rec_len = recordingLength(current_file);
+    }
+}
+
+/*! \brief Get duration of a recording in seconds. */
+qint64 CIqTool::recordingLength(const QString &filename)
+{
+    QFileInfo info(*recdir, filename);
+    uint64_t items = 0;
+
+    // compressed file size does not tell the number of samples
+    if (fmt == FILE_FORMAT_CS16Z)
+    {
+        if (!chunked_iq::probe(info.absoluteFilePath().toStdString(), &items))
+            return 0;
+        return items * samples_per_chunk / sample_rate;
     }
+    return info.size() * samples_per_chunk / (sample_rate * chunk_size);
 }
 
 /*! \brief Refresh time labels and slider position
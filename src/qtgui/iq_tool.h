@@ -67,19 +67,21 @@ public:
 
 signals:
     void startRecording(const QString recdir, file_formats fmt,
-                        int buffers_max);
+                        int buffers_max, bool direct_io);
     void stopRecording();
     void startPlayback(const QString filename, float samprate,
                        qint64 center_freq, file_formats fmt,
                        qint64 time_ms, int buffers_max, bool repeat);
     void stopPlayback();
+    void playbackSpeedChanged(double speed);
     void seek(qint64 seek_pos);
-    void saveFileRange(const QString &, file_formats, quint64,quint64);
+    void saveFileRange(const QString &, file_formats, file_formats, quint64,quint64);
 
 public slots:
     void cancelRecording();
     void cancelPlayback();
     void updateStats(bool hasFailed, int buffersUsed, size_t fileSize);
+    void updateWriterStats(int buffersHwm, float latency, float latencyMax);
     void updateSaveProgress(const qint64 save_progress);
     void setRunningState(bool);
 
@@ -92,11 +94,13 @@ private slots:
     void on_listWidget_currentTextChanged(const QString &currentText);
     void timeoutFunction(void);
     void on_formatCombo_currentIndexChanged(int index);
+    void on_speedCombo_currentIndexChanged(int index);
     void on_slider_customContextMenuRequested(const QPoint& pos);
     void sliderA();
     void sliderB();
     void sliderReset();
     void sliderSave();
+    void sliderSaveAs(QAction *action);
     void sliderGoA();
     void sliderGoB();
     void sliderSetExtractDir();
@@ -105,9 +109,12 @@ private:
     void refreshDir(void);
     void refreshTimeWidgets(void);
     void parseFileName(const QString &filename);
+    qint64 recordingLength(const QString &filename);
     void switchControlsState(bool recording, bool playback);
     void updateSliderStylesheet(qint64 save_progress = -2);
     void listWidgetFileSelected(const QString &currentText);
+    void saveSelection(file_formats out_fmt);
+    double playbackSpeed() const;
 
 private:
     Ui::CIqTool *ui;
@@ -122,6 +129,7 @@ private:
     QAction     *setA;
     QAction     *setB;
     QAction     *selSave;
+    QMenu       *selSaveAs;
     QAction     *selReset;
     QAction     *goA;
     QAction     *goB;
@@ -142,6 +150,7 @@ private:
     qint64  center_freq;       /*!< Center frequency. */
     qint64  rec_len;           /*!< Length of a recording in seconds */
     int     o_buffersUsed{0};
+    int     o_buffersHwm{-1};
     size_t  o_fileSize{0};
 };
 
@@ -21,6 +21,7 @@
  * the Free Software Foundation, Inc., 51 Franklin Street,
  * Boston, MA 02110-1301, USA.
  */
+#include <cctype>
 #include "receivers/defines.h"
 #include "receivers/modulations.h"
 
@@ -43,24 +44,33 @@ static constexpr Modulations::idx old2new[] = {
     Modulations::MODE_AM_SYNC
 };
 
-bool Modulations::IsModulationValid(QString strModulation)
+/* Compare the names of modes ignoring the case. */
+static bool SameModulationName(const std::string &a, const char *b)
+{
+    size_t k = 0;
+
+    for (; k < a.size() && b[k]; k++)
+        if (std::tolower((unsigned char)a[k]) != std::tolower((unsigned char)b[k]))
+            return false;
+    return k == a.size() && !b[k];
+}
+
+bool Modulations::IsModulationValid(const std::string &strModulation)
 {
     for(auto & mode: modes)
     {
-        const QString& strModulation = mode.name;
-        if (strModulation.compare(strModulation, Qt::CaseInsensitive) == 0)
+        if (SameModulationName(strModulation, mode.name))
             return true;
     }
     return false;
 }
 
-Modulations::idx Modulations::GetEnumForModulationString(QString param)
+Modulations::idx Modulations::GetEnumForModulationString(const std::string &param)
 {
     int iModulation = -1;
     for(int i = 0; i < Modulations::MODE_COUNT; ++i)
     {
-        const QString& strModulation = modes[i].name;
-        if (param.compare(strModulation, Qt::CaseInsensitive) == 0)
+        if (SameModulationName(param, modes[i].name))
         {
             iModulation = i;
             break;
@@ -68,7 +78,7 @@ Modulations::idx Modulations::GetEnumForModulationString(QString param)
     }
     if(iModulation == -1)
     {
-        std::cout << "Modulation '" << param.toStdString() << "' is unknown." << std::endl;
+        std::cout << "Modulation '" << param << "' is unknown." << std::endl;
         iModulation = MODE_OFF;
     }
     return idx(iModulation);
@@ -25,7 +25,7 @@
 #define MODULATIONS_H
 #include <iostream>
 #include <array>
-#include <QStringList>
+#include <string>
 
 //FIXME: Convert to enum?
 #define FILTER_PRESET_WIDE      0
@@ -167,8 +167,8 @@ public:
     {
         return modes[iModulationIndex].name;
     }
-    static bool IsModulationValid(QString strModulation);
-    static idx GetEnumForModulationString(QString param);
+    static bool IsModulationValid(const std::string &strModulation);
+    static idx GetEnumForModulationString(const std::string &param);
     static idx ConvertFromOld(int old);
     static bool GetFilterPreset(idx iModulationIndex, int preset, int& low, int& high);
     static int FindFilterPreset(idx mode_index, int lo, int hi);
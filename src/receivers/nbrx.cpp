@@ -22,7 +22,6 @@
  */
 #include <cmath>
 #include <iostream>
-#include <QDebug>
 #include "receivers/nbrx.h"
 
 
@@ -38,12 +37,7 @@ nbrx::nbrx(double quad_rate, float audio_rate)
 
     nb = make_rx_nb_cc((double)NB_PREF_QUAD_RATE, 3.3, 2.5);
     filter = make_rx_filter((double)NB_PREF_QUAD_RATE, -5000.0, 5000.0, 1000.0);
-    demod_raw = gr::blocks::complex_to_float::make(1);
-    demod_ssb = gr::blocks::complex_to_real::make(1);
-    demod_fm = make_rx_demod_fm(NB_PREF_QUAD_RATE, 5000.0, 75.0e-6);
-    demod_fmpll = make_rx_demod_fmpll(NB_PREF_QUAD_RATE, 5000.0, 0.1);
-    demod_am = make_rx_demod_am(NB_PREF_QUAD_RATE, true);
-    demod_amsync = make_rx_demod_amsync(NB_PREF_QUAD_RATE, true, 0.001);
+    // Demodulators are built in set_demod(), when they are used first
 
     // Width of rx_filter can be adjusted at run time, so the input buffer (the
     // output buffer of nb) needs to be large enough for the longest history
@@ -61,12 +55,11 @@ nbrx::nbrx(double quad_rate, float audio_rate)
         audio_rr1 = make_resampler_ff(d_audio_rate/NB_PREF_QUAD_RATE);
     }
 
-    demod = demod_raw;
+    demod.reset();
     connect(ddc, 0, iq_resamp, 0);
     connect(iq_resamp, 0, nb, 0);
     connect(nb, 0, filter, 0);
-    connect(filter, 0, meter, 0);
-    connect(filter, 0, sql, 0);
+    connect(filter, 0, pwr, 0);
 }
 
 bool nbrx::start()
@@ -85,14 +78,12 @@ bool nbrx::stop()
 
 void nbrx::set_audio_rate(int audio_rate)
 {
-    qDebug() << "Changing NB_RX audio rate:"  << d_audio_rate << "->" << audio_rate;
     receiver_base_cf::set_audio_rate(audio_rate);
     if (audio_rr0 && (std::abs(d_audio_rate - d_pref_quad_rate) < 0.1f))
     {
         if (d_demod != Modulations::MODE_OFF)
         {
             lock();
-            qDebug() << "nbrx::set_audio_rate Bypassing resampler ";
             disconnect(demod, 0, audio_rr0, 0);
             disconnect(audio_rr0, 0, output, 0); // left  channel
             if (d_demod == Modulations::MODE_RAW)
@@ -126,11 +117,10 @@ void nbrx::set_audio_rate(int audio_rate)
                 disconnect(demod, 1, output, 1);
             else
                 disconnect(demod, 0, output, 1);
-            qDebug() << "nbrx::set_audio_rate Resampling audio " << d_pref_quad_rate << " -> "
-                    << d_audio_rate;
         }
         audio_rr0 = make_resampler_ff(d_audio_rate / d_pref_quad_rate);
         audio_rr1 = make_resampler_ff(d_audio_rate / d_pref_quad_rate);
+        set_latency_profile(d_latency_profile);
         if (d_demod != Modulations::MODE_OFF)
         {
             connect(demod, 0, audio_rr0, 0);
@@ -146,8 +136,6 @@ void nbrx::set_audio_rate(int audio_rate)
         }
         return;
     }
-    qDebug() << "nbrx::set_audio_rate rate=" << d_audio_rate << " demod=" <<
-                    d_demod;
     if (audio_rr0)
     {
         audio_rr0->set_rate(d_audio_rate / d_pref_quad_rate);
@@ -156,6 +144,26 @@ void nbrx::set_audio_rate(int audio_rate)
     }
 }
 
+void nbrx::set_latency_profile(latency_profile profile)
+{
+    receiver_base_cf::set_latency_profile(profile);
+
+    // The noise blanker keeps its large buffer, the filter history needs it
+    int max_buffer = latency_buffer_items(profile, NB_PREF_QUAD_RATE);
+    filter->set_max_output_buffer(max_buffer);
+    d_latency_budget += latency_block_time(1, max_buffer, sizeof(gr_complex), NB_PREF_QUAD_RATE);
+
+    if (audio_rr0)
+    {
+        int multiple = latency_batch_items(profile, d_audio_rate, 1);
+
+        max_buffer = latency_buffer_items(profile, d_audio_rate);
+        audio_rr0->set_buffering(multiple, max_buffer);
+        audio_rr1->set_buffering(multiple, max_buffer);
+        d_latency_budget += latency_block_time(multiple, max_buffer, sizeof(float), d_audio_rate);
+    }
+}
+
 void nbrx::set_filter(int low, int high, int tw)
 {
     receiver_base_cf::set_filter(low, high, tw);
@@ -241,7 +249,7 @@ void nbrx::set_demod(Modulations::idx new_demod)
 
     if (current_demod > Modulations::MODE_OFF)
     {
-        disconnect(sql, 0, demod, 0);
+        disconnect(pwr, 0, demod, 0);
         if (audio_rr0)
         {
             if (current_demod == Modulations::MODE_RAW)
@@ -275,41 +283,17 @@ void nbrx::set_demod(Modulations::idx new_demod)
         }
     }
 
-    switch (new_demod) {
-
-    case Modulations::MODE_RAW:
-    case Modulations::MODE_OFF:
-        demod = demod_raw;
-        break;
-
-    case Modulations::MODE_LSB:
-    case Modulations::MODE_USB:
-    case Modulations::MODE_CWL:
-    case Modulations::MODE_CWU:
-        demod = demod_ssb;
-        break;
-
-    case Modulations::MODE_AM:
-        demod = demod_am;
-        break;
-
-    case Modulations::MODE_AM_SYNC:
-        demod = demod_amsync;
-        break;
-
-    case Modulations::MODE_NFMPLL:
-        demod = demod_fmpll;
-        break;
+    if (current_demod > Modulations::MODE_OFF)
+        d_demod_used[get_demod_kind(current_demod)] = demod_now();
 
-    case Modulations::MODE_NFM:
-    default:
-        demod = demod_fm;
-        break;
-    }
+    if (new_demod > Modulations::MODE_OFF)
+        demod = get_demod_block(get_demod_kind(new_demod));
+    else
+        demod.reset();
 
     if (new_demod > Modulations::MODE_OFF)
     {
-        connect(sql, 0, demod, 0);
+        connect(pwr, 0, demod, 0);
         if (audio_rr0)
         {
             if (new_demod == Modulations::MODE_RAW)
@@ -357,25 +341,149 @@ void nbrx::set_demod(Modulations::idx new_demod)
         ddc->set_center_freq(get_offset());
         filter->set_cw_offset(0);
     }
+    release_idle_demods();
+}
+
+nbrx::demod_kind nbrx::get_demod_kind(Modulations::idx demod)
+{
+    switch (demod) {
+
+    case Modulations::MODE_RAW:
+    case Modulations::MODE_OFF:
+        return DEMOD_RAW;
+
+    case Modulations::MODE_LSB:
+    case Modulations::MODE_USB:
+    case Modulations::MODE_CWL:
+    case Modulations::MODE_CWU:
+        return DEMOD_SSB;
+
+    case Modulations::MODE_AM:
+        return DEMOD_AM;
+
+    case Modulations::MODE_AM_SYNC:
+        return DEMOD_AMSYNC;
+
+    case Modulations::MODE_NFMPLL:
+        return DEMOD_FMPLL;
+
+    case Modulations::MODE_NFM:
+    default:
+        return DEMOD_FM;
+    }
+}
+
+/**
+ * @brief Get a demodulator, build it if it is not cached.
+ *
+ * A new demodulator gets the current settings of the VFO, because the
+ * setters only update the demodulators, that exist.
+ */
+gr::basic_block_sptr nbrx::get_demod_block(demod_kind kind)
+{
+    switch (kind) {
+
+    case DEMOD_RAW:
+        if (!demod_raw)
+            demod_raw = gr::blocks::complex_to_float::make(1);
+        return demod_raw;
+
+    case DEMOD_SSB:
+        if (!demod_ssb)
+            demod_ssb = gr::blocks::complex_to_real::make(1);
+        return demod_ssb;
+
+    case DEMOD_AM:
+        if (!demod_am)
+            demod_am = make_rx_demod_am(NB_PREF_QUAD_RATE, get_am_dcr());
+        return demod_am;
+
+    case DEMOD_AMSYNC:
+        if (!demod_amsync)
+            demod_amsync = make_rx_demod_amsync(NB_PREF_QUAD_RATE, get_amsync_dcr(),
+                                                get_pll_bw());
+        return demod_amsync;
+
+    case DEMOD_FMPLL:
+        if (!demod_fmpll)
+        {
+            demod_fmpll = make_rx_demod_fmpll(NB_PREF_QUAD_RATE, get_fm_maxdev(),
+                                              get_pll_bw());
+            demod_fmpll->set_damping_factor((double)get_fmpll_damping_factor());
+            if (get_subtone_filter())
+                demod_fmpll->set_subtone_filter(true);
+        }
+        return demod_fmpll;
+
+    case DEMOD_FM:
+    default:
+        if (!demod_fm)
+        {
+            demod_fm = make_rx_demod_fm(NB_PREF_QUAD_RATE, get_fm_maxdev(),
+                                        get_fm_deemph() * 1.0e-6);
+            if (get_subtone_filter())
+                demod_fm->set_subtone_filter(true);
+        }
+        return demod_fm;
+    }
+}
+
+void nbrx::release_demod(demod_kind kind)
+{
+    switch (kind) {
+    case DEMOD_RAW:
+        demod_raw.reset();
+        break;
+    case DEMOD_SSB:
+        demod_ssb.reset();
+        break;
+    case DEMOD_AM:
+        demod_am.reset();
+        break;
+    case DEMOD_AMSYNC:
+        demod_amsync.reset();
+        break;
+    case DEMOD_FMPLL:
+        demod_fmpll.reset();
+        break;
+    case DEMOD_FM:
+    default:
+        demod_fm.reset();
+        break;
+    }
+}
+
+void nbrx::release_idle_demods()
+{
+    bool on = (get_demod() != Modulations::MODE_OFF);
+    demod_kind in_use = get_demod_kind(get_demod());
+
+    for (int k = 0; k < DEMOD_KIND_COUNT; k++)
+        if ((!on || k != in_use) && demod_idle(d_demod_used[k]))
+            release_demod(demod_kind(k));
 }
 
 void nbrx::set_fm_maxdev(float maxdev_hz)
 {
     receiver_base_cf::set_fm_maxdev(maxdev_hz);
-    demod_fm->set_max_dev(maxdev_hz);
-    demod_fmpll->set_max_dev(maxdev_hz);
+    if (demod_fm)
+        demod_fm->set_max_dev(maxdev_hz);
+    if (demod_fmpll)
+        demod_fmpll->set_max_dev(maxdev_hz);
 }
 
 void nbrx::set_fm_deemph(double tau)
 {
     receiver_base_cf::set_fm_deemph(tau);
-    demod_fm->set_tau(tau * 1.0e-6);
+    if (demod_fm)
+        demod_fm->set_tau(tau * 1.0e-6);
 }
 
 void nbrx::set_fmpll_damping_factor(float df)
 {
     receiver_base_cf::set_fmpll_damping_factor(df);
-    demod_fmpll->set_damping_factor((double)df);
+    if (demod_fmpll)
+        demod_fmpll->set_damping_factor((double)df);
 }
 
 void nbrx::set_subtone_filter(bool state)
@@ -385,8 +493,10 @@ void nbrx::set_subtone_filter(bool state)
         receiver_base_cf::set_subtone_filter(state);
         if(get_demod() != Modulations::MODE_OFF)
             lock();
-        demod_fmpll->set_subtone_filter(state);
-        demod_fm->set_subtone_filter(state);
+        if (demod_fmpll)
+            demod_fmpll->set_subtone_filter(state);
+        if (demod_fm)
+            demod_fm->set_subtone_filter(state);
         if(get_demod() != Modulations::MODE_OFF)
             unlock();
     }
@@ -397,7 +507,8 @@ void nbrx::set_am_dcr(bool enabled)
     receiver_base_cf::set_am_dcr(enabled);
     if(get_demod() != Modulations::MODE_OFF)
         lock();
-    demod_am->set_dcr(enabled);
+    if (demod_am)
+        demod_am->set_dcr(enabled);
     if(get_demod() != Modulations::MODE_OFF)
         unlock();
 }
@@ -407,7 +518,8 @@ void nbrx::set_amsync_dcr(bool enabled)
     receiver_base_cf::set_amsync_dcr(enabled);
     if(get_demod() != Modulations::MODE_OFF)
         lock();
-    demod_amsync->set_dcr(enabled);
+    if (demod_amsync)
+        demod_amsync->set_dcr(enabled);
     if(get_demod() != Modulations::MODE_OFF)
         unlock();
 }
@@ -415,6 +527,8 @@ void nbrx::set_amsync_dcr(bool enabled)
 void nbrx::set_pll_bw(float pll_bw)
 {
     receiver_base_cf::set_pll_bw(pll_bw);
-    demod_amsync->set_pll_bw(pll_bw);
-    demod_fmpll->set_pll_bw(pll_bw);
+    if (demod_amsync)
+        demod_amsync->set_pll_bw(pll_bw);
+    if (demod_fmpll)
+        demod_fmpll->set_pll_bw(pll_bw);
 }
@@ -62,6 +62,7 @@ public:
     void set_cw_offset(int offset) override;
 
     void set_audio_rate(int audio_rate) override;
+    void set_latency_profile(latency_profile profile) override;
 
     /* Noise blanker */
     bool has_nb() override { return true; }
@@ -83,8 +84,27 @@ public:
     void set_amsync_dcr(bool enabled) override;
     void set_pll_bw(float pll_bw) override;
 
+    void release_idle_demods() override;
+
+private:
+    /*! \brief Demodulator blocks, built on first use. */
+    enum demod_kind {
+        DEMOD_RAW = 0,
+        DEMOD_SSB,
+        DEMOD_AM,
+        DEMOD_AMSYNC,
+        DEMOD_FM,
+        DEMOD_FMPLL,
+        DEMOD_KIND_COUNT
+    };
+
+    static demod_kind get_demod_kind(Modulations::idx demod);
+    gr::basic_block_sptr get_demod_block(demod_kind kind);
+    void release_demod(demod_kind kind);
+
 private:
     bool   d_running;          /*!< Whether receiver is running or not. */
+    demod_time d_demod_used[DEMOD_KIND_COUNT]; /*!< When each demodulator was last in use. */
 
     rx_filter_sptr            filter;  /*!< Non-translating bandpass filter.*/
 
@@ -98,7 +118,7 @@ private:
     resampler_ff_sptr         audio_rr0;  /*!< Audio resampler. */
     resampler_ff_sptr         audio_rr1;  /*!< Audio resampler. */
 
-    gr::basic_block_sptr      demod;    // dummy pointer used for simplifying reconf
+    gr::basic_block_sptr      demod;    // dummy pointer used for simplifying reconf, null if off
 };
 
 #endif // NBRX_H
@@ -22,11 +22,11 @@
  */
 #include <gnuradio/io_signature.h>
 #include "receivers/receiver_base.h"
-#include <QDebug>
-#include <QDateTime>
-#include <QDir>
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <exception>
+#include <iostream>
 
 static const int MIN_IN = 1;  /* Minimum number of input streams. */
 static const int MAX_IN = 1;  /* Maximum number of input streams. */
@@ -49,7 +49,9 @@ receiver_base_cf::receiver_base_cf(std::string src_name, float pref_quad_rate, d
       d_audio_filename(""),
       d_udp_streaming(false),
       d_dedicated_audio_sink(false),
-      d_audio_dev("")
+      d_audio_dev(""),
+      d_latency_profile(LATENCY_PROFILE_THROUGHPUT),
+      d_latency_budget(0.0)
 {
     d_ddc_decim = std::max(1, (int)(d_decim_rate / TARGET_QUAD_RATE));
     d_quad_rate = d_decim_rate / d_ddc_decim;
@@ -60,12 +62,11 @@ receiver_base_cf::receiver_base_cf(std::string src_name, float pref_quad_rate, d
     agc = make_rx_agc_2f(d_audio_rate, d_agc_on, d_agc_target_level,
                          d_agc_manual_gain, d_agc_max_gain, d_agc_attack_ms,
                          d_agc_decay_ms, d_agc_hang_ms, d_agc_panning);
-    sql = make_rx_sql_cc(d_level_db, d_alpha);
-    meter = make_rx_meter_c((double)d_pref_quad_rate);
+    pwr = make_rx_power_cc((double)d_pref_quad_rate, d_level_db, d_alpha);
     wav_sink = wavfile_sink_gqrx::make(0, 2, (unsigned int) d_audio_rate,
                                        wavfile_sink_gqrx::FORMAT_WAV,
                                        wavfile_sink_gqrx::FORMAT_PCM_16);
-    audio_udp_sink = make_udp_sink_f();
+    audio_udp_sink = make_udp_sink_f(d_audio_rate);
     audio_rnnoise =  make_rx_rnnoise_f(audio_rate);
 
     output = audio_rnnoise;
@@ -92,7 +93,6 @@ void receiver_base_cf::set_demod(Modulations::idx demod)
 {
     if ((get_demod() == Modulations::MODE_OFF) && (demod != Modulations::MODE_OFF))
     {
-        qDebug() << "Changing RX quad rate:"  << d_decim_rate << "->" << d_quad_rate;
         lock();
         ddc->set_decim_and_samp_rate(d_ddc_decim, d_decim_rate);
         iq_resamp->set_rate((double)d_pref_quad_rate/d_quad_rate);
@@ -111,12 +111,12 @@ void receiver_base_cf::set_quad_rate(double quad_rate)
         //avoid triggering https://github.com/gnuradio/gnuradio/issues/5436
         if (get_demod() != Modulations::MODE_OFF)
         {
-            qDebug() << "Changing RX quad rate:"  << d_decim_rate << "->" << d_quad_rate;
             lock();
             ddc->set_decim_and_samp_rate(d_ddc_decim, d_decim_rate);
             iq_resamp->set_rate((double)d_pref_quad_rate/d_quad_rate);
             unlock();
         }
+        set_latency_profile(d_latency_profile);
     }
 }
 void receiver_base_cf::set_audio_rate(int audio_rate)
@@ -127,6 +127,7 @@ void receiver_base_cf::set_audio_rate(int audio_rate)
         disconnect(agc, 0, wav_sink, 0);
         disconnect(agc, 1, wav_sink, 1);
         wav_sink->set_sample_rate(audio_rate);
+        audio_udp_sink->set_sample_rate(audio_rate);
         connect(agc, 0, wav_sink, 0);
         connect(agc, 1, wav_sink, 1);
         agc->set_sample_rate(audio_rate);
@@ -139,6 +140,7 @@ void receiver_base_cf::set_audio_rate(int audio_rate)
             connect(agc, 0, audio_snk, 0);
             connect(agc, 1, audio_snk, 1);
         }
+        set_latency_profile(d_latency_profile);
     }
 }
 
@@ -193,7 +195,7 @@ void receiver_base_cf::set_audio_rec_dir(const std::string& dir)
 void receiver_base_cf::set_audio_rec_sql_triggered(bool enabled)
 {
     vfo_s::set_audio_rec_sql_triggered(enabled);
-    sql->set_impl(enabled ? rx_sql_cc::SQL_PWR : rx_sql_cc::SQL_SIMPLE);
+    pwr->set_tags(enabled);
     wav_sink->set_sql_triggered(enabled);
 }
 
@@ -211,7 +213,12 @@ void receiver_base_cf::set_audio_rec_max_gap(const int time_ms)
 
 float receiver_base_cf::get_signal_level()
 {
-    return meter->get_level_db();
+    return pwr->get_level_db();
+}
+
+bool receiver_base_cf::get_sql_open()
+{
+    return pwr->unmuted();
 }
 
 bool receiver_base_cf::has_nb()
@@ -221,13 +228,13 @@ bool receiver_base_cf::has_nb()
 
 void receiver_base_cf::set_sql_level(double level_db)
 {
-    sql->set_threshold(level_db);
+    pwr->set_threshold(level_db);
     vfo_s::set_sql_level(level_db);
 }
 
 void receiver_base_cf::set_sql_alpha(double alpha)
 {
-    sql->set_alpha(alpha);
+    pwr->set_alpha(alpha);
     vfo_s::set_sql_alpha(alpha);
 }
 
@@ -403,6 +410,22 @@ void receiver_base_cf::rec_event(receiver_base_cf * self, std::string filename,
     }
 }
 
+/**
+ * @brief Release the demodulators, that have not been used for DEMOD_IDLE_TIMEOUT.
+ *
+ * Receivers, that build their demodulators on first use, override this.
+ * The demodulator in use is never released.
+ */
+void receiver_base_cf::release_idle_demods()
+{
+}
+
+/** Whether a demodulator, last used at last_used, has been idle long enough. */
+bool receiver_base_cf::demod_idle(const demod_time &last_used)
+{
+    return demod_now() - last_used >= std::chrono::seconds(DEMOD_IDLE_TIMEOUT);
+}
+
 void receiver_base_cf::restore_settings(receiver_base_cf& from)
 {
     vfo_s::restore_settings(from);
@@ -435,3 +458,118 @@ void receiver_base_cf::set_dedicated_audio_sink(bool value)
         }
     }
 }
+
+/**
+ * @brief Connect a latency probe sink to the audio output.
+ *
+ * The probe measures the arrival of the latency tags added at the receiver
+ * input. Takes effect, when the flowgraph is restarted or unlocked.
+ */
+void receiver_base_cf::set_latency_probe(bool enabled)
+{
+    if (enabled == !!latency_probe)
+        return;
+    if (enabled)
+    {
+        latency_probe = make_latency_probe_sink(sizeof(float));
+        connect(agc, 2, latency_probe, 0);
+    }
+    else
+    {
+        disconnect(agc, 2, latency_probe, 0);
+        latency_probe.reset();
+    }
+}
+
+latency_stats receiver_base_cf::get_latency()
+{
+    if (latency_probe)
+        return latency_probe->get();
+    return latency_stats{-1.0, -1.0, -1.0, 0};
+}
+
+/**
+ * @brief Size the batches and output buffers for a latency profile.
+ *
+ * Also updates the latency budget, the longest time a sample can spend in
+ * the blocks of the main signal path. Derived receivers add their blocks.
+ * Takes effect, when the flowgraph is restarted or unlocked.
+ */
+void receiver_base_cf::set_latency_profile(latency_profile profile)
+{
+    int multiple;
+    int max_buffer;
+
+    d_latency_profile = profile;
+
+    multiple = latency_batch_items(profile, d_quad_rate, 0);
+    max_buffer = latency_buffer_items(profile, d_quad_rate);
+    ddc->set_buffering(multiple, max_buffer);
+    d_latency_budget = latency_block_time(ddc->output_multiple(), max_buffer,
+                                          sizeof(gr_complex), d_quad_rate);
+
+    multiple = latency_batch_items(profile, d_pref_quad_rate, RESAMPLER_OUTPUT_MULTIPLE);
+    max_buffer = latency_buffer_items(profile, d_pref_quad_rate);
+    iq_resamp->set_buffering(multiple, max_buffer);
+    d_latency_budget += latency_block_time(multiple, max_buffer, sizeof(gr_complex),
+                                           d_pref_quad_rate);
+
+    max_buffer = latency_buffer_items(profile, d_pref_quad_rate);
+    pwr->set_max_output_buffer(max_buffer);
+    d_latency_budget += latency_block_time(1, max_buffer, sizeof(gr_complex), d_pref_quad_rate);
+
+    max_buffer = latency_buffer_items(profile, d_audio_rate);
+    agc->set_max_output_buffer(max_buffer);
+    d_latency_budget += latency_block_time(1, max_buffer, sizeof(float), d_audio_rate);
+}
+
+/**
+ * @brief Connect an I/Q stream sink.
+ * @param tap The sink, its stage selects the VFO input or the baseband
+ *            after the down-converter and the resampler.
+ *
+ * The taps stay connected, when the VFO is connected to or disconnected
+ * from the flowgraph, samples arrive while the VFO is active.
+ */
+void receiver_base_cf::add_iq_tap(iq_stream_sink_sptr tap)
+{
+    // Only a VFO in the flowgraph can be locked, see set_demod()
+    bool running = (d_port != -1);
+
+    if (running)
+        lock();
+    if (tap->get_stage() == iq_stream_sink::STAGE_INPUT)
+        connect(self(), 0, tap, 0);
+    else
+        connect(iq_resamp, 0, tap, 0);
+    if (running)
+        unlock();
+    d_iq_taps.push_back(tap);
+}
+
+void receiver_base_cf::remove_iq_tap(iq_stream_sink_sptr tap)
+{
+    auto it = std::find(d_iq_taps.begin(), d_iq_taps.end(), tap);
+    bool running = (d_port != -1);
+
+    if (it == d_iq_taps.end())
+        return;
+
+    if (running)
+        lock();
+    if (tap->get_stage() == iq_stream_sink::STAGE_INPUT)
+        disconnect(self(), 0, tap, 0);
+    else
+        disconnect(iq_resamp, 0, tap, 0);
+    if (running)
+        unlock();
+    d_iq_taps.erase(it);
+}
+
+/** Sample rate of an I/Q stream stage. */
+double receiver_base_cf::get_iq_tap_rate(iq_stream_sink::stage where) const
+{
+    if (where == iq_stream_sink::STAGE_INPUT)
+        return d_decim_rate;
+    return d_pref_quad_rate;
+}
@@ -23,22 +23,28 @@
 #ifndef RECEIVER_BASE_H
 #define RECEIVER_BASE_H
 
+#include <chrono>
 #include <gnuradio/hier_block2.h>
 #include <gnuradio/blocks/wavfile_sink.h>
 #include "dsp/resampler_xx.h"
-#include "dsp/rx_meter.h"
 #include "dsp/rx_agc_xx.h"
 #include "dsp/rx_rnnoise.h"
-#include "dsp/rx_squelch.h"
+#include "dsp/rx_power.h"
 #include "dsp/downconverter.h"
+#include "dsp/latency_probe.h"
+#include "dsp/latency_profile.h"
 #include "interfaces/wav_sink.h"
 #include "interfaces/udp_sink_f.h"
 #include "interfaces/audio_sink.h"
+#include "interfaces/iq_stream_sink.h"
 #include "receivers/vfo.h"
 #include "defines.h"
 
 class receiver_base_cf;
 
+/*! \brief Seconds, after which a cached demodulator, that is not in use, is released. */
+#define DEMOD_IDLE_TIMEOUT 60
+
 #if 0
 /** Available demodulators. */
 enum rx_demod {
@@ -96,6 +102,7 @@ public:
     void set_audio_rec_min_time(const int time_ms) override;
     void set_audio_rec_max_gap(const int time_ms) override;
     void set_timestamp_source(wavfile_sink_gqrx::timestamp_source * value){ wav_sink->set_timestamp_source(value); }
+    wavfile_sink_gqrx::sptr get_wav_sink() { return wav_sink; }
 
     /* UDP  streaming */
     bool         set_udp_host(const std::string &host) override;
@@ -105,6 +112,7 @@ public:
     inline bool  get_udp_streaming() const { return d_udp_streaming; }
 
     virtual float get_signal_level();
+    virtual bool  get_sql_open();
 
     void set_demod(Modulations::idx demod) override;
 
@@ -155,7 +163,31 @@ public:
     std::string get_dedicated_audio_dev() { return d_audio_dev; }
     void set_audio_dev(std::string audio_dev) { d_audio_dev = audio_dev; }
 
+    /* Latency measurement */
+    void set_latency_probe(bool enabled);
+    latency_stats get_latency();
+
+    /* Latency profile */
+    virtual void set_latency_profile(latency_profile profile);
+    latency_profile get_latency_profile() const { return d_latency_profile; }
+    double get_latency_budget() const { return d_latency_budget; }
+
+    /* Demodulator cache */
+    virtual void release_idle_demods();
+
+    /* I/Q streaming */
+    void add_iq_tap(iq_stream_sink_sptr tap);
+    void remove_iq_tap(iq_stream_sink_sptr tap);
+    const std::vector<iq_stream_sink_sptr> &get_iq_taps() const { return d_iq_taps; }
+    double get_iq_tap_rate(iq_stream_sink::stage where) const;
+
 protected:
+    typedef std::chrono::steady_clock::time_point demod_time;
+
+    static demod_time demod_now() { return std::chrono::steady_clock::now(); }
+    static bool demod_idle(const demod_time &last_used);
+
+
     bool         d_connected;
     int          d_port;
     double       d_decim_rate;   /*!< Quadrature rate (before down-conversion) */
@@ -168,17 +200,20 @@ protected:
     bool         d_udp_streaming;
     bool         d_dedicated_audio_sink;
     std::string  d_audio_dev;
+    latency_profile d_latency_profile;
+    double       d_latency_budget;  /*!< Longest time a sample can spend in the VFO. */
 
     downconverter_cc_sptr     ddc;        /*!< Digital down-converter for demod chain. */
     resampler_cc_sptr         iq_resamp;   /*!< Baseband resampler. */
-    rx_meter_c_sptr           meter;      /*!< Signal strength. */
     rx_agc_2f_sptr            agc;        /*!< Receiver AGC. */
-    rx_sql_cc_sptr            sql;        /*!< Squelch. */
+    rx_power_cc_sptr          pwr;        /*!< Signal strength, squelch and recorder trigger. */
     wavfile_sink_gqrx::sptr   wav_sink;   /*!< WAV file sink for recording. */
     udp_sink_f_sptr           audio_udp_sink;  /*!< UDP sink to stream audio over the network. */
     gr::basic_block_sptr      audio_snk;  /*!< Dedicated audio sink. */
     rx_rnnoise_f_sptr         audio_rnnoise;
+    latency_probe_sink_sptr   latency_probe; /*!< Latency probe at the VFO output. */
     gr::basic_block_sptr      output;
+    std::vector<iq_stream_sink_sptr> d_iq_taps; /*!< I/Q stream sinks. */
 private:
     rec_event_handler_t d_rec_event;
     static void rec_event(receiver_base_cf * self, std::string filename, bool is_running);
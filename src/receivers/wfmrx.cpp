@@ -23,7 +23,6 @@
  */
 #include <cmath>
 #include <iostream>
-#include <QDebug>
 #include "receivers/wfmrx.h"
 
 wfmrx_sptr make_wfmrx(double quad_rate, float audio_rate)
@@ -39,22 +38,15 @@ wfmrx::wfmrx(double quad_rate, float audio_rate)
     filter = make_rx_filter((double)WFM_PREF_QUAD_RATE, -80000.0, 80000.0, 20000.0);
     /* demodulator */
     demod_fm = gr::analog::quadrature_demod_cf::make((double)WFM_PREF_QUAD_RATE / (2.0 * M_PI * 75000.0));
-    stereo = make_stereo_demod(WFM_PREF_QUAD_RATE, d_audio_rate, true);
-    stereo_oirt = make_stereo_demod(WFM_PREF_QUAD_RATE, d_audio_rate, true, true);
     mono = make_stereo_demod(WFM_PREF_QUAD_RATE, d_audio_rate, false);
 
-    /* create rds blocks but dont connect them */
-    rds = make_rx_rds((double)WFM_PREF_QUAD_RATE);
-    rds_decoder = gr::rds::decoder::make(0, 0);
-    rds_parser = gr::rds::parser::make(0, 0, 0);
-    rds_store = make_rx_rds_store();
+    /* stereo demodulators and rds blocks are built on first use */
     rds_enabled = false;
 
     connect(ddc, 0, iq_resamp, 0);
     connect(iq_resamp, 0, filter, 0);
-    connect(filter, 0, meter, 0);
-    connect(filter, 0, sql, 0);
-    connect(sql, 0, demod_fm, 0);
+    connect(filter, 0, pwr, 0);
+    connect(pwr, 0, demod_fm, 0);
     connect(demod_fm, 0, mono, 0);
     connect(mono, 0, output, 0); // left  channel
     connect(mono, 1, output, 1); // right channel
@@ -99,6 +91,26 @@ void wfmrx::set_audio_rate(int audio_rate)
     }
 }
 
+void wfmrx::set_latency_profile(latency_profile profile)
+{
+    receiver_base_cf::set_latency_profile(profile);
+
+    int max_buffer = latency_buffer_items(profile, WFM_PREF_QUAD_RATE);
+    filter->set_max_output_buffer(max_buffer);
+    demod_fm->set_max_output_buffer(max_buffer);
+    d_latency_budget += latency_block_time(1, max_buffer, sizeof(gr_complex), WFM_PREF_QUAD_RATE);
+    d_latency_budget += latency_block_time(1, max_buffer, sizeof(float), WFM_PREF_QUAD_RATE);
+
+    int multiple = latency_batch_items(profile, d_audio_rate, 1);
+    max_buffer = latency_buffer_items(profile, d_audio_rate);
+    mono->set_buffering(multiple, max_buffer);
+    if (stereo)
+        stereo->set_buffering(multiple, max_buffer);
+    if (stereo_oirt)
+        stereo_oirt->set_buffering(multiple, max_buffer);
+    d_latency_budget += latency_block_time(multiple, max_buffer, sizeof(float), d_audio_rate);
+}
+
 void wfmrx::set_filter(int low, int high, int tw)
 {
     receiver_base_cf::set_filter(low, high, tw);
@@ -151,6 +163,7 @@ void wfmrx::set_demod(Modulations::idx demod)
         break;
 
     case Modulations::MODE_WFM_STEREO:
+        get_stereo_demod(demod);
         connect(demod_fm, 0, stereo, 0);
         connect(stereo, 0, output, 0); // left  channel
         connect(stereo, 1, output, 1); // right channel
@@ -158,31 +171,85 @@ void wfmrx::set_demod(Modulations::idx demod)
         break;
 
     case Modulations::MODE_WFM_STEREO_OIRT:
+        get_stereo_demod(demod);
         connect(demod_fm, 0, stereo_oirt, 0);
         connect(stereo_oirt, 0, output, 0); // left  channel
         connect(stereo_oirt, 1, output, 1); // right channel
         stereo_oirt->set_audio_rate(d_audio_rate);
         break;
     }
+    if (receiver_base_cf::get_demod() == Modulations::MODE_WFM_STEREO)
+        d_stereo_used = demod_now();
+    else if (receiver_base_cf::get_demod() == Modulations::MODE_WFM_STEREO_OIRT)
+        d_stereo_oirt_used = demod_now();
     receiver_base_cf::set_demod(demod);
+    release_idle_demods();
+}
 
+/**
+ * @brief Get a stereo demodulator, build it if it is not cached.
+ *
+ * A new demodulator gets the current de-emphasis and latency profile.
+ */
+stereo_demod_sptr wfmrx::get_stereo_demod(Modulations::idx demod)
+{
+    bool oirt = (demod == Modulations::MODE_WFM_STEREO_OIRT);
+    stereo_demod_sptr &sd = oirt ? stereo_oirt : stereo;
+
+    if (!sd)
+    {
+        sd = make_stereo_demod(WFM_PREF_QUAD_RATE, d_audio_rate, true, oirt);
+        sd->set_tau((double)get_wfm_deemph());
+        sd->set_buffering(latency_batch_items(d_latency_profile, d_audio_rate, 1),
+                          latency_buffer_items(d_latency_profile, d_audio_rate));
+    }
+    return sd;
+}
+
+void wfmrx::release_idle_demods()
+{
+    Modulations::idx current = receiver_base_cf::get_demod();
+
+    if (current != Modulations::MODE_WFM_STEREO && demod_idle(d_stereo_used))
+        stereo.reset();
+    if (current != Modulations::MODE_WFM_STEREO_OIRT && demod_idle(d_stereo_oirt_used))
+        stereo_oirt.reset();
+    if (!rds_enabled && demod_idle(d_rds_used))
+    {
+        rds.reset();
+        rds_decoder.reset();
+        rds_parser.reset();
+        rds_store.reset();
+    }
 }
 
 void wfmrx::set_wfm_deemph(float tau)
 {
     receiver_base_cf::set_wfm_deemph(tau);
     mono->set_tau((double)tau);
-    stereo->set_tau((double)tau);
-    stereo_oirt->set_tau((double)tau);
+    if (stereo)
+        stereo->set_tau((double)tau);
+    if (stereo_oirt)
+        stereo_oirt->set_tau((double)tau);
 }
 
 void wfmrx::get_rds_data(std::string &outbuff, int &num)
 {
-    rds_store->get_message(outbuff, num);
+    if (rds_store)
+        rds_store->get_message(outbuff, num);
+    else
+        num = -1;
 }
 
 void wfmrx::start_rds_decoder()
 {
+    if (!rds)
+    {
+        rds = make_rx_rds((double)WFM_PREF_QUAD_RATE);
+        rds_decoder = gr::rds::decoder::make(0, 0);
+        rds_parser = gr::rds::parser::make(0, 0, 0);
+        rds_store = make_rx_rds_store();
+    }
     connect(demod_fm, 0, rds, 0);
     connect(rds, 0, rds_decoder, 0);
     msg_connect(rds_decoder, "out", rds_parser, "in");
@@ -199,11 +266,13 @@ void wfmrx::stop_rds_decoder()
     msg_disconnect(rds_parser, "out", rds_store, "store");
     unlock();
     rds_enabled=false;
+    d_rds_used = demod_now();
 }
 
 void wfmrx::reset_rds_parser()
 {
-    rds_parser->reset();
+    if (rds_parser)
+        rds_parser->reset();
 }
 
 bool wfmrx::is_rds_decoder_active()
@@ -61,6 +61,7 @@ public:
     bool stop() override;
 
     void set_audio_rate(int audio_rate) override;
+    void set_latency_profile(latency_profile profile) override;
 
     void set_filter(int low, int high, int tw) override;
 
@@ -76,16 +77,25 @@ public:
     void reset_rds_parser() override;
     bool is_rds_decoder_active() override;
 
+    void release_idle_demods() override;
+
+private:
+    stereo_demod_sptr get_stereo_demod(Modulations::idx demod);
+
 private:
     bool   d_running;          /*!< Whether receiver is running or not. */
+    demod_time d_stereo_used;      /*!< When the stereo demodulator was last in use. */
+    demod_time d_stereo_oirt_used; /*!< When the OIRT stereo demodulator was last in use. */
+    demod_time d_rds_used;         /*!< When the RDS decoder was last in use. */
 
     rx_filter_sptr            filter;    /*!< Non-translating bandpass filter.*/
 
     gr::analog::quadrature_demod_cf::sptr demod_fm;  /*!< FM demodulator. */
-    stereo_demod_sptr         stereo;    /*!< FM stereo demodulator. */
-    stereo_demod_sptr         stereo_oirt;    /*!< FM stereo oirt demodulator. */
+    stereo_demod_sptr         stereo;    /*!< FM stereo demodulator, built on first use. */
+    stereo_demod_sptr         stereo_oirt;    /*!< FM stereo oirt demodulator, built on first use. */
     stereo_demod_sptr         mono;      /*!< FM stereo demodulator OFF. */
 
+    /* The RDS blocks are built, when the decoder is started first */
     rx_rds_sptr               rds;       /*!< RDS decoder */
     rx_rds_store_sptr         rds_store; /*!< RDS decoded messages */
     gr::rds::decoder::sptr    rds_decoder;